@@ -0,0 +1,295 @@
+#include "AsyncLog.h"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <string>
+
+using namespace tmms::base;
+
+namespace
+{
+    // 崩溃时要写出的日志，信号处理里只能访问全局变量
+    static AsyncLogPtr crash_log;
+
+    // 崩溃信号处理：写出还没写的日志，再按默认方式处理信号（生成 core 等）
+    void OnCrashSignal(int sig)
+    {
+        if (crash_log)
+        {
+            crash_log->CrashFlush();
+        }
+        // 安装时带了 SA_RESETHAND，这里已经恢复成默认处理
+        ::raise(sig);
+    }
+}
+
+AsyncLog::AsyncLog(const FileLogPtr &log, size_t buffer_size, size_t max_buffers)
+    : log_(log), buffer_size_(buffer_size), max_buffers_(max_buffers < 2 ? 2 : max_buffers)
+{
+    // 先准备好当前缓冲和一个备用缓冲
+    current_ = TakeBufferLocked();
+    free_.emplace_back(TakeBufferLocked());
+}
+
+AsyncLog::~AsyncLog()
+{
+    Stop();
+}
+// 设置溢出策略
+void AsyncLog::SetOverflowPolicy(LogOverflowPolicy policy)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    policy_ = policy;
+}
+// 设置刷新间隔
+void AsyncLog::SetFlushInterval(int32_t ms)
+{
+    flush_interval_ = ms > 0 ? ms : 1;
+}
+// 启动后台线程
+void AsyncLog::Start()
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    if (running_)
+    {
+        return;
+    }
+    running_ = true;
+    quit_ = false;
+    thread_ = std::thread([this]()
+                          { OnWork(); });
+}
+// 写完所有缓冲后停止后台线程
+void AsyncLog::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        if (!running_ || quit_)
+        {
+            return;
+        }
+        quit_ = true;
+        cond_.notify_one();
+    }
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+
+    // 后台线程最后一次取走缓冲之后追加的日志，在锁里写完再切换到同步写，同一个线程的日志不会乱序
+    std::lock_guard<std::mutex> lk(lock_);
+    for (auto &b : full_)
+    {
+        if (log_)
+        {
+            log_->WriteLog(b->data.get(), b->len);
+        }
+        written_ += b->len;
+        b->len = 0;
+        free_.emplace_back(std::move(b));
+    }
+    full_.clear();
+    if (current_ && current_->len > 0)
+    {
+        if (log_)
+        {
+            log_->WriteLog(current_->data.get(), current_->len);
+        }
+        written_ += current_->len;
+        current_->len = 0;
+    }
+    running_ = false;
+    done_.notify_all();
+}
+// 追加一条日志
+void AsyncLog::Append(const char *data, size_t size)
+{
+    // 超过一个缓冲的日志截断
+    if (size > buffer_size_)
+    {
+        size = buffer_size_;
+    }
+
+    std::unique_lock<std::mutex> lk(lock_);
+    while (true)
+    {
+        if (!running_)
+        {
+            // 没有启动或者已经停止，直接同步写；持锁写，和 CrashFlush 之外的写入不交错
+            if (log_)
+            {
+                log_->WriteLog(data, size);
+            }
+            written_ += size;
+            return;
+        }
+        if (current_ && current_->Avail() >= size)
+        {
+            memcpy(current_->data.get() + current_->len, data, size);
+            current_->len += size;
+            return;
+        }
+        // 当前缓冲写满了，交给后台线程，换一个空缓冲
+        if (current_)
+        {
+            full_.emplace_back(std::move(current_));
+            cond_.notify_one();
+        }
+        current_ = TakeBufferLocked();
+        if (current_)
+        {
+            continue;
+        }
+        // 缓冲用完了
+        if (policy_ == kLogOverflowDrop)
+        {
+            dropped_++;
+            return;
+        }
+        done_.wait(lk);
+        if (!current_)
+        {
+            current_ = TakeBufferLocked();
+        }
+    }
+}
+// 等待在这之前追加的日志都写到文件
+void AsyncLog::Flush()
+{
+    std::unique_lock<std::mutex> lk(lock_);
+    if (!running_)
+    {
+        return;
+    }
+    auto target = ++flush_requested_;
+    cond_.notify_one();
+    done_.wait(lk, [this, target]()
+               { return flushed_ >= target || !running_; });
+}
+// 丢弃的日志条数
+uint64_t AsyncLog::Dropped() const
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    return dropped_;
+}
+// 写到文件的字节数
+uint64_t AsyncLog::Written() const
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    return written_;
+}
+// 崩溃时不加锁地写出还没写的缓冲
+void AsyncLog::CrashFlush()
+{
+    // 崩溃的线程可能正持有锁，加锁会死锁；这里尽力而为，后台线程正在写的那一批可能丢失
+    if (!log_)
+    {
+        return;
+    }
+    for (auto &b : full_)
+    {
+        if (b && b->len > 0)
+        {
+            log_->WriteLog(b->data.get(), b->len);
+        }
+    }
+    if (current_ && current_->len > 0)
+    {
+        log_->WriteLog(current_->data.get(), current_->len);
+    }
+}
+// 安装崩溃信号处理
+void AsyncLog::InstallCrashHandler(const std::shared_ptr<AsyncLog> &log)
+{
+    crash_log = log;
+    struct sigaction sa;
+    memset(&sa, 0x00, sizeof(sa));
+    sa.sa_handler = OnCrashSignal;
+    sigemptyset(&sa.sa_mask);
+    // 处理一次后恢复默认处理，信号处理里再次崩溃或者重新发送信号时直接结束进程
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+    for (int sig : {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL})
+    {
+        ::sigaction(sig, &sa, nullptr);
+    }
+}
+// 后台线程：按大小或者时间取走缓冲，在锁外批量写
+void AsyncLog::OnWork()
+{
+    std::vector<BufferPtr> writing;
+    uint64_t reported = 0;
+    while (true)
+    {
+        uint64_t target = 0;
+        uint64_t dropped = 0;
+        bool exit = false;
+        {
+            std::unique_lock<std::mutex> lk(lock_);
+            if (full_.empty() && !quit_ && flush_requested_ == flushed_)
+            {
+                cond_.wait_for(lk, std::chrono::milliseconds(flush_interval_));
+            }
+            // 没写满的当前缓冲也一起取走，日志最多延迟一个刷新间隔
+            if (current_ && current_->len > 0)
+            {
+                full_.emplace_back(std::move(current_));
+                current_ = TakeBufferLocked();
+            }
+            writing.swap(full_);
+            target = flush_requested_;
+            dropped = dropped_;
+            exit = quit_;
+        }
+
+        // 在锁外写，写日志的线程这时只和空闲缓冲打交道
+        size_t bytes = 0;
+        if (dropped > reported && log_)
+        {
+            auto msg = "AsyncLog dropped " + std::to_string(dropped - reported) + " log messages\n";
+            log_->WriteLog(msg.data(), msg.size());
+            reported = dropped;
+        }
+        for (auto &b : writing)
+        {
+            if (log_)
+            {
+                log_->WriteLog(b->data.get(), b->len);
+            }
+            bytes += b->len;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(lock_);
+            for (auto &b : writing)
+            {
+                b->len = 0;
+                free_.emplace_back(std::move(b));
+            }
+            writing.clear();
+            written_ += bytes;
+            flushed_ = target;
+            // 缓冲用完时被阻塞的线程和等待刷新的线程
+            done_.notify_all();
+        }
+        if (exit)
+        {
+            break;
+        }
+    }
+}
+// 取一个空缓冲
+AsyncLog::BufferPtr AsyncLog::TakeBufferLocked()
+{
+    if (!free_.empty())
+    {
+        auto b = std::move(free_.back());
+        free_.pop_back();
+        return b;
+    }
+    if (allocated_ >= max_buffers_)
+    {
+        return BufferPtr();
+    }
+    allocated_++;
+    return BufferPtr(new Buffer(buffer_size_));
+}
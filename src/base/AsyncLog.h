@@ -0,0 +1,121 @@
+#pragma once
+/*
+    AsyncLog 异步日志后端
+    Logger::Write 直接调用 FileLog::WriteLog 时，每条日志都在调用线程里 ::write 一次，磁盘一卡就卡住 I/O 循环
+    AsyncLog 用双缓冲：写日志的线程只在锁里把日志拷进当前缓冲，缓冲写满或者到了刷新间隔时，
+    后台线程把写满的缓冲整批取走，在锁外一次写一个缓冲，写完把缓冲还回空闲列表重复使用
+    缓冲的总个数有上限，内存有界；缓冲用完时按溢出策略丢弃（计数，后台线程写一条丢弃了多少条的提示）或者阻塞等待
+    InstallCrashHandler 安装崩溃信号处理，进程崩溃时把还没写的缓冲直接写到文件里，再按默认方式结束进程
+*/
+#include "NonCopyable.h"
+#include "FileLog.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tmms
+{
+    namespace base
+    {
+        // 每个缓冲的大小，单位：字节
+        const size_t kAsyncLogBufferSize = 1024 * 1024;
+        // 缓冲个数的上限，内存最多占用 kAsyncLogBufferSize * kAsyncLogMaxBuffers
+        const size_t kAsyncLogMaxBuffers = 16;
+        // 没写满的缓冲最多等待多久就写到文件，单位：毫秒
+        const int32_t kAsyncLogFlushInterval = 1000;
+
+        // 缓冲用完时的处理方式
+        enum LogOverflowPolicy
+        {
+            kLogOverflowDrop = 0,   // 丢弃这条日志并计数，写日志的线程不会被阻塞
+            kLogOverflowBlock = 1,  // 等待后台线程写完一个缓冲，不丢日志
+        };
+
+        class AsyncLog : public NonCopyable
+        {
+        public:
+            // buffer_size 是每个缓冲的大小，超过的单条日志会被截断；max_buffers 是缓冲个数的上限，至少为 2
+            AsyncLog(const FileLogPtr &log, size_t buffer_size = kAsyncLogBufferSize, size_t max_buffers = kAsyncLogMaxBuffers);
+            ~AsyncLog();
+
+            // 设置溢出策略，默认丢弃
+            void SetOverflowPolicy(LogOverflowPolicy policy);
+            // 设置刷新间隔，单位：毫秒，在 Start 之前调用
+            void SetFlushInterval(int32_t ms);
+
+            // 启动后台线程
+            void Start();
+            // 写完所有缓冲后停止后台线程，之后的日志直接同步写
+            void Stop();
+
+            // 追加一条日志，可以在任意线程调用；没有启动时直接同步写
+            void Append(const char *data, size_t size);
+            // 等待在这之前追加的日志都写到文件
+            void Flush();
+
+            // 丢弃的日志条数
+            uint64_t Dropped() const;
+            // 写到文件的字节数
+            uint64_t Written() const;
+
+            // 不加锁地把还没写的缓冲直接写到文件，只在崩溃信号处理里调用
+            void CrashFlush();
+            // 安装 SIGSEGV、SIGABRT、SIGBUS、SIGFPE、SIGILL 的处理，崩溃时调用 log 的 CrashFlush
+            static void InstallCrashHandler(const std::shared_ptr<AsyncLog> &log);
+
+        private:
+            // 一个固定大小的缓冲
+            struct Buffer
+            {
+                explicit Buffer(size_t capacity) : data(new char[capacity]), cap(capacity) {}
+                size_t Avail() const { return cap - len; }
+
+                std::unique_ptr<char[]> data;
+                size_t len{0};
+                size_t cap{0};
+            };
+            using BufferPtr = std::unique_ptr<Buffer>;
+
+            // 后台线程
+            void OnWork();
+            // 取一个空缓冲，空闲列表为空且个数已到上限时返回空，调用方持有 lock_
+            BufferPtr TakeBufferLocked();
+
+            FileLogPtr log_;
+            size_t buffer_size_{kAsyncLogBufferSize};
+            size_t max_buffers_{kAsyncLogMaxBuffers};
+            LogOverflowPolicy policy_{kLogOverflowDrop};
+            int32_t flush_interval_{kAsyncLogFlushInterval};
+
+            mutable std::mutex lock_;
+            // 唤醒后台线程：缓冲写满、请求刷新或者停止
+            std::condition_variable cond_;
+            // 唤醒写日志和等待刷新的线程：后台线程写完一批缓冲
+            std::condition_variable done_;
+            // 正在追加的缓冲，缓冲用完时为空
+            BufferPtr current_;
+            // 写满等待后台线程写的缓冲
+            std::vector<BufferPtr> full_;
+            // 空闲的缓冲
+            std::vector<BufferPtr> free_;
+            // 已经分配的缓冲个数
+            size_t allocated_{0};
+
+            bool running_{false};
+            // 正在停止，后台线程写完这一批后退出
+            bool quit_{false};
+            std::thread thread_;
+
+            // 请求刷新的次数和后台线程已经完成的刷新次数
+            uint64_t flush_requested_{0};
+            uint64_t flushed_{0};
+
+            uint64_t dropped_{0};
+            uint64_t written_{0};
+        };
+        using AsyncLogPtr = std::shared_ptr<AsyncLog>;
+    }
+}
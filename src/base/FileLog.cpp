@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <errno.h>
 #include <iostream>
 
 using namespace tmms::base;
@@ -26,6 +27,26 @@ size_t FileLog::WriteLog(const std::string &msg) // 写入日志
     return ::write(fd, msg.data(), msg.size());
 }
 
+size_t FileLog::WriteLog(const char *data, size_t size) // 写入一整块日志
+{
+    int fd = fd_ == -1 ? 1 : fd_;
+    size_t done = 0;
+    while (done < size)
+    {
+        auto ret = ::write(fd, data + done, size - done);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        done += ret;
+    }
+    return done;
+}
+
 void FileLog::Rotate(const std::string &file) // 切分日志文件
 {
     if (file_path_.empty())
@@ -21,6 +21,7 @@ namespace tmms
 
             bool Open(const std::string &filePath);// 打开日志文件
             size_t WriteLog(const std::string &msg);// 写入日志
+            size_t WriteLog(const char *data, size_t size);// 写入一整块日志，写到全部写完或者出错，不分配内存，崩溃信号处理里也可以调用
             void Rotate(const std::string &file);// 切分日志文件
             void SetRotate(RotateType type);// 设置切分类型
             RotateType GetRotateType() const;// 获取当前的切分类型
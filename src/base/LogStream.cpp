@@ -1,13 +1,19 @@
 #include "LogStream.h"
 #include "TTime.h"
+#include <cmath>
+#include <cstdio>
 #include <string.h>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include <time.h>
 #include <iostream>
 
 using namespace tmms::base;
 Logger *tmms::base::g_logger = nullptr;
 static thread_local pid_t thread_id = 0;
+// 格式化好的线程 ID 和后面的空格，每个线程只格式化一次
+static thread_local char thread_id_buf[16];
+static thread_local size_t thread_id_len = 0;
 
 const char *log_stream[] = {
     "TRACE",
@@ -17,11 +23,54 @@ const char *log_stream[] = {
     "ERROR"
 };
 
+namespace
+{
+    // 00 到 99 的两位数字，整数转换时一次查出两位
+    const char kDigitPairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
 
+    // 把无符号整数写到 end 之前，返回第一个字符的位置
+    char *FormatUnsigned(unsigned long long v, char *end)
+    {
+        char *p = end;
+        while (v >= 100)
+        {
+            auto i = (v % 100) * 2;
+            v /= 100;
+            *--p = kDigitPairs[i + 1];
+            *--p = kDigitPairs[i];
+        }
+        if (v < 10)
+        {
+            *--p = (char)('0' + v);
+        }
+        else
+        {
+            auto i = v * 2;
+            *--p = kDigitPairs[i + 1];
+            *--p = kDigitPairs[i];
+        }
+        return p;
+    }
+
+    // 定点格式能精确表示的范围，超出的交给 snprintf
+    const double kFixedMax = 1e12;
+    const double kFixedMin = 1e-4;
+    const unsigned long long kFracScale = 1000000;
+}
 
- LogStream::LogStream(Logger *logger, const char *file, int line, LogLevel l, const char *func)
- : logger_(logger) 
- {
+LogStream::LogStream(Logger *logger, const char *file, int line, LogLevel l, const char *func)
+    : logger_(logger)
+{
     //提取文件名
     const char *filename = strrchr(file, '/');//从完整文件路径中找到最后一个 /
     if (filename == nullptr)
@@ -32,30 +81,233 @@ const char *log_stream[] = {
     {
         filename++; // 说明找到了 '/', 跳过 '/'
     }
-    stream_ << TTime::ISOTime()<<"  ";
-    if(thread_id == 0)
+    size_t time_len = 0;
+    const char *time = TTime::CachedISOTime(time_len);
+    Append(time, time_len);
+    Append("  ", 2);
+    if (thread_id == 0)
     {
         thread_id = static_cast<pid_t>(::syscall(SYS_gettid)); // 获取当前线程ID
+        char *end = thread_id_buf + sizeof(thread_id_buf) - 1;
+        *end = ' ';
+        char *p = FormatUnsigned((unsigned long long)thread_id, end);
+        thread_id_len = end + 1 - p;
+        memmove(thread_id_buf, p, thread_id_len);
     }
-    stream_<<thread_id<<" ";
-    stream_<< log_stream[l];
-    stream_ << " [" << filename << ":" << line << "] ";
-    if(func)
+    Append(thread_id_buf, thread_id_len);
+    *this << log_stream[l];
+    Append(" [", 2);
+    *this << filename;
+    Append(":", 1);
+    *this << line;
+    Append("] ", 2);
+    if (func)
     {
-        stream_ << " ["<<func << "] ";
+        Append(" [", 2);
+        *this << func;
+        Append("] ", 2);
     }
-
- }
+}
 LogStream::~LogStream()
 {
-    stream_ << "\n";
+    buf_[len_++] = '\n';
     if (logger_)
     {
-        logger_->Write(stream_.str());
+        logger_->Write(buf_, len_);
     }
     else
     {
-        std::cout<< stream_.str()<< std::endl;
+        std::cout.write(buf_, len_);
+        std::cout.flush();
+    }
+}
+// 追加一段数据，最后一个字节留给换行
+void LogStream::Append(const char *data, size_t size)
+{
+    size_t avail = kLogLineMax - 1 - len_;
+    if (size > avail)
+    {
+        size = avail;
     }
+    memcpy(buf_ + len_, data, size);
+    len_ += size;
+}
+// 注明压掉的条数
+LogStream &LogStream::Suppressed(uint64_t count)
+{
+    if (count > 0)
+    {
+        Append("[suppressed ", 12);
+        *this << (unsigned long long)count;
+        Append("] ", 2);
+    }
+    return *this;
+}
+// 粗粒度的单调时钟，精度是一个时钟节拍，读取不进内核
+int64_t LogRateLimiter::CoarseSeconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec;
+}
+template <typename T>
+void LogStream::AppendInteger(T v)
+{
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    char *p;
+    if (v < 0)
+    {
+        // 先转成无符号再取负，最小的负数也不会溢出
+        p = FormatUnsigned(0ULL - (unsigned long long)v, end);
+        *--p = '-';
+    }
+    else
+    {
+        p = FormatUnsigned((unsigned long long)v, end);
+    }
+    Append(p, end - p);
+}
+LogStream &LogStream::operator<<(bool v)
+{
+    // 和 std::ostream 的默认格式一样输出 1/0
+    Append(v ? "1" : "0", 1);
+    return *this;
+}
+LogStream &LogStream::operator<<(char v)
+{
+    Append(&v, 1);
+    return *this;
+}
+LogStream &LogStream::operator<<(signed char v)
+{
+    return *this << (char)v;
+}
+LogStream &LogStream::operator<<(unsigned char v)
+{
+    return *this << (char)v;
+}
+LogStream &LogStream::operator<<(short v)
+{
+    AppendInteger(v);
+    return *this;
+}
+LogStream &LogStream::operator<<(unsigned short v)
+{
+    AppendInteger(v);
+    return *this;
+}
+LogStream &LogStream::operator<<(int v)
+{
+    AppendInteger(v);
+    return *this;
+}
+LogStream &LogStream::operator<<(unsigned int v)
+{
+    AppendInteger(v);
+    return *this;
+}
+LogStream &LogStream::operator<<(long v)
+{
+    AppendInteger(v);
+    return *this;
+}
+LogStream &LogStream::operator<<(unsigned long v)
+{
+    AppendInteger(v);
+    return *this;
+}
+LogStream &LogStream::operator<<(long long v)
+{
+    AppendInteger(v);
+    return *this;
+}
+LogStream &LogStream::operator<<(unsigned long long v)
+{
+    AppendInteger(v);
+    return *this;
+}
+LogStream &LogStream::operator<<(float v)
+{
+    return *this << (double)v;
+}
+LogStream &LogStream::operator<<(double v)
+{
+    double a = std::fabs(v);
+    if (std::isfinite(v) && a < kFixedMax && (a == 0 || a >= kFixedMin))
+    {
+        // 定点格式：整数部分加最多 6 位小数，四舍五入后去掉末尾的 0
+        unsigned long long scaled = (unsigned long long)std::llround(a * kFracScale);
+        unsigned long long ip = scaled / kFracScale;
+        unsigned long long fp = scaled % kFracScale;
 
+        char tmp[40];
+        char *end = tmp + sizeof(tmp);
+        char *p = end;
+        if (fp > 0)
+        {
+            int digits = 6;
+            while (fp % 10 == 0)
+            {
+                fp /= 10;
+                digits--;
+            }
+            char *frac = FormatUnsigned(fp, end);
+            // 小数部分前面补 0
+            while (end - frac < digits)
+            {
+                *--frac = '0';
+            }
+            p = frac;
+            *--p = '.';
+        }
+        p = FormatUnsigned(ip, p);
+        if (v < 0 && scaled > 0)
+        {
+            *--p = '-';
+        }
+        Append(p, end - p);
+        return *this;
+    }
+    char tmp[32];
+    auto n = snprintf(tmp, sizeof(tmp), "%g", v);
+    if (n > 0)
+    {
+        Append(tmp, n < (int)sizeof(tmp) ? n : sizeof(tmp) - 1);
+    }
+    return *this;
+}
+LogStream &LogStream::operator<<(const char *v)
+{
+    if (v)
+    {
+        Append(v, strlen(v));
+    }
+    else
+    {
+        Append("(null)", 6);
+    }
+    return *this;
+}
+LogStream &LogStream::operator<<(const std::string &v)
+{
+    Append(v.data(), v.size());
+    return *this;
+}
+LogStream &LogStream::operator<<(const void *v)
+{
+    static const char kHex[] = "0123456789abcdef";
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+    auto u = (uintptr_t)v;
+    do
+    {
+        *--p = kHex[u & 0xf];
+        u >>= 4;
+    } while (u);
+    *--p = 'x';
+    *--p = '0';
+    Append(p, end - p);
+    return *this;
 }
@@ -1,44 +1,163 @@
 #pragma once
 #include "Logger.h"
-#include <sstream>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
 
 namespace tmms
 {
     namespace base
     {
         extern Logger *g_logger;
+
+        // 一条日志的最大长度，超过的部分截断
+        const size_t kLogLineMax = 4096;
+
+        /*
+            LogStream 把一条日志格式化到对象自带的定长缓冲里，不分配内存
+            整数按两位一组查表转换，浮点数在常见范围内按定点格式转换（最多 6 位小数，去掉末尾的 0），其余的交给 snprintf
+            时间前缀用 TTime::CachedISOTime，同一秒内每个线程只格式化一次
+        */
         class LogStream
         {
         public:
             LogStream(Logger *logger, const char *file, int line, LogLevel l, const char *func = nullptr);
             ~LogStream();
 
-            template <typename T>
-            LogStream &operator<<(const T &value)
+            LogStream &operator<<(bool v);
+            LogStream &operator<<(char v);
+            LogStream &operator<<(signed char v);
+            LogStream &operator<<(unsigned char v);
+            LogStream &operator<<(short v);
+            LogStream &operator<<(unsigned short v);
+            LogStream &operator<<(int v);
+            LogStream &operator<<(unsigned int v);
+            LogStream &operator<<(long v);
+            LogStream &operator<<(unsigned long v);
+            LogStream &operator<<(long long v);
+            LogStream &operator<<(unsigned long long v);
+            LogStream &operator<<(float v);
+            LogStream &operator<<(double v);
+            LogStream &operator<<(const char *v);
+            LogStream &operator<<(const std::string &v);
+            // 指针按十六进制输出
+            LogStream &operator<<(const void *v);
+
+            // 枚举按整数输出
+            template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+            LogStream &operator<<(T v)
             {
-                stream_ << value;
-                return *this;
+                return *this << (long long)v;
             }
 
+            // 追加一段数据，放不下的部分截断
+            void Append(const char *data, size_t size);
+            // 限频的日志在前面注明上一条之后压掉了多少条，为 0 时不输出
+            LogStream &Suppressed(uint64_t count);
+
         private:
-            std::ostringstream stream_;
+            template <typename T>
+            void AppendInteger(T v);
+
+            // 最后留一个字节给换行
+            char buf_[kLogLineMax];
+            size_t len_{0};
             Logger *logger_{nullptr};
         };
+
+        // 一次限频检查的结果
+        struct LogSample
+        {
+            bool allow{false};
+            // 上一条输出之后被压掉的条数
+            uint64_t suppressed{0};
+        };
+
+        /*
+            每个调用点一个的日志限频器：每一秒里前 first 条都输出，之后每 every 条输出一条
+            秒用粗粒度的单调时钟，换到新的一秒时计数清零，偶发的错误不会因为很久以前的洪峰一直被压着
+            被压掉的条数累计起来，在下一条输出的日志上注明，跨秒的也不会丢
+        */
+        class LogRateLimiter
+        {
+        public:
+            LogRateLimiter(uint64_t first, uint64_t every)
+                : first_(first), every_(every > 0 ? every : 1)
+            {
+            }
+
+            LogSample Sample()
+            {
+                LogSample sample;
+                int64_t now = CoarseSeconds();
+                int64_t window = window_.load(std::memory_order_relaxed);
+                // 只有换秒的那个线程清零，同一时刻别的线程的计数可能被清掉，只影响这一秒输出的条数
+                if (now != window && window_.compare_exchange_strong(window, now, std::memory_order_relaxed))
+                {
+                    count_.store(0, std::memory_order_relaxed);
+                }
+                uint64_t n = count_.fetch_add(1, std::memory_order_relaxed);
+                if (n < first_ || (n - first_ + 1) % every_ == 0)
+                {
+                    sample.allow = true;
+                    sample.suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+                }
+                else
+                {
+                    suppressed_.fetch_add(1, std::memory_order_relaxed);
+                }
+                return sample;
+            }
+
+            // 当前这一秒的调用次数
+            uint64_t Count() const
+            {
+                return count_.load(std::memory_order_relaxed);
+            }
+
+            // 粗粒度的单调时钟，单位：秒
+            static int64_t CoarseSeconds();
+
+        private:
+            uint64_t first_{0};
+            uint64_t every_{1};
+            std::atomic<int64_t> window_{0};
+            std::atomic<uint64_t> count_{0};
+            std::atomic<uint64_t> suppressed_{0};
+        };
     }
 }
+// 级别检查在构造 LogStream 和计算 << 右边的参数之前，没有安装 g_logger 或者级别不够时参数都不会求值
+// 写成 if (!cond) {} else ... 的形式，宏放在调用方的 if/else 里也不会把 else 配错
+#define LOG_LEVEL_ENABLED(level) \
+    (tmms::base::g_logger && tmms::base::g_logger->GetLogLevel() <= (level))
 #define LOG_TRACE                                                  \
-    if (g_logger&&tmms::base::g_logger->GetLogLevel() <= tmms::base::kTrace) \
+    if (!LOG_LEVEL_ENABLED(tmms::base::kTrace)) {} else \
     tmms::base::LogStream(tmms::base::g_logger, __FILE__, __LINE__, tmms::base::kTrace, __func__)
 #define LOG_DEBUG                                                  \
-    if (g_logger&&tmms::base::g_logger->GetLogLevel() <= tmms::base::kDebug) \
+    if (!LOG_LEVEL_ENABLED(tmms::base::kDebug)) {} else \
     tmms::base::LogStream(tmms::base::g_logger, __FILE__, __LINE__, tmms::base::kDebug, __func__)
 #define LOG_INFO                                                  \
-    if (g_logger&&tmms::base::g_logger->GetLogLevel() <= tmms::base::kInfo) \
+    if (!LOG_LEVEL_ENABLED(tmms::base::kInfo)) {} else \
     tmms::base::LogStream(tmms::base::g_logger, __FILE__, __LINE__, tmms::base::kInfo)
 #define LOG_WARN \
+    if (!LOG_LEVEL_ENABLED(tmms::base::kWarn)) {} else \
     tmms::base::LogStream(tmms::base::g_logger, __FILE__, __LINE__, tmms::base::kWarn)
 #define LOG_ERROR \
+    if (!LOG_LEVEL_ENABLED(tmms::base::kError)) {} else \
     tmms::base::LogStream(tmms::base::g_logger, __FILE__, __LINE__, tmms::base::kError)
+
+// 限频的日志：每个调用点每秒前 first 条都输出，之后每 every 条输出一条，并注明中间压掉了多少条
+// 级别不够时连限频器都不碰；lambda 里的静态变量让每个调用点有自己的限频器
+#define LOG_RATE_LIMITER(first, every) \
+    ([]() -> tmms::base::LogRateLimiter & { static tmms::base::LogRateLimiter limiter((first), (every)); return limiter; }())
+#define LOG_LIMITED(level, first, every) \
+    if (!LOG_LEVEL_ENABLED(level)) {} else \
+    for (tmms::base::LogSample tmms_log_sample_ = LOG_RATE_LIMITER(first, every).Sample(); tmms_log_sample_.allow; tmms_log_sample_.allow = false) \
+    tmms::base::LogStream(tmms::base::g_logger, __FILE__, __LINE__, level).Suppressed(tmms_log_sample_.suppressed)
+#define LOG_WARN_LIMITED(first, every) LOG_LIMITED(tmms::base::kWarn, first, every)
+#define LOG_ERROR_LIMITED(first, every) LOG_LIMITED(tmms::base::kError, first, every)
 // 这个宏定义用于在日志流中添加一个值，并返回当前日志流对象的引用，以便可以链式调用。
 //__func__是一个编译器在编译时会自动替换的变量。它会被替换成一个包含当前函数名称的字符串。
 //例如，如果在 int main() 函数中使用了 __func__，它的值就是 "main"
\ No newline at end of file
@@ -15,15 +15,27 @@ LogLevel Logger::GetLogLevel() const
 {
     return level_;
 }
+void Logger::SetAsyncLog(const AsyncLogPtr &async)
+{
+    async_ = async;
+}
 void Logger::Write(const std::string &msg)
 {
-   if (log_)
+    Write(msg.data(), msg.size());
+}
+void Logger::Write(const char *data, size_t size)
+{
+   if (async_)
+   {
+    async_->Append(data, size);
+   }
+   else if (log_)
    {
-    log_->WriteLog(msg);
+    log_->WriteLog(data, size);
    }
    else
    {
-       std::cout<<msg;
+       std::cout.write(data, size);
    
 }
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "NonCopyable.h"
 #include "FileLog.h"
+#include "AsyncLog.h"
 #include <string>
 
 //这个头文件是日志记录器的声明文件，用于定义日志记录器的接口和日志级别枚举。
@@ -27,10 +28,15 @@ namespace tmms
             void SetLogLevel(const LogLevel &level);
             LogLevel GetLogLevel() const;
             void Write(const std::string &msg);
+            // 写入一条已经格式化好的日志，不构造 std::string
+            void Write(const char *data, size_t size);
+            // 设置异步日志后端，设置后 Write 只把日志交给后台线程，不在调用线程里写文件
+            void SetAsyncLog(const AsyncLogPtr &async);
 
         private:
             LogLevel level_{kDebug};
             FileLogPtr log_; 
+            AsyncLogPtr async_;
         };
     }
 }
\ No newline at end of file
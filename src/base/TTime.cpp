@@ -1,4 +1,6 @@
 #include "TTime.h"
+#include <cstdio>
+#include <ctime>
 #include <sys/time.h>
 
 using namespace tmms::base;
@@ -34,9 +36,7 @@ int64_t TTime::Now(int &year, int &month, int &day, int &hour, int &minute, int
 //将当前时间转换为ISO 8601格式的字符串
 std::string TTime::ISOTime()
 {
-    struct timeval tv;
     struct tm tm;
-    gettimeofday(&tv, NULL);
     time_t t = time(NULL);
     localtime_r(&t, &tm);
     char buf[128] = {0};
@@ -44,4 +44,28 @@ std::string TTime::ISOTime()
                      tm.tm_year + 1900,
                      tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
     return std::string(buf, buf + n);
-}
\ No newline at end of file
+}
+
+//当前线程缓存的 ISO 8601 时间，同一秒内的日志直接复用，不用每条都 localtime_r 和 sprintf
+const char *TTime::CachedISOTime(size_t &len)
+{
+    static thread_local time_t cached_second = -1;
+    static thread_local char cached_buf[32];
+    static thread_local size_t cached_len = 0;
+
+    // 粗粒度时钟走 vDSO，不进内核，精度够秒级用
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    if (ts.tv_sec != cached_second)
+    {
+        struct tm tm;
+        localtime_r(&ts.tv_sec, &tm);
+        auto n = snprintf(cached_buf, sizeof(cached_buf), "%4d-%02d-%02dT%02d:%02d:%02d",
+                          tm.tm_year + 1900,
+                          tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        cached_len = n > 0 ? (size_t)n : 0;
+        cached_second = ts.tv_sec;
+    }
+    len = cached_len;
+    return cached_buf;
+}
@@ -12,6 +12,8 @@ namespace tmms
             static int64_t Now();
             static int64_t Now(int &year, int &month, int &day, int &hour, int &minute, int &second);
             static std::string ISOTime();
+            // 当前线程缓存的 ISO 8601 时间，秒变化时才重新格式化，len 返回长度；返回的指针在当前线程下次调用前有效
+            static const char *CachedISOTime(size_t &len);
         };
     }
 }
\ No newline at end of file
@@ -32,6 +32,11 @@ int main(int argc, const char **argv)
     log->SetRotate(log_info->rotate_type);
     g_logger = new Logger(log);
     g_logger->SetLogLevel(log_info->level);
+    // 日志由后台线程批量写文件，I/O 线程不会被磁盘卡住；崩溃时把还没写的日志写出去
+    AsyncLogPtr async_log = std::make_shared<AsyncLog>(log);
+    async_log->Start();
+    AsyncLog::InstallCrashHandler(async_log);
+    g_logger->SetAsyncLog(async_log);
 
 
     TaskPtr task4 = std::make_shared<Task>([](const TaskPtr &task)
@@ -0,0 +1,272 @@
+#include "DnsPacket.h"
+#include <cctype>
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace tmms::network;
+
+namespace
+{
+    // 压缩指针最多跳转的次数
+    const int kMaxPointerJumps = 16;
+
+    void Put16(std::string *out, uint16_t v)
+    {
+        out->push_back((char)(v >> 8));
+        out->push_back((char)(v & 0xff));
+    }
+
+    uint16_t Get16(const char *buf)
+    {
+        uint16_t v;
+        memcpy(&v, buf, sizeof(v));
+        return ntohs(v);
+    }
+
+    uint32_t Get32(const char *buf)
+    {
+        uint32_t v;
+        memcpy(&v, buf, sizeof(v));
+        return ntohl(v);
+    }
+
+    // 从 offset 开始读一个名字，name 不为空时输出点分的小写名字，offset 移到名字之后
+    bool ReadName(const char *data, size_t size, size_t *offset, std::string *name)
+    {
+        size_t pos = *offset;
+        // 第一次跳转之前的位置就是名字在原处的结尾
+        size_t end = 0;
+        int jumps = 0;
+        while (true)
+        {
+            if (pos >= size)
+            {
+                return false;
+            }
+            uint8_t len = (uint8_t)data[pos];
+            if (len == 0)
+            {
+                pos++;
+                break;
+            }
+            if ((len & 0xc0) == 0xc0)
+            {
+                if (pos + 1 >= size || ++jumps > kMaxPointerJumps)
+                {
+                    return false;
+                }
+                if (end == 0)
+                {
+                    end = pos + 2;
+                }
+                pos = ((len & 0x3f) << 8) | (uint8_t)data[pos + 1];
+                continue;
+            }
+            if ((len & 0xc0) != 0 || pos + 1 + len > size)
+            {
+                return false;
+            }
+            if (name)
+            {
+                if (!name->empty())
+                {
+                    name->push_back('.');
+                }
+                for (size_t i = 0; i < len; i++)
+                {
+                    name->push_back((char)tolower((unsigned char)data[pos + 1 + i]));
+                }
+                if (name->size() > 255)
+                {
+                    return false;
+                }
+            }
+            pos += 1 + len;
+        }
+        *offset = end > 0 ? end : pos;
+        return true;
+    }
+
+    // 读一条资源记录的固定部分，返回 rdata 的位置和长度，name 不为空时输出记录的名字
+    bool ReadRecord(const char *data, size_t size, size_t *offset, uint16_t *type, uint32_t *ttl, size_t *rdata, uint16_t *rdlen,
+                    std::string *name = nullptr)
+    {
+        if (!ReadName(data, size, offset, name) || *offset + 10 > size)
+        {
+            return false;
+        }
+        *type = Get16(data + *offset);
+        *ttl = Get32(data + *offset + 4);
+        *rdlen = Get16(data + *offset + 8);
+        *rdata = *offset + 10;
+        if (*rdata + *rdlen > size)
+        {
+            return false;
+        }
+        // TTL 的最高位为 1 时按 0 处理（RFC 2181）
+        if (*ttl > 0x7fffffff)
+        {
+            *ttl = 0;
+        }
+        *offset = *rdata + *rdlen;
+        return true;
+    }
+}
+
+// 编码一个查询
+bool DnsPacket::EncodeQuery(uint16_t id, const std::string &host, uint16_t qtype, std::string *out)
+{
+    auto name = Normalize(host);
+    if (name.empty() || name.size() > 253)
+    {
+        return false;
+    }
+    out->clear();
+    Put16(out, id);
+    // 只设置 RD，请求递归解析
+    Put16(out, 0x0100);
+    Put16(out, 1);
+    Put16(out, 0);
+    Put16(out, 0);
+    Put16(out, 0);
+
+    size_t start = 0;
+    while (start <= name.size())
+    {
+        auto dot = name.find('.', start);
+        if (dot == std::string::npos)
+        {
+            dot = name.size();
+        }
+        size_t len = dot - start;
+        if (len == 0 || len > 63)
+        {
+            return false;
+        }
+        out->push_back((char)len);
+        out->append(name, start, len);
+        start = dot + 1;
+    }
+    out->push_back('\0');
+    Put16(out, qtype);
+    Put16(out, kDnsClassIn);
+    return true;
+}
+
+// 解码一个应答
+bool DnsPacket::DecodeResponse(const char *data, size_t size, DnsResponse *resp)
+{
+    if (size < kDnsHeaderSize)
+    {
+        return false;
+    }
+    uint16_t flags = Get16(data + 2);
+    // 不是应答
+    if ((flags & 0x8000) == 0)
+    {
+        return false;
+    }
+    resp->id = Get16(data);
+    resp->rcode = flags & 0x0f;
+    resp->truncated = (flags & 0x0200) != 0;
+    uint16_t qdcount = Get16(data + 4);
+    uint16_t ancount = Get16(data + 6);
+    uint16_t nscount = Get16(data + 8);
+    resp->qname.clear();
+    resp->qtype = 0;
+    resp->answers.clear();
+    resp->has_soa = false;
+    resp->negative_ttl = 0;
+
+    // 只发一个问题，应答里也只认一个
+    if (qdcount != 1)
+    {
+        return false;
+    }
+    size_t offset = kDnsHeaderSize;
+    if (!ReadName(data, size, &offset, &resp->qname) || offset + 4 > size)
+    {
+        return false;
+    }
+    resp->qtype = Get16(data + offset);
+    offset += 4;
+
+    for (uint16_t i = 0; i < ancount; i++)
+    {
+        uint16_t type = 0, rdlen = 0;
+        uint32_t ttl = 0;
+        size_t rdata = 0;
+        std::string name;
+        if (!ReadRecord(data, size, &offset, &type, &ttl, &rdata, &rdlen, &name))
+        {
+            // 截断的应答只用完整的记录
+            return resp->truncated;
+        }
+        if ((type == kDnsTypeA && rdlen == 4) || (type == kDnsTypeAaaa && rdlen == 16))
+        {
+            DnsRecord record;
+            record.name = std::move(name);
+            record.type = type;
+            record.ttl = ttl;
+            record.data.assign(data + rdata, rdlen);
+            resp->answers.emplace_back(std::move(record));
+        }
+        else if (type == kDnsTypeCname)
+        {
+            // 别名的目标名字可以用压缩指针，按名字读出来，解析器据此沿别名链核对地址记录的名字
+            DnsRecord record;
+            size_t pos = rdata;
+            if (!ReadName(data, size, &pos, &record.data) || pos > rdata + rdlen)
+            {
+                continue;
+            }
+            record.name = std::move(name);
+            record.type = type;
+            record.ttl = ttl;
+            resp->answers.emplace_back(std::move(record));
+        }
+    }
+
+    for (uint16_t i = 0; i < nscount; i++)
+    {
+        uint16_t type = 0, rdlen = 0;
+        uint32_t ttl = 0;
+        size_t rdata = 0;
+        if (!ReadRecord(data, size, &offset, &type, &ttl, &rdata, &rdlen))
+        {
+            break;
+        }
+        if (type != kDnsTypeSoa)
+        {
+            continue;
+        }
+        // SOA 的 rdata：mname、rname 两个名字，之后是 serial、refresh、retry、expire、minimum
+        size_t pos = rdata;
+        if (!ReadName(data, size, &pos, nullptr) || !ReadName(data, size, &pos, nullptr) ||
+            pos + 20 > rdata + rdlen)
+        {
+            continue;
+        }
+        uint32_t minimum = Get32(data + pos + 16);
+        resp->has_soa = true;
+        resp->negative_ttl = ttl < minimum ? ttl : minimum;
+        break;
+    }
+    return true;
+}
+
+// 主机名规范化
+std::string DnsPacket::Normalize(const std::string &host)
+{
+    std::string name;
+    name.reserve(host.size());
+    for (auto c : host)
+    {
+        name.push_back((char)tolower((unsigned char)c));
+    }
+    if (!name.empty() && name.back() == '.')
+    {
+        name.pop_back();
+    }
+    return name;
+}
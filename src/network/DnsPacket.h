@@ -0,0 +1,72 @@
+#pragma once
+/*
+    DNS 报文的编码和解码（RFC 1035），只覆盖解析器用到的部分：
+    编码一个带 RD 标志的查询，解码应答里的问题、A/AAAA/CNAME 记录和否定应答的 SOA
+    名字可以用压缩指针，解码时限制跳转次数，防止构造的报文让指针绕圈
+*/
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tmms
+{
+    namespace network
+    {
+        // 记录类型
+        const uint16_t kDnsTypeA = 1;
+        const uint16_t kDnsTypeCname = 5;
+        const uint16_t kDnsTypeSoa = 6;
+        const uint16_t kDnsTypeAaaa = 28;
+        // IN 类
+        const uint16_t kDnsClassIn = 1;
+
+        // 应答码
+        const uint8_t kDnsRcodeNoError = 0;
+        const uint8_t kDnsRcodeServFail = 2;
+        const uint8_t kDnsRcodeNxDomain = 3;
+
+        // 报文头的大小
+        const size_t kDnsHeaderSize = 12;
+        // 不带 EDNS 时 UDP 应答的上限
+        const size_t kDnsMaxUdpSize = 512;
+
+        // 应答里的一条记录，A 的 data 是 4 字节地址，AAAA 是 16 字节，CNAME 是目标名字（小写，不带结尾的点）
+        struct DnsRecord
+        {
+            // 记录的名字（小写，不带结尾的点）
+            std::string name;
+            uint16_t type{0};
+            uint32_t ttl{0};
+            std::string data;
+        };
+
+        // 解码后的应答
+        struct DnsResponse
+        {
+            uint16_t id{0};
+            uint8_t rcode{0};
+            // 应答被截断，本来应该改用 TCP 重新查询，这里只用已经收到的记录
+            bool truncated{false};
+            // 问题部分的名字（小写，不带结尾的点）和类型
+            std::string qname;
+            uint16_t qtype{0};
+            // 回答部分的记录
+            std::vector<DnsRecord> answers;
+            // 授权部分有 SOA 时的否定缓存时间，取 SOA 的 TTL 和 minimum 中较小的（RFC 2308）
+            bool has_soa{false};
+            uint32_t negative_ttl{0};
+        };
+
+        class DnsPacket
+        {
+        public:
+            // 编码一个查询，host 不合法（空标签、标签超过 63 字节、总长超过 253 字节）时返回 false
+            static bool EncodeQuery(uint16_t id, const std::string &host, uint16_t qtype, std::string *out);
+            // 解码一个应答，报文不完整或者不是应答时返回 false
+            static bool DecodeResponse(const char *data, size_t size, DnsResponse *resp);
+            // 主机名规范化：转成小写，去掉结尾的点
+            static std::string Normalize(const std::string &host);
+        };
+    }
+}
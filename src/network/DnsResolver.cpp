@@ -0,0 +1,667 @@
+#include "DnsResolver.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <arpa/inet.h>
+#include "network/base/Network.h"
+#include "network/base/SlabPool.h"
+
+using namespace tmms::network;
+
+namespace
+{
+    // IP 字面量的结果一直有效
+    const uint32_t kDnsLiteralTtl = UINT32_MAX;
+    // 静态表的结果的有效期，单位：秒；静态表在启动前设置，之后不变
+    const uint32_t kDnsHostsTtl = 60;
+    // resolv.conf 最多使用的服务器个数，和 glibc 的 MAXNS 一样
+    const size_t kDnsMaxServers = 3;
+    // ndots 的上限，和 glibc 一样
+    const int32_t kDnsMaxNdots = 15;
+    // 别名链最多跟随的次数
+    const int kDnsMaxCnameChain = 8;
+
+    // 从问题的名字开始沿 CNAME 记录找出别名链上的所有名字，地址记录只认这些名字的
+    std::vector<std::string> CnameChain(const std::string &qname, const std::vector<DnsRecord> &answers)
+    {
+        std::vector<std::string> chain{qname};
+        for (int i = 0; i < kDnsMaxCnameChain; i++)
+        {
+            bool next = false;
+            for (auto &record : answers)
+            {
+                if (record.type == kDnsTypeCname && record.name == chain.back())
+                {
+                    chain.emplace_back(record.data);
+                    next = true;
+                    break;
+                }
+            }
+            if (!next)
+            {
+                break;
+            }
+        }
+        return chain;
+    }
+
+    // 只有一个服务器、没有搜索域的配置
+    DnsConfig SingleServer(const InetAddress &server)
+    {
+        DnsConfig config;
+        config.servers.emplace_back(server);
+        return config;
+    }
+}
+
+DnsResolver::DnsResolver(EventLoop *loop, const InetAddress &server)
+    : DnsResolver(loop, SingleServer(server))
+{
+}
+
+DnsResolver::DnsResolver(EventLoop *loop, const DnsConfig &config)
+    : loop_(loop), config_(config), rng_(std::random_device()())
+{
+    if (config_.servers.empty())
+    {
+        config_.servers.emplace_back("127.0.0.1", (uint16_t)53);
+    }
+    for (auto &server : config_.servers)
+    {
+        if (server.Port() == 0)
+        {
+            server.SetPort(53);
+        }
+    }
+}
+
+// 读 /etc/resolv.conf
+DnsConfig DnsResolver::SystemConfig(const std::string &conf)
+{
+    DnsConfig config;
+    std::ifstream file(conf);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream in(line);
+        std::string key;
+        in >> key;
+        if (key == "nameserver")
+        {
+            std::string ip;
+            in >> ip;
+            struct in_addr a4;
+            struct in6_addr a6;
+            if (config.servers.size() >= kDnsMaxServers)
+            {
+                continue;
+            }
+            if (::inet_pton(AF_INET, ip.c_str(), &a4) == 1)
+            {
+                config.servers.emplace_back(ip, (uint16_t)53);
+            }
+            // 带 %scope 的链路本地地址这里不支持，跳过
+            else if (::inet_pton(AF_INET6, ip.c_str(), &a6) == 1)
+            {
+                config.servers.emplace_back(ip, (uint16_t)53, true);
+            }
+        }
+        else if (key == "search" || key == "domain")
+        {
+            // 后出现的 search 或 domain 覆盖前面的
+            config.search.clear();
+            std::string domain;
+            while (in >> domain)
+            {
+                domain = DnsPacket::Normalize(domain);
+                if (!domain.empty())
+                {
+                    config.search.emplace_back(domain);
+                }
+                if (key == "domain")
+                {
+                    break;
+                }
+            }
+        }
+        else if (key == "options")
+        {
+            std::string option;
+            while (in >> option)
+            {
+                if (option.compare(0, 6, "ndots:") == 0)
+                {
+                    config.ndots = std::min(std::max(std::atoi(option.c_str() + 6), 0), kDnsMaxNdots);
+                }
+            }
+        }
+    }
+    if (config.servers.empty())
+    {
+        config.servers.emplace_back("127.0.0.1", (uint16_t)53);
+    }
+    return config;
+}
+
+// 读 /etc/resolv.conf 的第一个 nameserver
+InetAddress DnsResolver::SystemNameServer(const std::string &conf)
+{
+    return SystemConfig(conf).servers.front();
+}
+
+// 读 hosts 文件：每行一个地址，后面是主机名和别名，# 之后是注释
+DnsHostsTable DnsResolver::LoadHosts(const std::string &path)
+{
+    DnsHostsTable hosts;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        auto comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.resize(comment);
+        }
+        std::istringstream in(line);
+        std::string ip, name;
+        in >> ip;
+        struct in_addr a4;
+        struct in6_addr a6;
+        InetAddressPtr addr;
+        if (::inet_pton(AF_INET, ip.c_str(), &a4) == 1)
+        {
+            addr = std::make_shared<InetAddress>(ip, (uint16_t)0);
+        }
+        else if (::inet_pton(AF_INET6, ip.c_str(), &a6) == 1)
+        {
+            addr = std::make_shared<InetAddress>(ip, (uint16_t)0, true);
+        }
+        else
+        {
+            continue;
+        }
+        while (in >> name)
+        {
+            auto &list = hosts[DnsPacket::Normalize(name)];
+            // 和 DNS 的结果一样 IPv6 在前
+            if (addr->IsIpV6())
+            {
+                auto iter = std::find_if(list.begin(), list.end(), [](const InetAddressPtr &a)
+                                         { return !a->IsIpV6(); });
+                list.insert(iter, addr);
+            }
+            else
+            {
+                list.emplace_back(addr);
+            }
+        }
+    }
+    return hosts;
+}
+
+// 设置静态表
+void DnsResolver::SetHosts(const DnsHostsTable &hosts)
+{
+    hosts_ = hosts;
+}
+
+// 每次发送后等待应答的时间和重试次数
+void DnsResolver::SetTimeout(int32_t timeout, int32_t retry)
+{
+    timeout_ = timeout > 0 ? timeout : 1;
+    retry_ = retry >= 0 ? retry : 0;
+}
+
+// 是否查询 AAAA
+void DnsResolver::SetQueryIpv6(bool on)
+{
+    query_ipv6_ = on;
+}
+
+// 打开到服务器的套接字
+void DnsResolver::Start()
+{
+    auto self = shared_from_this();
+    loop_->RunInLoop([self]()
+                     {
+        self->sockets_.resize(self->config_.servers.size());
+        for (size_t i = 0; i < self->sockets_.size(); i++)
+        {
+            self->OpenSocket(i);
+        }
+        self->running_ = true; });
+}
+
+// 打开到第 index 个服务器的套接字
+void DnsResolver::OpenSocket(size_t index)
+{
+    std::weak_ptr<DnsResolver> weak = shared_from_this();
+    auto socket = std::make_shared<UdpClient>(loop_, config_.servers[index]);
+    socket->SetRecvMsgCallback([weak, index](const InetAddress &addr, MsgBuffer &buff)
+                               {
+        auto r = weak.lock();
+        if (r)
+        {
+            r->OnMessage(index, buff.Peek(), buff.ReadableBytes());
+        } });
+    // 服务器端口不可达（ICMP）时套接字因为出错被关闭，重新打开一个，之后的查询还能发给它
+    socket->SetCloseCallback([weak, index](const UdpSocketPtr &)
+                             {
+        auto r = weak.lock();
+        if (r)
+        {
+            r->loop_->QueueInLoop([weak, index]()
+                                  {
+                auto r = weak.lock();
+                if (r && r->running_)
+                {
+                    r->OpenSocket(index);
+                } });
+        } });
+    socket->ConnectInLoop();
+    sockets_[index] = socket;
+}
+
+// 关闭套接字，还没完成的查询以 kDnsError 结束
+void DnsResolver::Stop()
+{
+    auto self = shared_from_this();
+    loop_->RunInLoop([self]()
+                     {
+        self->running_ = false;
+        for (auto &socket : self->sockets_)
+        {
+            if (socket)
+            {
+                socket->OnClose();
+            }
+        }
+        self->queries_.clear();
+        auto lookups = std::move(self->lookups_);
+        self->lookups_.clear();
+        for (auto &l : lookups)
+        {
+            l.second->error = true;
+            self->Finish(l.second);
+        } });
+}
+
+// 解析主机名
+void DnsResolver::Resolve(const std::string &host, const DnsResolveCallback &cb)
+{
+    DnsResolveCallback f = cb;
+    Resolve(host, std::move(f));
+}
+
+void DnsResolver::Resolve(const std::string &host, DnsResolveCallback &&cb)
+{
+    auto self = shared_from_this();
+    // 回调可能不可拷贝地持有状态，放进共享指针再投递
+    auto f = std::make_shared<DnsResolveCallback>(std::move(cb));
+    loop_->RunInLoop([self, host, f]()
+                     { self->ResolveInLoop(host, std::move(*f)); });
+}
+
+// 正在进行的主机名查询个数
+size_t DnsResolver::Pending() const
+{
+    return lookups_.size();
+}
+
+// 所属的事件循环
+EventLoop *DnsResolver::Loop() const
+{
+    return loop_;
+}
+
+// 在事件循环线程里开始解析
+void DnsResolver::ResolveInLoop(const std::string &host, DnsResolveCallback &&cb)
+{
+    DnsResult result;
+    // IP 字面量不用查询
+    struct in_addr a4;
+    struct in6_addr a6;
+    if (::inet_pton(AF_INET, host.c_str(), &a4) == 1 || ::inet_pton(AF_INET6, host.c_str(), &a6) == 1)
+    {
+        bool v6 = host.find(':') != std::string::npos;
+        result.status = kDnsOk;
+        result.ttl = kDnsLiteralTtl;
+        result.addrs.emplace_back(std::make_shared<InetAddress>(host, 0, v6));
+        if (cb)
+        {
+            cb(host, result);
+        }
+        return;
+    }
+    if (!running_)
+    {
+        if (cb)
+        {
+            cb(host, result);
+        }
+        return;
+    }
+
+    auto name = DnsPacket::Normalize(host);
+    if (ResolveFromHosts(name, cb))
+    {
+        return;
+    }
+
+    // 同一个主机名正在查询，合并到同一次查询上
+    auto iter = lookups_.find(name);
+    if (iter != lookups_.end())
+    {
+        iter->second->callbacks.emplace_back(std::move(cb));
+        return;
+    }
+
+    auto lookup = std::make_shared<Lookup>();
+    lookup->host = name;
+    lookup->names = SearchNames(name, !host.empty() && host.back() == '.');
+    lookup->callbacks.emplace_back(std::move(cb));
+    lookups_[name] = lookup;
+    if (!QueryNextName(lookup))
+    {
+        // 主机名不合法
+        lookup->error = true;
+        Finish(lookup);
+    }
+}
+
+// 在静态表里查找
+bool DnsResolver::ResolveFromHosts(const std::string &host, const DnsResolveCallback &cb)
+{
+    DnsResult result;
+    auto iter = hosts_.find(host);
+    if (iter != hosts_.end())
+    {
+        for (auto &addr : iter->second)
+        {
+            if (query_ipv6_ || !addr->IsIpV6())
+            {
+                result.addrs.emplace_back(addr);
+            }
+        }
+    }
+    // 静态表里没有 localhost 时也解析到环回地址（RFC 6761），不发给服务器
+    else if (host == "localhost" || (host.size() > 10 && host.compare(host.size() - 10, 10, ".localhost") == 0))
+    {
+        if (query_ipv6_)
+        {
+            result.addrs.emplace_back(std::make_shared<InetAddress>("::1", (uint16_t)0, true));
+        }
+        result.addrs.emplace_back(std::make_shared<InetAddress>("127.0.0.1", (uint16_t)0));
+    }
+    if (result.addrs.empty())
+    {
+        return false;
+    }
+    result.status = kDnsOk;
+    result.ttl = kDnsHostsTtl;
+    if (cb)
+    {
+        cb(host, result);
+    }
+    return true;
+}
+
+// 按搜索域生成依次查询的名字
+std::vector<std::string> DnsResolver::SearchNames(const std::string &name, bool absolute) const
+{
+    std::vector<std::string> names;
+    if (absolute || config_.search.empty())
+    {
+        names.emplace_back(name);
+        return names;
+    }
+    // 点够多的名字先按原名查询，否则最后才按原名查询，和 glibc 的 res_search 一样
+    bool first = std::count(name.begin(), name.end(), '.') >= config_.ndots;
+    if (first)
+    {
+        names.emplace_back(name);
+    }
+    for (auto &domain : config_.search)
+    {
+        names.emplace_back(name + "." + domain);
+    }
+    if (!first)
+    {
+        names.emplace_back(name);
+    }
+    return names;
+}
+
+// 查询下一个名字
+bool DnsResolver::QueryNextName(const LookupPtr &lookup)
+{
+    while (lookup->next_name < lookup->names.size())
+    {
+        lookup->qname = lookup->names[lookup->next_name++];
+        if (query_ipv6_)
+        {
+            SendQuery(lookup, kDnsTypeAaaa);
+        }
+        // 名字不合法（加上搜索域后太长）时 AAAA 也不会发出去，换下一个
+        if (SendQuery(lookup, kDnsTypeA))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 发出一个类型的查询
+bool DnsResolver::SendQuery(const LookupPtr &lookup, uint16_t qtype)
+{
+    auto query = std::make_shared<Query>();
+    query->id = NextId();
+    query->qtype = qtype;
+    query->lookup = lookup;
+    if (!DnsPacket::EncodeQuery(query->id, lookup->qname, qtype, &query->packet))
+    {
+        return false;
+    }
+    queries_[query->id] = query;
+    lookup->pending++;
+    Transmit(query);
+    return true;
+}
+
+// 发送并在时间轮上放超时节点
+void DnsResolver::Transmit(const QueryPtr &query)
+{
+    // 套接字已经连接到服务器，不用再带地址
+    sockets_[query->server]->SendCopy(query->packet.data(), query->packet.size(), nullptr, 0);
+    auto entry = MakeSlabShared<DnsQueryTimeoutEntry>(shared_from_this(), query->id, query->attempt);
+    loop_->InsertEntry(timeout_, entry);
+}
+
+// 收到一个应答
+void DnsResolver::OnMessage(size_t server, const char *data, size_t size)
+{
+    auto &server_addr = config_.servers[server];
+    DnsResponse resp;
+    if (!DnsPacket::DecodeResponse(data, size, &resp))
+    {
+        NETWORK_TRACE << " dns server : " << server_addr.ToIpPort() << " bad response, size : " << size;
+        return;
+    }
+    auto iter = queries_.find(resp.id);
+    if (iter == queries_.end())
+    {
+        // 已经超时结束的查询，或者伪造的应答
+        return;
+    }
+    auto query = iter->second;
+    auto &lookup = query->lookup;
+    if (resp.qtype != query->qtype || resp.qname != lookup->qname)
+    {
+        NETWORK_WARN << " dns server : " << server_addr.ToIpPort() << " mismatched response for : " << lookup->qname;
+        return;
+    }
+
+    if (resp.rcode == kDnsRcodeNoError)
+    {
+        bool found = false;
+        uint32_t ttl = UINT32_MAX;
+        // 名字不在别名链上的记录不是这个问题的答案，可能是被注入的，丢弃
+        auto chain = CnameChain(lookup->qname, resp.answers);
+        for (auto &record : resp.answers)
+        {
+            if (std::find(chain.begin(), chain.end(), record.name) == chain.end())
+            {
+                NETWORK_TRACE << " dns server : " << server_addr.ToIpPort() << " host : " << lookup->qname
+                              << " ignore record for : " << record.name;
+                continue;
+            }
+            if (record.ttl < ttl)
+            {
+                ttl = record.ttl;
+            }
+            if (record.type == kDnsTypeA && record.type == query->qtype)
+            {
+                struct sockaddr_in addr;
+                memset(&addr, 0x00, sizeof(addr));
+                addr.sin_family = AF_INET;
+                memcpy(&addr.sin_addr, record.data.data(), 4);
+                lookup->v4.emplace_back(std::make_shared<InetAddress>((struct sockaddr *)&addr, sizeof(addr)));
+                found = true;
+            }
+            else if (record.type == kDnsTypeAaaa && record.type == query->qtype)
+            {
+                struct sockaddr_in6 addr;
+                memset(&addr, 0x00, sizeof(addr));
+                addr.sin6_family = AF_INET6;
+                memcpy(&addr.sin6_addr, record.data.data(), 16);
+                lookup->v6.emplace_back(std::make_shared<InetAddress>((struct sockaddr *)&addr, sizeof(addr)));
+                found = true;
+            }
+        }
+        if (found && ttl < lookup->ttl)
+        {
+            lookup->ttl = ttl;
+        }
+        // 没有这个类型的记录（NODATA），否定缓存时间在 SOA 里
+        if (!found && resp.has_soa && resp.negative_ttl < lookup->negative_ttl)
+        {
+            lookup->negative_ttl = resp.negative_ttl;
+        }
+    }
+    else if (resp.rcode == kDnsRcodeNxDomain)
+    {
+        lookup->nxdomain = true;
+        if (resp.has_soa && resp.negative_ttl < lookup->negative_ttl)
+        {
+            lookup->negative_ttl = resp.negative_ttl;
+        }
+    }
+    else
+    {
+        NETWORK_WARN << " dns server : " << server_addr.ToIpPort() << " host : " << lookup->qname << " rcode : " << (int)resp.rcode;
+        // 服务器出错（SERVFAIL、REFUSED 等）时换下一个服务器，每个服务器只试一次
+        if (++query->failures < sockets_.size())
+        {
+            query->attempt++;
+            query->server = (query->server + 1) % sockets_.size();
+            Transmit(query);
+            return;
+        }
+        lookup->error = true;
+    }
+    OnQueryDone(query);
+}
+
+// 某次发送超时
+void DnsResolver::OnTimeout(uint16_t id, int32_t attempt)
+{
+    auto iter = queries_.find(id);
+    if (iter == queries_.end() || iter->second->attempt != attempt)
+    {
+        // 已经有结果，或者已经重发过
+        return;
+    }
+    auto query = iter->second;
+    // 每次重发换下一个服务器，每个服务器都重试 retry 次
+    if (attempt < (int32_t)((retry_ + 1) * sockets_.size()) - 1)
+    {
+        query->attempt++;
+        query->server = (query->server + 1) % sockets_.size();
+        Transmit(query);
+        return;
+    }
+    NETWORK_WARN << " dns server : " << config_.servers[query->server].ToIpPort() << " host : " << query->lookup->qname << " timeout";
+    query->lookup->timeout = true;
+    OnQueryDone(query);
+}
+
+// 一个查询有了结果
+void DnsResolver::OnQueryDone(const QueryPtr &query)
+{
+    queries_.erase(query->id);
+    auto &lookup = query->lookup;
+    if (--lookup->pending > 0)
+    {
+        return;
+    }
+    // 这个名字不存在，换下一个搜索域；超时或者出错时不再继续，和 glibc 一样
+    bool not_found = lookup->v4.empty() && lookup->v6.empty() && !lookup->timeout && !lookup->error;
+    if (not_found && QueryNextName(lookup))
+    {
+        return;
+    }
+    Finish(lookup);
+}
+
+// 把主机名的解析结果交给所有等待的回调
+void DnsResolver::Finish(const LookupPtr &lookup)
+{
+    DnsResult result;
+    // IPv6 在前，TcpClient 按地址族交替排列候选地址时以第一个地址的地址族开头
+    result.addrs = lookup->v6;
+    result.addrs.insert(result.addrs.end(), lookup->v4.begin(), lookup->v4.end());
+    if (!result.addrs.empty())
+    {
+        // 一个类型有地址、另一个超时或者出错时也算成功
+        result.status = kDnsOk;
+        result.ttl = lookup->ttl == UINT32_MAX ? 0 : lookup->ttl;
+    }
+    else if (lookup->nxdomain || (!lookup->timeout && !lookup->error))
+    {
+        result.status = kDnsNotFound;
+        result.ttl = lookup->negative_ttl == UINT32_MAX ? 0 : lookup->negative_ttl;
+    }
+    else if (lookup->timeout)
+    {
+        result.status = kDnsTimeout;
+    }
+    else
+    {
+        result.status = kDnsError;
+    }
+
+    // 先从表里删掉，回调里可以重新解析同一个主机名
+    lookups_.erase(lookup->host);
+    auto callbacks = std::move(lookup->callbacks);
+    for (auto &cb : callbacks)
+    {
+        if (cb)
+        {
+            cb(lookup->host, result);
+        }
+    }
+}
+
+// 分配一个没有在用的查询 ID
+uint16_t DnsResolver::NextId()
+{
+    while (true)
+    {
+        uint16_t id = (uint16_t)rng_();
+        if (queries_.find(id) == queries_.end())
+        {
+            return id;
+        }
+    }
+}
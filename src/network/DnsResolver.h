@@ -0,0 +1,219 @@
+#pragma once
+/*
+    异步 DNS 解析器
+    getaddrinfo 会阻塞调用线程，DnsService 只能放在单独的线程里逐个主机轮询
+    这里直接用 UdpSocket 和 DNS 服务器通信，在一个事件循环里同时进行任意多个查询：
+    每个主机名同时查 A 和 AAAA，两个都有结果后回调；同一个主机名正在查询时，新的请求合并到同一次查询上
+    每次发送后在时间轮上放一个超时节点，超时重发，重试次数用完后以超时结束
+    应答按查询 ID、问题的名字和类型核对，对不上的丢弃；回答里的记录只认问题的名字和沿 CNAME 链到达的名字
+    套接字连接到服务器，别的地址发来的数据报内核直接丢弃
+    截断的应答不改用 TCP 重查，只用已经收到的记录
+    和 getaddrinfo 一样先查 /etc/hosts 的内容（SetHosts），再查 DNS；可以有多个服务器，超时或者服务器出错时换下一个；
+    名字里的点少于 ndots 时先依次加上搜索域查询，不存在时再换下一个搜索域（容器和 k8s 里的短服务名）
+*/
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "network/UdpClient.h"
+#include "network/DnsPacket.h"
+#include "network/base/InetAddress.h"
+#include "base/NonCopyable.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        using InetAddressPtr = std::shared_ptr<InetAddress>;
+
+        // 解析结果的状态
+        enum DnsStatus
+        {
+            kDnsOk = 0,         // 至少有一个地址
+            kDnsNotFound = 1,   // 域名不存在（NXDOMAIN），或者没有 A/AAAA 记录
+            kDnsTimeout = 2,    // 重试次数用完也没有应答
+            kDnsError = 3,      // 服务器报错（SERVFAIL 等）、主机名不合法或者解析器已经停止
+        };
+
+        // 解析结果
+        struct DnsResult
+        {
+            DnsStatus status{kDnsError};
+            // 解析出的地址，不带端口，IPv6 在前
+            std::vector<InetAddressPtr> addrs;
+            // 结果的有效期，单位：秒；成功时是记录里最小的 TTL，不存在时是否定缓存时间（SOA），其他情况为 0
+            uint32_t ttl{0};
+        };
+
+        // resolv.conf 里解析器用到的配置
+        struct DnsConfig
+        {
+            // DNS 服务器，不带端口时用 53；按顺序使用，超时或者出错时换下一个
+            std::vector<InetAddress> servers;
+            // 搜索域，小写，不带结尾的点
+            std::vector<std::string> search;
+            // 名字里的点少于 ndots 时先加搜索域查询，否则先按原名查询
+            int32_t ndots{1};
+        };
+
+        // 主机名（小写，不带结尾的点）到地址的静态表，也就是 /etc/hosts 的内容，IPv6 在前
+        using DnsHostsTable = std::unordered_map<std::string, std::vector<InetAddressPtr>>;
+
+        // 解析完成的回调，在解析器的事件循环线程执行
+        using DnsResolveCallback = std::function<void(const std::string &host, const DnsResult &result)>;
+
+        class DnsResolver;
+        using DnsResolverPtr = std::shared_ptr<DnsResolver>;
+        struct DnsQueryTimeoutEntry;
+
+        // 任务通过弱指针访问解析器，必须用 std::make_shared 创建
+        class DnsResolver : public std::enable_shared_from_this<DnsResolver>, public base::NonCopyable
+        {
+        public:
+            // server 是 DNS 服务器的地址，不带端口时用 53，不用搜索域
+            DnsResolver(EventLoop *loop, const InetAddress &server);
+            // 按 config 里的服务器和搜索域解析，没有服务器时用 127.0.0.1:53
+            DnsResolver(EventLoop *loop, const DnsConfig &config);
+
+            // 读 /etc/resolv.conf：nameserver（最多 3 个，和 glibc 一样）、search/domain 和 options ndots，
+            // 没有 nameserver 时用 127.0.0.1:53
+            static DnsConfig SystemConfig(const std::string &conf = "/etc/resolv.conf");
+            // 读 /etc/resolv.conf 的第一个 nameserver，读不到时用 127.0.0.1:53
+            static InetAddress SystemNameServer(const std::string &conf = "/etc/resolv.conf");
+            // 读 hosts 文件，读不到时返回空表
+            static DnsHostsTable LoadHosts(const std::string &path = "/etc/hosts");
+
+            // 设置静态表，表里有的主机名不发查询；在 Start 之前调用
+            void SetHosts(const DnsHostsTable &hosts);
+
+            // 每次发送后等待应答的时间，单位：秒，和重试次数；在 Start 之前调用
+            void SetTimeout(int32_t timeout, int32_t retry);
+            // 是否查询 AAAA，默认查询
+            void SetQueryIpv6(bool on);
+
+            // 打开到服务器的套接字
+            void Start();
+            // 关闭套接字，还没完成的查询以 kDnsError 结束
+            void Stop();
+
+            // 解析主机名，可以在任意线程调用，回调在解析器的事件循环线程执行
+            // IP 字面量直接返回，不发查询
+            void Resolve(const std::string &host, const DnsResolveCallback &cb);
+            void Resolve(const std::string &host, DnsResolveCallback &&cb);
+
+            // 正在进行的主机名查询个数，在事件循环线程里读
+            size_t Pending() const;
+
+            // 所属的事件循环
+            EventLoop *Loop() const;
+
+        private:
+            friend struct DnsQueryTimeoutEntry;
+
+            // 一个主机名的解析，等 A 和 AAAA 都有结果
+            struct Lookup
+            {
+                std::string host;
+                // 依次查询的名字（原名和加上搜索域的名字），和正在查询的名字
+                std::vector<std::string> names;
+                size_t next_name{0};
+                std::string qname;
+                std::vector<DnsResolveCallback> callbacks;
+                // 还没有结果的查询个数
+                int32_t pending{0};
+                std::vector<InetAddressPtr> v4;
+                std::vector<InetAddressPtr> v6;
+                // 地址记录和别名记录里最小的 TTL
+                uint32_t ttl{UINT32_MAX};
+                // 否定应答里最小的否定缓存时间
+                uint32_t negative_ttl{UINT32_MAX};
+                bool nxdomain{false};
+                bool timeout{false};
+                bool error{false};
+            };
+            using LookupPtr = std::shared_ptr<Lookup>;
+
+            // 一个发出去的查询
+            struct Query
+            {
+                uint16_t id{0};
+                uint16_t qtype{0};
+                std::string packet;
+                // 第几次发送，超时节点据此忽略过期的超时
+                int32_t attempt{0};
+                // 这次发给第几个服务器
+                size_t server{0};
+                // 报错的服务器个数
+                size_t failures{0};
+                LookupPtr lookup;
+            };
+            using QueryPtr = std::shared_ptr<Query>;
+
+            // 在事件循环线程里开始解析
+            void ResolveInLoop(const std::string &host, DnsResolveCallback &&cb);
+            // 在静态表里查找，找到时直接回调
+            bool ResolveFromHosts(const std::string &host, const DnsResolveCallback &cb);
+            // 按搜索域生成依次查询的名字，absolute 表示名字以点结尾，不加搜索域
+            std::vector<std::string> SearchNames(const std::string &name, bool absolute) const;
+            // 查询下一个名字，名字都不合法或者都查过时返回 false
+            bool QueryNextName(const LookupPtr &lookup);
+            // 打开到第 index 个服务器的套接字
+            void OpenSocket(size_t index);
+            // 发出一个类型的查询
+            bool SendQuery(const LookupPtr &lookup, uint16_t qtype);
+            // 发送并在时间轮上放超时节点
+            void Transmit(const QueryPtr &query);
+            // 从第 server 个服务器收到一个应答
+            void OnMessage(size_t server, const char *data, size_t size);
+            // 某次发送超时
+            void OnTimeout(uint16_t id, int32_t attempt);
+            // 一个查询有了结果，主机名的查询都有结果后回调
+            void OnQueryDone(const QueryPtr &query);
+            // 把主机名的解析结果交给所有等待的回调
+            void Finish(const LookupPtr &lookup);
+            // 分配一个没有在用的查询 ID
+            uint16_t NextId();
+
+            EventLoop *loop_{nullptr};
+            DnsConfig config_;
+            // 每个服务器一个连接好的套接字
+            std::vector<std::shared_ptr<UdpClient>> sockets_;
+            DnsHostsTable hosts_;
+            int32_t timeout_{2};
+            int32_t retry_{2};
+            bool query_ipv6_{true};
+            bool running_{false};
+            // 正在进行的查询，按查询 ID
+            std::unordered_map<uint16_t, QueryPtr> queries_;
+            // 正在进行的主机名解析，按规范化的主机名
+            std::unordered_map<std::string, LookupPtr> lookups_;
+            // 查询 ID 随机生成，猜不到 ID 的伪造应答对不上
+            std::mt19937 rng_;
+        };
+
+        // 一次发送的超时节点，时间轮转到时析构，通知解析器
+        struct DnsQueryTimeoutEntry
+        {
+            DnsQueryTimeoutEntry(const DnsResolverPtr &r, uint16_t i, int32_t a)
+                : resolver(r), id(i), attempt(a)
+            {
+            }
+
+            ~DnsQueryTimeoutEntry()
+            {
+                auto r = resolver.lock();
+                if (r)
+                {
+                    r->OnTimeout(id, attempt);
+                }
+            }
+
+            std::weak_ptr<DnsResolver> resolver;
+            uint16_t id{0};
+            int32_t attempt{0};
+        };
+    }
+}
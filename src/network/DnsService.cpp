@@ -1,9 +1,10 @@
 #include <functional>
-#include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
-#include <cstring>
+#include <chrono>
+#include <algorithm>
 #include "DnsService.h"
+#include "network/base/Network.h"
 
 using namespace tmms::network;
 
@@ -12,40 +13,70 @@ namespace
 {
     // static 关键字表示变量 inet_address_null 具有内部链接，不能从其他源文件访问，确保它在此文件中是唯一的
     static InetAddressPtr inet_address_null;
+
+    // 每次解析发出后等待应答的时间，单位：秒
+    const int32_t kDnsQueryTimeout = 2;
+
+    // 失败退避时基础间隔最多加倍的次数
+    const int32_t kDnsMaxBackoffShift = 8;
+
+    // 所有 DnsService 共用的快照版本号，实例销毁后地址被复用时，线程局部缓存也不会误用旧实例的快照
+    std::atomic<uint64_t> snapshot_version{0};
+
+    // 线程局部缓存的快照
+    struct SnapshotCache
+    {
+        const DnsService *owner{nullptr};
+        uint64_t version{0};
+        DnsSnapshotPtr snapshot;
+    };
+    thread_local SnapshotCache snapshot_cache;
+
+    // 还没有解析结果的主机名共用的空缓存项
+    const DnsCacheEntryPtr empty_entry = std::make_shared<DnsCacheEntry>();
 }
-// 添加主机到 hosts_info_ 容器中
+
+DnsService::DnsService()
+{
+    // 先发布一个空快照，读取方总能拿到有效的快照
+    std::lock_guard<std::mutex> lk(lock_);
+    Publish();
+}
+// 添加主机到缓存中，启动后添加的主机立即解析
 void DnsService::AddHost(const std::string& host)
 {
-    // 使用 std::lock_guard 来管理互斥量 lock_，确保在函数执行期间对共享资源的独占访问，自动处理锁的获取和释放
+    // 使用 std::lock_guard 来管理互斥量 lock_，确保写入方之间互斥
     std::lock_guard<std::mutex> lk(lock_);
 
-    // 在 hosts_info_ 容器中查找 host，返回一个迭代器 iter
-    auto iter = hosts_info_.find(host);
-
-    // 检查是否存在
-    if (iter != hosts_info_.end())
+    // 已存在，函数直接返回，不做任何操作
+    if (hosts_.find(host) != hosts_.end())
     {
-        // 已存在，函数直接返回，不做任何操作
         return;
     }
-    
-    // 如果 host 不存在，则在 hosts_info_ 中添加 host，并初始化为一个空的 InetAddressPtr 向量
-    hosts_info_[host] = std::vector<InetAddressPtr>();
+
+    // 还没有解析结果，先发布空的缓存项
+    hosts_[host].entry = empty_entry;
+    Publish();
+
+    // 投递到下一轮循环检查，在事件循环线程里调用也不会重入 lock_
+    if (running_)
+    {
+        thread_->Loop()->QueueInLoop([this]()
+                                     { OnWork(); });
+    }
 }
 // 返回某一个解析具体的结果
 InetAddressPtr DnsService::GetHostAddress(const std::string &host, int index)
 {
-    // 使用 std::lock_guard 管理互斥量 lock_，确保线程安全
-    std::lock_guard<std::mutex> lk(lock_);
-
-    // 在 hosts_info_ 中查找主机名
-    auto iter = hosts_info_.find(host);
+    // 在当前线程的快照中查找主机名，不加锁
+    auto &snapshot = Snapshot();
+    auto iter = snapshot.find(host);
 
     // 检查主机名是否存在
-    if (iter != hosts_info_.end())
+    if (iter != snapshot.end())
     {
-        // 获取与主机名关联的地址列表
-        auto list = iter->second;
+        // 直接引用快照里的地址列表，不拷贝
+        auto &list = iter->second->addrs;
 
         // 如果列表不为空
         if (list.size() > 0)
@@ -61,173 +92,276 @@ InetAddressPtr DnsService::GetHostAddress(const std::string &host, int index)
 // 返回所有解析的结果
 std::vector<InetAddressPtr> DnsService::GetHostAddress(const std::string &host)
 {
-    // 使用 std::lock_guard 管理互斥量 lock_，确保线程安全
-    std::lock_guard<std::mutex> lk(lock_);
-
-    // 在 hosts_info_ 中查找主机名
-    auto iter = hosts_info_.find(host);
+    // 在当前线程的快照中查找主机名，不加锁
+    auto &snapshot = Snapshot();
+    auto iter = snapshot.find(host);
 
     // 检查主机名是否存在
-    if (iter != hosts_info_.end())
+    if (iter != snapshot.end())
     {
-        // 获取与主机名关联的地址列表
-        auto list = iter->second;
-
         // 返回地址列表
-        return list;
+        return iter->second->addrs;
     }
 
     // 如果未找到主机名，返回一个空的地址列表
     return std::vector<InetAddressPtr>();
 }
-// 更新DNS服务中某个主机的地址列表
+// 返回主机名的缓存项
+DnsCacheEntryPtr DnsService::GetHostEntry(const std::string &host)
+{
+    auto &snapshot = Snapshot();
+    auto iter = snapshot.find(host);
+    if (iter != snapshot.end())
+    {
+        return iter->second;
+    }
+    return DnsCacheEntryPtr();
+}
+// 手工设置某个主机的地址列表
 void DnsService::UpdateHost(const std::string &host, std::vector<InetAddressPtr> &list)
 {
-    // 使用 std::lock_guard 管理互斥量 lock_，确保线程安全
+    // 使用 std::lock_guard 管理互斥量 lock_，确保写入方之间互斥
     std::lock_guard<std::mutex> lk(lock_);
 
-    // 通过交换操作，将传入的地址列表替换掉与主机名关联的现有地址列表
-    hosts_info_[host].swap(list);
+    auto now = NowMs();
+    auto entry = std::make_shared<DnsCacheEntry>();
+    // 通过交换操作取走传入的地址列表
+    entry->addrs.swap(list);
+    entry->status = kDnsOk;
+    entry->expire = now + interval_;
+
+    auto &state = hosts_[host];
+    state.entry = entry;
+    state.refresh_at = entry->expire;
+    state.failures = 0;
+    Publish();
 }
 // 返回当前所有主机及其关联的 IP 地址列表
 std::unordered_map<std::string, std::vector<InetAddressPtr>> DnsService::GetHosts()
 {
-    // 使用 std::lock_guard 管理互斥量 lock_，确保线程安全
-    std::lock_guard<std::mutex> lk(lock_);
-
-    // 返回当前所有主机及其关联的 IP 地址列表
-    return hosts_info_;
+    std::unordered_map<std::string, std::vector<InetAddressPtr>> hosts;
+    for (auto &h : Snapshot())
+    {
+        hosts[h.first] = h.second->addrs;
+    }
+    return hosts;
 }
-// 设置 DNS 服务的参数，包括时间间隔、休眠时间和重试次数
+// 设置 DNS 服务的参数，包括 TTL 上限、失败重试间隔和重发次数
 void DnsService::SetDnsServiceParam(int32_t interval, int32_t sleep, int32_t retry)
 {
-    // 设置 DNS 服务的时间间隔
+    // 设置 TTL 的上限
     interval_ = interval;
-    // 设置 DNS 服务的休眠时间
+    // 设置失败重试的基础间隔
     sleep_ = sleep;
-    // 设置 DNS 服务的重试次数
+    // 设置每次解析的重发次数
     retry_ = retry;
 }
+// 设置 TTL 的下限和过期后继续使用旧地址的时间
+void DnsService::SetCacheParam(int32_t min_ttl, int32_t stale)
+{
+    min_ttl_ = min_ttl;
+    stale_ = stale;
+}
+// 设置 DNS 服务器
+void DnsService::SetNameServer(const InetAddress &server)
+{
+    server_ = server;
+    has_server_ = true;
+}
+// 设置 resolv.conf 和 hosts 文件的路径
+void DnsService::SetConfigFiles(const std::string &resolv_conf, const std::string &hosts)
+{
+    resolv_conf_ = resolv_conf;
+    hosts_file_ = hosts;
+}
 // 启动 DNS 服务，开始解析主机信息
 void DnsService::Start()
 {
+    std::lock_guard<std::mutex> lk(lock_);
+    if (running_)
+    {
+        return;
+    }
     // 设置服务状态为运行中
     running_ = true;
-    // 创建一个新线程，执行 OnWork 方法
-    thread_ = std::thread(std::bind(&DnsService::OnWork, this));
+
+    // 创建解析用的事件循环线程
+    thread_.reset(new EventLoopThread());
+    thread_->Run();
+    auto loop = thread_->Loop();
+
+    // 服务器、搜索域和 ndots 来自 resolv.conf，SetNameServer 指定的服务器替换其中的服务器列表
+    auto config = DnsResolver::SystemConfig(resolv_conf_);
+    if (has_server_)
+    {
+        config.servers = {server_};
+    }
+    resolver_ = std::make_shared<DnsResolver>(loop, config);
+    resolver_->SetHosts(DnsResolver::LoadHosts(hosts_file_));
+    resolver_->SetTimeout(kDnsQueryTimeout, retry_);
+    resolver_->Start();
+
+    // 立即解析已经添加的主机，之后每秒检查一次到期的主机
+    loop->RunInLoop([this]()
+                    { OnWork(); });
+    loop->RunEvery(1, [this]()
+                   { OnWork(); });
 }
 // 停止 DNS 服务，等待线程完成
 void DnsService::Stop()
 {
-    // 设置服务状态为停止
-    running_ = false;
+    std::unique_ptr<EventLoopThread> thread;
+    DnsResolverPtr resolver;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        if (!running_)
+        {
+            return;
+        }
+        // 设置服务状态为停止
+        running_ = false;
+        thread = std::move(thread_);
+        resolver = std::move(resolver_);
+    }
+
+    // 没完成的解析以出错结束，旧地址保留；回调要拿 lock_，不能持锁等待线程退出
+    resolver->Stop();
+    thread->Stop();
 
-    // 如果线程可连接，则等待线程完成
-    if (thread_.joinable())
+    std::lock_guard<std::mutex> lk(lock_);
+    for (auto &h : hosts_)
     {
-        thread_.join();
+        h.second.resolving = false;
     }
 }
-
+// 检查到期的主机，发起刷新
 void DnsService::OnWork()
 {
-    // 当服务运行时持续执行
-    while (running_)
+    std::vector<std::string> due;
+    DnsResolverPtr resolver;
     {
-        // 获取主机信息
-        auto host_infos = GetHosts();
-        
-        // 遍历每个主机
-        for (auto &host : host_infos)
+        std::lock_guard<std::mutex> lk(lock_);
+        // Stop 在别的线程里取走解析器，这里在锁里拿一份
+        resolver = resolver_;
+        if (!resolver)
         {
-            std::vector<InetAddressPtr> list;
-            // 获取主机详细信息
-            GetHostInfo(host.first, list);
-            // 如果获取到信息，则更新主机
-            if (list.size() > 0)
+            return;
+        }
+        auto now = NowMs();
+        bool changed = false;
+        for (auto &h : hosts_)
+        {
+            auto &state = h.second;
+            // 一直刷新失败，旧地址过期超过 stale 时间后丢弃
+            if (!state.entry->addrs.empty() && now >= state.entry->expire + stale_)
             {
-                UpdateHost(host.first, list);
-
-                // 更新后跳出循环
-                break;
+                auto entry = std::make_shared<DnsCacheEntry>();
+                entry->status = state.entry->status;
+                state.entry = entry;
+                changed = true;
             }
-
-            // 如果没有信息，休眠一段时间再尝试
-            std::this_thread::sleep_for(std::chrono::milliseconds(sleep_));
+            if (!state.resolving && now >= state.refresh_at)
+            {
+                state.resolving = true;
+                due.emplace_back(h.first);
+            }
+        }
+        if (changed)
+        {
+            Publish();
         }
     }
-    // 循环结束后休眠一段时间
-    std::this_thread::sleep_for(std::chrono::milliseconds(interval_));
-}
 
-void DnsService::GetHostInfo(const std::string &host, std::vector<InetAddressPtr> &list)
+    // 不持锁发起解析，IP 字面量的回调会在 Resolve 里直接执行
+    for (auto &host : due)
+    {
+        resolver->Resolve(host, [this, host](const std::string &, const DnsResult &result)
+                          { OnResolved(host, result); });
+    }
+}
+// 解析完成，更新主机的缓存项
+void DnsService::OnResolved(const std::string &host, const DnsResult &result)
 {
-    // 定义 addrinfo 结构体并初始化
-    struct addrinfo ainfo, *res;
-    // 清空结构体
-    memset(&ainfo, 0x00, sizeof(ainfo));
-    // 支持 IPv4 和 IPv6
-    ainfo.ai_family = AF_UNSPEC;
-    // 被动模式
-    ainfo.ai_flags = AI_PASSIVE;
-    // 数据报套接字
-    ainfo.ai_socktype = SOCK_DGRAM;
-
-    // 获取主机信息
-    auto ret = ::getaddrinfo(host.c_str(), nullptr, &ainfo, &res);
-
-    // 检查返回值
-    if (ret == -1 || res == nullptr)
+    std::lock_guard<std::mutex> lk(lock_);
+    auto iter = hosts_.find(host);
+    if (iter == hosts_.end())
     {
-        // 出错则返回
         return;
     }
+    auto &state = iter->second;
+    state.resolving = false;
 
-    // 指向结果链表的指针
-    struct addrinfo *rp = res;
-
-    // 遍历 addrinfo 链表
-    for (; rp != nullptr; rp = rp->ai_next)
+    auto now = NowMs();
+    auto entry = std::make_shared<DnsCacheEntry>();
+    entry->status = result.status;
+    if (result.status == kDnsOk || result.status == kDnsNotFound)
     {
-        // 创建 InetAddress 对象
-        InetAddressPtr peeraddr = std::make_shared<InetAddress>();
-
-        // 如果是 IPv4
-        if (rp->ai_family == AF_INET)
+        // TTL 限制在 [min_ttl, interval] 之间；不存在时 ttl 是否定缓存时间，旧地址不再使用
+        // 应答里的 TTL 是协议规定的秒，换算成毫秒之后和其他参数比较，下面的时间都是毫秒
+        int64_t ttl = std::min((int64_t)result.ttl * 1000, (int64_t)interval_);
+        ttl = std::max(ttl, (int64_t)min_ttl_);
+        if (result.status == kDnsOk)
         {
-            // 定义 IPv4 地址缓冲区
-            char ip[16] = {0, };
-            // 转换为 sockaddr_in
-            struct sockaddr_in *saddr = (struct sockaddr_in *)rp->ai_addr;
-            // 转换为字符串格式
-            ::inet_ntop(AF_INET, &(saddr->sin_addr.s_addr), ip, sizeof(ip));
-            // 设置地址
-            peeraddr->SetAddr(ip);
-            // 设置端口
-            peeraddr->SetPort(ntohs(saddr->sin_port));
+            entry->addrs = result.addrs;
         }
-        // 如果是 IPv6
-        else if (rp->ai_family == AF_INET6)
+        entry->expire = now + ttl;
+        // 成功时在 TTL 用到 90% 时提前刷新，读取方一般看不到过期的地址
+        state.refresh_at = result.status == kDnsOk ? now + ttl - ttl / 10 : entry->expire;
+        state.failures = 0;
+    }
+    else
+    {
+        // 超时或者出错：旧地址在 stale 时间内继续使用，按退避间隔重试
+        auto &old = state.entry;
+        if (!old->addrs.empty() && now < old->expire + stale_)
         {
-            // 定义 IPv6 地址缓冲区
-            char ip[INET6_ADDRSTRLEN] = {0, };
-            // 转换为 sockaddr_in6
-            struct sockaddr_in6 *saddr = (struct sockaddr_in6 *)rp->ai_addr;
-            // 转换为字符串格式
-            ::inet_ntop(AF_INET6, &(saddr->sin6_addr), ip, sizeof(ip));
-            // 设置地址
-            peeraddr->SetAddr(ip);
-            // 设置端口
-            peeraddr->SetPort(ntohs(saddr->sin6_port));
-            // 标记为 IPv6
-            peeraddr->SetIsIPV6(true);
+            entry->addrs = old->addrs;
+            entry->expire = old->expire;
         }
-        // 将地址添加到列表中
-        list.push_back(peeraddr);
+        int64_t backoff = (int64_t)sleep_ << std::min(state.failures, kDnsMaxBackoffShift);
+        state.refresh_at = now + std::min(backoff, (int64_t)interval_);
+        state.failures++;
+        NETWORK_WARN << " dns refresh host : " << host << " failed, status : " << result.status
+                     << " failures : " << state.failures << " serve stale : " << !entry->addrs.empty();
+    }
+    state.entry = entry;
+    Publish();
+}
+// 按 hosts_ 生成新的快照并发布
+void DnsService::Publish()
+{
+    auto snapshot = std::make_shared<DnsSnapshot>();
+    snapshot->reserve(hosts_.size());
+    for (auto &h : hosts_)
+    {
+        (*snapshot)[h.first] = h.second.entry;
+    }
+    // 先替换快照再更新版本号，读取方看到新版本号时一定能加载到新快照
+    std::atomic_store(&snapshot_, DnsSnapshotPtr(snapshot));
+    version_.store(++snapshot_version, std::memory_order_release);
+}
+// 当前线程缓存的快照
+const DnsSnapshot &DnsService::Snapshot() const
+{
+    // 快路径只有一次原子读，不加锁，也不修改共享的引用计数
+    auto version = version_.load(std::memory_order_acquire);
+    auto &cache = snapshot_cache;
+    if (cache.owner != this || cache.version != version)
+    {
+        cache.snapshot = std::atomic_load(&snapshot_);
+        cache.owner = this;
+        cache.version = version;
     }
+    // 引用在当前线程下一次调用 Snapshot 之前有效
+    return *cache.snapshot;
+}
+// 单调时钟，单位：毫秒
+int64_t DnsService::NowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 DnsService::~DnsService()
 {
-
+    Stop();
 }
\ No newline at end of file
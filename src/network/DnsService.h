@@ -1,11 +1,22 @@
 #pragma once
+/*
+    DnsService 按 TTL 缓存主机名的解析结果
+    解析在自己的事件循环线程里用 DnsResolver 异步进行，每个主机名按记录的 TTL 刷新（在 TTL 用到 90% 时提前刷新）
+    和 getaddrinfo 一样先查 hosts 文件，再按 resolv.conf 的 search、ndots 和服务器列表查询
+    不存在的主机名按 SOA 给出的否定缓存时间缓存，到期前不再查询
+    刷新超时或者出错时继续返回过期的旧地址（serve-stale），同时按退避时间重试，旧地址过期超过 stale 时间后才丢弃
+    读取不加锁：写入方在事件循环线程里生成新的不可变快照，用 std::atomic_store 整体替换
+    读取方在线程局部缓存快照，只有版本号变化时才重新加载，平时一次原子读就能找到地址
+*/
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include <mutex>
-#include <thread>
+#include <atomic>
 #include <memory>
 #include "network/base/InetAddress.h"
+#include "network/net/EventLoopThread.h"
+#include "network/DnsResolver.h"
 #include "base/NonCopyable.h"
 #include "base/Singleton.h"
 
@@ -16,71 +27,135 @@ namespace tmms
         // 定义InetAddressPtr为InetAddress的智能指针
         using InetAddressPtr = std::shared_ptr<InetAddress>;
 
+        // 缓存里一个主机名的解析结果，发布之后不再修改
+        struct DnsCacheEntry
+        {
+            // 解析出的地址，不带端口；不存在或者一直没解析成功时为空
+            std::vector<InetAddressPtr> addrs;
+            // 最近一次解析的状态
+            DnsStatus status{kDnsError};
+            // 地址的有效期，单位：毫秒（steady_clock）；过期后仍可能在 stale 时间内继续返回
+            int64_t expire{0};
+        };
+        using DnsCacheEntryPtr = std::shared_ptr<const DnsCacheEntry>;
+        // 所有主机名的快照
+        using DnsSnapshot = std::unordered_map<std::string, DnsCacheEntryPtr>;
+        using DnsSnapshotPtr = std::shared_ptr<const DnsSnapshot>;
+
         // DnsService类，继承自NonCopyable
-        class DnsService : public base::NonCopyable 
+        class DnsService : public base::NonCopyable
         {
         public:
             // 默认构造函数
-            DnsService() = default;
+            DnsService();
 
-            // 添加主机，接受一个常量引用类型的字符串参数 host
+            // 添加主机，启动后添加的主机立即解析
             void AddHost(const std::string& host);
 
-            // 从与给定主机名关联的地址列表中检索 IP 地址
+            // 从与给定主机名关联的地址列表中检索 IP 地址，不加锁
             InetAddressPtr GetHostAddress(const std::string &host, int index);
 
-            // 根据给定的主机名返回与之关联的 IP 地址列表
+            // 根据给定的主机名返回与之关联的 IP 地址列表，不加锁
             std::vector<InetAddressPtr> GetHostAddress(const std::string &host);
 
-            // 更新与给定主机名关联的 IP 地址列表，包括间隔、休眠时间和重试次数
+            // 返回主机名的缓存项，不拷贝地址列表，主机名不在缓存里时返回空
+            DnsCacheEntryPtr GetHostEntry(const std::string &host);
+
+            // 手工设置主机的地址列表，有效期为 interval，到期后重新解析
             void UpdateHost(const std::string &host, std::vector<InetAddressPtr> &list);
 
             // 获取当前所有主机及其关联的 IP 地址列表
             std::unordered_map<std::string, std::vector<InetAddressPtr>> GetHosts();
 
-            // 设置DNS服务参数
+            // 设置DNS服务参数：interval 是 TTL 的上限，单位：毫秒；sleep 是解析失败后重试的基础间隔，单位：毫秒，
+            // 连续失败时加倍；retry 是每次解析的重发次数
             void SetDnsServiceParam(int32_t interval, int32_t sleep, int32_t retry);
 
-            // 启动DNS服务
+            // 设置缓存参数，单位和 SetDnsServiceParam 一样是毫秒：min_ttl 是 TTL 的下限，避免 TTL 为 0 的记录不停地查询；
+            // stale 是过期后解析失败时继续返回旧地址的时间
+            void SetCacheParam(int32_t min_ttl, int32_t stale);
+
+            // 设置 DNS 服务器，替换 resolv.conf 里的服务器列表，默认依次使用 resolv.conf 的 nameserver
+            void SetNameServer(const InetAddress &server);
+
+            // 设置 resolv.conf（服务器、search、ndots）和 hosts 文件的路径，默认为 /etc 下的系统文件
+            void SetConfigFiles(const std::string &resolv_conf, const std::string &hosts);
+
+            // 启动DNS服务，以上参数都要在启动之前设置
             void Start();
 
-            // 停止DNS服务
+            // 停止DNS服务，缓存里的地址保留
             void Stop();
 
-            // 在服务运行时持续获取主机信息并更新
+            // 检查到期的主机，发起刷新，在事件循环线程里每秒执行一次
             void OnWork();
 
-            // 静态函数获取主机信息
-            static void GetHostInfo(const std::string &host, std::vector<InetAddressPtr> &list);
-            
             // 析构函数
             ~DnsService();
 
         private:
-            // 线程对象
-            std::thread thread_;
+            // 写入方记录的主机状态
+            struct HostState
+            {
+                DnsCacheEntryPtr entry;
+                // 下次刷新的时间，单位：毫秒（steady_clock）
+                int64_t refresh_at{0};
+                // 连续失败的次数
+                int32_t failures{0};
+                // 正在解析
+                bool resolving{false};
+            };
+
+            // 当前线程缓存的快照，只有版本号变化时才重新加载
+            const DnsSnapshot &Snapshot() const;
+            // 解析完成，在事件循环线程里调用
+            void OnResolved(const std::string &host, const DnsResult &result);
+            // 按 hosts_ 生成新的快照并发布，调用方持有 lock_
+            void Publish();
+            // 单调时钟，单位：毫秒
+            static int64_t NowMs();
+
+            // 解析用的事件循环线程和解析器
+            std::unique_ptr<EventLoopThread> thread_;
+            DnsResolverPtr resolver_;
+            InetAddress server_;
+            // 是否用 SetNameServer 指定了服务器
+            bool has_server_{false};
+            // resolv.conf 和 hosts 文件的路径
+            std::string resolv_conf_{"/etc/resolv.conf"};
+            std::string hosts_file_{"/etc/hosts"};
 
             // 运行状态标志
             bool running_{false};
 
-            // 互斥锁，用于线程安全
+            // 互斥锁，只在写入方之间使用，读取不加锁
             std::mutex lock_;
 
-            // 存储主机信息的无序映射
-            std::unordered_map<std::string, std::vector<InetAddressPtr>> hosts_info_;
+            // 写入方的主机状态
+            std::unordered_map<std::string, HostState> hosts_;
+
+            // 发布给读取方的快照和版本号
+            DnsSnapshotPtr snapshot_;
+            std::atomic<uint64_t> version_{0};
 
             // 重试次数，默认3次
             int32_t retry_{3};
 
-            // 睡眠时间，单位ms
+            // 失败后重试的基础间隔，单位ms
             int32_t sleep_{200};
 
-            // 间隔时间，默认为6min
+            // TTL 的上限，默认为3min
             int32_t interval_{180 * 1000};
+
+            // TTL 的下限，单位ms，默认5s
+            int32_t min_ttl_{5 * 1000};
+
+            // 过期后继续返回旧地址的时间，单位ms，默认10min
+            int32_t stale_{600 * 1000};
         };
 
         // 定义单例DnsService实例
-        
+
         #define sDnsService tmms::base::Singleton<tmms::network::DnsService>::Instance()
     }
-}
\ No newline at end of file
+}
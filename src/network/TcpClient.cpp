@@ -1,8 +1,75 @@
+#include <algorithm>
+#include <unistd.h>
 #include "TcpClient.h"
+#include "network/DnsResolver.h"
 #include "network/base/Network.h"
 #include "network/base/SocketOpt.h"
 
 using namespace tmms::network;
+
+// 一次连接尝试，套接字连上或者失败后通知所属的 TcpClient
+class TcpClient::ConnectAttempt : public Event
+{
+public:
+    ConnectAttempt(EventLoop *loop, int fd, const InetAddress &addr, const std::weak_ptr<TcpClient> &owner)
+        : Event(loop, fd), addr_(addr), owner_(owner)
+    {
+    }
+
+    // 连接完成时套接字可写，失败时可能只报可读或者出错
+    void OnWrite() override
+    {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        ::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len);
+        Done(error == 0);
+    }
+    void OnRead() override
+    {
+        OnWrite();
+    }
+    void OnError(const std::string &msg) override
+    {
+        Done(false);
+    }
+    void OnClose() override
+    {
+        Done(false);
+    }
+
+    // 把套接字交出去，自己析构时不再关闭
+    int Release()
+    {
+        int fd = fd_;
+        fd_ = -1;
+        return fd;
+    }
+
+    const InetAddress &Addr() const
+    {
+        return addr_;
+    }
+
+    // 通知结果，只通知一次
+    void Done(bool connected)
+    {
+        if (done_)
+        {
+            return;
+        }
+        done_ = true;
+        auto owner = owner_.lock();
+        if (owner)
+        {
+            owner->OnAttemptDone(std::static_pointer_cast<ConnectAttempt>(shared_from_this()), connected);
+        }
+    }
+
+private:
+    InetAddress addr_;
+    std::weak_ptr<TcpClient> owner_;
+    bool done_{false};
+};
 //构造函数
 TcpClient::TcpClient(EventLoop *loop, const InetAddress &server)
     : TcpConnection(loop, -1, InetAddress(), server)        // 调用基类TcpConnection的构造函数
@@ -19,6 +86,44 @@ void TcpClient::Connect()
         ConnectInLoop();
     });
 }
+// 先解析再连接，解析结果在解析器的事件循环线程返回，再投递到连接所在的事件循环
+void TcpClient::Connect(const DnsResolverPtr &resolver, const std::string &host, uint16_t port)
+{
+    auto self = std::dynamic_pointer_cast<TcpClient>(shared_from_this());
+    loop_->RunInLoop([self, resolver, host, port]()
+                     {
+        // 解析期间也算连接中，Status() 和连接池据此知道有连接正在进行，期间 ForceClose 也按连接失败处理
+        self->status_ = kTcpConStatusConnecting;
+        self->ResolveInLoop(resolver, host, port); });
+}
+// 在事件循环里发起解析，结果投递回连接所在的事件循环
+void TcpClient::ResolveInLoop(const DnsResolverPtr &resolver, const std::string &host, uint16_t port)
+{
+    auto self = std::dynamic_pointer_cast<TcpClient>(shared_from_this());
+    resolver->Resolve(host, [self, port](const std::string &name, const DnsResult &result)
+                      {
+        auto addrs = result.addrs;
+        auto status = result.status;
+        self->loop_->RunInLoop([self, name, addrs, status, port]()
+                               {
+            // 解析期间连接被关闭了
+            if (self->status_ != kTcpConStatusConnecting)
+            {
+                return;
+            }
+            if (status != kDnsOk || addrs.empty())
+            {
+                NETWORK_WARN << " resolve host : " << name << " failed, status : " << status;
+                self->status_ = kTcpConStatusDisConnected;
+                if (self->connected_cb_)
+                {
+                    self->connected_cb_(self->Self(), false);
+                }
+                return;
+            }
+            self->SetCandidates(addrs, port);
+            self->ConnectInLoop(); }); });
+}
 //设置回调函数
 void TcpClient::SetConnectCallback(const ConnectionCallback &cb)
 {
@@ -31,18 +136,89 @@ void TcpClient::SetConnectCallback(ConnectionCallback &&cb)
     // 移动传入的回调函数
     connected_cb_ = std::move(cb);
 }
+// 设置连接超时时间
+void TcpClient::SetConnectTimeout(int32_t timeout)
+{
+    connect_timeout_ = timeout;
+}
+// 返回当前的连接状态
+int32_t TcpClient::Status() const
+{
+    return status_;
+}
+// 设置候选地址
+void TcpClient::SetCandidates(const std::vector<InetAddress> &addrs)
+{
+    // IPv6 和 IPv4 交替排列，从第一个地址的地址族开始，某一族整体不通时另一族很快就能轮到
+    std::vector<InetAddress> first, second;
+    for (auto &a : addrs)
+    {
+        if (a.IsIpV6() == addrs.front().IsIpV6())
+        {
+            first.emplace_back(a);
+        }
+        else
+        {
+            second.emplace_back(a);
+        }
+    }
+    candidates_.clear();
+    for (size_t i = 0; i < first.size() || i < second.size(); i++)
+    {
+        if (i < first.size())
+        {
+            candidates_.emplace_back(first[i]);
+        }
+        if (i < second.size())
+        {
+            candidates_.emplace_back(second[i]);
+        }
+    }
+    if (!candidates_.empty())
+    {
+        server_addr_ = candidates_.front();
+    }
+}
+// 用 DnsService 的解析结果设置候选地址
+void TcpClient::SetCandidates(const std::vector<InetAddressPtr> &addrs, uint16_t port)
+{
+    std::vector<InetAddress> list;
+    for (auto &a : addrs)
+    {
+        if (a)
+        {
+            list.emplace_back(*a);
+            list.back().SetPort(port);
+        }
+    }
+    SetCandidates(list);
+}
+// 设置两次连接尝试之间的间隔
+void TcpClient::SetConnectStagger(int32_t ms)
+{
+    stagger_ms_ = ms;
+}
 
 void TcpClient::ConnectInLoop()
 {
     // 确保在正确的线程中执行
     loop_->AssertInLoopThread();
+
+    // 多个候选地址时竞速连接
+    if (candidates_.size() > 1)
+    {
+        RaceInLoop();
+        return;
+    }
+
     // 创建非阻塞TCP套接字
-    fd_ = SocketOpt::CreateNonblockingTcpSocket(AF_INET);
+    fd_ = SocketOpt::CreateNonblockingTcpSocket(server_addr_.IsIpV6() ? AF_INET6 : AF_INET);
 
     // 检查套接字是否创建成功
     if (fd_ < 0)
     {
-        // 创建失败，关闭连接
+        // 创建失败，按连接失败处理，关闭连接并通知
+        status_ = kTcpConStatusConnecting;
         OnClose();
 
         // 退出函数
@@ -59,6 +235,8 @@ void TcpClient::ConnectInLoop()
     // 设置空闲超时为3秒
     // EnableCheckIdleTimeout(3);
 
+    ScheduleConnectTimeout();
+
     // 创建SocketOpt对象以操作套接字
     SocketOpt opt(fd_);
     // 尝试连接服务器
@@ -90,6 +268,140 @@ void TcpClient::ConnectInLoop()
     }
 }
 
+// 连接超时检查放到时间轮上
+void TcpClient::ScheduleConnectTimeout()
+{
+    // 用弱指针，连接先销毁的话什么都不做
+    if (connect_timeout_ > 0)
+    {
+        std::weak_ptr<TcpClient> weak = std::static_pointer_cast<TcpClient>(shared_from_this());
+        loop_->RunAfter(connect_timeout_, [weak]()
+                        {
+            auto client = weak.lock();
+            if (client && client->status_ == kTcpConStatusConnecting)
+            {
+                NETWORK_ERROR << " connect to server : " << client->server_addr_.ToIpPort() << " timeout.";
+                client->OnClose();
+            } });
+    }
+}
+
+// 在事件循环中对候选地址发起竞速连接
+void TcpClient::RaceInLoop()
+{
+    status_ = kTcpConStatusConnecting;
+    next_candidate_ = 0;
+    // 超时针对整个竞速过程，超时后所有尝试一起关闭
+    ScheduleConnectTimeout();
+    StartNextAttempt();
+}
+
+// 对下一个候选地址发起连接
+void TcpClient::StartNextAttempt()
+{
+    while (status_ == kTcpConStatusConnecting && next_candidate_ < candidates_.size())
+    {
+        const InetAddress &addr = candidates_[next_candidate_++];
+        int fd = SocketOpt::CreateNonblockingTcpSocket(addr.IsIpV6() ? AF_INET6 : AF_INET);
+        if (fd < 0)
+        {
+            continue;
+        }
+        SocketOpt opt(fd);
+        auto ret = opt.Connect(addr);
+        if (ret == -1 && errno != EINPROGRESS)
+        {
+            // 立即失败的（比如地址族不可用、网络不可达）直接换下一个，不用等
+            NETWORK_WARN << " connect to server : " << addr.ToIpPort() << " error : " << errno;
+            ::close(fd);
+            continue;
+        }
+
+        auto attempt = std::make_shared<ConnectAttempt>(loop_, fd, addr,
+                                                        std::static_pointer_cast<TcpClient>(shared_from_this()));
+        attempts_.emplace_back(attempt);
+        loop_->AddEvent(attempt);
+        attempt->EnableWriting(true);
+        if (ret == 0)
+        {
+            // 本机地址可能立即连上
+            attempt->Done(true);
+            return;
+        }
+
+        // 到了间隔还没有结果就发起下一个，期间有新的尝试发起的话这次定时作废
+        if (next_candidate_ < candidates_.size())
+        {
+            auto seq = ++stagger_seq_;
+            std::weak_ptr<TcpClient> weak = std::static_pointer_cast<TcpClient>(shared_from_this());
+            loop_->RunAfterMs(stagger_ms_, [weak, seq]()
+                              {
+                auto client = weak.lock();
+                if (client && client->stagger_seq_ == seq)
+                {
+                    client->StartNextAttempt();
+                } });
+        }
+        return;
+    }
+
+    // 没有可以发起的尝试，也没有进行中的，全部失败
+    if (status_ == kTcpConStatusConnecting && attempts_.empty())
+    {
+        NETWORK_ERROR << " connect to all " << candidates_.size() << " candidates failed.";
+        OnClose();
+    }
+}
+
+// 一次尝试有了结果
+void TcpClient::OnAttemptDone(const ConnectAttemptPtr &attempt, bool connected)
+{
+    auto iter = std::find(attempts_.begin(), attempts_.end(), attempt);
+    if (iter == attempts_.end())
+    {
+        return;
+    }
+    attempts_.erase(iter);
+    loop_->DelEvent(attempt);
+
+    if (status_ != kTcpConStatusConnecting)
+    {
+        return;
+    }
+
+    if (!connected)
+    {
+        NETWORK_WARN << " connect to server : " << attempt->Addr().ToIpPort() << " failed.";
+        attempt->Close();
+        // 失败了马上发起下一个，不等间隔
+        StartNextAttempt();
+        return;
+    }
+
+    // 胜出：其余的尝试全部关闭，接管胜出的套接字
+    AbortAttempts();
+    fd_ = attempt->Release();
+    server_addr_ = attempt->Addr();
+    peer_addr_ = attempt->Addr();
+    loop_->AddEvent(std::static_pointer_cast<TcpClient>(shared_from_this()));
+    NETWORK_TRACE << " connect to server : " << server_addr_.ToIpPort() << " won.";
+    UpdateConnectionStatus();
+}
+
+// 关闭所有还在进行的尝试
+void TcpClient::AbortAttempts()
+{
+    // 错开的定时任务也一起作废
+    stagger_seq_++;
+    std::vector<ConnectAttemptPtr> attempts;
+    attempts.swap(attempts_);
+    for (auto &a : attempts)
+    {
+        loop_->DelEvent(a);
+        a->Close();
+    }
+}
+
 void TcpClient::UpdateConnectionStatus()
 {
     // 更新状态为已连接
@@ -180,6 +492,11 @@ void TcpClient::OnWrite()
 
 void TcpClient::OnClose()
 {
+    // 连接还没建立就关闭了，说明连接失败
+    bool connecting = status_ == kTcpConStatusConnecting;
+    // 竞速中被关闭（超时或者 ForceClose），进行中的尝试一起关闭
+    AbortAttempts();
+
     // 如果状态为连接中或已连接
     if (status_ == kTcpConStatusConnecting || status_ == kTcpConStatusConnected)
     {
@@ -191,6 +508,12 @@ void TcpClient::OnClose()
     status_ = kTcpConStatusDisConnected;
     // 调用基类的关闭处理
     TcpConnection::OnClose();
+
+    // 通知连接失败，上层可以据此重试
+    if (connecting && connected_cb_)
+    {
+        connected_cb_(Self(), false);
+    }
 }
 
 void TcpClient::Send(std::list<BufferNodePtr> &list)
@@ -215,6 +538,6 @@ void TcpClient::Send(const char *buff, size_t size)
 
 TcpClient::~TcpClient()
 {
-    // 调用关闭函数
-    OnClose();
+    // 事件循环持有连接的智能指针，走到析构时连接已经不在事件循环里，只剩套接字要关闭，由 Event 的析构函数完成
+    // 这里不能再调用 OnClose：析构函数里不能用 shared_from_this，而且连接池里的客户端可能在任意线程析构
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <functional>
+#include <vector>
 #include "network/base/InetAddress.h"
 #include "network/net/TcpConnection.h"
 #include "network/net/EventLoop.h"
@@ -20,6 +21,12 @@ namespace tmms
         // 定义连接回调类型，用于处理连接状态的回调
         using ConnectionCallback = std::function<void (const TcpConnectionPtr &con, bool)>;
 
+        // DnsService 返回的地址类型
+        using InetAddressPtr = std::shared_ptr<InetAddress>;
+
+        class DnsResolver;
+        using DnsResolverPtr = std::shared_ptr<DnsResolver>;
+
         // TcpClient 类，继承自 TcpConnection
         class TcpClient : public TcpConnection
         {
@@ -30,12 +37,33 @@ namespace tmms
              // 连接方法
             void Connect();
 
+            // 先用异步解析器解析 host，再对解析出的地址（端口为 port）发起连接，不阻塞事件循环
+            // 解析失败时和连接失败一样，通过连接回调报告 false
+            void Connect(const DnsResolverPtr &resolver, const std::string &host, uint16_t port);
+
             // 设置连接回调（左值引用）
             void SetConnectCallback(const ConnectionCallback &cb);
 
             // 设置连接回调（右值引用）
             void SetConnectCallback(ConnectionCallback &&cb);
 
+            // 设置连接超时时间，单位：秒，超时还没连上就关闭并通过连接回调报告失败，0 表示不检查
+            void SetConnectTimeout(int32_t timeout);
+
+            // 返回当前的连接状态
+            int32_t Status() const;
+
+            // 设置候选地址，多于一个时 Connect 按 Happy Eyeballs 的方式连接：
+            // IPv6 和 IPv4 交替排列，每隔一段时间或者上一个失败时再发起下一个，先连上的胜出，其余的关闭
+            // 某个地址被黑洞时，连接耗时从连接超时缩短到错开的间隔
+            void SetCandidates(const std::vector<InetAddress> &addrs);
+
+            // 用 DnsService 的解析结果设置候选地址，解析结果不带端口，统一使用 port
+            void SetCandidates(const std::vector<InetAddressPtr> &addrs, uint16_t port);
+
+            // 设置两次连接尝试之间的间隔，单位：毫秒，默认 250
+            void SetConnectStagger(int32_t ms);
+
             // 重写读取事件处理
             void OnRead() override;
 
@@ -55,9 +83,31 @@ namespace tmms
             virtual ~TcpClient();
 
         private:
+            // 一次连接尝试，自己的套接字单独注册到事件循环，胜出后套接字交给 TcpClient
+            class ConnectAttempt;
+            using ConnectAttemptPtr = std::shared_ptr<ConnectAttempt>;
+
             // 在事件循环中进行连接
             void ConnectInLoop();
 
+            // 在事件循环中发起解析，解析完成后连接
+            void ResolveInLoop(const DnsResolverPtr &resolver, const std::string &host, uint16_t port);
+
+            // 连接超时检查放到时间轮上
+            void ScheduleConnectTimeout();
+
+            // 在事件循环中对候选地址发起竞速连接
+            void RaceInLoop();
+
+            // 对下一个候选地址发起连接，并安排下一次错开的尝试
+            void StartNextAttempt();
+
+            // 一次尝试有了结果
+            void OnAttemptDone(const ConnectAttemptPtr &attempt, bool connected);
+
+            // 关闭所有还在进行的尝试
+            void AbortAttempts();
+
             // 更新连接状态
             void UpdateConnectionStatus();
 
@@ -72,6 +122,24 @@ namespace tmms
 
             // 连接回调
             ConnectionCallback connected_cb_;
+
+            // 连接超时时间，单位：秒，0 表示不检查
+            int32_t connect_timeout_{0};
+
+            // 竞速连接的候选地址，已经按地址族交替排好
+            std::vector<InetAddress> candidates_;
+
+            // 下一个要尝试的候选地址
+            size_t next_candidate_{0};
+
+            // 正在进行的尝试
+            std::vector<ConnectAttemptPtr> attempts_;
+
+            // 两次尝试之间的间隔，单位：毫秒
+            int32_t stagger_ms_{250};
+
+            // 每发起一次尝试加一，过期的错开定时任务据此忽略
+            uint32_t stagger_seq_{0};
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,529 @@
+#include <algorithm>
+#include "TcpClientPool.h"
+#include "network/base/Network.h"
+
+using namespace tmms::network;
+
+TcpClientPool::TcpClientPool(EventLoopThreadPool *loops)
+    : loops_(loops)
+    , rand_(std::random_device()())
+{
+}
+
+// 添加源站
+void TcpClientPool::AddOrigin(const InetAddress &origin, int32_t warm)
+{
+    std::vector<TcpClientPtr> clients;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        if (stopped_)
+        {
+            return;
+        }
+        auto &o = origins_[origin.ToIpPort()];
+        if (!o)
+        {
+            o = std::make_shared<Origin>();
+            o->addr = origin;
+        }
+        o->warm = warm;
+        clients = FillLocked(o);
+    }
+    StartConnect(clients);
+}
+
+// 删除源站
+void TcpClientPool::RemoveOrigin(const InetAddress &origin)
+{
+    OriginPtr o;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        auto iter = origins_.find(origin.ToIpPort());
+        if (iter == origins_.end())
+        {
+            return;
+        }
+        o = iter->second;
+        origins_.erase(iter);
+    }
+
+    // 源站已经从表里删除，连接中的客户端连上后会发现找不到源站，自己关闭
+    // 这里只需要关闭空闲连接，通知等待的回调
+    std::vector<TcpClientPtr> idle;
+    std::vector<Waiter> waiters;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        idle.swap(o->idle);
+        waiters.swap(o->waiters);
+    }
+    for (auto &c : idle)
+    {
+        c->ForceClose();
+    }
+    for (auto &w : waiters)
+    {
+        w.cb(nullptr);
+    }
+}
+
+// 设置连接超时时间
+void TcpClientPool::SetConnectTimeout(int32_t timeout)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    connect_timeout_ = timeout;
+}
+
+// 设置重连的退避时间
+void TcpClientPool::SetBackoff(int32_t base, int32_t max)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    backoff_base_ = base > 0 ? base : 1;
+    backoff_max_ = max > backoff_base_ ? max : backoff_base_;
+}
+
+// 设置 Acquire 默认的等待时间
+void TcpClientPool::SetAcquireTimeout(int32_t timeout)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    acquire_timeout_ = timeout > 0 ? timeout : 0;
+}
+
+// 取一个已连接的客户端
+void TcpClientPool::Acquire(const InetAddress &origin, const TcpClientAcquireCallback &cb, int32_t timeout)
+{
+    TcpClientPtr client;
+    std::vector<TcpClientPtr> clients;
+    bool waiting = false;
+    uint64_t id = 0;
+    OriginPtr waiting_origin;
+    EventLoop *timer_loop = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        auto iter = origins_.find(origin.ToIpPort());
+        if (!stopped_ && iter != origins_.end())
+        {
+            auto &o = iter->second;
+            if (!o->idle.empty())
+            {
+                client = o->idle.back();
+                o->idle.pop_back();
+            }
+            else
+            {
+                // 没有空闲连接，排队等新连接建立
+                id = ++next_waiter_;
+                Waiter waiter;
+                waiter.id = id;
+                waiter.cb = cb;
+                o->waiters.emplace_back(std::move(waiter));
+                waiting = true;
+                if (timeout < 0)
+                {
+                    timeout = acquire_timeout_;
+                }
+                if (timeout > 0)
+                {
+                    waiting_origin = o;
+                    timer_loop = loops_->GetNextLoop();
+                }
+            }
+            // 取走一个或者多了一个等待者，都需要补足连接
+            clients = FillLocked(o);
+        }
+    }
+    // 发起连接可能在当前线程直接失败并回调，必须在锁外调用
+    StartConnect(clients);
+
+    if (waiting)
+    {
+        if (timer_loop)
+        {
+            // 等待者被满足之后定时器照常到期，找不到编号就什么也不做
+            std::weak_ptr<TcpClientPool> weak_pool = shared_from_this();
+            std::weak_ptr<Origin> weak_origin = waiting_origin;
+            timer_loop->RunAfterMs(timeout, [weak_pool, weak_origin, id]()
+                                   {
+                auto pool = weak_pool.lock();
+                auto origin = weak_origin.lock();
+                if (pool && origin)
+                {
+                    pool->OnAcquireTimeout(origin, id);
+                } });
+        }
+        return;
+    }
+    if (!client)
+    {
+        // 池已经停止或者源站不存在
+        cb(nullptr);
+        return;
+    }
+
+    // 在连接所在的事件循环里回调，和新建连接时的回调线程保持一致
+    // 空闲连接可能刚好被源站关闭，这种情况重新取一次
+    std::weak_ptr<TcpClientPool> weak = shared_from_this();
+    InetAddress addr = origin;
+    client->Loop()->RunInLoop([weak, client, addr, cb]()
+                              {
+        if (client->Status() == kTcpConStatusConnected)
+        {
+            cb(client);
+            return;
+        }
+        auto pool = weak.lock();
+        if (pool)
+        {
+            pool->Acquire(addr, cb);
+        }
+        else
+        {
+            cb(nullptr);
+        } });
+}
+
+// 取一个空闲的已连接客户端，不等待
+TcpClientPtr TcpClientPool::TryAcquire(const InetAddress &origin)
+{
+    TcpClientPtr client;
+    std::vector<TcpClientPtr> clients;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        auto iter = origins_.find(origin.ToIpPort());
+        if (stopped_ || iter == origins_.end() || iter->second->idle.empty())
+        {
+            return nullptr;
+        }
+        auto &o = iter->second;
+        client = o->idle.back();
+        o->idle.pop_back();
+        clients = FillLocked(o);
+    }
+    StartConnect(clients);
+    return client;
+}
+
+// 把取走的连接还回池里
+void TcpClientPool::Release(const TcpClientPtr &client)
+{
+    if (!client)
+    {
+        return;
+    }
+    // 回调要在连接所在的事件循环里重新设置
+    std::weak_ptr<TcpClientPool> weak = shared_from_this();
+    client->Loop()->RunInLoop([weak, client]()
+                              {
+        auto pool = weak.lock();
+        if (pool)
+        {
+            pool->ReleaseInLoop(client);
+        }
+        else
+        {
+            client->ForceClose();
+        } });
+}
+
+// 在连接所在的事件循环里归还连接
+void TcpClientPool::ReleaseInLoop(const TcpClientPtr &client)
+{
+    // 已经断开的直接丢弃
+    if (client->Status() != kTcpConStatusConnected)
+    {
+        return;
+    }
+
+    // 清掉使用者设置的回调，空闲时收到的数据直接丢弃
+    client->SetRecvMsgCallback(MessageCallback());
+    client->SetRecvMsgRefCallback(MessageRefCallback());
+    client->SetWriteCompleteCallback(WriteCompleteCallback());
+    client->SetWriteCompleteRefCallback(WriteCompleteRefCallback());
+
+    TcpClientAcquireCallback waiter;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        auto iter = origins_.find(client->PeerAddr().ToIpPort());
+        if (!stopped_ && iter != origins_.end())
+        {
+            auto &o = iter->second;
+            // 有等待者的直接交给等待者
+            if (!o->waiters.empty())
+            {
+                waiter = std::move(o->waiters.front().cb);
+                o->waiters.erase(o->waiters.begin());
+            }
+            // 空闲连接不超过预热数量
+            else if ((int32_t)o->idle.size() < o->warm)
+            {
+                ParkLocked(o, client);
+                return;
+            }
+        }
+    }
+
+    if (waiter)
+    {
+        waiter(client);
+        return;
+    }
+    client->ForceClose();
+}
+
+// 源站当前的空闲连接数
+size_t TcpClientPool::IdleCount(const InetAddress &origin)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    auto iter = origins_.find(origin.ToIpPort());
+    if (iter == origins_.end())
+    {
+        return 0;
+    }
+    return iter->second->idle.size();
+}
+
+// 停止连接池
+void TcpClientPool::Stop()
+{
+    std::vector<TcpClientPtr> idle;
+    std::vector<Waiter> waiters;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        if (stopped_)
+        {
+            return;
+        }
+        stopped_ = true;
+        for (auto &kv : origins_)
+        {
+            auto &o = kv.second;
+            idle.insert(idle.end(), o->idle.begin(), o->idle.end());
+            waiters.insert(waiters.end(), o->waiters.begin(), o->waiters.end());
+            o->idle.clear();
+            o->waiters.clear();
+        }
+        origins_.clear();
+    }
+    for (auto &c : idle)
+    {
+        c->ForceClose();
+    }
+    for (auto &w : waiters)
+    {
+        w.cb(nullptr);
+    }
+}
+
+TcpClientPool::~TcpClientPool()
+{
+    // 析构时已经不能再取自身的弱指针，空闲连接的回调里持有的弱指针都会失效
+    Stop();
+}
+
+// 补足预热连接，调用时必须持有锁
+std::vector<TcpClientPtr> TcpClientPool::FillLocked(const OriginPtr &origin)
+{
+    std::vector<TcpClientPtr> clients;
+    // 停止了，或者正在退避，等退避结束再补
+    if (stopped_ || origin->retry_pending)
+    {
+        return clients;
+    }
+
+    // 需要的连接数：预热数量加上等待者，减去已有的空闲和正在连接的
+    int32_t need = origin->warm + (int32_t)origin->waiters.size()
+                   - (int32_t)origin->idle.size() - (int32_t)origin->connecting.size();
+    for (int32_t i = 0; i < need; i++)
+    {
+        auto client = CreateClient(origin);
+        origin->connecting.insert(client);
+        clients.emplace_back(client);
+    }
+    return clients;
+}
+
+// 创建一个新的客户端并设置回调
+TcpClientPtr TcpClientPool::CreateClient(const OriginPtr &origin)
+{
+    // 轮流分配到各个事件循环，连接建立和后续的读写都在这个事件循环里
+    auto client = std::make_shared<TcpClient>(loops_->GetNextLoop(), origin->addr);
+    client->SetConnectTimeout(connect_timeout_);
+
+    // 回调里只持有弱指针，源站和连接池都不会因为回调而延长生命周期
+    std::weak_ptr<TcpClientPool> weak_pool = shared_from_this();
+    std::weak_ptr<Origin> weak_origin = origin;
+    client->SetConnectCallback([weak_pool, weak_origin](const TcpConnectionPtr &con, bool connected)
+                               {
+        auto client = std::static_pointer_cast<TcpClient>(con);
+        auto pool = weak_pool.lock();
+        auto origin = weak_origin.lock();
+        if (!pool || !origin)
+        {
+            // 连接池或者源站已经不在了，连上的连接直接关闭
+            if (connected)
+            {
+                client->ForceClose();
+            }
+            return;
+        }
+        pool->OnConnected(origin, client, connected); });
+    return client;
+}
+
+// 在锁外发起连接
+void TcpClientPool::StartConnect(const std::vector<TcpClientPtr> &clients)
+{
+    for (auto &c : clients)
+    {
+        c->Connect();
+    }
+}
+
+// 连接结果
+void TcpClientPool::OnConnected(const OriginPtr &origin, const TcpClientPtr &client, bool connected)
+{
+    TcpClientAcquireCallback waiter;
+    bool drop = false;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        origin->connecting.erase(client);
+
+        if (connected)
+        {
+            origin->failures = 0;
+            if (stopped_ || origins_.find(origin->addr.ToIpPort()) == origins_.end())
+            {
+                // 池已经停止或者源站已经删除
+                drop = true;
+            }
+            else if (!origin->waiters.empty())
+            {
+                // 优先交给等待者
+                waiter = std::move(origin->waiters.front().cb);
+                origin->waiters.erase(origin->waiters.begin());
+            }
+            else
+            {
+                ParkLocked(origin, client);
+            }
+        }
+        else
+        {
+            // 同一轮发起的几个连接一起失败只算一次，退避结束前不会再有新的连接
+            if (!stopped_ && !origin->retry_pending)
+            {
+                origin->failures++;
+                NETWORK_WARN << " origin : " << origin->addr.ToIpPort() << " connect failed, failures : " << origin->failures;
+                // 退避一段时间后再补足连接，期间不再发起新的连接
+                origin->retry_pending = true;
+                auto delay = BackoffLocked(origin);
+                std::weak_ptr<TcpClientPool> weak_pool = shared_from_this();
+                std::weak_ptr<Origin> weak_origin = origin;
+                client->Loop()->RunAfterMs(delay, [weak_pool, weak_origin]()
+                                           {
+                    auto pool = weak_pool.lock();
+                    auto origin = weak_origin.lock();
+                    if (pool && origin)
+                    {
+                        pool->OnRetry(origin);
+                    } });
+            }
+        }
+    }
+
+    if (drop)
+    {
+        client->ForceClose();
+    }
+    else if (waiter)
+    {
+        waiter(client);
+    }
+}
+
+// 空闲连接被关闭
+void TcpClientPool::OnIdleClosed(const OriginPtr &origin, const TcpClientPtr &client)
+{
+    std::vector<TcpClientPtr> clients;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        auto iter = std::find(origin->idle.begin(), origin->idle.end(), client);
+        if (iter == origin->idle.end())
+        {
+            return;
+        }
+        origin->idle.erase(iter);
+        NETWORK_TRACE << " origin : " << origin->addr.ToIpPort() << " idle connection closed.";
+        clients = FillLocked(origin);
+    }
+    StartConnect(clients);
+}
+
+// 计算下一次重连的等待时间
+int64_t TcpClientPool::BackoffLocked(const OriginPtr &origin)
+{
+    // 指数退避：base * 2^(failures-1)，最多 max
+    int64_t delay = backoff_base_;
+    for (int32_t i = 1; i < origin->failures && delay < backoff_max_; i++)
+    {
+        delay <<= 1;
+    }
+    if (delay > backoff_max_)
+    {
+        delay = backoff_max_;
+    }
+
+    // 加上随机抖动，在 [delay/2, delay] 之间，避免很多边缘节点同时重连源站
+    int64_t half = delay / 2;
+    std::uniform_int_distribution<int64_t> dist(0, delay - half);
+    delay = half + dist(rand_);
+    return delay < 1 ? 1 : delay;
+}
+
+// 等待的 Acquire 超时
+void TcpClientPool::OnAcquireTimeout(const OriginPtr &origin, uint64_t id)
+{
+    TcpClientAcquireCallback waiter;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        auto iter = std::find_if(origin->waiters.begin(), origin->waiters.end(), [id](const Waiter &w)
+                                 { return w.id == id; });
+        if (iter == origin->waiters.end())
+        {
+            return;
+        }
+        waiter = std::move(iter->cb);
+        origin->waiters.erase(iter);
+    }
+    NETWORK_WARN << " origin : " << origin->addr.ToIpPort() << " acquire timeout.";
+    waiter(nullptr);
+}
+
+// 退避时间到了，重新补足连接
+void TcpClientPool::OnRetry(const OriginPtr &origin)
+{
+    std::vector<TcpClientPtr> clients;
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        origin->retry_pending = false;
+        clients = FillLocked(origin);
+    }
+    StartConnect(clients);
+}
+
+// 把客户端挂到空闲列表
+void TcpClientPool::ParkLocked(const OriginPtr &origin, const TcpClientPtr &client)
+{
+    origin->idle.emplace_back(client);
+
+    // 空闲期间被源站关闭的，从空闲列表删除并补足
+    std::weak_ptr<TcpClientPool> weak_pool = shared_from_this();
+    std::weak_ptr<Origin> weak_origin = origin;
+    client->SetCloseCallback([weak_pool, weak_origin](const TcpConnectionPtr &con)
+                             {
+        auto pool = weak_pool.lock();
+        auto origin = weak_origin.lock();
+        if (pool && origin)
+        {
+            pool->OnIdleClosed(origin, std::static_pointer_cast<TcpClient>(con));
+        } });
+}
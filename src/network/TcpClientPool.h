@@ -0,0 +1,157 @@
+#pragma once
+/*
+    回源连接池
+    边缘节点从源站拉流时使用，每个源站保持一定数量的预热连接，拉流时直接取用，不需要等待三次握手
+    连接失败按指数退避加随机抖动重试，避免源站恢复时所有边缘同时重连，退避用毫秒定时器
+    等待连接的 Acquire 有超时，源站一直不可用时按时回调空指针
+    连接超时由 TcpClient 放在时间轮上检查
+    新的连接轮流分配到 EventLoopThreadPool 的各个事件循环上
+    连接回调来自不同的事件循环线程，池的状态用互斥锁保护，回调都在锁外调用
+*/
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "network/TcpClient.h"
+#include "network/net/EventLoopThreadPool.h"
+#include "network/base/InetAddress.h"
+#include "base/NonCopyable.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        // 定义 TcpClient 的智能指针类型
+        using TcpClientPtr = std::shared_ptr<TcpClient>;
+
+        // 取连接的回调，成功时参数为已连接的客户端，池停止或者等待超时时参数为空
+        using TcpClientAcquireCallback = std::function<void(const TcpClientPtr &)>;
+
+        // 连接回调和定时任务通过弱指针访问连接池，必须用 std::make_shared 创建
+        class TcpClientPool : public std::enable_shared_from_this<TcpClientPool>, public base::NonCopyable
+        {
+        public:
+            // 构造函数，新的连接从 loops 里轮流选择事件循环
+            TcpClientPool(EventLoopThreadPool *loops);
+
+            // 添加源站，warm 为保持的预热连接数
+            void AddOrigin(const InetAddress &origin, int32_t warm);
+
+            // 删除源站，关闭它的空闲连接，不再重连；已经取走的连接不受影响
+            void RemoveOrigin(const InetAddress &origin);
+
+            // 设置连接超时时间，单位：秒
+            void SetConnectTimeout(int32_t timeout);
+
+            // 设置重连的退避时间，单位：毫秒，第 n 次失败后等待 base * 2^(n-1)，最多 max，实际等待在它的一半到全部之间随机
+            void SetBackoff(int32_t base, int32_t max);
+
+            // 设置 Acquire 默认的等待时间，单位：毫秒，0 表示一直等待
+            void SetAcquireTimeout(int32_t timeout);
+
+            // 取一个已连接的客户端，有空闲连接时直接回调，否则等新连接建立后回调
+            // 等待超过 timeout 毫秒时回调空指针，timeout 小于 0 时用 SetAcquireTimeout 的设置，0 表示一直等待
+            // 回调在连接所在的事件循环线程执行（超时时在池的某个事件循环线程执行），取走的连接归调用者所有，用完可以 Release 还回来
+            void Acquire(const InetAddress &origin, const TcpClientAcquireCallback &cb, int32_t timeout = -1);
+
+            // 取一个空闲的已连接客户端，没有时返回空，不等待
+            TcpClientPtr TryAcquire(const InetAddress &origin);
+
+            // 把取走的连接还回池里，连接已经断开的直接丢弃
+            void Release(const TcpClientPtr &client);
+
+            // 源站当前的空闲连接数
+            size_t IdleCount(const InetAddress &origin);
+
+            // 停止连接池，关闭所有空闲连接，等待中的 Acquire 回调空指针
+            void Stop();
+
+            ~TcpClientPool();
+
+        private:
+            // 一个等待连接的 Acquire
+            struct Waiter
+            {
+                uint64_t id{0};                                     // 超时时据此找到自己
+                TcpClientAcquireCallback cb;
+            };
+
+            // 一个源站的状态
+            struct Origin
+            {
+                InetAddress addr;                                   // 源站地址
+                int32_t warm{1};                                    // 保持的预热连接数
+                int32_t failures{0};                                // 连续失败的次数
+                bool retry_pending{false};                          // 是否已经安排了退避后的重连
+                std::vector<TcpClientPtr> idle;                     // 空闲的已连接客户端
+                std::unordered_set<TcpClientPtr> connecting;        // 正在连接的客户端
+                std::vector<Waiter> waiters;                        // 等待连接的 Acquire
+            };
+            using OriginPtr = std::shared_ptr<Origin>;
+
+            // 补足预热连接，调用时必须持有锁，返回需要发起连接的客户端
+            std::vector<TcpClientPtr> FillLocked(const OriginPtr &origin);
+
+            // 创建一个新的客户端并设置回调
+            TcpClientPtr CreateClient(const OriginPtr &origin);
+
+            // 在锁外发起连接
+            void StartConnect(const std::vector<TcpClientPtr> &clients);
+
+            // 连接结果
+            void OnConnected(const OriginPtr &origin, const TcpClientPtr &client, bool connected);
+
+            // 空闲连接被关闭
+            void OnIdleClosed(const OriginPtr &origin, const TcpClientPtr &client);
+
+            // 计算下一次重连的等待时间，单位：毫秒
+            int64_t BackoffLocked(const OriginPtr &origin);
+
+            // 等待的 Acquire 超时，还在等待时回调空指针
+            void OnAcquireTimeout(const OriginPtr &origin, uint64_t id);
+
+            // 退避时间到了，重新补足连接
+            void OnRetry(const OriginPtr &origin);
+
+            // 把客户端挂到空闲列表，设置好空闲时的回调
+            void ParkLocked(const OriginPtr &origin, const TcpClientPtr &client);
+
+            // 在连接所在的事件循环里归还连接
+            void ReleaseInLoop(const TcpClientPtr &client);
+
+            // 事件循环线程池
+            EventLoopThreadPool *loops_{nullptr};
+
+            // 源站地址到状态的映射，键为 ip:port
+            std::unordered_map<std::string, OriginPtr> origins_;
+
+            // 保护池的状态
+            std::mutex lock_;
+
+            // 连接超时时间，单位：秒
+            int32_t connect_timeout_{3};
+
+            // 退避的基础时间，单位：毫秒
+            int32_t backoff_base_{1000};
+
+            // 退避的最大时间，单位：毫秒
+            int32_t backoff_max_{30000};
+
+            // Acquire 默认的等待时间，单位：毫秒，0 表示一直等待
+            int32_t acquire_timeout_{10000};
+
+            // 下一个等待者的编号
+            uint64_t next_waiter_{0};
+
+            // 退避抖动用的随机数
+            std::mt19937 rand_;
+
+            // 是否已经停止
+            bool stopped_{false};
+        };
+    }
+}
@@ -1,149 +1,417 @@
 #include "TcpServer.h"
 #include "network/base/Network.h"
+#include "network/base/SlabPool.h"
 
 using namespace tmms::network;
 
 // TcpServer构造函数，初始化事件循环和地址
 TcpServer::TcpServer(EventLoop *loop, const InetAddress &addr)
-    : loop_(loop) // 将事件循环指针赋值给成员变量loop_
-      ,
-      addr_(addr) // 将服务器地址赋值给成员变量addr_
+    : state_(std::make_shared<State>(loop, addr))
 {
     // 创建一个Acceptor对象，用于接受连接
-    acceptor_ = std::make_shared<Acceptor>(loop, addr);
+    state_->acceptor = std::make_shared<Acceptor>(loop, addr);
+    // 没有线程池时所有连接都在 loop 上
+    state_->connections[loop];
 }
 // 设置新连接回调函数
 void TcpServer::SetNewConnectionCallback(const NewConnectionCallback &cb)
 {
     // 将回调函数赋值给成员变量
-    new_connection_cb_ = cb;
+    state_->new_connection_cb = cb;
 }
 // 设置新连接回调函数（右值引用）
 void TcpServer::SetNewConnectionCallback(NewConnectionCallback &&cb)
 {
     // 将回调函数赋值给成员变量，使用移动语义赋值
-    new_connection_cb_ = std::move(cb);
+    state_->new_connection_cb = std::move(cb);
 }
 // 设置销毁连接回调函数
 void TcpServer::SetDestroyConnectionCallback(const DestroyConnectionCallback &cb)
 {
     // 将回调函数赋值给成员变量
-    destroy_connection_cb_ = cb;
+    state_->destroy_connection_cb = cb;
 }
 // 设置销毁连接回调函数（右值引用）
 void TcpServer::SetDestroyConnectionCallback(DestroyConnectionCallback &&cb)
 {
     // 将回调函数赋值给成员变量，使用移动语义赋值
-    destroy_connection_cb_ = std::move(cb);
+    state_->destroy_connection_cb = std::move(cb);
 }
 // 设置新连接的一系列回调，这个是给acceptor调用的函数
 void TcpServer::OnAccept(int fd, const InetAddress &addr)
+{
+    state_->OnAccept(fd, addr);
+}
+void TcpServer::State::OnAccept(int fd, const InetAddress &peer)
 {
     // 记录新连接信息
-    NETWORK_TRACE << " new connection fd : " << fd << " host : " << addr.ToIpPort();
+    NETWORK_TRACE << " new connection fd : " << fd << " host : " << peer.ToIpPort();
 
-    // 创建TcpConnection对象
-    TcpConnectionPtr con = std::make_shared<TcpConnection>(loop_, fd, addr_, addr);
-    // 设置连接关闭时的回调
-    con->SetCloseCallback(std::bind(&TcpServer::OnConnectionClose, this, std::placeholders::_1));
+    // 选择处理这个连接的事件循环
+    EventLoop *io_loop = SelectLoop(fd);
+    // 先计数，连接投递到其他事件循环的途中不会被当成已经全部关闭
+    connection_count++;
+    // 连接在所在的事件循环线程里创建，在同一个线程时直接执行
+    auto self = shared_from_this();
+    io_loop->RunInLoop([self, io_loop, fd, peer]()
+                       { self->AddConnectionInLoop(io_loop, fd, peer); });
+}
+// 在连接所在的事件循环里创建连接，把连接加入集合和事件循环
+void TcpServer::State::AddConnectionInLoop(EventLoop *io_loop, int fd, const InetAddress &peer)
+{
+    // 投递途中服务器析构了，连接不再建立，直接关闭描述符
+    if (!alive)
+    {
+        connection_count--;
+        ::close(fd);
+        return;
+    }
+    // 创建TcpConnection对象，对象和控制块从事件循环线程的内存块池里申请，连接频繁建立断开时不走全局分配器；
+    // 连接最后也在这个线程里释放，内存块回到同一个线程的池里
+    TcpConnectionPtr con = MakeSlabShared<TcpConnection>(io_loop, fd, addr, peer);
+    // 设置连接关闭时的回调，只捕获一个 weak_ptr，std::function 可以放在内部的小缓冲区里，不需要额外申请内存
+    // 用 weak_ptr：连接在集合里，集合在状态里，捕获 shared_ptr 会形成循环引用
+    StateWeakPtr weak = shared_from_this();
+    con->SetCloseCallback([weak](const TcpConnectionPtr &c)
+                          {
+        auto state = weak.lock();
+        if (state)
+        {
+            state->OnConnectionClose(c);
+            return;
+        }
+        // 服务器已经析构，连接还是要从事件循环里删除，否则 fd 关闭后被新连接复用时和留下的事件冲突
+        c->Loop()->DelEvent(c); });
 
-    if (write_complete_cb_)
+    if (write_complete_cb)
     {
         // 设置写操作完成时的回调
-        con->SetWriteCompleteCallback(write_complete_cb_);
+        con->SetWriteCompleteCallback(write_complete_cb);
     }
 
-    if (active_cb_)
+    if (active_cb)
     {
         // 设置激活完成时的回调
-        con->SetActiveCallback(active_cb_);
+        con->SetActiveCallback(active_cb);
+    }
+
+    if (write_complete_ref_cb)
+    {
+        // 设置借用引用的写操作完成回调
+        con->SetWriteCompleteRefCallback(write_complete_ref_cb);
     }
 
     // 设置接收消息的回调
-    con->SetRecvMsgCallback(message_cb_);
-    // 将连接插入到连接集合中
-    connections_.insert(con);
+    con->SetRecvMsgCallback(message_cb);
+    if (message_ref_cb)
+    {
+        // 设置借用引用的接收消息回调
+        con->SetRecvMsgRefCallback(message_ref_cb);
+    }
+    // 设置读取预算
+    con->SetReadBudget(read_budget_bytes, read_budget_loops);
+    // 设置内核发送缓冲区的低水位
+    con->SetNotSentLowat(notsent_lowat);
+    // 设置发送限速
+    con->SetPacing(pacing_rate, pacing_burst);
+    con->SetPacingGroup(pacing_group);
+    if (max_pacing_rate > 0 && !con->SetMaxPacingRate(max_pacing_rate))
+    {
+        NETWORK_WARN << " host : " << peer.ToIpPort() << " SO_MAX_PACING_RATE not supported.";
+    }
+    // 将连接插入到连接集合中；各个线程同时访问这个表，只能用 at 查找，不能用 [] 插入
+    connections.at(io_loop).insert(con);
     // 将连接添加到事件循环中，会给连接一个读的监听
-    loop_->AddEvent(con);
+    io_loop->AddEvent(con);
     // 启用空闲超时检查，单位：秒
     con->EnableCheckIdleTimeout(30);
 
-    if (new_connection_cb_)
+    if (new_connection_cb)
     {
         // 调用新的连接回调，通知业务层有一个新的连接
-        new_connection_cb_(con);
+        new_connection_cb(con);
+    }
+
+    // 投递途中开始了优雅停止，这个连接也一起停止
+    if (shutting_down)
+    {
+        con->Shutdown(shutdown_timeout);
+    }
+}
+// 为新连接选择事件循环
+EventLoop *TcpServer::State::SelectLoop(int fd)
+{
+    if (!pool)
+    {
+        return loop;
+    }
+    if (steer)
+    {
+        // 新连接的 SO_INCOMING_CPU 是处理握手报文的 CPU，也就是它的接收队列中断所在的 CPU
+        SocketOpt opt(fd);
+        return pool->GetLoopByCpu(opt.GetIncomingCpu());
+    }
+    return pool->GetNextLoop();
+}
+// 设置处理连接的事件循环线程池
+void TcpServer::SetThreadPool(EventLoopThreadPool *pool, bool steer)
+{
+    state_->pool = pool;
+    state_->steer = steer;
+    // 集合的键在这里一次建好，之后各个线程只访问自己的集合，不会有并发的插入导致重新哈希
+    state_->connections.clear();
+    state_->connections[state_->loop];
+    if (pool)
+    {
+        for (auto loop : pool->GetLoops())
+        {
+            state_->connections[loop];
+        }
     }
 }
 // 设置关闭连接的一系列回调
 void TcpServer::OnConnectionClose(const TcpConnectionPtr &con)
+{
+    state_->OnConnectionClose(con);
+}
+void TcpServer::State::OnConnectionClose(const TcpConnectionPtr &con)
 {
     // 记录关闭信息
     NETWORK_TRACE << " host : " << con->PeerAddr().ToIpPort() << " closed.";
 
-    // 确保在事件循环线程中执行
-    loop_->AssertInLoopThread();
+    // 确保在连接所在的事件循环线程中执行
+    EventLoop *io_loop = con->Loop();
+    io_loop->AssertInLoopThread();
     // 从连接集合中移除连接
-    connections_.erase(con);
+    connections.at(io_loop).erase(con);
+    connection_count--;
     // 从事件循环中删除连接
-    loop_->DelEvent(con);
+    io_loop->DelEvent(con);
 
-    if (destroy_connection_cb_)
+    if (alive && destroy_connection_cb)
     {
         // 调用连接销毁回调，通知业务层，该连接已经关闭
-        destroy_connection_cb_(con);
+        destroy_connection_cb(con);
     }
+
+    CheckDrained();
 }
 // 设置激活回调函数
 void TcpServer::SetActiveCallback(const ActiveCallback &cb)
 {
     // 将回调函数赋值给成员变量
-    active_cb_ = cb;
+    state_->active_cb = cb;
 }
 // 设置激活回调函数（右值引用）
 void TcpServer::SetActiveCallback(ActiveCallback &&cb)
 {
     // 将回调函数赋值给成员变量，使用移动语义赋值
-    active_cb_ = std::move(cb);
+    state_->active_cb = std::move(cb);
 }
 // 设置写操作完成回调函数
 void TcpServer::SetWriteCompleteCallback(const WriteCompleteCallback &cb)
 {
     // 将回调函数赋值给成员变量
-    write_complete_cb_ = cb;
+    state_->write_complete_cb = cb;
 }
 // 设置写操作完成回调函数（右值引用）
 void TcpServer::SetWriteCompleteCallback(WriteCompleteCallback &&cb)
 {
     // 将回调函数赋值给成员变量，使用移动语义赋值
-    write_complete_cb_ = std::move(cb);
+    state_->write_complete_cb = std::move(cb);
 }
 // 设置接收消息回调函数
 void TcpServer::SetMessageCallback(const MessageCallback &cb)
 {
     // 将回调函数赋值给成员变量
-    message_cb_ = cb;
+    state_->message_cb = cb;
 }
 // 设置接收消息回调函数（右值引用）
 void TcpServer::SetMessageCallback(MessageCallback &&cb)
 {
     // 将回调函数赋值给成员变量，使用移动语义赋值
-    message_cb_ = std::move(cb);
+    state_->message_cb = std::move(cb);
+}
+
+// 设置新连接的读取预算
+void TcpServer::SetReadBudget(size_t max_bytes, int32_t max_loops)
+{
+    state_->read_budget_bytes = max_bytes;
+    state_->read_budget_loops = max_loops;
+}
+
+// 设置借用引用的接收消息回调函数
+void TcpServer::SetMessageRefCallback(const MessageRefCallback &cb)
+{
+    state_->message_ref_cb = cb;
+}
+// 设置借用引用的接收消息回调函数（右值引用）
+void TcpServer::SetMessageRefCallback(MessageRefCallback &&cb)
+{
+    state_->message_ref_cb = std::move(cb);
+}
+// 设置借用引用的写操作完成回调函数
+void TcpServer::SetWriteCompleteRefCallback(const WriteCompleteRefCallback &cb)
+{
+    state_->write_complete_ref_cb = cb;
+}
+// 设置借用引用的写操作完成回调函数（右值引用）
+void TcpServer::SetWriteCompleteRefCallback(WriteCompleteRefCallback &&cb)
+{
+    state_->write_complete_ref_cb = std::move(cb);
+}
+
+// 设置新连接的 TCP_NOTSENT_LOWAT
+void TcpServer::SetNotSentLowat(uint32_t bytes)
+{
+    state_->notsent_lowat = bytes;
+}
+
+// 设置新连接的单连接限速
+void TcpServer::SetPacing(uint64_t rate, uint64_t burst)
+{
+    state_->pacing_rate = rate;
+    state_->pacing_burst = burst;
+}
+
+// 设置新连接加入的限速组
+void TcpServer::SetPacingGroup(const TokenBucketPtr &group)
+{
+    state_->pacing_group = group;
+}
+
+// 设置新连接的 SO_MAX_PACING_RATE
+void TcpServer::SetMaxPacingRate(uint64_t rate)
+{
+    state_->max_pacing_rate = rate;
+}
+
+// 收集所有连接的统计快照
+void TcpServer::GetConnectionStats(const ConnectionStatsCallback &cb)
+{
+    // 连接集合只在各自的事件循环线程里修改，投递过去遍历，不需要加锁；计数器本身是原子的，读取也不需要加锁
+    // 各个事件循环的结果汇总到一起，最后完成的那个调用回调
+    struct Collector
+    {
+        std::mutex lock;
+        std::vector<ConnectionStatsSnapshot> list;
+        size_t remaining{0};
+        ConnectionStatsCallback cb;
+    };
+    auto collector = std::make_shared<Collector>();
+    collector->remaining = state_->connections.size();
+    collector->cb = cb;
+    auto state = state_;
+    for (auto &kv : state_->connections)
+    {
+        EventLoop *loop = kv.first;
+        loop->RunInLoop([state, loop, collector]()
+                        {
+            std::vector<ConnectionStatsSnapshot> list;
+            auto &cons = state->connections.at(loop);
+            list.reserve(cons.size());
+            for (auto &con : cons)
+            {
+                list.emplace_back(con->Stats());
+            }
+
+            bool last = false;
+            {
+                std::lock_guard<std::mutex> lk(collector->lock);
+                collector->list.insert(collector->list.end(), list.begin(), list.end());
+                last = --collector->remaining == 0;
+            }
+            if (last)
+            {
+                collector->cb(collector->list);
+            } });
+    }
 }
 
 void TcpServer::Start()
 {
-    // 设置接受连接的回调
-    acceptor_->SetAcceptCallback(std::bind(&TcpServer::OnAccept, this, std::placeholders::_1, std::placeholders::_2));
+    // 设置接受连接的回调，接受器在事件循环里，可能比服务器活得久，只捕获 weak_ptr
+    StateWeakPtr weak = state_;
+    state_->acceptor->SetAcceptCallback([weak](int fd, const InetAddress &addr)
+                                        {
+        auto state = weak.lock();
+        if (state && state->alive)
+        {
+            state->OnAccept(fd, addr);
+            return;
+        }
+        // 服务器已经析构，没有人接管这个连接
+        ::close(fd); });
     // 启动Acceptor
-    acceptor_->Start();
+    state_->acceptor->Start();
 }
 
 void TcpServer::Stop()
 {
     // 停止Acceptor
-    acceptor_->Stop();
+    state_->acceptor->Stop();
+}
+
+// 优雅停止
+void TcpServer::Shutdown(int32_t timeout, const ServerDrainedCallback &cb)
+{
+    auto state = state_;
+    state_->loop->RunInLoop([state, timeout, cb]()
+                            { state->ShutdownInLoop(timeout, cb); });
+}
+
+// 在监听的事件循环里开始优雅停止
+void TcpServer::State::ShutdownInLoop(int32_t timeout, const ServerDrainedCallback &cb)
+{
+    if (shutting_down)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(drained_lock);
+        drained_cb = cb;
+    }
+    shutdown_timeout = timeout;
+    shutting_down = true;
+    // 先停止接受新连接，再让已有的连接各自发完后关闭
+    acceptor->Stop();
+    NETWORK_TRACE << " server : " << addr.ToIpPort() << " shutdown, connections : " << connection_count;
+    // 每个事件循环停止自己的连接
+    auto self = shared_from_this();
+    for (auto &kv : connections)
+    {
+        EventLoop *io_loop = kv.first;
+        io_loop->RunInLoop([self, io_loop, timeout]()
+                           {
+            for (auto &con : self->connections.at(io_loop))
+            {
+                con->Shutdown(timeout);
+            } });
+    }
+    CheckDrained();
+}
+
+// 优雅停止时所有连接都关闭了，通知调用者
+void TcpServer::State::CheckDrained()
+{
+    if (!shutting_down || connection_count > 0)
+    {
+        return;
+    }
+    // 只通知一次，回调里可能析构服务器，先移出来；调用方持有状态的 shared_ptr，析构服务器后状态仍然有效
+    ServerDrainedCallback cb;
+    {
+        std::lock_guard<std::mutex> lk(drained_lock);
+        cb.swap(drained_cb);
+    }
+    if (cb && alive)
+    {
+        cb();
+    }
 }
 
 TcpServer::~TcpServer()
 {
-}
\ No newline at end of file
+    // 不等正在执行的任务和回调，只标记一下，之后不再接受新连接，也不再调用业务层的回调
+    state_->alive = false;
+}
@@ -2,9 +2,13 @@
 #include <functional>
 #include <memory>
 #include <unordered_set>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
 #include "network/net/TcpConnection.h"
 #include "network/net/EventLoop.h"
 #include "network/net/Acceptor.h"
+#include "network/net/EventLoopThreadPool.h"
 #include "network/base/InetAddress.h"
 
 namespace tmms
@@ -16,6 +20,8 @@ namespace tmms
 
         // 定义一个连接销毁回调类型，接受一个 TcpConnectionPtr 类型的参数
         using DestroyConnectionCallback = std::function<void (const TcpConnectionPtr &)>;
+        // 优雅停止完成的回调，所有连接都已经关闭
+        using ServerDrainedCallback = std::function<void ()>;
         
         // TcpServer 类的定义
         class TcpServer
@@ -60,42 +66,135 @@ namespace tmms
             // 设置消息回调函数（右值引用）
             void SetMessageCallback(MessageCallback &&cb);
 
-            // 启动服务器的虚函数
-            virtual void Start();
-
-            // 停止服务器的虚函数
-            virtual void Stop();
+            // 设置借用引用的消息回调函数，设置后优先于 SetMessageCallback 设置的回调（左值引用）
+            void SetMessageRefCallback(const MessageRefCallback &cb);
 
-            // 析构函数（虚函数，允许子类重写以实现特定的启动和停止逻辑）
-            virtual ~TcpServer();
+            // 设置借用引用的消息回调函数（右值引用）
+            void SetMessageRefCallback(MessageRefCallback &&cb);
 
-        private:
-            // 事件循环指针
-            EventLoop *loop_{nullptr};
+            // 设置借用引用的写完成回调函数，设置后优先于 SetWriteCompleteCallback 设置的回调（左值引用）
+            void SetWriteCompleteRefCallback(const WriteCompleteRefCallback &cb);
 
-            // 服务器地址
-            InetAddress addr_;
+            // 设置借用引用的写完成回调函数（右值引用）
+            void SetWriteCompleteRefCallback(WriteCompleteRefCallback &&cb);
 
-            // 接受器的智能指针
-            std::shared_ptr<Acceptor> acceptor_;
+            // 设置新连接单次读事件的读取预算，max_bytes 为最多读取的字节数，max_loops 为最多读取的次数，0 表示不限制
+            void SetReadBudget(size_t max_bytes, int32_t max_loops);
 
-            // 新连接回调函数
-            NewConnectionCallback new_connection_cb_;
+            // 设置新连接的 TCP_NOTSENT_LOWAT，0 表示不设置
+            void SetNotSentLowat(uint32_t bytes);
+            // 设置新连接的单连接限速，rate 单位：字节/秒，burst 单位：字节，0 表示不限速
+            void SetPacing(uint64_t rate, uint64_t burst = 0);
+            // 设置新连接加入的限速组，这个服务器的所有连接共用一个令牌桶
+            void SetPacingGroup(const TokenBucketPtr &group);
+            // 设置新连接的 SO_MAX_PACING_RATE，单位：字节/秒，0 表示不设置
+            void SetMaxPacingRate(uint64_t rate);
 
-            // 当前连接的集合
-            std::unordered_set<TcpConnectionPtr> connections_;
+            // 设置处理连接的事件循环线程池，不设置时所有连接都在构造时传入的事件循环上处理
+            // 必须在线程池启动之后、Start 之前调用
+            // steer 为 true 时读取新连接的 SO_INCOMING_CPU，把连接放到绑定在同一个 CPU 上的事件循环，
+            // 收包软中断和用户态处理在同一个核上，避免跨核的缓存同步；找不到对应的事件循环时按轮询分配
+            void SetThreadPool(EventLoopThreadPool *pool, bool steer = false);
+            // 收集所有连接的统计快照，在各个事件循环线程里遍历连接，全部收集完后通过回调返回，回调在最后完成的事件循环线程执行
+            void GetConnectionStats(const ConnectionStatsCallback &cb);
 
-            // 消息回调函数
-            MessageCallback message_cb_;
+            // 启动服务器的虚函数
+            virtual void Start();
 
-            // 激活回调函数
-            ActiveCallback active_cb_;
+            // 停止服务器的虚函数
+            virtual void Stop();
+            // 优雅停止：停止接受新连接，所有连接发完发送队列后半关闭，timeout 秒后还没关闭的强制关闭
+            // 所有连接都关闭后在事件循环线程调用 cb，滚动重启时据此退出进程，观众不会在一个 GOP 中间被断开
+            void Shutdown(int32_t timeout, const ServerDrainedCallback &cb);
 
-            // 写完成回调函数
-            WriteCompleteCallback write_complete_cb_;
+            // 析构函数（虚函数，允许子类重写以实现特定的启动和停止逻辑）
+            virtual ~TcpServer();
 
-            // 连接销毁回调函数
-            DestroyConnectionCallback destroy_connection_cb_;
+        private:
+            // 服务器的状态，投递到事件循环的任务和连接的回调持有它的智能指针，不直接访问服务器
+            // 服务器析构后任务和回调访问的仍然是有效的对象，不需要加锁等它们执行完；析构时把 alive 置为 false，
+            // 之后不再接受新连接，也不再调用业务层的回调。回调里可以直接析构服务器
+            struct State : public std::enable_shared_from_this<State>
+            {
+                State(EventLoop *l, const InetAddress &a) : loop(l), addr(a) {}
+
+                // 处理新连接
+                void OnAccept(int fd, const InetAddress &peer);
+                // 处理连接关闭
+                void OnConnectionClose(const TcpConnectionPtr &con);
+                // 在监听的事件循环里开始优雅停止
+                void ShutdownInLoop(int32_t timeout, const ServerDrainedCallback &cb);
+                // 优雅停止时所有连接都关闭了，通知调用者
+                void CheckDrained();
+                // 为新连接选择事件循环
+                EventLoop *SelectLoop(int fd);
+                // 在连接所在的事件循环里创建连接，把连接加入集合和事件循环
+                void AddConnectionInLoop(EventLoop *io_loop, int fd, const InetAddress &peer);
+
+                // 服务器是否还没有析构，不加锁读取，回调正在执行时析构服务器，这次回调仍然会执行完
+                std::atomic<bool> alive{true};
+
+                // 事件循环指针
+                EventLoop *loop{nullptr};
+                // 服务器地址
+                InetAddress addr;
+                // 接受器的智能指针
+                std::shared_ptr<Acceptor> acceptor;
+
+                // 处理连接的事件循环线程池，为空时连接都在 loop 上
+                EventLoopThreadPool *pool{nullptr};
+                // 是否按 SO_INCOMING_CPU 选择事件循环
+                bool steer{false};
+                // 每个事件循环上的连接集合，键在 Start 之前确定，之后每个集合只在自己的事件循环线程里修改，不需要加锁
+                // 表本身被多个线程同时访问，Start 之后只能用 at 查找，[] 遇到不存在的键会插入并重新哈希
+                std::unordered_map<EventLoop *, std::unordered_set<TcpConnectionPtr>> connections;
+                // 所有事件循环上的连接总数，包括已经接受、还没加入集合的
+                std::atomic<size_t> connection_count{0};
+
+                // 新连接回调函数
+                NewConnectionCallback new_connection_cb;
+                // 消息回调函数
+                MessageCallback message_cb;
+                // 借用引用的消息回调函数
+                MessageRefCallback message_ref_cb;
+                // 借用引用的写完成回调函数
+                WriteCompleteRefCallback write_complete_ref_cb;
+                // 激活回调函数
+                ActiveCallback active_cb;
+                // 写完成回调函数
+                WriteCompleteCallback write_complete_cb;
+                // 连接销毁回调函数
+                DestroyConnectionCallback destroy_connection_cb;
+
+                // 新连接单次读事件最多读取的字节数
+                size_t read_budget_bytes{kDefaultReadBudgetBytes};
+                // 新连接单次读事件最多读取的次数
+                int32_t read_budget_loops{kDefaultReadBudgetLoops};
+                // 新连接的 TCP_NOTSENT_LOWAT，0 表示不设置
+                uint32_t notsent_lowat{0};
+                // 新连接的限速速率，单位：字节/秒，0 表示不限速
+                uint64_t pacing_rate{0};
+                // 新连接的限速突发量，单位：字节
+                uint64_t pacing_burst{0};
+                // 新连接加入的限速组
+                TokenBucketPtr pacing_group;
+                // 新连接的 SO_MAX_PACING_RATE，0 表示不设置
+                uint64_t max_pacing_rate{0};
+
+                // 是否正在优雅停止，各个事件循环线程都会读取
+                std::atomic<bool> shutting_down{false};
+                // 优雅停止的期限，单位：秒，在 shutting_down 置位之前写入
+                int32_t shutdown_timeout{0};
+                // 保护 drained_cb，最后一个连接可能在任意一个事件循环上关闭
+                std::mutex drained_lock;
+                // 优雅停止完成的回调
+                ServerDrainedCallback drained_cb;
+            };
+            using StatePtr = std::shared_ptr<State>;
+            using StateWeakPtr = std::weak_ptr<State>;
+
+            // 服务器的状态
+            StatePtr state_;
         };
     }
 }
\ No newline at end of file
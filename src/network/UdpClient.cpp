@@ -39,8 +39,8 @@ void UdpClient::ConnectInLoop()
     // 确保在事件循环线程中调用
     loop_->AssertInLoopThread();
 
-    // 创建一个非阻塞 UDP 套接字，返回文件描述符
-    fd_ = SocketOpt::CreateNonblockingUdpSocket(AF_INET);
+    // 创建一个非阻塞 UDP 套接字，地址族和服务器地址一致，返回文件描述符
+    fd_ = SocketOpt::CreateNonblockingUdpSocket(server_addr_.IsIpV6() ? AF_INET6 : AF_INET);
 
     // 如果文件描述符小于 0，表示创建失败
     if (fd_ < 0)
@@ -63,6 +63,11 @@ void UdpClient::ConnectInLoop()
     // 使用套接字选项类的 Connect 方法连接到服务器
     opt.Connect(server_addr_);
 
+    // 打开套接字之前要求了 UDP_GRO，现在设置
+    ApplyGro();
+    // 打开套接字之前要求了 SO_TXTIME，现在设置
+    ApplyTxTime();
+
     // 获取服务器的地址信息，并存储在 sock_addr_ 中
     server_addr_.GetSockAddr((struct sockaddr *)&sock_addr_);
 
@@ -20,26 +20,76 @@ void UdpServer::Start()
 
 void UdpServer::Stop()
 {
-    // 在事件循环中运行停止操作
-    loop_->RunInLoop([this](){
+    // 在事件循环中运行停止操作，持有自己的引用，任务执行前对象不会被析构
+    auto self = std::dynamic_pointer_cast<UdpSocket>(shared_from_this());
+    loop_->RunInLoop([this, self](){
         // 从事件循环中删除当前的 UdpSocket 对象
-        loop_->DelEvent(std::dynamic_pointer_cast<UdpSocket>(shared_from_this()));
+        loop_->DelEvent(self);
         // 执行关闭操作
         OnClose();
     });
 }
 
+void UdpServer::SetReusePort(bool on)
+{
+    reuse_port_ = on;
+}
+
+void UdpServer::SetIncomingCpu(int cpu)
+{
+    incoming_cpu_ = cpu;
+}
+
+// 创建并绑定套接字，还没有注册到事件循环，可以在任意线程调用
+bool UdpServer::Bind()
+{
+    if (fd_ >= 0)
+    {
+        return true;
+    }
+    // 创建一个非阻塞 UDP 套接字，地址族和监听地址一致
+    int fd = SocketOpt::CreateNonblockingUdpSocket(server_.IsIpV6() ? AF_INET6 : AF_INET);
+    if (fd < 0)
+    {
+        return false;
+    }
+    fd_ = fd;
+
+    // 创建一个 SocketOpt 对象用于操作套接字选项
+    SocketOpt opt(fd_);
+
+    // 共用端口的套接字要在绑定之前设置
+    if (reuse_port_ || incoming_cpu_ >= 0)
+    {
+        opt.SetReusePort(true);
+    }
+    // 关联 CPU 的套接字要和其他 CPU 上的套接字共用端口
+    if (incoming_cpu_ >= 0)
+    {
+        if (!opt.SetIncomingCpu(incoming_cpu_))
+        {
+            NETWORK_WARN << " udp server : " << server_.ToIpPort() << " set incoming cpu " << incoming_cpu_ << " failed";
+        }
+    }
+
+    // 将套接字绑定到指定的服务器地址
+    opt.BindAddress(server_);
+
+    // 打开套接字之前要求了 UDP_GRO，现在设置
+    ApplyGro();
+    // 打开套接字之前要求了 SO_TXTIME，现在设置
+    ApplyTxTime();
+    return true;
+}
+
 // Open 方法，打开服务器进行绑定和事件监听
 void UdpServer::Open()
 {
     // 确保在事件循环线程中执行此方法
     loop_->AssertInLoopThread();
 
-    // 创建一个非阻塞 UDP 套接字，AF_INET 表示使用 IPv4
-    fd_ = SocketOpt::CreateNonblockingUdpSocket(AF_INET);
-
-    // 如果套接字创建失败
-    if (fd_ < 0)
+    // 已经用 Bind 绑定过的套接字只需要注册
+    if (!Bind())
     {
         // 调用关闭操作
         OnClose();
@@ -50,16 +100,10 @@ void UdpServer::Open()
 
     // 将当前的 UdpSocket 对象添加到事件循环中进行事件处理
     loop_->AddEvent(std::dynamic_pointer_cast<UdpSocket>(shared_from_this()));
-
-    // 创建一个 SocketOpt 对象用于操作套接字选项
-    SocketOpt opt(fd_);
-
-    // 将套接字绑定到指定的服务器地址
-    opt.BindAddress(server_);
 }
 
 UdpServer::~UdpServer()
 {
-    // 在析构时停止服务器
-    Stop();
+    // 析构时已经没有 shared_ptr 了，不能再投递停止任务，需要停止时在析构之前调用 Stop
+    // 套接字由 Event 的析构函数关闭
 }
\ No newline at end of file
@@ -18,9 +18,21 @@ namespace tmms
             // 启动服务器的方法
             void Start();
 
+            // 创建并绑定套接字，不注册到事件循环，在 Start 之前调用，可以在任意线程调用
+            // 共用端口的多个套接字先全部绑定再 Start，开始读之前 SO_REUSEPORT 组就已经完整
+            bool Bind();
+
             // 停止服务器的方法
             void Stop();
 
+            // 设置 SO_REUSEPORT，多个套接字监听同一个地址，内核按四元组哈希分配数据报，必须在 Start 之前调用
+            void SetReusePort(bool on);
+
+            // 把套接字和 CPU 关联起来，必须在 Start 之前调用
+            // 每个 CPU 一个绑定在该 CPU 的事件循环和一个 UdpServer，监听同一个地址，
+            // 内核按收包的 CPU 把报文交给对应的套接字，收包软中断和用户态处理在同一个核上
+            void SetIncomingCpu(int cpu);
+
             // 析构函数，对象销毁时释放资源
             virtual ~UdpServer();
             
@@ -30,6 +42,10 @@ namespace tmms
 
             // 保存服务器地址
             InetAddress server_;
+            // 关联的 CPU，-1 表示不关联
+            int incoming_cpu_{-1};
+            // 是否设置 SO_REUSEPORT
+            bool reuse_port_{false};
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "UdpSessionServer.h"
+#include "network/base/Network.h"
+#include "network/base/SlabPool.h"
+#include "base/TTime.h"
+
+using namespace tmms::network;
+
+UdpSession::UdpSession(EventLoop *loop, const InetAddress &peer, const UdpSocketPtr &socket)
+    : loop_(loop), peer_(peer), socket_(socket)
+{
+}
+
+// 对端地址
+const InetAddress &UdpSession::PeerAddr() const
+{
+    return peer_;
+}
+
+// 所属的事件循环
+EventLoop *UdpSession::Loop() const
+{
+    return loop_;
+}
+
+// 发送数据给对端，地址直接用二进制的 sockaddr，不做字符串转换
+void UdpSession::Send(const char *buff, size_t size)
+{
+    socket_->Send(buff, size, peer_.SockAddr(), peer_.SockAddrLen());
+}
+
+// 设置发给这个对端的目标码率
+void UdpSession::SetPacing(uint64_t rate)
+{
+    pacer_.SetRate(rate);
+}
+
+// 按媒体时间戳和目标码率平滑地发送，一帧的几十个数据报不再一起打到交换机上
+void UdpSession::SendMedia(const char *buff, size_t size, int64_t media_ts)
+{
+    socket_->SendAt(buff, size, peer_.SockAddr(), peer_.SockAddrLen(), pacer_.Next(size, media_ts));
+}
+
+// 主动关闭会话
+void UdpSession::Close()
+{
+    auto self = shared_from_this();
+    loop_->RunInLoop([self]()
+                     { self->OnIdleTimeout(); });
+}
+
+// 业务层的会话状态
+void UdpSession::SetContext(const std::shared_ptr<void> &context)
+{
+    context_ = context;
+}
+
+void UdpSession::SetContext(std::shared_ptr<void> &&context)
+{
+    context_ = std::move(context);
+}
+
+// 收到的数据报个数
+uint64_t UdpSession::MsgsIn() const
+{
+    return msgs_in_;
+}
+
+// 收到的字节数
+uint64_t UdpSession::BytesIn() const
+{
+    return bytes_in_;
+}
+
+// 空闲超时或者主动关闭，从服务器的分片里删除
+void UdpSession::OnIdleTimeout()
+{
+    auto server = server_.lock();
+    if (server)
+    {
+        server->RemoveSession(shard_, shared_from_this());
+        return;
+    }
+    closed_ = true;
+}
+
+// 每个事件循环一个分片
+UdpSessionServer::UdpSessionServer(EventLoopThreadPool *pool, const InetAddress &addr)
+    : addr_(addr)
+{
+    for (auto loop : pool->GetLoops())
+    {
+        shards_.emplace_back(new Shard());
+        shards_.back()->loop = loop;
+    }
+}
+
+// 只有一个分片
+UdpSessionServer::UdpSessionServer(EventLoop *loop, const InetAddress &addr)
+    : addr_(addr)
+{
+    shards_.emplace_back(new Shard());
+    shards_.back()->loop = loop;
+}
+
+void UdpSessionServer::SetNewSessionCallback(const UdpSessionCallback &cb)
+{
+    new_session_cb_ = cb;
+}
+
+void UdpSessionServer::SetNewSessionCallback(UdpSessionCallback &&cb)
+{
+    new_session_cb_ = std::move(cb);
+}
+
+void UdpSessionServer::SetSessionMessageCallback(const UdpSessionMessageCallback &cb)
+{
+    message_cb_ = cb;
+}
+
+void UdpSessionServer::SetSessionMessageCallback(UdpSessionMessageCallback &&cb)
+{
+    message_cb_ = std::move(cb);
+}
+
+void UdpSessionServer::SetSessionCloseCallback(const UdpSessionCallback &cb)
+{
+    close_cb_ = cb;
+}
+
+void UdpSessionServer::SetSessionCloseCallback(UdpSessionCallback &&cb)
+{
+    close_cb_ = std::move(cb);
+}
+
+// 会话的空闲超时时间，单位：秒
+void UdpSessionServer::SetIdleTimeout(int32_t timeout)
+{
+    idle_timeout_ = timeout > 0 ? timeout : 1;
+}
+
+// 每个分片最多的会话数
+void UdpSessionServer::SetMaxSessions(size_t max)
+{
+    max_sessions_ = max;
+}
+
+// 各个分片的套接字开启 SO_TXTIME
+void UdpSessionServer::EnableTxTime(bool on, clockid_t clockid)
+{
+    txtime_ = on;
+    txtime_clock_ = clockid;
+}
+
+// 打开各个分片的套接字
+void UdpSessionServer::Start()
+{
+    std::weak_ptr<UdpSessionServer> weak = shared_from_this();
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+        auto &shard = shards_[i];
+        shard->socket = std::make_shared<UdpServer>(shard->loop, addr_);
+        // 多个分片共用一个端口，同一个四元组总是交给同一个套接字
+        shard->socket->SetReusePort(shards_.size() > 1);
+        shard->socket->EnableTxTime(txtime_, txtime_clock_);
+        shard->socket->SetRecvBatchCallback([weak, i](const UdpDatagram *msgs, size_t count)
+                                            {
+            auto server = weak.lock();
+            if (server)
+            {
+                server->OnBatch(i, msgs, count);
+            } });
+        // 在当前线程连续绑定所有分片的套接字，组成员变化的窗口很短；
+        // 如果各自在事件循环里绑定，先绑定的分片已经在收包，后加入的套接字改变哈希，同一个对端会在两个分片各建一个会话
+        shard->socket->Bind();
+    }
+    for (auto &shard : shards_)
+    {
+        shard->socket->Start();
+    }
+}
+
+// 关闭所有会话和套接字
+void UdpSessionServer::Stop()
+{
+    auto self = shared_from_this();
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+        shards_[i]->loop->RunInLoop([self, i]()
+                                    {
+            auto &shard = self->shards_[i];
+            if (shard->socket)
+            {
+                shard->socket->Stop();
+            }
+            for (auto &session : shard->sessions.TakeAll())
+            {
+                session->closed_ = true;
+                self->session_count_--;
+                if (self->close_cb_)
+                {
+                    self->close_cb_(session);
+                }
+            } });
+    }
+}
+
+// 所有分片的会话总数
+size_t UdpSessionServer::SessionCount() const
+{
+    return session_count_;
+}
+
+// 因为会话数达到上限丢弃的数据报个数
+uint64_t UdpSessionServer::Dropped() const
+{
+    return dropped_;
+}
+
+// 分片的套接字收到一批数据报，在分片的事件循环线程执行
+void UdpSessionServer::OnBatch(size_t shard, const UdpDatagram *msgs, size_t count)
+{
+    auto &sessions = shards_[shard]->sessions;
+    // 一批数据报只取一次时间
+    int64_t now = base::TTime::Now();
+    for (size_t i = 0; i < count; i++)
+    {
+        // 地址直接用二进制的 sockaddr 构造，查找时只做哈希和比较
+        InetAddress peer(msgs[i].addr, msgs[i].addr_len);
+        auto session = sessions.Find(peer);
+        if (!session)
+        {
+            if (max_sessions_ > 0 && sessions.Size() >= max_sessions_)
+            {
+                dropped_++;
+                continue;
+            }
+            session = CreateSession(shard, peer, now);
+        }
+
+        session->msgs_in_++;
+        session->bytes_in_ += msgs[i].size;
+        ExtendSession(session, now);
+
+        if (message_cb_)
+        {
+            message_cb_(session, msgs[i].data, msgs[i].size);
+        }
+    }
+}
+
+// 为新的对端创建会话
+UdpSessionPtr UdpSessionServer::CreateSession(size_t shard, const InetAddress &peer, int64_t now)
+{
+    auto &s = shards_[shard];
+    auto session = std::make_shared<UdpSession>(s->loop, peer, s->socket);
+    session->server_ = shared_from_this();
+    session->shard_ = shard;
+    s->sessions.Insert(session);
+    session_count_++;
+
+    // 空闲超时放在时间轮上，超时节点从内存块池里申请
+    auto tp = MakeSlabShared<UdpSessionTimeoutEntry>(session);
+    session->timeout_entry_ = tp;
+    session->refreshed_at_ = now;
+    s->loop->InsertEntry(idle_timeout_, tp);
+
+    NETWORK_TRACE << " udp session : " << peer.ToIpPort() << " created, shard : " << shard;
+    if (new_session_cb_)
+    {
+        new_session_cb_(session);
+    }
+    return session;
+}
+
+// 把会话从分片里删除，调用关闭回调
+void UdpSessionServer::RemoveSession(size_t shard, const UdpSessionPtr &session)
+{
+    if (session->closed_)
+    {
+        return;
+    }
+    session->closed_ = true;
+    shards_[shard]->sessions.Erase(session->PeerAddr());
+    session_count_--;
+
+    NETWORK_TRACE << " udp session : " << session->PeerAddr().ToIpPort() << " closed, shard : " << shard;
+    if (close_cb_)
+    {
+        close_cb_(session);
+    }
+}
+
+// 刷新会话的空闲超时
+void UdpSessionServer::ExtendSession(const UdpSessionPtr &session, int64_t now)
+{
+    // 时间轮的精度是一秒，同一秒里只重新插入一次；超时不小于一分钟时每次插入都要申请一个中转节点
+    if (session->refreshed_at_ == now)
+    {
+        return;
+    }
+    session->refreshed_at_ = now;
+    auto tp = session->timeout_entry_.lock();
+    if (tp)
+    {
+        session->loop_->InsertEntry(idle_timeout_, tp);
+    }
+}
+
+UdpSessionServer::~UdpSessionServer()
+{
+    // 析构前需要先调用 Stop，并等待各个事件循环执行完停止任务
+}
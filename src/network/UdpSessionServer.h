@@ -0,0 +1,194 @@
+#pragma once
+/*
+    UDP 会话服务器
+    RTP/SRT 这类推流每个发送端都需要自己的状态，UdpServer 只把数据报和对端地址交给一个回调，
+    这里按对端地址把数据报分到各自的会话上
+    每个事件循环一个分片，每个分片一个 SO_REUSEPORT 的 UdpServer 监听同一个地址，
+    内核按四元组哈希选择套接字，同一个对端的数据报总是到同一个分片，
+    会话表只在分片自己的事件循环线程里访问，没有全局的查找和锁
+    会话的空闲超时放在时间轮上，收到数据时刷新，每个会话每秒最多刷新一次
+    所有分片的套接字先在 Start 里依次绑定，再开始读
+*/
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "network/UdpServer.h"
+#include "network/UdpSessionTable.h"
+#include "network/net/EventLoopThreadPool.h"
+#include "network/base/InetAddress.h"
+#include "network/base/UdpPacer.h"
+#include "base/NonCopyable.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        class UdpSessionServer;
+        struct UdpSessionTimeoutEntry;
+
+        // 新会话和会话关闭的回调
+        using UdpSessionCallback = std::function<void(const UdpSessionPtr &)>;
+        // 会话收到数据报的回调，data 只在回调期间有效
+        using UdpSessionMessageCallback = std::function<void(const UdpSessionPtr &, const char *data, size_t size)>;
+
+        // 一个对端的会话，在所属分片的事件循环线程里创建、使用和销毁
+        class UdpSession : public std::enable_shared_from_this<UdpSession>
+        {
+        public:
+            UdpSession(EventLoop *loop, const InetAddress &peer, const UdpSocketPtr &socket);
+
+            // 对端地址
+            const InetAddress &PeerAddr() const;
+
+            // 所属的事件循环
+            EventLoop *Loop() const;
+
+            // 发送数据给对端，和 UdpSocket::Send 一样，buff 要保持有效直到发送完成
+            void Send(const char *buff, size_t size);
+
+            // 设置发给这个对端的目标码率，单位：字节/秒，SendMedia 按它错开数据报，0 表示只按媒体时间戳
+            void SetPacing(uint64_t rate);
+
+            // 按媒体时间戳和目标码率平滑地发送一个数据报，media_ts 单位：毫秒，小于 0 表示没有时间戳
+            // 发送时间交给套接字，由内核的 SO_TXTIME 或者定时器发出；需要排队时拷贝，返回后 buff 就可以释放
+            // 和会话的其他状态一样，在会话所属的事件循环线程调用
+            void SendMedia(const char *buff, size_t size, int64_t media_ts = -1);
+
+            // 主动关闭会话，会调用会话关闭的回调
+            void Close();
+
+            // 业务层的会话状态
+            void SetContext(const std::shared_ptr<void> &context);
+            void SetContext(std::shared_ptr<void> &&context);
+            template <typename T>
+            T *GetContextPtr() const
+            {
+                return static_cast<T *>(context_.get());
+            }
+
+            // 收到的数据报个数和字节数
+            uint64_t MsgsIn() const;
+            uint64_t BytesIn() const;
+
+        private:
+            friend class UdpSessionServer;
+            friend struct UdpSessionTimeoutEntry;
+
+            // 空闲超时
+            void OnIdleTimeout();
+
+            EventLoop *loop_{nullptr};
+            InetAddress peer_;
+            // 所属分片的套接字，回复从同一个套接字发出，对端看到的源地址不变
+            UdpSocketPtr socket_;
+            std::shared_ptr<void> context_;
+            // 发往对端的数据报的发送时间
+            UdpPacer pacer_;
+            // 所属的服务器和分片
+            std::weak_ptr<UdpSessionServer> server_;
+            size_t shard_{0};
+            // 时间轮上的超时节点，收到数据时重新插入
+            std::weak_ptr<UdpSessionTimeoutEntry> timeout_entry_;
+            // 上次刷新空闲超时的时间，单位：秒
+            int64_t refreshed_at_{0};
+            uint64_t msgs_in_{0};
+            uint64_t bytes_in_{0};
+            bool closed_{false};
+        };
+
+        // 会话的超时节点，时间轮转过一圈没有刷新时析构，关闭会话
+        struct UdpSessionTimeoutEntry
+        {
+            UdpSessionTimeoutEntry(const UdpSessionPtr &s)
+                : session(s)
+            {
+            }
+
+            ~UdpSessionTimeoutEntry()
+            {
+                auto s = session.lock();
+                if (s)
+                {
+                    s->OnIdleTimeout();
+                }
+            }
+
+            std::weak_ptr<UdpSession> session;
+        };
+
+        // 数据报回调和停止任务通过弱指针访问服务器，必须用 std::make_shared 创建
+        class UdpSessionServer : public std::enable_shared_from_this<UdpSessionServer>, public base::NonCopyable
+        {
+        public:
+            // 每个事件循环一个分片
+            UdpSessionServer(EventLoopThreadPool *pool, const InetAddress &addr);
+            // 只有一个分片
+            UdpSessionServer(EventLoop *loop, const InetAddress &addr);
+
+            // 设置新会话的回调，在 Start 之前调用
+            void SetNewSessionCallback(const UdpSessionCallback &cb);
+            void SetNewSessionCallback(UdpSessionCallback &&cb);
+            // 设置会话收到数据报的回调，在 Start 之前调用
+            void SetSessionMessageCallback(const UdpSessionMessageCallback &cb);
+            void SetSessionMessageCallback(UdpSessionMessageCallback &&cb);
+            // 设置会话关闭的回调，空闲超时、主动关闭和服务器停止时调用，在 Start 之前调用
+            void SetSessionCloseCallback(const UdpSessionCallback &cb);
+            void SetSessionCloseCallback(UdpSessionCallback &&cb);
+
+            // 会话的空闲超时时间，单位：秒
+            void SetIdleTimeout(int32_t timeout);
+            // 每个分片最多的会话数，超过后新的对端的数据报被丢弃，0 表示不限制
+            void SetMaxSessions(size_t max);
+            // 各个分片的套接字开启 SO_TXTIME，会话的 SendMedia 由内核按发送时间发出，在 Start 之前调用
+            // 出口要配置 fq 或者 etf 队列规则，否则不要开启，SendMedia 会用定时器；clockid 见 UdpSocket::EnableTxTime
+            void EnableTxTime(bool on, clockid_t clockid = CLOCK_MONOTONIC);
+
+            // 打开各个分片的套接字
+            void Start();
+            // 关闭所有会话和套接字，之后才能析构
+            void Stop();
+
+            // 所有分片的会话总数
+            size_t SessionCount() const;
+            // 因为会话数达到上限丢弃的数据报个数
+            uint64_t Dropped() const;
+
+            ~UdpSessionServer();
+
+        private:
+            friend class UdpSession;
+
+            // 一个分片：事件循环、套接字和会话表
+            struct Shard
+            {
+                EventLoop *loop{nullptr};
+                std::shared_ptr<UdpServer> socket;
+                UdpSessionTable sessions;
+            };
+
+            // 分片的套接字收到一批数据报
+            void OnBatch(size_t shard, const UdpDatagram *msgs, size_t count);
+            // 为新的对端创建会话
+            UdpSessionPtr CreateSession(size_t shard, const InetAddress &peer, int64_t now);
+            // 把会话从分片里删除，调用关闭回调
+            void RemoveSession(size_t shard, const UdpSessionPtr &session);
+            // 刷新会话的空闲超时，now 单位：秒，同一秒里只刷新一次
+            void ExtendSession(const UdpSessionPtr &session, int64_t now);
+
+            InetAddress addr_;
+            std::vector<std::unique_ptr<Shard>> shards_;
+
+            UdpSessionCallback new_session_cb_;
+            UdpSessionMessageCallback message_cb_;
+            UdpSessionCallback close_cb_;
+
+            int32_t idle_timeout_{30};
+            size_t max_sessions_{0};
+            bool txtime_{false};
+            clockid_t txtime_clock_{CLOCK_MONOTONIC};
+            std::atomic<size_t> session_count_{0};
+            std::atomic<uint64_t> dropped_{0};
+        };
+    }
+}
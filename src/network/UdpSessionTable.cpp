@@ -0,0 +1,130 @@
+#include "UdpSessionTable.h"
+#include "UdpSessionServer.h"
+
+using namespace tmms::network;
+
+UdpSessionTable::UdpSessionTable(size_t capacity)
+{
+    size_t n = 8;
+    while (n < capacity)
+    {
+        n <<= 1;
+    }
+    slots_.resize(n);
+    mask_ = n - 1;
+}
+
+// 查找地址所在的槽位，没有时返回应该插入的空槽位
+size_t UdpSessionTable::Probe(const InetAddress &addr, size_t hash) const
+{
+    size_t i = hash & mask_;
+    while (slots_[i].session)
+    {
+        if (slots_[i].hash == hash && slots_[i].session->PeerAddr() == addr)
+        {
+            break;
+        }
+        i = (i + 1) & mask_;
+    }
+    return i;
+}
+
+// 查找对端地址对应的会话
+UdpSessionPtr UdpSessionTable::Find(const InetAddress &addr) const
+{
+    return slots_[Probe(addr, addr.Hash())].session;
+}
+
+// 插入会话，已经存在时替换
+void UdpSessionTable::Insert(const UdpSessionPtr &session)
+{
+    if ((size_ + 1) * 2 > slots_.size())
+    {
+        Grow();
+    }
+    size_t hash = session->PeerAddr().Hash();
+    auto &slot = slots_[Probe(session->PeerAddr(), hash)];
+    if (!slot.session)
+    {
+        size_++;
+    }
+    slot.hash = hash;
+    slot.session = session;
+}
+
+// 删除对端地址对应的会话
+bool UdpSessionTable::Erase(const InetAddress &addr)
+{
+    size_t i = Probe(addr, addr.Hash());
+    if (!slots_[i].session)
+    {
+        return false;
+    }
+    slots_[i].session.reset();
+    size_--;
+
+    // 后面同一个探测链上的元素往回移，填上空出来的槽位，查找时不会提前遇到空槽位而中断
+    size_t j = i;
+    while (true)
+    {
+        j = (j + 1) & mask_;
+        if (!slots_[j].session)
+        {
+            break;
+        }
+        size_t home = slots_[j].hash & mask_;
+        // home 不在 (i, j] 这个循环区间里，说明 j 可以移到 i
+        bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable)
+        {
+            slots_[i] = std::move(slots_[j]);
+            slots_[j].session.reset();
+            i = j;
+        }
+    }
+    return true;
+}
+
+// 会话个数
+size_t UdpSessionTable::Size() const
+{
+    return size_;
+}
+
+// 取出所有会话并清空
+std::vector<UdpSessionPtr> UdpSessionTable::TakeAll()
+{
+    std::vector<UdpSessionPtr> list;
+    list.reserve(size_);
+    for (auto &slot : slots_)
+    {
+        if (slot.session)
+        {
+            list.emplace_back(std::move(slot.session));
+            slot.session.reset();
+        }
+    }
+    size_ = 0;
+    return list;
+}
+
+// 容量翻倍，重新放置所有元素
+void UdpSessionTable::Grow()
+{
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(old.size() * 2);
+    mask_ = slots_.size() - 1;
+    for (auto &slot : old)
+    {
+        if (slot.session)
+        {
+            size_t i = slot.hash & mask_;
+            while (slots_[i].session)
+            {
+                i = (i + 1) & mask_;
+            }
+            slots_[i] = std::move(slot);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+/*
+    UDP 会话表
+    对端地址到会话的开放寻址哈希表，线性探测，删除时把后面的元素往回移，不留墓碑
+    槽位里保存哈希值，探测时先比较哈希值，大部分情况下不用比较地址
+    只在所属的事件循环线程访问，不加锁
+*/
+#include <functional>
+#include <memory>
+#include <vector>
+#include "network/base/InetAddress.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        class UdpSession;
+        using UdpSessionPtr = std::shared_ptr<UdpSession>;
+
+        class UdpSessionTable
+        {
+        public:
+            // capacity 会向上取整到 2 的幂
+            explicit UdpSessionTable(size_t capacity = 64);
+
+            // 查找对端地址对应的会话，没有时返回空
+            UdpSessionPtr Find(const InetAddress &addr) const;
+
+            // 插入会话，键是会话的对端地址，已经存在时替换
+            void Insert(const UdpSessionPtr &session);
+
+            // 删除对端地址对应的会话，返回是否删除了
+            bool Erase(const InetAddress &addr);
+
+            // 会话个数
+            size_t Size() const;
+
+            // 取出所有会话并清空
+            std::vector<UdpSessionPtr> TakeAll();
+
+        private:
+            struct Slot
+            {
+                size_t hash{0};
+                UdpSessionPtr session;
+            };
+
+            // 查找地址所在的槽位，没有时返回应该插入的空槽位
+            size_t Probe(const InetAddress &addr, size_t hash) const;
+
+            // 装载率超过一半时扩容
+            void Grow();
+
+            std::vector<Slot> slots_;
+            size_t mask_{0};
+            size_t size_{0};
+        };
+    }
+}
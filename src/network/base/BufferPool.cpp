@@ -0,0 +1,136 @@
+#include "BufferPool.h"
+#include <cstdlib>
+
+using namespace tmms::network;
+
+namespace
+{
+    // 分级的个数：1KB 到 1MB，共 11 级
+    static const int kBufferPoolClassNum = 11;
+
+    // 当前线程的池是否已经析构，线程退出时静态对象的析构顺序不确定，析构后的归还直接走系统释放
+    static thread_local bool t_pool_destroyed = false;
+}
+
+BufferPool::BufferPool() : free_lists_(kBufferPoolClassNum)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    t_pool_destroyed = true;
+
+    // 线程退出时把缓存的内存全部还给系统
+    for (auto &list : free_lists_)
+    {
+        for (auto buf : list)
+        {
+            ::free(buf);
+        }
+    }
+}
+
+// 每个线程一个内存池，事件循环线程和池一一对应
+BufferPool *BufferPool::Local()
+{
+    if (t_pool_destroyed)
+    {
+        return nullptr;
+    }
+    static thread_local BufferPool pool;
+    return &pool;
+}
+
+char *BufferPool::Acquire(size_t size, size_t *capacity)
+{
+    auto pool = Local();
+    if (!pool)
+    {
+        *capacity = size;
+        return static_cast<char *>(::malloc(size));
+    }
+    return pool->Allocate(size, capacity);
+}
+
+void BufferPool::Recycle(char *buf, size_t capacity)
+{
+    auto pool = Local();
+    if (!pool)
+    {
+        ::free(buf);
+        return;
+    }
+    pool->Release(buf, capacity);
+}
+
+int BufferPool::ClassIndex(size_t size)
+{
+    if (size > kBufferPoolMaxClass)
+    {
+        return -1;
+    }
+    int index = 0;
+    size_t class_size = kBufferPoolMinClass;
+    while (class_size < size)
+    {
+        class_size <<= 1;
+        index++;
+    }
+    return index;
+}
+
+size_t BufferPool::ClassSize(size_t size)
+{
+    int index = ClassIndex(size);
+    if (index < 0)
+    {
+        return size;
+    }
+    return kBufferPoolMinClass << index;
+}
+
+char *BufferPool::Allocate(size_t size, size_t *capacity)
+{
+    int index = ClassIndex(size);
+    // 超过最大级别，直接向系统申请
+    if (index < 0)
+    {
+        *capacity = size;
+        return static_cast<char *>(::malloc(size));
+    }
+
+    *capacity = kBufferPoolMinClass << index;
+    auto &list = free_lists_[index];
+    // 池里有空闲的，直接复用
+    if (!list.empty())
+    {
+        char *buf = list.back();
+        list.pop_back();
+        cached_bytes_ -= *capacity;
+        return buf;
+    }
+    return static_cast<char *>(::malloc(*capacity));
+}
+
+void BufferPool::Release(char *buf, size_t capacity)
+{
+    if (!buf)
+    {
+        return;
+    }
+    int index = ClassIndex(capacity);
+    // 不是池里的级别，或者这一级已经缓存够多了，直接还给系统
+    if (index < 0 || (kBufferPoolMinClass << index) != capacity
+        || (free_lists_[index].size() + 1) * capacity > kBufferPoolClassBytes)
+    {
+        ::free(buf);
+        return;
+    }
+    free_lists_[index].push_back(buf);
+    cached_bytes_ += capacity;
+}
+
+size_t BufferPool::CachedBytes() const
+{
+    return cached_bytes_;
+}
@@ -0,0 +1,63 @@
+#pragma once
+/*
+    按大小分级的内存块池
+    每个线程一个池，事件循环线程上的 MsgBuffer 都从自己线程的池里借内存，不需要加锁
+    分级为 1KB、2KB、4KB ... 1MB，申请的大小向上取整到最近的级别
+    超过最大级别的内存直接走系统分配，不进池
+    每一级缓存的总字节数有上限，超出上限的内存直接还给系统，保证空闲时内存可以回落
+*/
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "base/NonCopyable.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        // 最小的分级大小
+        const size_t kBufferPoolMinClass = 1024;
+        // 最大的分级大小
+        const size_t kBufferPoolMaxClass = 1024 * 1024;
+        // 每一级最多缓存的字节数
+        const size_t kBufferPoolClassBytes = 4 * 1024 * 1024;
+
+        class BufferPool : public base::NonCopyable
+        {
+        public:
+            BufferPool();
+            ~BufferPool();
+
+            // 返回当前线程的内存池，线程退出、池已经析构后返回 nullptr
+            static BufferPool *Local();
+
+            // 从当前线程的池里申请内存，池不可用时直接向系统申请
+            static char *Acquire(size_t size, size_t *capacity);
+
+            // 把内存还给当前线程的池，池不可用时直接还给系统
+            static void Recycle(char *buf, size_t capacity);
+
+            // 把 size 向上取整到所属级别的大小，超过最大级别的原样返回
+            static size_t ClassSize(size_t size);
+
+            // 申请至少 size 字节的内存，实际大小通过 capacity 返回
+            char *Allocate(size_t size, size_t *capacity);
+
+            // 归还内存，capacity 必须是 Allocate 返回的实际大小
+            void Release(char *buf, size_t capacity);
+
+            // 当前池里缓存的总字节数
+            size_t CachedBytes() const;
+
+        private:
+            // 返回 size 所属级别的下标，超过最大级别返回 -1
+            static int ClassIndex(size_t size);
+
+            // 每一级的空闲内存块
+            std::vector<std::vector<char *>> free_lists_;
+
+            // 池里缓存的总字节数
+            size_t cached_bytes_{0};
+        };
+    }
+}
@@ -4,6 +4,29 @@
 
 using namespace tmms::network;
 
+namespace
+{
+    // 64 位整数的混合函数，让相邻的地址和端口也能均匀分布到哈希桶里
+    uint64_t Mix64(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    // 主机字节序的 IPv4 地址是否是广域网地址：
+    // 局域网 10/8、172.16/12、192.168/16，回环 127/8，本网络 0/8（包括任意地址），链路本地 169.254/16 都不是
+    bool IsWanIpV4(uint32_t ip)
+    {
+        bool is_lan = (ip & 0xff000000) == 0x0a000000 || (ip & 0xfff00000) == 0xac100000 || (ip & 0xffff0000) == 0xc0a80000;
+        bool is_loopback = (ip & 0xff000000) == 0x7f000000;
+        bool is_local = (ip & 0xff000000) == 0 || (ip & 0xffff0000) == 0xa9fe0000;
+        return !is_lan && !is_loopback && !is_local;
+    }
+}
 
 // 获取IP和端口
 void InetAddress::GetIpAndPort(const std::string &host, std::string &ip, std::string &port)
@@ -20,151 +43,243 @@ void InetAddress::GetIpAndPort(const std::string &host, std::string &ip, std::st
     }
 }
 // 构造函数
+InetAddress::InetAddress()
+{
+    memset(&addr_, 0x00, sizeof(addr_));
+}
 InetAddress::InetAddress(const std::string &ip, uint16_t port, bool bv6)
-    : addr_(ip), port_(std::to_string(port)), is_ipv6_(bv6)
+    : InetAddress()
 {
+    // 空的 IP 表示任意地址，按 bv6 决定地址族
+    SetIsIPV6(bv6);
+    SetAddr(ip);
+    SetPort(port);
 }
 InetAddress::InetAddress(const std::string &host, bool is_v6)
+    : InetAddress()
+{
+    SetIsIPV6(is_v6);
+    SetHost(host);
+}
+InetAddress::InetAddress(const struct sockaddr *saddr, socklen_t len)
+    : InetAddress()
 {
-    GetIpAndPort(host, addr_, port_);
-    is_ipv6_ = is_v6;
+    SetSockAddr(saddr, len);
 }
 
 // 设置主机地址
 void InetAddress::SetHost(const std::string &host)
 {
-    GetIpAndPort(host, addr_, port_);
+    std::string ip, port;
+    GetIpAndPort(host, ip, port);
+    SetAddr(ip);
+    // 没有端口时保留原来的端口
+    if (!port.empty())
+    {
+        SetPort(atoi(port.c_str()));
+    }
 }
-// 设置IP
+// 设置IP，解析一次，之后都使用二进制地址
 void InetAddress::SetAddr(const std::string &addr)
 {
-    addr_ = addr;
+    // 空的 IP 保留原来的地址族，地址清零
+    if (addr.empty())
+    {
+        if (addr_.ss_family == AF_INET6)
+        {
+            memset(&In6()->sin6_addr, 0x00, sizeof(struct in6_addr));
+        }
+        else if (addr_.ss_family == AF_INET)
+        {
+            memset(&In4()->sin_addr, 0x00, sizeof(struct in_addr));
+        }
+        return;
+    }
+
+    uint16_t port = Port();
+    struct in6_addr addr6;
+    struct in_addr addr4;
+    if (addr.find(':') != std::string::npos && ::inet_pton(AF_INET6, addr.c_str(), &addr6) == 1)
+    {
+        memset(&addr_, 0x00, sizeof(addr_));
+        In6()->sin6_family = AF_INET6;
+        In6()->sin6_addr = addr6;
+    }
+    else if (::inet_pton(AF_INET, addr.c_str(), &addr4) == 1)
+    {
+        memset(&addr_, 0x00, sizeof(addr_));
+        In4()->sin_family = AF_INET;
+        In4()->sin_addr = addr4;
+    }
+    else
+    {
+        NETWORK_ERROR << "ip :" << addr << " is error";
+        memset(&addr_, 0x00, sizeof(addr_));
+    }
+    SetPort(port);
 }
 // 设置端口
 void InetAddress::SetPort(uint16_t port)
 {
-    port_ = std::to_string(port);
+    // sin_port 和 sin6_port 在结构体里的偏移相同
+    In4()->sin_port = htons(port);
 }
 // 设置是否为IPv6地址
 void InetAddress::SetIsIPV6(bool is_v6)
 {
-    is_ipv6_ = is_v6;
-}
+    if (is_v6 == IsIpV6() && addr_.ss_family != AF_UNSPEC)
+    {
+        return;
+    }
 
-// 返回IP地址的字符串形式
-const std::string &InetAddress::IP() const
+    uint16_t port = Port();
+    if (is_v6)
+    {
+        // IPv4 地址转换成 IPv4 映射的 IPv6 地址，任意地址还是任意地址
+        uint32_t ip = addr_.ss_family == AF_INET ? In4()->sin_addr.s_addr : 0;
+        memset(&addr_, 0x00, sizeof(addr_));
+        In6()->sin6_family = AF_INET6;
+        if (ip != 0)
+        {
+            In6()->sin6_addr.s6_addr[10] = 0xff;
+            In6()->sin6_addr.s6_addr[11] = 0xff;
+            memcpy(&In6()->sin6_addr.s6_addr[12], &ip, sizeof(ip));
+        }
+    }
+    else
+    {
+        // IPv4 映射的 IPv6 地址转换回 IPv4 地址，其他的 IPv6 地址没有对应的 IPv4 地址
+        uint32_t ip = 0;
+        if (addr_.ss_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&In6()->sin6_addr))
+        {
+            memcpy(&ip, &In6()->sin6_addr.s6_addr[12], sizeof(ip));
+        }
+        memset(&addr_, 0x00, sizeof(addr_));
+        In4()->sin_family = AF_INET;
+        In4()->sin_addr.s_addr = ip;
+    }
+    SetPort(port);
+}
+// 直接设置二进制地址
+void InetAddress::SetSockAddr(const struct sockaddr *saddr, socklen_t len)
 {
-    return addr_;
+    memset(&addr_, 0x00, sizeof(addr_));
+    if (saddr == nullptr)
+    {
+        return;
+    }
+    if (saddr->sa_family == AF_INET && len >= sizeof(struct sockaddr_in))
+    {
+        memcpy(&addr_, saddr, sizeof(struct sockaddr_in));
+    }
+    else if (saddr->sa_family == AF_INET6 && len >= sizeof(struct sockaddr_in6))
+    {
+        memcpy(&addr_, saddr, sizeof(struct sockaddr_in6));
+    }
 }
 
-// 给类外部使用的接口，唯一工作就是调用那个私有的、带有参数的 IPv4 版本
-uint32_t InetAddress::IPv4() const
+// 返回IP地址的字符串形式
+std::string InetAddress::IP() const
 {
-    return IPv4(addr_.c_str());
+    char ip[INET6_ADDRSTRLEN] = {0, };
+    if (addr_.ss_family == AF_INET)
+    {
+        ::inet_ntop(AF_INET, &In4()->sin_addr, ip, sizeof(ip));
+    }
+    else if (addr_.ss_family == AF_INET6)
+    {
+        ::inet_ntop(AF_INET6, &In6()->sin6_addr, ip, sizeof(ip));
+    }
+    return ip;
 }
 
-// 返回主机字节序的 IPv4 地址
-uint32_t InetAddress::IPv4(const char *ip) const
+// 返回主机字节序的 IPv4 地址，不是 IPv4 地址时返回 0
+uint32_t InetAddress::IPv4() const
 {
-    // 创建并初始化 socket 地址结构体
-    struct sockaddr_in addr_in;
-    memset(&addr_in, 0x00, sizeof(sockaddr_in));
-    // 设置地址族
-    addr_in.sin_family = AF_INET;
-    // 设置端口，这个函数的目标仅仅是转换 IP 地址本身，并不关心端口
-    addr_in.sin_port = 0;
-    // inet_pton：将一个人类可读的 IP 地址字符串，转换成计算机网络系统所使用的二进制格式
-    // 转换后的IP地址存放在 addr_in.sin_addr 中
-    if (::inet_pton(AF_INET, ip, &addr_in.sin_addr) < 0)
+    if (addr_.ss_family != AF_INET)
     {
-        NETWORK_ERROR << "ipv4 ip :" << ip << " is error";
         return 0;
     }
-    // 网络字节序到主机字节序的转换
-    return ntohl(addr_in.sin_addr.s_addr);
+    return ntohl(In4()->sin_addr.s_addr);
 }
 
 // 返回IP地址和端口的字符串形式
 std::string InetAddress::ToIpPort() const
 {
-    std::stringstream ss;
-    ss << addr_ << ":" << port_;
-    return ss.str();
+    return IP() + ":" + std::to_string(Port());
 }
 
 // 返回端口号
 uint16_t InetAddress::Port() const
 {
-    return atoi(port_.c_str());
+    return ntohs(In4()->sin_port);
 }
 
-//将 C++ 的 InetAddress 对象内部存储的地址信息，转换并打包成一个 C 语言底层网络库能够识别和使用的标准地址结构体  
+//将 C++ 的 InetAddress 对象内部存储的地址信息，转换并打包成一个 C 语言底层网络库能够识别和使用的标准地址结构体
 void InetAddress::GetSockAddr(struct sockaddr *saddr) const
 {
-    if (is_ipv6_)
+    if (addr_.ss_family == AF_INET6)
     {
-        struct sockaddr_in6 *addr_in6 = (struct sockaddr_in6 *)saddr;
-        memset(addr_in6, 0x00, sizeof(struct sockaddr_in6));
-
-        addr_in6->sin6_family = AF_INET6;
-        addr_in6->sin6_port = htons(Port());
-        if (::inet_pton(AF_INET6, addr_.c_str(), &addr_in6->sin6_addr) < 0)
-        {
-        }
+        memcpy(saddr, &addr_, sizeof(struct sockaddr_in6));
         return;
     }
 
-    // 将通用指针转换为专用指针
+    // 地址族未知时按 IPv4 的任意地址处理
     struct sockaddr_in *addr_in = (struct sockaddr_in *)saddr;
-    memset(addr_in, 0x00, sizeof(struct sockaddr_in));
-
-    // 设置地址族：表明这是IPv4
+    memcpy(addr_in, &addr_, sizeof(struct sockaddr_in));
     addr_in->sin_family = AF_INET;
-    // 设置端口号：将端口转换为网络字节序
-    addr_in->sin_port = htons(Port());
-    if (::inet_pton(AF_INET, addr_.c_str(), &addr_in->sin_addr) < 0)
-    {
-    }
+}
+
+// 内部保存的 sockaddr
+const struct sockaddr *InetAddress::SockAddr() const
+{
+    return (const struct sockaddr *)&addr_;
+}
+
+// 内部保存的 sockaddr 的长度
+socklen_t InetAddress::SockAddrLen() const
+{
+    return addr_.ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
 }
 
 // 判断是否为IPV6地址
 bool InetAddress::IsIpV6() const
 {
-    return is_ipv6_;
+    return addr_.ss_family == AF_INET6;
 }
 
-// 判断是否是广域网IP
+// 判断是否是广域网IP，地址族逐个处理，不认识的地址族都不是
 bool InetAddress::IsWanIp() const
 {
-    uint32_t a_start = IPv4("10.0.0.0");
-    uint32_t a_end = IPv4("10.255.255.255");
-    uint32_t b_start = IPv4("172.16.0.0");
-    uint32_t b_end = IPv4("172.31.255.255");
-    uint32_t c_start = IPv4("192.168.0.0");
-    uint32_t c_end = IPv4("192.168.255.255");
-
-    uint32_t ip = IPv4();
-    bool is_a = (ip >= a_start && ip <= a_end);
-    bool is_b = (ip >= b_start && ip <= b_end);
-    bool is_c = (ip >= c_start && ip <= c_end);
-
-    return !is_a && !is_b && !is_c && ip != INADDR_LOOPBACK;
+    if (addr_.ss_family == AF_INET)
+    {
+        return IsWanIpV4(IPv4());
+    }
+    if (addr_.ss_family == AF_INET6)
+    {
+        const struct in6_addr &a = In6()->sin6_addr;
+        // IPv4 映射的地址按里面的 IPv4 地址判断
+        if (IN6_IS_ADDR_V4MAPPED(&a))
+        {
+            uint32_t ip = 0;
+            memcpy(&ip, &a.s6_addr[12], sizeof(ip));
+            return IsWanIpV4(ntohl(ip));
+        }
+        // 未指定 ::、回环 ::1、链路本地 fe80::/10、唯一本地 fc00::/7 都不是
+        bool is_ula = (a.s6_addr[0] & 0xfe) == 0xfc;
+        return !IN6_IS_ADDR_UNSPECIFIED(&a) && !IN6_IS_ADDR_LOOPBACK(&a) && !IN6_IS_ADDR_LINKLOCAL(&a) && !is_ula;
+    }
+    return false;
 }
 
 // 判断是否是局域网IP
 bool InetAddress::IsLanIp() const
 {
-    uint32_t a_start = IPv4("10.0.0.0");
-    uint32_t a_end = IPv4("10.255.255.255");
-    uint32_t b_start = IPv4("172.16.0.0");
-    uint32_t b_end = IPv4("172.31.255.255");
-    uint32_t c_start = IPv4("192.168.0.0");
-    uint32_t c_end = IPv4("192.168.255.255");
-
+    // 10.0.0.0/8、172.16.0.0/12、192.168.0.0/16，直接比较前缀，不用再解析字符串
     uint32_t ip = IPv4();
-    bool is_a = ip >= a_start && ip <= a_end;
-    bool is_b = ip >= b_start && ip <= b_end;
-    bool is_c = ip >= c_start && ip <= c_end;
+    bool is_a = (ip & 0xff000000) == 0x0a000000;
+    bool is_b = (ip & 0xfff00000) == 0xac100000;
+    bool is_c = (ip & 0xffff0000) == 0xc0a80000;
 
     return is_a || is_b || is_c;
 }
@@ -172,5 +287,64 @@ bool InetAddress::IsLanIp() const
 // 判断是否是回环IP
 bool InetAddress::IsLoopbackIp() const
 {
-    return addr_ == "127.0.0.1";
-}
\ No newline at end of file
+    if (addr_.ss_family == AF_INET6)
+    {
+        return IN6_IS_ADDR_LOOPBACK(&In6()->sin6_addr);
+    }
+    return (IPv4() & 0xff000000) == 0x7f000000;
+}
+
+// 哈希值，只用地址族、IP 和端口
+size_t InetAddress::Hash() const
+{
+    uint64_t h = ((uint64_t)addr_.ss_family << 16) | Port();
+    if (addr_.ss_family == AF_INET6)
+    {
+        uint64_t words[2];
+        memcpy(words, &In6()->sin6_addr, sizeof(words));
+        h = Mix64(h ^ words[0]) ^ words[1];
+    }
+    else
+    {
+        h |= (uint64_t)In4()->sin_addr.s_addr << 32;
+    }
+    return (size_t)Mix64(h);
+}
+
+// 地址族、IP 和端口都相同才相等
+bool InetAddress::operator==(const InetAddress &other) const
+{
+    if (addr_.ss_family != other.addr_.ss_family || In4()->sin_port != other.In4()->sin_port)
+    {
+        return false;
+    }
+    if (addr_.ss_family == AF_INET6)
+    {
+        return memcmp(&In6()->sin6_addr, &other.In6()->sin6_addr, sizeof(struct in6_addr)) == 0 &&
+               In6()->sin6_scope_id == other.In6()->sin6_scope_id;
+    }
+    return In4()->sin_addr.s_addr == other.In4()->sin_addr.s_addr;
+}
+
+bool InetAddress::operator!=(const InetAddress &other) const
+{
+    return !(*this == other);
+}
+
+// 按地址族返回 IPv4 或者 IPv6 的结构体
+struct sockaddr_in *InetAddress::In4()
+{
+    return (struct sockaddr_in *)&addr_;
+}
+const struct sockaddr_in *InetAddress::In4() const
+{
+    return (const struct sockaddr_in *)&addr_;
+}
+struct sockaddr_in6 *InetAddress::In6()
+{
+    return (struct sockaddr_in6 *)&addr_;
+}
+const struct sockaddr_in6 *InetAddress::In6() const
+{
+    return (const struct sockaddr_in6 *)&addr_;
+}
@@ -4,11 +4,14 @@
     IP 和端口经常需要进行转换成其他形式
     有时候需要对地址进行分类检测
     InetAddress 类主要方便存储 IP 和端口信息，提供地址相关的操作
+    内部直接保存二进制的 sockaddr，转换成系统调用需要的地址不用再解析字符串，
+    只有需要文本的时候才格式化；可以直接做哈希表的键
 */
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <string>
+#include <functional>
 #include <bits/socket.h>
 
 namespace tmms {
@@ -19,22 +22,27 @@ namespace tmms {
             InetAddress(const std::string &ip, uint16_t port, bool bv6=false);
             // 通过一个单一的 host 字符串（格式为 "ip:port"）来构造
             InetAddress(const std::string &host, bool is_v6=false);
-            InetAddress() = default;
-            ~InetAddress() = default; 
+            // 通过系统调用返回的二进制地址来构造
+            InetAddress(const struct sockaddr *saddr, socklen_t len);
+            InetAddress();
+            ~InetAddress() = default;
 
             // 赋值函数
             void SetHost(const std::string &host);
-            void SetAddr(const std::string &addr);
+            void SetAddr(const std::string &addr);                  // IP 的格式决定是 IPv4 还是 IPv6
             void SetPort(uint16_t port);
-            void SetIsIPV6(bool is_v6);
+            void SetIsIPV6(bool is_v6);                             // 切换地址族，IPv4 和 IPv4 映射的 IPv6 地址互相转换
+            void SetSockAddr(const struct sockaddr *saddr, socklen_t len);  // 直接设置二进制地址，不做字符串转换
 
             // 取值函数
-            const std::string &IP() const;                          // 返回字符串形式的 IP 地址
+            std::string IP() const;                                 // 返回字符串形式的 IP 地址，每次调用时格式化
             uint32_t IPv4() const;                                  // 返回 uint32_t 形式的 IPv4 地址（主机字节序）
             std::string ToIpPort() const;                           // 返回 "ip:port" 格式的完整地址字符串
             uint16_t Port() const;                                  // 返回 uint16_t 形式的端口号
-            
+
             void GetSockAddr(struct sockaddr *addr) const;          // 将 InetAddress 转换为 sockaddr 结构体
+            const struct sockaddr *SockAddr() const;                // 内部保存的 sockaddr，可以直接传给系统调用
+            socklen_t SockAddrLen() const;                          // 内部保存的 sockaddr 的长度
 
             // 测试函数
             bool IsIpV6() const;
@@ -42,15 +50,34 @@ namespace tmms {
             bool IsLanIp() const;
             bool IsLoopbackIp() const;
 
+            // 哈希和比较，只看地址族、IP 和端口，不需要格式化
+            size_t Hash() const;
+            bool operator==(const InetAddress &other) const;
+            bool operator!=(const InetAddress &other) const;
+
             static void GetIpAndPort(const std::string &host, std::string &ip, std::string &port);
 
         private:
-            // 私有取值
-            uint32_t IPv4(const char *ip) const;
-            // 私有成员变量
-            std::string addr_;
-            std::string port_;
-            bool is_ipv6_{false};
+            // 按地址族返回 IPv4 或者 IPv6 的结构体
+            struct sockaddr_in *In4();
+            const struct sockaddr_in *In4() const;
+            struct sockaddr_in6 *In6();
+            const struct sockaddr_in6 *In6() const;
+            // 私有成员变量，端口在 IPv4 和 IPv6 的结构体里位置相同，地址族未知时也保存在这里
+            struct sockaddr_storage addr_;
         };
     }
-}
\ No newline at end of file
+}
+
+namespace std
+{
+    // 可以直接用 InetAddress 做 unordered_map 的键
+    template <>
+    struct hash<tmms::network::InetAddress>
+    {
+        size_t operator()(const tmms::network::InetAddress &addr) const
+        {
+            return addr.Hash();
+        }
+    };
+}
@@ -29,6 +29,17 @@ namespace tmms
              */
             MsgBuffer(size_t len = kBufferDefaultLength);
 
+            /**
+             * @brief The storage is borrowed from the per-thread BufferPool and
+             * returned to it on destruction.
+             *
+             */
+            MsgBuffer(const MsgBuffer &buf);
+            MsgBuffer(MsgBuffer &&buf) noexcept;
+            MsgBuffer &operator=(const MsgBuffer &buf);
+            MsgBuffer &operator=(MsgBuffer &&buf) noexcept;
+            ~MsgBuffer();
+
             /**
              * @brief Get the beginning of the buffer.
              *
@@ -145,9 +156,27 @@ namespace tmms
              */
             size_t WritableBytes() const
             {
-                return buffer_.size() - tail_;
+                return capacity_ > tail_ ? capacity_ - tail_ : 0;
             }
 
+            /**
+             * @brief Return the size of the storage currently held by the buffer,
+             * 0 when the storage has been given back to the pool.
+             *
+             * @return size_t
+             */
+            size_t Capacity() const
+            {
+                return Owned() ? capacity_ : 0;
+            }
+
+            /**
+             * @brief Give the storage back to the pool if the buffer is empty. The
+             * next write borrows storage again at the size it actually needs.
+             *
+             */
+            void Shrink();
+
             /**
              * @brief Append new data to the buffer.
              *
@@ -250,6 +279,9 @@ namespace tmms
 
             /**
              * @brief Read data from a file descriptor and put it into the buffer.˝
+             * When the buffer is nearly full a pooled block is read into as well,
+             * and on overflow that block becomes the new storage, so a large burst
+             * is never copied.
              *
              * @param fd The file descriptor. It is usually a socket.
              * @param retErrno The error code when reading.
@@ -332,16 +364,21 @@ namespace tmms
         private:
             size_t head_;
             size_t initCap_;
-            std::vector<char> buffer_;
+            char *buffer_;
+            size_t capacity_;
             size_t tail_;
             const char *begin() const
             {
-                return &buffer_[0];
+                return buffer_;
             }
             char *begin()
             {
-                return &buffer_[0];
+                return buffer_;
             }
+            bool Owned() const;
+            void Adopt(char *buf, size_t capacity);
+            void ReleaseStorage();
+            void MaybeShrink();
         };
 
         inline void swap(MsgBuffer &one, MsgBuffer &two) noexcept
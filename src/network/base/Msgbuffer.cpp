@@ -1,6 +1,8 @@
 #include "MsgBuffer.h"
+#include "BufferPool.h"
 #include <string.h>
 #include <sys/uio.h>
+#include <unistd.h>
 #include <netinet/in.h>
 #include <errno.h>
 #include <assert.h>
@@ -11,11 +13,118 @@ using namespace tmms::network;
 namespace 
 {
     static constexpr size_t kBufferOffset{8};
+    // ReadFd 可写空间不足时，从池里额外借用的内存块大小
+    static constexpr size_t kExtraReadLength{64 * 1024};
+    // 额外借用的内存块里至少留给新数据的空间
+    static constexpr size_t kMinExtraReadLength{16 * 1024};
+    // 没有持有内存时使用的占位空间，只用来让 Peek()/BeginWrite() 返回合法地址，从不写入
+    static char kEmptyBuffer[kBufferOffset];
 }
 
 MsgBuffer::MsgBuffer(size_t len)
-    : head_(kBufferOffset), initCap_(len), buffer_(len + head_), tail_(head_)
+    : head_(kBufferOffset), initCap_(len), buffer_(kEmptyBuffer), capacity_(kBufferOffset), tail_(head_)
 {
+    // len 为 0 表示延迟分配，第一次写入时再向池借内存
+    if (len > 0)
+    {
+        buffer_ = BufferPool::Acquire(len + kBufferOffset, &capacity_);
+    }
+}
+
+MsgBuffer::MsgBuffer(const MsgBuffer &buf)
+    : head_(kBufferOffset), initCap_(buf.initCap_), buffer_(kEmptyBuffer), capacity_(kBufferOffset), tail_(head_)
+{
+    Append(buf);
+}
+
+MsgBuffer::MsgBuffer(MsgBuffer &&buf) noexcept
+    : head_(buf.head_), initCap_(buf.initCap_), buffer_(buf.buffer_), capacity_(buf.capacity_), tail_(buf.tail_)
+{
+    buf.buffer_ = kEmptyBuffer;
+    buf.capacity_ = kBufferOffset;
+    buf.head_ = buf.tail_ = kBufferOffset;
+}
+
+MsgBuffer &MsgBuffer::operator=(const MsgBuffer &buf)
+{
+    if (this != &buf)
+    {
+        MsgBuffer tmp(buf);
+        Swap(tmp);
+    }
+    return *this;
+}
+
+MsgBuffer &MsgBuffer::operator=(MsgBuffer &&buf) noexcept
+{
+    if (this != &buf)
+    {
+        MsgBuffer tmp(std::move(buf));
+        Swap(tmp);
+    }
+    return *this;
+}
+
+MsgBuffer::~MsgBuffer()
+{
+    ReleaseStorage();
+}
+
+bool MsgBuffer::Owned() const
+{
+    return buffer_ != kEmptyBuffer;
+}
+
+// 换成一块新的内存，原来的内存还回池里
+void MsgBuffer::Adopt(char *buf, size_t capacity)
+{
+    ReleaseStorage();
+    buffer_ = buf;
+    capacity_ = capacity;
+}
+
+// 把内存还回池里，回到不持有内存的状态
+void MsgBuffer::ReleaseStorage()
+{
+    if (Owned())
+    {
+        BufferPool::Recycle(buffer_, capacity_);
+    }
+    buffer_ = kEmptyBuffer;
+    capacity_ = kBufferOffset;
+}
+
+void MsgBuffer::Shrink()
+{
+    if (ReadableBytes() == 0)
+    {
+        ReleaseStorage();
+        tail_ = head_ = kBufferOffset;
+    }
+}
+
+// 大块数据被读走、只剩少量数据时，把剩余数据搬到按剩余数据大小借的内存块，大块还回池里
+// ReadFd 借来的 64K 内存块也会收缩，连接上只缓存半个消息时不会一直占着大块内存
+void MsgBuffer::MaybeShrink()
+{
+    size_t readable = ReadableBytes();
+    // 没有超过初始容量的内存不收缩；剩余数据超过容量的四分之一时，搬运省不下多少内存
+    if (capacity_ <= BufferPool::ClassSize(initCap_ + kBufferOffset) || (kBufferOffset + readable) * 4 > capacity_)
+    {
+        return;
+    }
+    // 给后续写入留出和剩余数据一样多的空间，不小于初始容量
+    size_t size = std::max(kBufferOffset + readable * 2, initCap_ + kBufferOffset);
+    if (BufferPool::ClassSize(size) >= capacity_)
+    {
+        return;
+    }
+    size_t capacity = 0;
+    char *buf = BufferPool::Acquire(size, &capacity);
+    memcpy(buf + kBufferOffset, Peek(), readable);
+    Adopt(buf, capacity);
+    head_ = kBufferOffset;
+    tail_ = kBufferOffset + readable;
 }
 
 void MsgBuffer::EnsureWritableBytes(size_t len)
@@ -32,18 +141,24 @@ void MsgBuffer::EnsureWritableBytes(size_t len)
     }
     // create new buffer
     size_t newLen;
-    if ((buffer_.size() * 2) > (kBufferOffset + ReadableBytes() + len))
-        newLen = buffer_.size() * 2;
+    if ((capacity_ * 2) > (kBufferOffset + ReadableBytes() + len))
+        newLen = capacity_ * 2;
     else
         newLen = kBufferOffset + ReadableBytes() + len;
-    MsgBuffer newbuffer(newLen);
-    newbuffer.Append(*this);
-    Swap(newbuffer);
+    // 新内存直接从池里借，按级别取整后多出来的部分也能用上
+    size_t capacity = 0;
+    char *buf = BufferPool::Acquire(newLen, &capacity);
+    size_t readable = ReadableBytes();
+    memcpy(buf + kBufferOffset, Peek(), readable);
+    Adopt(buf, capacity);
+    head_ = kBufferOffset;
+    tail_ = kBufferOffset + readable;
 }
 
 void MsgBuffer::Swap(MsgBuffer &buf) noexcept
 {
-    buffer_.swap(buf.buffer_);
+    std::swap(buffer_, buf.buffer_);
+    std::swap(capacity_, buf.capacity_);
     std::swap(head_, buf.head_);
     std::swap(tail_, buf.tail_);
     std::swap(initCap_, buf.initCap_);
@@ -51,15 +166,19 @@ void MsgBuffer::Swap(MsgBuffer &buf) noexcept
 
 void MsgBuffer::Append(const MsgBuffer &buf)
 {
+    if (buf.ReadableBytes() == 0)
+        return;
     EnsureWritableBytes(buf.ReadableBytes());
-    memcpy(&buffer_[tail_], buf.Peek(), buf.ReadableBytes());
+    memcpy(begin() + tail_, buf.Peek(), buf.ReadableBytes());
     tail_ += buf.ReadableBytes();
 }
 
 void MsgBuffer::Append(const char *buf, size_t len)
 {
+    if (len == 0)
+        return;
     EnsureWritableBytes(len);
-    memcpy(&buffer_[tail_], buf, len);
+    memcpy(begin() + tail_, buf, len);
     tail_ += len;
 }
 
@@ -128,40 +247,78 @@ void MsgBuffer::Retrieve(size_t len)
         return;
     }
     head_ += len;
+    MaybeShrink();
 }
 
 void MsgBuffer::RetrieveAll()
 {
-    if (buffer_.size() > (initCap_ * 2))
+    tail_ = head_ = kBufferOffset;
+    // 数据全部读走后，超出初始容量的内存还回池里，下次有数据时再按需借用
+    // 这样突发过后空闲下来的连接不会一直占着峰值大小的内存
+    if (capacity_ > BufferPool::ClassSize(initCap_ + kBufferOffset) || initCap_ == 0)
     {
-        buffer_.resize(initCap_);
+        ReleaseStorage();
     }
-    tail_ = head_ = kBufferOffset;
 }
 
 ssize_t MsgBuffer::ReadFd(int fd, int *retErrno)
 {
-    char extBuffer[8192];
-    struct iovec vec[2];
     size_t writable = WritableBytes();
-    vec[0].iov_base = begin() + tail_;
-    vec[0].iov_len = static_cast<int>(writable);
-    vec[1].iov_base = extBuffer;
-    vec[1].iov_len = sizeof(extBuffer);
-    const int iovcnt = (writable < sizeof extBuffer) ? 2 : 1;
+    // 可写空间足够大，直接读到自己的内存里
+    if (writable >= kExtraReadLength)
+    {
+        ssize_t n = ::read(fd, begin() + tail_, writable);
+        if (n < 0)
+        {
+            *retErrno = errno;
+        }
+        else
+        {
+            tail_ += n;
+        }
+        return n;
+    }
+
+    // 可写空间不够，额外从池里借一块内存一起读
+    // 借来的内存前面预留出 readable + writable 的位置，溢出时只需要把原来的数据（小的部分）搬到前面，
+    // 读进来的大块数据原地不动，借来的内存直接成为新的存储，不再额外拷贝
+    size_t readable = ReadableBytes();
+    size_t prefix = readable + writable;
+    size_t ext_capacity = 0;
+    char *ext = BufferPool::Acquire(std::max(kExtraReadLength, kBufferOffset + prefix + kMinExtraReadLength), &ext_capacity);
+    char *ext_data = ext + kBufferOffset + prefix;
+
+    struct iovec vec[2];
+    int iovcnt = 0;
+    if (writable > 0)
+    {
+        vec[iovcnt].iov_base = begin() + tail_;
+        vec[iovcnt].iov_len = writable;
+        iovcnt++;
+    }
+    vec[iovcnt].iov_base = ext_data;
+    vec[iovcnt].iov_len = ext_capacity - kBufferOffset - prefix;
+    iovcnt++;
+
     ssize_t n = ::readv(fd, vec, iovcnt);
     if (n < 0)
     {
         *retErrno = errno;
+        BufferPool::Recycle(ext, ext_capacity);
     }
     else if (static_cast<size_t>(n) <= writable)
     {
         tail_ += n;
+        BufferPool::Recycle(ext, ext_capacity);
     }
     else
     {
-        tail_ = buffer_.size();
-        Append(extBuffer, n - writable);
+        memcpy(ext + kBufferOffset, Peek(), prefix);
+        Adopt(ext, ext_capacity);
+        head_ = kBufferOffset;
+        tail_ = kBufferOffset + readable + n;
+        // 只比可写空间多读了一点时，不留着整块借来的内存
+        MaybeShrink();
     }
     return n;
 }
@@ -205,7 +362,7 @@ uint64_t MsgBuffer::ReadInt64()
 
 void MsgBuffer::AddInFront(const char *buf, size_t len)
 {
-    if (head_ >= len)
+    if (head_ >= len && Owned())
     {
         memcpy(begin() + head_ - len, buf, len);
         head_ -= len;
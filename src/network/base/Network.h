@@ -9,4 +9,6 @@ using namespace tmms::base;
 #define NETWORK_DEBUG LOG_DEBUG
 #define NETWORK_INFO LOG_INFO
 #define NETWORK_WARN LOG_WARN
-#define NETWORK_ERROR LOG_ERROR
\ No newline at end of file
+#define NETWORK_ERROR LOG_ERROR
+#define NETWORK_WARN_LIMITED LOG_WARN_LIMITED
+#define NETWORK_ERROR_LIMITED LOG_ERROR_LIMITED
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+/*
+    报文里的序号只有 32 位，两端内部用不回绕的 64 位序号
+    收到的 32 位序号按离参考序号最近的原则还原，RUDP 和 FEC 共用
+*/
+#include <cstdint>
+
+namespace tmms
+{
+    namespace network
+    {
+        // 把 32 位的序号还原成离 ref 最近的 64 位序号：
+        // 取高 32 位和 ref 相同、相邻的三个候选里离 ref 最近的一个，不会还原成负数
+        inline uint64_t UnwrapSeq(uint32_t seq, uint64_t ref)
+        {
+            const uint64_t kSpan = 1ULL << 32;
+            uint64_t v = (ref & ~(kSpan - 1)) | seq;
+            if (v > ref && v - ref > kSpan / 2 && v >= kSpan)
+            {
+                v -= kSpan;
+            }
+            else if (v < ref && ref - v > kSpan / 2)
+            {
+                v += kSpan;
+            }
+            return v;
+        }
+    }
+}
@@ -0,0 +1,143 @@
+#include "SlabPool.h"
+#include <cstdlib>
+#include <cstring>
+
+using namespace tmms::network;
+
+namespace
+{
+    // 分级的个数
+    static const size_t kSlabClassNum = kSlabMaxBlock / kSlabAlign;
+
+    // 当前线程的池是否已经析构，析构后的归还直接走系统释放
+    static thread_local bool t_slab_destroyed = false;
+
+    // 返回 size 所属级别的下标，超过最大块大小返回 -1
+    int ClassIndex(size_t size)
+    {
+        if (size == 0 || size > kSlabMaxBlock)
+        {
+            return -1;
+        }
+        return static_cast<int>((size + kSlabAlign - 1) / kSlabAlign) - 1;
+    }
+}
+
+SlabPool::SlabPool()
+{
+    memset(free_lists_, 0x00, sizeof(free_lists_));
+    memset(counts_, 0x00, sizeof(counts_));
+}
+
+SlabPool::~SlabPool()
+{
+    t_slab_destroyed = true;
+
+    // 线程退出时把缓存的内存块全部还给系统
+    for (size_t i = 0; i < kSlabClassNum; i++)
+    {
+        auto node = free_lists_[i];
+        while (node)
+        {
+            auto next = node->next;
+            ::free(node);
+            node = next;
+        }
+        free_lists_[i] = nullptr;
+    }
+}
+
+// 每个线程一个池
+SlabPool *SlabPool::Local()
+{
+    if (t_slab_destroyed)
+    {
+        return nullptr;
+    }
+    static thread_local SlabPool pool;
+    return &pool;
+}
+
+void *SlabPool::Acquire(size_t size)
+{
+    auto pool = Local();
+    void *block = nullptr;
+    if (pool)
+    {
+        block = pool->Allocate(size);
+    }
+    else
+    {
+        int index = ClassIndex(size);
+        block = ::malloc(index < 0 ? size : (index + 1) * kSlabAlign);
+    }
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void SlabPool::Recycle(void *block, size_t size)
+{
+    auto pool = Local();
+    if (!pool)
+    {
+        ::free(block);
+        return;
+    }
+    pool->Release(block, size);
+}
+
+void *SlabPool::Allocate(size_t size)
+{
+    int index = ClassIndex(size);
+    // 超过最大块大小，直接向系统申请
+    if (index < 0)
+    {
+        return ::malloc(size);
+    }
+
+    // 池里有空闲的，直接复用
+    auto node = free_lists_[index];
+    if (node)
+    {
+        free_lists_[index] = node->next;
+        counts_[index]--;
+        cached_blocks_--;
+        reused_++;
+        return node;
+    }
+    // 按级别的大小申请，归还后可以给同级别的其他对象复用
+    return ::malloc((index + 1) * kSlabAlign);
+}
+
+void SlabPool::Release(void *block, size_t size)
+{
+    if (!block)
+    {
+        return;
+    }
+    int index = ClassIndex(size);
+    // 不是池里的级别，或者这一级已经缓存够多了，直接还给系统
+    if (index < 0 || (counts_[index] + 1) * (index + 1) * kSlabAlign > kSlabClassBytes)
+    {
+        ::free(block);
+        return;
+    }
+    auto node = static_cast<FreeNode *>(block);
+    node->next = free_lists_[index];
+    free_lists_[index] = node;
+    counts_[index]++;
+    cached_blocks_++;
+}
+
+size_t SlabPool::CachedBlocks() const
+{
+    return cached_blocks_;
+}
+
+uint64_t SlabPool::Reused() const
+{
+    return reused_;
+}
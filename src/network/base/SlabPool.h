@@ -0,0 +1,129 @@
+#pragma once
+/*
+    连接对象和它固定附带的小对象（超时节点、发送节点等）使用的定长内存块池
+    每个线程一个池，事件循环线程上创建和销毁连接都走自己线程的池，不需要加锁
+    块大小按 16 字节对齐分级，最大 2KB，超过的直接走系统分配
+    每个内存块单独向系统申请，空闲时挂在所属级别的单向链表上，所以在别的线程释放也是安全的，
+    只是会进入释放线程的池里
+    每一级缓存的总字节数有上限，超出上限的直接还给系统
+*/
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include "base/NonCopyable.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        // 分级的粒度
+        const size_t kSlabAlign = 16;
+        // 最大的块大小
+        const size_t kSlabMaxBlock = 2048;
+        // 每一级最多缓存的字节数
+        const size_t kSlabClassBytes = 256 * 1024;
+
+        class SlabPool : public base::NonCopyable
+        {
+        public:
+            SlabPool();
+            ~SlabPool();
+
+            // 返回当前线程的池，线程退出、池已经析构后返回 nullptr
+            static SlabPool *Local();
+
+            // 从当前线程的池里申请 size 字节，池不可用时直接向系统申请
+            static void *Acquire(size_t size);
+
+            // 把内存还给当前线程的池，size 必须和申请时相同，池不可用时直接还给系统
+            static void Recycle(void *block, size_t size);
+
+            // 申请 size 字节的内存块
+            void *Allocate(size_t size);
+
+            // 归还内存块
+            void Release(void *block, size_t size);
+
+            // 池里缓存的内存块个数
+            size_t CachedBlocks() const;
+
+            // 从池里复用的次数
+            uint64_t Reused() const;
+
+        private:
+            // 空闲块的链表节点，直接放在空闲块的内存里
+            struct FreeNode
+            {
+                FreeNode *next{nullptr};
+            };
+
+            // 每一级的空闲链表
+            FreeNode *free_lists_[kSlabMaxBlock / kSlabAlign];
+
+            // 每一级缓存的块数
+            size_t counts_[kSlabMaxBlock / kSlabAlign];
+
+            // 池里缓存的总块数
+            size_t cached_blocks_{0};
+
+            // 从池里复用的次数
+            uint64_t reused_{0};
+        };
+
+        // 使用 SlabPool 的分配器，配合 std::allocate_shared 使用，对象和控制块在同一个内存块里
+        template <typename T>
+        class SlabAllocator
+        {
+        public:
+            using value_type = T;
+
+            SlabAllocator() = default;
+
+            template <typename U>
+            SlabAllocator(const SlabAllocator<U> &)
+            {
+            }
+
+            T *allocate(size_t n)
+            {
+                // 一次只申请一个对象时才走池，数组直接走系统分配
+                if (n == 1)
+                {
+                    return static_cast<T *>(SlabPool::Acquire(sizeof(T)));
+                }
+                return static_cast<T *>(::operator new(n * sizeof(T)));
+            }
+
+            void deallocate(T *p, size_t n)
+            {
+                if (n == 1)
+                {
+                    SlabPool::Recycle(p, sizeof(T));
+                    return;
+                }
+                ::operator delete(p);
+            }
+        };
+
+        template <typename T, typename U>
+        bool operator==(const SlabAllocator<T> &, const SlabAllocator<U> &)
+        {
+            return true;
+        }
+
+        template <typename T, typename U>
+        bool operator!=(const SlabAllocator<T> &, const SlabAllocator<U> &)
+        {
+            return false;
+        }
+
+        // 替代 std::make_shared，对象和控制块从当前线程的池里申请
+        template <typename T, typename... Args>
+        std::shared_ptr<T> MakeSlabShared(Args &&...args)
+        {
+            return std::allocate_shared<T>(SlabAllocator<T>(), std::forward<Args>(args)...);
+        }
+    }
+}
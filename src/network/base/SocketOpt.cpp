@@ -1,8 +1,33 @@
+#include <cstring>
+#include <ctime>
+#include <netinet/udp.h>
+#include <linux/net_tstamp.h>
 #include "SocketOpt.h"
 #include "Network.h"
 
 using namespace tmms::network;
 
+namespace
+{
+    // glibc 的 tcp_info 只到 tcpi_total_retrans，内核后面追加的字段按内核 ABI 接在后面
+    // 内核只会在末尾追加字段，getsockopt 返回的长度不够时，后面的字段保持为 0
+    struct TcpInfoExt
+    {
+        struct tcp_info base;
+        uint64_t pacing_rate;
+        uint64_t max_pacing_rate;
+        uint64_t bytes_acked;
+        uint64_t bytes_received;
+        uint32_t segs_out;
+        uint32_t segs_in;
+        uint32_t notsent_bytes;
+        uint32_t min_rtt;
+        uint32_t data_segs_in;
+        uint32_t data_segs_out;
+        uint64_t delivery_rate;
+    };
+}
+
 SocketOpt::SocketOpt(int sock, bool v6) : sock_(sock), is_v6_(v6)
 {
 }
@@ -34,20 +59,10 @@ int SocketOpt::CreateNonblockingUdpSocket(int family)
 //  服务端将 socke绑定到一个本地 IP 地址和端口（localaddr）上
 int SocketOpt::BindAddress(const InetAddress &localaddr)
 {
-    if (localaddr.IsIpV6())
-    {
-        struct sockaddr_in6 addr;
-        localaddr.GetSockAddr((struct sockaddr *)&addr);
-        socklen_t size = sizeof(struct sockaddr_in6);
-        return ::bind(sock_, (struct sockaddr *)&addr, size);
-    }
-    else
-    {
-        struct sockaddr_in addr;
-        localaddr.GetSockAddr((struct sockaddr *)&addr);
-        socklen_t size = sizeof(struct sockaddr_in);
-        return ::bind(sock_, (struct sockaddr *)&addr, size);
-    }
+    // InetAddress 内部保存的就是二进制地址，直接使用
+    struct sockaddr_in6 addr;
+    localaddr.GetSockAddr((struct sockaddr *)&addr);
+    return ::bind(sock_, (struct sockaddr *)&addr, localaddr.IsIpV6() ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
 }
 
 // 服务端监听
@@ -71,28 +86,8 @@ int SocketOpt::Accept(InetAddress *peeraddr)
     int sock = ::accept4(sock_, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
     if (sock > 0)
     {
-        // 如果是IPV4
-        if (addr.sin6_family == AF_INET)
-        {
-            char ip[16] = {0};
-            struct sockaddr_in *saddr = (struct sockaddr_in *)&addr;
-            // 将二进制的网络格式 IP 地址，转换回人类可读的字符串格式
-            ::inet_ntop(AF_INET, &(saddr->sin_addr.s_addr), ip, sizeof(ip)); 
-            peeraddr->SetAddr(ip);
-            // saddr->sin_port: 从 sockaddr_in 结构体中取出端口号。这个值是内核给我们的，它是网络字节序的！
-            // ntohs(saddr->sin_port):网络字节序转换回当前计算机可以正常计算和显示的主机字节序
-            peeraddr->SetPort(ntohs(saddr->sin_port));
-        }
-        else if (addr.sin6_family == AF_INET6)
-        {
-            char ip[INET6_ADDRSTRLEN] = {
-                0,
-            };
-            ::inet_ntop(AF_INET6, &(addr.sin6_addr), ip, sizeof(ip));
-            peeraddr->SetAddr(ip);
-            peeraddr->SetPort(ntohs(addr.sin6_port));
-            peeraddr->SetIsIPV6(true);
-        }
+        // 直接保存二进制地址，需要文本时再格式化，每个连接不用再分配字符串
+        peeraddr->SetSockAddr((struct sockaddr *)&addr, len);
     }
     return sock;
 }
@@ -112,26 +107,7 @@ InetAddressPtr SocketOpt::GetLocalAddr()
     socklen_t len = sizeof(struct sockaddr_in6);
     // 查到的结果会存储在 addr_in 中
     ::getsockname(sock_, (struct sockaddr *)&addr_in, &len);
-    InetAddressPtr peeraddr = std::make_shared<InetAddress>();
-    // 根据 addr_in 的地址族（IPv4 或 IPv6）来设置 InetAddress 对象的 IP 地址和端口号
-    if (addr_in.sin6_family == AF_INET)
-    {
-        char ip[16] = {0};
-        struct sockaddr_in *saddr = (struct sockaddr_in *)&addr_in;
-        ::inet_ntop(AF_INET, &(saddr->sin_addr.s_addr), ip, sizeof(ip));
-        peeraddr->SetAddr(ip);
-        peeraddr->SetPort(ntohs(saddr->sin_port));
-    }
-    else if (addr_in.sin6_family == AF_INET6)
-    {
-        char ip[INET6_ADDRSTRLEN] = {
-            0,
-        };
-        ::inet_ntop(AF_INET6, &(addr_in.sin6_addr), ip, sizeof(ip));
-        peeraddr->SetAddr(ip);
-        peeraddr->SetPort(ntohs(addr_in.sin6_port));
-        peeraddr->SetIsIPV6(true);
-    }
+    InetAddressPtr peeraddr = std::make_shared<InetAddress>((struct sockaddr *)&addr_in, len);
     return peeraddr;
 }
 
@@ -141,25 +117,7 @@ InetAddressPtr SocketOpt::GetPeerAddr()
     struct sockaddr_in6 addr_in;
     socklen_t len = sizeof(struct sockaddr_in6);
     ::getpeername(sock_, (struct sockaddr *)&addr_in, &len);
-    InetAddressPtr peeraddr = std::make_shared<InetAddress>();
-    if (addr_in.sin6_family == AF_INET)
-    {
-        char ip[16] = {0};
-        struct sockaddr_in *saddr = (struct sockaddr_in *)&addr_in;
-        ::inet_ntop(AF_INET, &(saddr->sin_addr.s_addr), ip, sizeof(ip));
-        peeraddr->SetAddr(ip);
-        peeraddr->SetPort(ntohs(saddr->sin_port));
-    }
-    else if (addr_in.sin6_family == AF_INET6)
-    {
-        char ip[INET6_ADDRSTRLEN] = {
-            0,
-        };
-        ::inet_ntop(AF_INET6, &(addr_in.sin6_addr), ip, sizeof(ip));
-        peeraddr->SetAddr(ip);
-        peeraddr->SetPort(ntohs(addr_in.sin6_port));
-        peeraddr->SetIsIPV6(true);
-    }
+    InetAddressPtr peeraddr = std::make_shared<InetAddress>((struct sockaddr *)&addr_in, len);
     return peeraddr;
 }
 
@@ -220,4 +178,103 @@ void SocketOpt::SetNonBlocking(bool on)
     }
 
     ::fcntl(sock_, F_SETFL, flag);
-}
\ No newline at end of file
+}
+
+// 设置 TCP_NOTSENT_LOWAT
+void SocketOpt::SetTcpNotSentLowat(uint32_t bytes)
+{
+    int optvalue = static_cast<int>(bytes);
+    ::setsockopt(sock_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &optvalue, sizeof(optvalue));
+}
+
+// 设置 SO_MAX_PACING_RATE
+bool SocketOpt::SetMaxPacingRate(uint64_t rate)
+{
+#ifdef SO_MAX_PACING_RATE
+    // 4.20 以后的内核接受 64 位的值，老内核只认 32 位
+    if (::setsockopt(sock_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) == 0)
+    {
+        return true;
+    }
+    uint32_t rate32 = rate > 0xffffffffu ? 0xffffffffu : static_cast<uint32_t>(rate);
+    return ::setsockopt(sock_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate32, sizeof(rate32)) == 0;
+#else
+    return false;
+#endif
+}
+
+// 读取 SO_INCOMING_CPU
+int SocketOpt::GetIncomingCpu()
+{
+#ifdef SO_INCOMING_CPU
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (::getsockopt(sock_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0)
+    {
+        return -1;
+    }
+    return cpu;
+#else
+    return -1;
+#endif
+}
+
+// 设置 SO_INCOMING_CPU
+bool SocketOpt::SetIncomingCpu(int cpu)
+{
+#ifdef SO_INCOMING_CPU
+    return ::setsockopt(sock_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == 0;
+#else
+    return false;
+#endif
+}
+
+// 设置 UDP_GRO
+bool SocketOpt::SetUdpGro(bool on)
+{
+#ifdef UDP_GRO
+    int optvalue = on ? 1 : 0;
+    return ::setsockopt(sock_, SOL_UDP, UDP_GRO, &optvalue, sizeof(optvalue)) == 0;
+#else
+    return false;
+#endif
+}
+
+// 设置 SO_TXTIME，并要求内核把丢弃的数据报报告到错误队列
+bool SocketOpt::SetTxTime(clockid_t clockid)
+{
+#ifdef SO_TXTIME
+    struct sock_txtime cfg;
+    memset(&cfg, 0x00, sizeof(cfg));
+    cfg.clockid = clockid;
+    cfg.flags = SOF_TXTIME_REPORT_ERRORS;
+    return ::setsockopt(sock_, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) == 0;
+#else
+    return false;
+#endif
+}
+
+// 读取 TCP_INFO
+bool SocketOpt::GetTcpInfo(TcpInfo *info)
+{
+    struct TcpInfoExt ext;
+    memset(&ext, 0x00, sizeof(ext));
+    socklen_t len = sizeof(ext);
+    if (::getsockopt(sock_, IPPROTO_TCP, TCP_INFO, &ext, &len) < 0)
+    {
+        return false;
+    }
+
+    info->rtt_us = ext.base.tcpi_rtt;
+    info->rttvar_us = ext.base.tcpi_rttvar;
+    info->min_rtt_us = ext.min_rtt;
+    info->snd_cwnd = ext.base.tcpi_snd_cwnd;
+    info->snd_mss = ext.base.tcpi_snd_mss;
+    info->unacked = ext.base.tcpi_unacked;
+    info->lost = ext.base.tcpi_lost;
+    info->total_retrans = ext.base.tcpi_total_retrans;
+    info->notsent_bytes = ext.notsent_bytes;
+    info->delivery_rate = ext.delivery_rate;
+    info->pacing_rate = ext.pacing_rate;
+    return true;
+}
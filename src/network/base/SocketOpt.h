@@ -11,11 +11,29 @@
 #include <sys/types.h> 
 #include <unistd.h>
 #include <fcntl.h>
+#include <ctime>
 #include <memory>
 
 namespace tmms{
     namespace network{
         using InetAddressPtr = std::shared_ptr<InetAddress>;
+
+        // TCP_INFO 里和发送拥塞相关的字段，rtt 单位：微秒，速率单位：字节/秒
+        // 内核较老时拿不到的字段为 0
+        struct TcpInfo
+        {
+            uint32_t rtt_us{0};             // 平滑后的 RTT
+            uint32_t rttvar_us{0};          // RTT 的抖动
+            uint32_t min_rtt_us{0};         // 最小 RTT
+            uint32_t snd_cwnd{0};           // 拥塞窗口，单位：报文段
+            uint32_t snd_mss{0};            // 发送方向的 MSS
+            uint32_t unacked{0};            // 已发送未确认的报文段数
+            uint32_t lost{0};               // 认为丢失的报文段数
+            uint32_t total_retrans{0};      // 累计重传的报文段数
+            uint32_t notsent_bytes{0};      // 内核发送缓冲区里还没发出去的字节数
+            uint64_t delivery_rate{0};      // 最近的交付速率
+            uint64_t pacing_rate{0};        // 内核的发送节奏速率
+        };
         class SocketOpt{
         public:
             SocketOpt(int sock, bool v6=false);
@@ -43,6 +61,33 @@ namespace tmms{
             void SetReusePort(bool on);
             void SetKeepAlive(bool on);
             void SetNonBlocking(bool on);
+
+            // 限制内核发送缓冲区里未发送的字节数，超过后套接字不再可写，让数据留在用户态，便于上层丢帧
+            void SetTcpNotSentLowat(uint32_t bytes);
+
+            // 读取 TCP_INFO，成功返回 true
+            bool GetTcpInfo(TcpInfo *info);
+
+            // 设置 SO_MAX_PACING_RATE，由内核（fq 队列规则或 TCP 内部限速）按速率发送，单位：字节/秒
+            // 内核不支持时返回 false
+            bool SetMaxPacingRate(uint64_t rate);
+
+            // 读取 SO_INCOMING_CPU，返回最近一次在哪个 CPU 上处理这个套接字的收包软中断，失败返回 -1
+            int GetIncomingCpu();
+
+            // 设置 SO_INCOMING_CPU，同一个 SO_REUSEPORT 组里，内核优先把这个 CPU 上收到的包交给这个套接字
+            bool SetIncomingCpu(int cpu);
+
+            // 设置 UDP_GRO，开启后内核把同一个流的连续数据报合并成一个大数据报交给用户态，
+            // 每个数据报的大小通过 UDP_GRO 控制消息给出，内核不支持时返回 false
+            bool SetUdpGro(bool on);
+
+            // 开启 SO_TXTIME，之后每个数据报可以用 SCM_TXTIME 控制消息带上发送时间（clockid 时钟的纳秒），
+            // 由出口的 fq 或者 etf 队列规则到时间再发出，内核没有关闭的方法，不带控制消息的数据报照常立即发送
+            // fq 只认 CLOCK_MONOTONIC；etf 要和队列规则配置的时钟一致，一般是 CLOCK_TAI，非单调时钟需要 CAP_NET_ADMIN
+            // 同时开启错误报告：发送时间已经错过或者参数不对时，etf 丢掉数据报并在错误队列里报告，而不是悄悄丢弃
+            // 内核不支持时返回 false
+            bool SetTxTime(clockid_t clockid = CLOCK_MONOTONIC);
         
         private:
             int sock_{-1};
@@ -0,0 +1,109 @@
+#include <time.h>
+#include "TokenBucket.h"
+
+using namespace tmms::network;
+
+namespace
+{
+    // 单调时钟，单位：微秒，不受系统时间调整影响
+    int64_t MonotonicUS()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+}
+
+TokenBucket::TokenBucket(uint64_t rate, uint64_t burst)
+{
+    SetRate(rate, burst);
+    // 刚创建时桶是满的，新连接可以先发一个突发量
+    tokens_ = static_cast<double>(burst_);
+}
+
+// 修改速率和容量
+void TokenBucket::SetRate(uint64_t rate, uint64_t burst)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    RefillLocked();
+    rate_ = rate;
+    burst_ = burst > 0 ? burst : rate / 10;
+    // 容量至少一个 MSS，否则低速率时一个报文都发不出去
+    if (rate_ > 0 && burst_ < 1460)
+    {
+        burst_ = 1460;
+    }
+    if (tokens_ > burst_)
+    {
+        tokens_ = static_cast<double>(burst_);
+    }
+}
+
+// 返回速率
+uint64_t TokenBucket::Rate()
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    return rate_;
+}
+
+// 取走最多 want 个令牌
+size_t TokenBucket::Take(size_t want)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    if (rate_ == 0)
+    {
+        return want;
+    }
+    RefillLocked();
+    size_t got = tokens_ >= want ? want : static_cast<size_t>(tokens_);
+    tokens_ -= got;
+    return got;
+}
+
+// 没用完的令牌还回桶里
+void TokenBucket::Refund(size_t bytes)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    if (rate_ == 0)
+    {
+        return;
+    }
+    tokens_ += bytes;
+    if (tokens_ > burst_)
+    {
+        tokens_ = static_cast<double>(burst_);
+    }
+}
+
+// 攒够 bytes 个令牌还要等多少毫秒
+int64_t TokenBucket::WaitMs(size_t bytes)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    if (rate_ == 0)
+    {
+        return 1;
+    }
+    RefillLocked();
+    double need = static_cast<double>(bytes > burst_ ? burst_ : bytes) - tokens_;
+    if (need <= 0)
+    {
+        return 1;
+    }
+    int64_t ms = static_cast<int64_t>(need * 1000 / rate_) + 1;
+    return ms;
+}
+
+// 按流逝的时间补充令牌
+void TokenBucket::RefillLocked()
+{
+    int64_t now = MonotonicUS();
+    if (last_us_ > 0 && now > last_us_ && rate_ > 0)
+    {
+        tokens_ += static_cast<double>(now - last_us_) * rate_ / 1000000;
+        if (tokens_ > burst_)
+        {
+            tokens_ = static_cast<double>(burst_);
+        }
+    }
+    last_us_ = now;
+}
@@ -0,0 +1,56 @@
+#pragma once
+/*
+    令牌桶，用于发送限速
+    rate 为每秒产生的令牌数（字节），burst 为桶的容量，决定一次最多能突发多少字节
+    一个连接自己用一个桶做单连接限速；多个连接共用一个桶就是按流或者按租户的组限速
+    组里的连接可能分布在不同的事件循环线程上，所以桶内部加锁
+*/
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "base/NonCopyable.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        class TokenBucket : public base::NonCopyable
+        {
+        public:
+            // rate 单位：字节/秒，0 表示不限速；burst 单位：字节，0 表示取 rate 的十分之一（100ms 的量）
+            TokenBucket(uint64_t rate, uint64_t burst = 0);
+
+            // 修改速率和容量，已有的令牌超过新容量的部分丢弃
+            void SetRate(uint64_t rate, uint64_t burst = 0);
+
+            // 返回速率，单位：字节/秒
+            uint64_t Rate();
+
+            // 取走最多 want 个令牌，返回实际取到的个数，不限速时全部给
+            size_t Take(size_t want);
+
+            // 取到的令牌没用完（比如写到 EAGAIN），还回桶里
+            void Refund(size_t bytes);
+
+            // 攒够 bytes 个令牌还要等多少毫秒，bytes 超过容量时按容量算，至少 1 毫秒
+            int64_t WaitMs(size_t bytes);
+
+        private:
+            // 按流逝的时间补充令牌，调用时必须持有锁
+            void RefillLocked();
+
+            std::mutex lock_;
+            // 速率，单位：字节/秒
+            uint64_t rate_{0};
+            // 桶的容量，单位：字节
+            uint64_t burst_{0};
+            // 当前的令牌数，用浮点数保留不足一个字节的部分，低速率时也不会因为取整而停住
+            double tokens_{0};
+            // 上一次补充令牌的时间，单位：微秒
+            int64_t last_us_{0};
+        };
+
+        using TokenBucketPtr = std::shared_ptr<TokenBucket>;
+    }
+}
@@ -0,0 +1,73 @@
+#include <time.h>
+#include "UdpPacer.h"
+
+using namespace tmms::network;
+
+UdpPacer::UdpPacer(uint64_t rate)
+    : rate_(rate)
+{
+}
+
+// 修改目标码率
+void UdpPacer::SetRate(uint64_t rate)
+{
+    rate_ = rate;
+}
+
+uint64_t UdpPacer::Rate() const
+{
+    return rate_;
+}
+
+// 计算下一个数据报的发送时间
+uint64_t UdpPacer::Next(size_t size, int64_t media_ts)
+{
+    uint64_t now = NowNs();
+    // 空闲之后不攒发送额度，从现在开始算
+    uint64_t when = next_ns_ > now ? next_ns_ : now;
+
+    if (media_ts >= 0)
+    {
+        // 第一个时间戳，或者时间戳往回跳、往前跳太多，用现在的时间重新对齐
+        if (!anchored_ || media_ts < base_ts_ ||
+            base_ns_ + (uint64_t)(media_ts - base_ts_) * 1000000 > now + (uint64_t)kUdpPacerMaxLeadMs * 1000000)
+        {
+            anchored_ = true;
+            base_ts_ = media_ts;
+            base_ns_ = now;
+        }
+        // 时间戳落后于现在说明帧来晚了，不再等，只按码率排
+        uint64_t media_ns = base_ns_ + (uint64_t)(media_ts - base_ts_) * 1000000;
+        if (media_ns > when)
+        {
+            when = media_ns;
+        }
+    }
+
+    // 排得太靠后时不再往后推，延迟封顶，多出来的码率直接发出
+    uint64_t limit = now + (uint64_t)kUdpPacerMaxDelayMs * 1000000;
+    if (when > limit)
+    {
+        when = limit;
+    }
+    if (rate_ > 0)
+    {
+        next_ns_ = when + (uint64_t)size * 1000000000 / rate_;
+    }
+    return when;
+}
+
+// 媒体时间戳重新对齐
+void UdpPacer::Reset()
+{
+    anchored_ = false;
+    next_ns_ = 0;
+}
+
+// 单调时钟，和 SO_TXTIME 设置的时钟一致
+uint64_t UdpPacer::NowNs()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
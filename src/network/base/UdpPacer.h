@@ -0,0 +1,51 @@
+#pragma once
+/*
+    UDP 媒体流的发送时间计算
+    一帧视频打成几十个数据报后一起交给套接字，直接发出就是一个突发，浅缓存的交换机会丢包
+    这里给每个数据报算一个发送时间：按媒体时间戳映射到本地时钟，同一帧的数据报再按目标码率依次错开
+    发送时间交给 UdpSocket::SendAt，由内核的 SO_TXTIME 或者用户态定时器在那个时间发出
+    只做计算不加锁，一个流一个，在发送线程里使用
+*/
+#include <cstddef>
+#include <cstdint>
+
+namespace tmms
+{
+    namespace network
+    {
+        // 媒体时间戳相对本地时钟最多提前多少，超过时认为时间戳跳变，重新对齐，单位：毫秒
+        const int64_t kUdpPacerMaxLeadMs = 1000;
+        // 发送时间最多比现在晚多少，码率长期超过目标时不再继续往后排，单位：毫秒
+        const int64_t kUdpPacerMaxDelayMs = 500;
+
+        class UdpPacer
+        {
+        public:
+            // rate 单位：字节/秒，和 TcpConnection::SetPacing 一致，0 表示只按媒体时间戳
+            explicit UdpPacer(uint64_t rate = 0);
+
+            // 修改目标码率，单位：字节/秒
+            void SetRate(uint64_t rate);
+            uint64_t Rate() const;
+
+            // 返回下一个 size 字节的数据报的发送时间，单位：CLOCK_MONOTONIC 纳秒
+            // media_ts 是数据报所属帧的媒体时间戳，单位：毫秒，小于 0 表示没有时间戳，只按码率错开
+            uint64_t Next(size_t size, int64_t media_ts = -1);
+
+            // 媒体时间戳重新对齐，流切换或者断流重连之后调用
+            void Reset();
+
+            // 当前的单调时钟，单位：纳秒
+            static uint64_t NowNs();
+
+        private:
+            uint64_t rate_{0};
+            // 按码率算出的下一个数据报最早的发送时间
+            uint64_t next_ns_{0};
+            // 媒体时间戳和本地时钟的对应关系
+            bool anchored_{false};
+            int64_t base_ts_{0};
+            uint64_t base_ns_{0};
+        };
+    }
+}
@@ -0,0 +1,248 @@
+#include "FecDecoder.h"
+#include "network/fec/FecXor.h"
+#include "network/base/SeqNumber.h"
+
+using namespace tmms::network;
+
+FecDecoder::FecDecoder(size_t window)
+    : window_(window > 0 ? window : kFecDefaultWindow)
+{
+}
+
+void FecDecoder::SetMessageCallback(const FecMessageCallback &cb)
+{
+    message_cb_ = cb;
+}
+
+void FecDecoder::SetMessageCallback(FecMessageCallback &&cb)
+{
+    message_cb_ = std::move(cb);
+}
+
+// 收到一个 FEC 层的报文
+void FecDecoder::Input(const char *data, size_t size)
+{
+    auto type = FecPacket::Type(data, size);
+    if (type == kFecSource)
+    {
+        uint32_t wire_seq = 0;
+        if (!FecPacket::DecodeSource(data, size, &wire_seq))
+        {
+            return;
+        }
+        source_packets_++;
+        uint64_t seq = UnwrapSeq(wire_seq, max_seq_);
+        MaybeResync(seq);
+        if (started_ && seq + window_ <= max_seq_)
+        {
+            // 已经移出窗口，分不清是不是恢复过的，不再交付
+            late_++;
+            return;
+        }
+        if (sources_.find(seq) != sources_.end())
+        {
+            // 恢复过，或者重复的包
+            return;
+        }
+        if (!started_ || seq > max_seq_)
+        {
+            max_seq_ = seq;
+            started_ = true;
+        }
+        Deliver(seq, data + kFecSourceHeaderSize, size - kFecSourceHeaderSize);
+    }
+    else if (type == kFecRowParity || type == kFecColumnParity)
+    {
+        FecParityHeader header;
+        if (!FecPacket::DecodeParity(data, size, &header))
+        {
+            return;
+        }
+        parity_packets_++;
+        // 保护的范围比窗口还大，组里前面的包等不到校验包就移出窗口了，这样的校验包用不上
+        if ((uint64_t)header.count * header.stride > window_)
+        {
+            return;
+        }
+        ParityPacket parity;
+        parity.base = UnwrapSeq(header.base, max_seq_);
+        MaybeResync(parity.base);
+        parity.count = header.count;
+        parity.stride = header.stride;
+        parity.length_xor = header.length_xor;
+        parity.payload.assign(data + kFecParityHeaderSize, size - kFecParityHeaderSize);
+        uint64_t last = parity.base + (uint64_t)(parity.count - 1) * parity.stride;
+        if (!started_ || last > max_seq_)
+        {
+            // 组里最后面的包都丢了，按校验包推进窗口
+            max_seq_ = last;
+            started_ = true;
+        }
+        if (!TryRecover(parity))
+        {
+            parities_.emplace_back(std::move(parity));
+            return;
+        }
+    }
+    else
+    {
+        return;
+    }
+    RecoverAll();
+    Evict();
+}
+
+uint64_t FecDecoder::SourcePackets() const
+{
+    return source_packets_;
+}
+
+uint64_t FecDecoder::ParityPackets() const
+{
+    return parity_packets_;
+}
+
+uint64_t FecDecoder::Recovered() const
+{
+    return recovered_;
+}
+
+uint64_t FecDecoder::Late() const
+{
+    return late_;
+}
+
+uint64_t FecDecoder::Resyncs() const
+{
+    return resyncs_;
+}
+
+// 保存并交付一个源包
+void FecDecoder::Deliver(uint64_t seq, const char *data, size_t size)
+{
+    sources_[seq].assign(data, size);
+    if (message_cb_)
+    {
+        message_cb_(data, size);
+    }
+}
+
+// 尝试用一个校验包恢复
+bool FecDecoder::TryRecover(const ParityPacket &parity)
+{
+    uint64_t missing = 0;
+    int32_t missing_count = 0;
+    for (uint8_t i = 0; i < parity.count; i++)
+    {
+        uint64_t seq = parity.base + (uint64_t)i * parity.stride;
+        if (sources_.find(seq) == sources_.end())
+        {
+            missing = seq;
+            if (++missing_count > 1)
+            {
+                return false;
+            }
+        }
+    }
+    if (missing_count == 0)
+    {
+        return true;
+    }
+    // 窗口之外的包已经不需要了
+    if (missing + window_ <= max_seq_)
+    {
+        return true;
+    }
+
+    // 校验负载和其他包逐个异或，剩下的就是缺的那个包
+    recover_buf_.assign(parity.payload);
+    uint16_t length = parity.length_xor;
+    for (uint8_t i = 0; i < parity.count; i++)
+    {
+        uint64_t seq = parity.base + (uint64_t)i * parity.stride;
+        if (seq == missing)
+        {
+            continue;
+        }
+        auto &src = sources_[seq];
+        if (src.size() > recover_buf_.size())
+        {
+            // 校验包比组里的包短，报文有问题
+            return true;
+        }
+        FecXor(&recover_buf_[0], src.data(), src.size());
+        length ^= (uint16_t)src.size();
+    }
+    if (length > recover_buf_.size())
+    {
+        return true;
+    }
+    recovered_++;
+    Deliver(missing, recover_buf_.data(), length);
+    return true;
+}
+
+// 恢复出一个包之后，别的组可能也只缺一个了
+void FecDecoder::RecoverAll()
+{
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        for (auto it = parities_.begin(); it != parities_.end();)
+        {
+            auto before = recovered_;
+            if (TryRecover(*it))
+            {
+                it = parities_.erase(it);
+                progress = progress || recovered_ != before;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
+
+// 移出窗口之外的源包和校验包
+void FecDecoder::Evict()
+{
+    if (max_seq_ < window_)
+    {
+        return;
+    }
+    uint64_t low = max_seq_ - window_ + 1;
+    sources_.erase(sources_.begin(), sources_.lower_bound(low));
+    for (auto it = parities_.begin(); it != parities_.end();)
+    {
+        if (it->base + (uint64_t)(it->count - 1) * it->stride < low)
+        {
+            it = parities_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+// 和 RUDP 的最大空洞一样：序号往前跳得太远，或者落后太多（发送端重启后从 0 开始），
+// 窗口里的包和新的包已经没有关系，全部丢掉，从这个序号重新开始，否则新的源包都会被当成太晚到达
+void FecDecoder::MaybeResync(uint64_t seq)
+{
+    if (!started_)
+    {
+        return;
+    }
+    uint64_t gap = (uint64_t)window_ * kFecMaxGapWindows;
+    if (seq <= max_seq_ + gap && seq + gap >= max_seq_)
+    {
+        return;
+    }
+    sources_.clear();
+    parities_.clear();
+    max_seq_ = seq;
+    started_ = false;
+    resyncs_++;
+}
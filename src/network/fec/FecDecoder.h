@@ -0,0 +1,87 @@
+#pragma once
+/*
+    FEC 解码：放在 UdpSocket 的接收回调和解包器之间
+    源包去掉源包头立即交付，同时留在窗口里；校验包保存到它保护的包都到齐或者移出窗口
+    一组里只缺一个包时用校验包和其他包异或恢复出来，恢复出的包又可能让别的组只缺一个，反复直到没有进展
+    恢复出的包交付时可能已经落后于后面的包，顺序由上层（比如 RTP 的抖动缓冲）按自己的序号整理
+    不加锁，在同一个线程里使用
+*/
+#include <functional>
+#include <list>
+#include <map>
+#include <string>
+#include "network/fec/FecPacket.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        // 交付一个媒体包，data 只在回调期间有效
+        using FecMessageCallback = std::function<void(const char *data, size_t size)>;
+
+        // 默认的窗口大小，单位：源包个数，要大于一个块
+        const size_t kFecDefaultWindow = 1024;
+        // 新序号离收到过的最大序号超过这么多个窗口时重新同步，前后都算：发送端重启后从 0 重新编号，或者长时间断开
+        const size_t kFecMaxGapWindows = 4;
+
+        class FecDecoder
+        {
+        public:
+            explicit FecDecoder(size_t window = kFecDefaultWindow);
+
+            // 设置交付回调
+            void SetMessageCallback(const FecMessageCallback &cb);
+            void SetMessageCallback(FecMessageCallback &&cb);
+
+            // 收到一个 FEC 层的报文
+            void Input(const char *data, size_t size);
+
+            // 收到的源包、校验包，恢复的源包，太晚到达丢弃的源包
+            uint64_t SourcePackets() const;
+            uint64_t ParityPackets() const;
+            uint64_t Recovered() const;
+            uint64_t Late() const;
+            // 重新同步的次数
+            uint64_t Resyncs() const;
+
+        private:
+            // 一个还没用完的校验包
+            struct ParityPacket
+            {
+                uint64_t base{0};
+                uint8_t count{0};
+                uint16_t stride{0};
+                uint16_t length_xor{0};
+                std::string payload;
+            };
+
+            // 保存并交付一个源包
+            void Deliver(uint64_t seq, const char *data, size_t size);
+            // 尝试用一个校验包恢复，返回这个校验包是否已经用完（组里的包都齐了，或者恢复了缺的那个）
+            bool TryRecover(const ParityPacket &parity);
+            // 反复尝试所有校验包，直到没有进展
+            void RecoverAll();
+            // 移出窗口之外的源包和校验包
+            void Evict();
+            // 序号离窗口太远时丢掉窗口里的所有包，从这个序号重新开始
+            void MaybeResync(uint64_t seq);
+
+            size_t window_{kFecDefaultWindow};
+            FecMessageCallback message_cb_;
+            // 收到和恢复的源包
+            std::map<uint64_t, std::string> sources_;
+            std::list<ParityPacket> parities_;
+            // 收到过的最大序号
+            uint64_t max_seq_{0};
+            bool started_{false};
+            // 恢复时用的缓冲区
+            std::string recover_buf_;
+
+            uint64_t source_packets_{0};
+            uint64_t parity_packets_{0};
+            uint64_t recovered_{0};
+            uint64_t late_{0};
+            uint64_t resyncs_{0};
+        };
+    }
+}
@@ -0,0 +1,157 @@
+#include "FecEncoder.h"
+#include <cstring>
+#include "network/fec/FecXor.h"
+#include "network/base/Network.h"
+
+using namespace tmms::network;
+
+FecEncoder::FecEncoder(const FecConfig &config)
+    : config_(config)
+{
+    if (config_.columns == 0)
+    {
+        config_.columns = 1;
+    }
+    row_.buf.resize(kFecParityHeaderSize + kFecMaxPayload);
+    if (config_.rows > 0)
+    {
+        columns_.resize(config_.columns);
+        for (auto &column : columns_)
+        {
+            column.buf.resize(kFecParityHeaderSize + kFecMaxPayload);
+        }
+    }
+    source_buf_.resize(kFecSourceHeaderSize + kFecMaxPayload);
+}
+
+void FecEncoder::SetOutputCallback(const FecOutputCallback &cb)
+{
+    output_cb_ = cb;
+}
+
+void FecEncoder::SetOutputCallback(FecOutputCallback &&cb)
+{
+    output_cb_ = std::move(cb);
+}
+
+// 把输出接到 UDP 套接字上
+void FecEncoder::Attach(const UdpSocketPtr &socket, const InetAddress &peer)
+{
+    output_cb_ = [socket, peer](const char *data, size_t size)
+    {
+        socket->SendCopy(data, size, peer.SockAddr(), peer.SockAddrLen());
+    };
+}
+
+// 发送一个媒体包
+bool FecEncoder::Protect(const char *data, size_t size)
+{
+    if (size > kFecMaxPayload)
+    {
+        NETWORK_WARN << " fec payload too large : " << size << " max : " << kFecMaxPayload;
+        return false;
+    }
+
+    uint32_t seq = seq_++;
+    FecPacket::EncodeSource(source_buf_.data(), seq);
+    memcpy(source_buf_.data() + kFecSourceHeaderSize, data, size);
+    source_packets_++;
+    Output(source_buf_.data(), kFecSourceHeaderSize + size);
+
+    // 在块里的位置，不发列校验时一行就是一块
+    uint32_t index = seq - block_base_;
+    uint32_t row = index / config_.columns;
+    uint32_t col = index % config_.columns;
+
+    if (config_.row_parity)
+    {
+        if (col == 0)
+        {
+            Reset(row_, seq);
+        }
+        Accumulate(row_, data, size);
+        if (col + 1 == config_.columns)
+        {
+            Flush(row_, kFecRowParity, config_.columns, 1);
+        }
+    }
+
+    if (config_.rows > 0)
+    {
+        auto &column = columns_[col];
+        if (row == 0)
+        {
+            Reset(column, seq);
+        }
+        Accumulate(column, data, size);
+        if (row + 1 == config_.rows)
+        {
+            Flush(column, kFecColumnParity, config_.rows, config_.columns);
+        }
+    }
+
+    uint32_t block_size = config_.columns * (config_.rows > 0 ? config_.rows : 1);
+    if (index + 1 == block_size)
+    {
+        block_base_ = seq_;
+    }
+    return true;
+}
+
+const FecConfig &FecEncoder::Config() const
+{
+    return config_;
+}
+
+uint64_t FecEncoder::SourcePackets() const
+{
+    return source_packets_;
+}
+
+uint64_t FecEncoder::ParityPackets() const
+{
+    return parity_packets_;
+}
+
+// 开始新的一组，只清上一组用到的长度
+void FecEncoder::Reset(Parity &parity, uint32_t base)
+{
+    memset(parity.buf.data() + kFecParityHeaderSize, 0, parity.size);
+    parity.size = 0;
+    parity.length_xor = 0;
+    parity.base = base;
+}
+
+// 比当前长度长的部分原来是 0，直接异或就等于按 0 补齐
+void FecEncoder::Accumulate(Parity &parity, const char *data, size_t size)
+{
+    FecXor(parity.buf.data() + kFecParityHeaderSize, data, size);
+    parity.length_xor ^= (uint16_t)size;
+    if (size > parity.size)
+    {
+        parity.size = size;
+    }
+}
+
+// 发出校验包
+void FecEncoder::Flush(Parity &parity, uint8_t type, uint8_t count, uint16_t stride)
+{
+    FecParityHeader header;
+    header.type = type;
+    header.count = count;
+    header.stride = stride;
+    header.length_xor = parity.length_xor;
+    header.base = parity.base;
+    FecPacket::EncodeParity(parity.buf.data(), header);
+    parity_packets_++;
+    Output(parity.buf.data(), kFecParityHeaderSize + parity.size);
+}
+
+// 把报文交给输出回调
+void FecEncoder::Output(const char *data, size_t size)
+{
+    if (output_cb_)
+    {
+        output_cb_(data, size);
+    }
+}
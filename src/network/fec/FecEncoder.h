@@ -0,0 +1,74 @@
+#pragma once
+/*
+    FEC 编码：放在打包器和 UdpSocket::Send 之间
+    每个媒体包加上源包头立即发出，同时异或进所在行和所在列的校验缓冲区，一行或者一块凑齐后发出校验包
+    接收端丢了包不用等重传的往返，凑够同一组的其他包就能恢复，适合重传赶不上延迟预算的链路
+*/
+#include <functional>
+#include <memory>
+#include <vector>
+#include "network/fec/FecPacket.h"
+#include "network/net/UdpSocket.h"
+#include "network/base/InetAddress.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        // 输出一个要发出的报文，data 只在回调期间有效
+        using FecOutputCallback = std::function<void(const char *data, size_t size)>;
+
+        class FecEncoder
+        {
+        public:
+            explicit FecEncoder(const FecConfig &config);
+
+            // 设置输出回调
+            void SetOutputCallback(const FecOutputCallback &cb);
+            void SetOutputCallback(FecOutputCallback &&cb);
+            // 把输出接到 UDP 套接字上发给 peer，源包和校验包的缓冲区都会复用，要排队时由套接字拷贝
+            void Attach(const UdpSocketPtr &socket, const InetAddress &peer);
+
+            // 发送一个媒体包，超过 kFecMaxPayload 时返回 false
+            bool Protect(const char *data, size_t size);
+
+            // 配置
+            const FecConfig &Config() const;
+            // 发出的源包和校验包个数
+            uint64_t SourcePackets() const;
+            uint64_t ParityPackets() const;
+
+        private:
+            // 一个校验包的累加缓冲区
+            struct Parity
+            {
+                std::vector<char> buf;
+                // 参与异或的最长负载
+                size_t size{0};
+                uint16_t length_xor{0};
+                uint32_t base{0};
+            };
+
+            // 开始新的一组，清掉上一组用过的部分
+            void Reset(Parity &parity, uint32_t base);
+            // 把一个负载异或进校验缓冲区
+            void Accumulate(Parity &parity, const char *data, size_t size);
+            // 发出校验包
+            void Flush(Parity &parity, uint8_t type, uint8_t count, uint16_t stride);
+            // 把报文交给输出回调
+            void Output(const char *data, size_t size);
+
+            FecConfig config_;
+            FecOutputCallback output_cb_;
+            // 下一个源包的序号和当前块的第一个序号
+            uint32_t seq_{0};
+            uint32_t block_base_{0};
+            Parity row_;
+            std::vector<Parity> columns_;
+            // 源包的发送缓冲区
+            std::vector<char> source_buf_;
+            uint64_t source_packets_{0};
+            uint64_t parity_packets_{0};
+        };
+    }
+}
@@ -0,0 +1,80 @@
+#include "FecPacket.h"
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace tmms::network;
+
+namespace
+{
+    void Put16(char *buf, uint16_t v)
+    {
+        v = htons(v);
+        memcpy(buf, &v, sizeof(v));
+    }
+
+    void Put32(char *buf, uint32_t v)
+    {
+        v = htonl(v);
+        memcpy(buf, &v, sizeof(v));
+    }
+
+    uint16_t Get16(const char *buf)
+    {
+        uint16_t v;
+        memcpy(&v, buf, sizeof(v));
+        return ntohs(v);
+    }
+
+    uint32_t Get32(const char *buf)
+    {
+        uint32_t v;
+        memcpy(&v, buf, sizeof(v));
+        return ntohl(v);
+    }
+}
+
+uint8_t FecPacket::Type(const char *buf, size_t size)
+{
+    return size > 0 ? (uint8_t)buf[0] : 0;
+}
+
+void FecPacket::EncodeSource(char *buf, uint32_t seq)
+{
+    buf[0] = (char)kFecSource;
+    buf[1] = buf[2] = buf[3] = 0;
+    Put32(buf + 4, seq);
+}
+
+bool FecPacket::DecodeSource(const char *buf, size_t size, uint32_t *seq)
+{
+    if (size < kFecSourceHeaderSize || (uint8_t)buf[0] != kFecSource)
+    {
+        return false;
+    }
+    *seq = Get32(buf + 4);
+    return true;
+}
+
+void FecPacket::EncodeParity(char *buf, const FecParityHeader &header)
+{
+    buf[0] = (char)header.type;
+    buf[1] = (char)header.count;
+    Put16(buf + 2, header.stride);
+    Put16(buf + 4, header.length_xor);
+    buf[6] = buf[7] = 0;
+    Put32(buf + 8, header.base);
+}
+
+bool FecPacket::DecodeParity(const char *buf, size_t size, FecParityHeader *header)
+{
+    if (size < kFecParityHeaderSize)
+    {
+        return false;
+    }
+    header->type = (uint8_t)buf[0];
+    header->count = (uint8_t)buf[1];
+    header->stride = Get16(buf + 2);
+    header->length_xor = Get16(buf + 4);
+    header->base = Get32(buf + 8);
+    return (header->type == kFecRowParity || header->type == kFecColumnParity) && header->count > 0 && header->stride > 0;
+}
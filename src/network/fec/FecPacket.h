@@ -0,0 +1,69 @@
+#pragma once
+/*
+    FEC 层的报文格式，所有字段都是网络字节序
+    源包：类型(1) 保留(3) 序号(4) + 媒体负载
+    校验包：类型(1) 个数(1) 间隔(2) 长度异或(2) 保留(2) 起始序号(4) + 负载异或
+    一个校验包保护 起始序号、起始序号 + 间隔、…… 共 个数 个源包：行校验的间隔是 1，列校验的间隔是列数
+    负载长度不同时短的按 0 补齐参与异或，长度本身单独异或，恢复时还原出原来的长度
+*/
+#include <cstddef>
+#include <cstdint>
+
+namespace tmms
+{
+    namespace network
+    {
+        // 报文类型
+        enum FecPacketType
+        {
+            kFecSource = 1,
+            kFecRowParity = 2,
+            kFecColumnParity = 3
+        };
+
+        // 源包头和校验包头的大小
+        const size_t kFecSourceHeaderSize = 8;
+        const size_t kFecParityHeaderSize = 12;
+        // 一个报文最大的大小，以太网 MTU 1500 减去 IP 头 20 字节和 UDP 头 8 字节
+        const size_t kFecMaxPacketSize = 1472;
+        // 一个源包最多携带的媒体负载，校验包的负载和最长的源包一样长，也不能超过 MTU
+        const size_t kFecMaxPayload = kFecMaxPacketSize - kFecParityHeaderSize;
+
+        // FEC 的配置，每路流各自设置
+        // columns 个源包排成一行，rows 行组成一个块：每行一个行校验包，每个块每列一个列校验包
+        // 行校验恢复零散的丢包，列校验恢复连续不超过 columns 个的突发丢包，两者交替还能恢复更多
+        struct FecConfig
+        {
+            // 每行的源包个数，1 到 255
+            uint8_t columns{10};
+            // 每块的行数，0 表示不发列校验
+            uint8_t rows{0};
+            // 是否发行校验
+            bool row_parity{true};
+        };
+
+        // 校验包头
+        struct FecParityHeader
+        {
+            uint8_t type{0};
+            uint8_t count{0};
+            uint16_t stride{0};
+            uint16_t length_xor{0};
+            uint32_t base{0};
+        };
+
+        // 报文头的编码和解码，buf 的大小由调用方保证
+        class FecPacket
+        {
+        public:
+            // 报文类型，长度不够返回 0
+            static uint8_t Type(const char *buf, size_t size);
+
+            static void EncodeSource(char *buf, uint32_t seq);
+            static bool DecodeSource(const char *buf, size_t size, uint32_t *seq);
+
+            static void EncodeParity(char *buf, const FecParityHeader &header);
+            static bool DecodeParity(const char *buf, size_t size, FecParityHeader *header);
+        };
+    }
+}
@@ -0,0 +1,110 @@
+#include "FecXor.h"
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FEC_XOR_X86 1
+#endif
+
+using namespace tmms::network;
+
+namespace
+{
+    using XorFunc = void (*)(char *, const char *, size_t);
+
+    // 一次 8 字节，memcpy 读写不要求对齐，编译器会生成普通的 load/store
+    void XorWords(char *dst, const char *src, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t a, b;
+            memcpy(&a, dst + i, 8);
+            memcpy(&b, src + i, 8);
+            a ^= b;
+            memcpy(dst + i, &a, 8);
+        }
+        for (; i < size; i++)
+        {
+            dst[i] ^= src[i];
+        }
+    }
+
+#ifdef FEC_XOR_X86
+    __attribute__((target("sse2"))) void XorSse2(char *dst, const char *src, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(a, b));
+        }
+        XorWords(dst + i, src + i, size - i);
+    }
+
+    __attribute__((target("avx2"))) void XorAvx2(char *dst, const char *src, size_t size)
+    {
+        size_t i = 0;
+        // 一次两个 32 字节，MTU 大小的包两个寄存器轮流用，load 和 xor 可以重叠执行
+        for (; i + 64 <= size; i += 64)
+        {
+            __m256i a0 = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i a1 = _mm256_loadu_si256((const __m256i *)(dst + i + 32));
+            __m256i b0 = _mm256_loadu_si256((const __m256i *)(src + i));
+            __m256i b1 = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(a0, b0));
+            _mm256_storeu_si256((__m256i *)(dst + i + 32), _mm256_xor_si256(a1, b1));
+        }
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(a, b));
+        }
+        XorWords(dst + i, src + i, size - i);
+    }
+#endif
+
+    struct XorKernel
+    {
+        XorFunc func;
+        const char *name;
+    };
+
+    // 第一次使用时检测一次 CPU
+    const XorKernel &SelectKernel()
+    {
+        static const XorKernel kernel = []()
+        {
+#ifdef FEC_XOR_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return XorKernel{XorAvx2, "avx2"};
+            }
+            if (__builtin_cpu_supports("sse2"))
+            {
+                return XorKernel{XorSse2, "sse2"};
+            }
+#endif
+            return XorKernel{XorWords, "scalar"};
+        }();
+        return kernel;
+    }
+}
+
+void tmms::network::FecXor(char *dst, const char *src, size_t size)
+{
+    SelectKernel().func(dst, src, size);
+}
+
+void tmms::network::FecXorScalar(char *dst, const char *src, size_t size)
+{
+    XorWords(dst, src, size);
+}
+
+const char *tmms::network::FecXorKernel()
+{
+    return SelectKernel().name;
+}
@@ -0,0 +1,22 @@
+#pragma once
+/*
+    FEC 用的异或内核：dst[i] ^= src[i]
+    x86 上运行时检测 CPU，支持 AVX2 时一次处理 32 字节，否则用 SSE2 一次 16 字节，其他平台用 8 字节的标量实现
+    各个内核用 target 属性单独编译，整个工程不需要打开 -mavx2，在不支持的机器上也不会执行到
+*/
+#include <cstddef>
+
+namespace tmms
+{
+    namespace network
+    {
+        // dst 的前 size 字节和 src 异或，两者可以不对齐，但不能部分重叠
+        void FecXor(char *dst, const char *src, size_t size);
+
+        // 标量实现，测试里用来对照
+        void FecXorScalar(char *dst, const char *src, size_t size);
+
+        // 当前使用的内核名字：avx2、sse2 或者 scalar
+        const char *FecXorKernel();
+    }
+}
@@ -8,7 +8,8 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &addr)
 }
 Acceptor::~Acceptor()
 {
-    Stop();
+    // 析构时已经没有 shared_ptr 指向自己，不能再调用 Stop()（里面的 shared_from_this 会抛 bad_weak_ptr）
+    // 走到这里说明事件循环也不再持有它，描述符由 Event 的析构函数关闭
     if (socket_opt_)
     {
         delete socket_opt_;
@@ -1,7 +1,19 @@
+#include <time.h>
 #include "Connection.h"
 
 using namespace tmms::network;
 
+namespace
+{
+    // 单调时钟的当前时间，单位：微秒，用于统计阻塞时长，不受系统时间调整的影响
+    uint64_t MonotonicUS()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+}
+
 // Connection 类的构造函数，接受一个事件循环指针、文件描述符和两个 InetAddress 类型的参数，分别表示本地地址和远端地址
 Connection::Connection(EventLoop *loop, int fd, const InetAddress &localAddr, const InetAddress &peerAddr)
     : Event(loop, fd) // 调用基类 Event 的构造函数，接受一个事件循环指针和文件描述符进行初始化
@@ -39,24 +51,44 @@ const InetAddress &Connection::PeerAddr() const
 // 设置特定类型的上下文，接受一个类型和一个共享指针作为参数，并将它们存储在 contexts_ 映射中
 void Connection::SetContext(int type, const std::shared_ptr<void> &context)
 {
+    if (type >= 0 && type < kContextSlots)
+    {
+        context_slots_[type] = context;
+        return;
+    }
     contexts_[type] = context;
 }
 
 // 重载成员函数，使用右值引用接受 context ，并将 context 移动到 contexts_ 映射中，而不是复制
 void Connection::SetContext(int type, std::shared_ptr<void> &&context)
 {
+    if (type >= 0 && type < kContextSlots)
+    {
+        context_slots_[type] = std::move(context);
+        return;
+    }
     contexts_[type] = std::move(context);
 }
 
 // 清除特定类型的上下文，接受一个类型作为参数
 void Connection::ClearContext(int type)
 {
-    contexts_[type].reset();
+    if (type >= 0 && type < kContextSlots)
+    {
+        context_slots_[type].reset();
+        return;
+    }
+    // 直接删除节点，不要用 operator[]，否则清除一个不存在的类型反而会插入一个空节点
+    contexts_.erase(type);
 }
 
 // 清除所有上下文
 void Connection::ClearContext()
 {
+    for (auto &slot : context_slots_)
+    {
+        slot.reset();
+    }
     contexts_.clear();
 }
 
@@ -105,4 +137,112 @@ void Connection::Deactive()
 {
     // 将active_标志设置为false
     active_.store(false);
-}
\ No newline at end of file
+}
+
+// 设置单次读事件的读取预算
+void Connection::SetReadBudget(size_t max_bytes, int32_t max_loops)
+{
+    read_budget_bytes_ = max_bytes;
+    read_budget_loops_ = max_loops;
+}
+
+// 返回读取预算被用完的次数
+uint64_t Connection::ReadBudgetHits() const
+{
+    return read_budget_hits_.load(std::memory_order_relaxed);
+}
+
+// 判断本次读事件是否已经用完预算
+bool Connection::ReadBudgetExhausted(size_t bytes, int32_t loops) const
+{
+    if (read_budget_bytes_ > 0 && bytes >= read_budget_bytes_)
+    {
+        return true;
+    }
+    if (read_budget_loops_ > 0 && loops >= read_budget_loops_)
+    {
+        return true;
+    }
+    return false;
+}
+
+// 预算用完后重新安排读取
+void Connection::ScheduleRead()
+{
+    // 统计预算命中次数，只有事件循环线程写，用 relaxed 即可
+    read_budget_hits_.fetch_add(1, std::memory_order_relaxed);
+
+    // 已经安排过了，不需要重复入队
+    if (read_scheduled_)
+    {
+        return;
+    }
+    read_scheduled_ = true;
+
+    // 边缘触发模式下，没读到 EAGAIN 就不会再有新的可读通知，所以要自己在下一轮循环里补一次 OnRead
+    // 用弱指针捕获，连接在这期间被销毁的话就什么都不做
+    std::weak_ptr<Event> weak = shared_from_this();
+    loop_->QueueInLoop([this, weak]()
+                       {
+        auto self = weak.lock();
+        if (!self)
+        {
+            return;
+        }
+        read_scheduled_ = false;
+        OnRead(); });
+}
+// 返回连接统计数据的快照
+ConnectionStatsSnapshot Connection::Stats() const
+{
+    ConnectionStatsSnapshot snapshot;
+    snapshot.peer = peer_addr_.ToIpPort();
+    snapshot.bytes_in = stats_.bytes_in.load(std::memory_order_relaxed);
+    snapshot.bytes_out = stats_.bytes_out.load(std::memory_order_relaxed);
+    snapshot.msgs_in = stats_.msgs_in.load(std::memory_order_relaxed);
+    snapshot.msgs_out = stats_.msgs_out.load(std::memory_order_relaxed);
+    snapshot.read_calls = stats_.read_calls.load(std::memory_order_relaxed);
+    snapshot.write_calls = stats_.write_calls.load(std::memory_order_relaxed);
+    snapshot.eagain = stats_.eagain.load(std::memory_order_relaxed);
+    snapshot.peak_queued_bytes = stats_.peak_queued_bytes.load(std::memory_order_relaxed);
+    snapshot.write_blocked_us = stats_.write_blocked_us.load(std::memory_order_relaxed);
+    snapshot.read_budget_hits = read_budget_hits_.load(std::memory_order_relaxed);
+
+    // 当前还在积压的，把已经阻塞的时间也算上
+    auto since = write_blocked_since_.load(std::memory_order_relaxed);
+    if (since > 0)
+    {
+        auto now = MonotonicUS();
+        if (now > since)
+        {
+            snapshot.write_blocked_us += now - since;
+        }
+    }
+    return snapshot;
+}
+
+// 发送队列有积压
+void Connection::OnWriteQueued(size_t queued)
+{
+    ConnectionStats::Max(stats_.peak_queued_bytes, queued);
+    if (write_blocked_since_.load(std::memory_order_relaxed) == 0)
+    {
+        write_blocked_since_.store(MonotonicUS(), std::memory_order_relaxed);
+    }
+}
+
+// 发送队列清空
+void Connection::OnWriteDrained()
+{
+    auto since = write_blocked_since_.load(std::memory_order_relaxed);
+    if (since == 0)
+    {
+        return;
+    }
+    write_blocked_since_.store(0, std::memory_order_relaxed);
+    auto now = MonotonicUS();
+    if (now > since)
+    {
+        ConnectionStats::Add(stats_.write_blocked_us, now - since);
+    }
+}
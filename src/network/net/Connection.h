@@ -1,11 +1,13 @@
 #pragma once
 #include <functional>
 #include <unordered_map>
+#include <array>
 #include <memory>
 #include <atomic>
 #include "network/base/InetAddress.h"
 #include "Event.h"
 #include "EventLoop.h"
+#include "ConnectionStats.h"
 
 namespace tmms
 {
@@ -21,6 +23,14 @@ namespace tmms
             kFlvContext
         };
 
+        // 已知的上下文类型放在固定的槽位里，按下标直接访问；更大的类型（用户自定义）才放到哈希表里
+        const int kContextSlots = kFlvContext + 1;
+
+        // 单次读事件默认的读取预算：最多读取的字节数和循环次数，0 表示不限制
+        // 一个连接用完预算后让出事件循环，剩余数据留到下一轮再读，避免一个推流端独占整个线程
+        const size_t kDefaultReadBudgetBytes = 256 * 1024;
+        const int32_t kDefaultReadBudgetLoops = 64;
+
         // 定义一个缓冲区节点
         struct BufferNode
         {
@@ -73,9 +83,16 @@ namespace tmms
             void SetContext(int type, std::shared_ptr<void> &&context);
 
             // 声明一个模板函数，用于获取特定类型的上下文，接受一个类型参数，返回一个共享指针
+            // 返回的共享指针会增加一次引用计数，只在需要延长上下文生命周期时使用，消息回调里优先用 GetContextPtr / Context
             template <typename T> 
             std::shared_ptr<T> GetContext(int type) const
             {
+                // 已知类型直接取固定槽位
+                if (type >= 0 && type < kContextSlots)
+                {
+                    return std::static_pointer_cast<T>(context_slots_[type]);
+                }
+
                 // 在 contexts_ 中查找特定类型的上下文
                 auto iter = contexts_.find(type);
 
@@ -90,6 +107,30 @@ namespace tmms
                 return std::shared_ptr<T>();
             }
 
+            // 获取特定类型的上下文的裸指针，不增加引用计数，上下文的生命周期由连接保证
+            template <typename T>
+            T *GetContextPtr(int type) const
+            {
+                if (type >= 0 && type < kContextSlots)
+                {
+                    return static_cast<T *>(context_slots_[type].get());
+                }
+                auto iter = contexts_.find(type);
+                if (iter != contexts_.end())
+                {
+                    return static_cast<T *>(iter->second.get());
+                }
+                return nullptr;
+            }
+
+            // 编译期确定槽位的上下文访问，没有查找也不增加引用计数，例如 Context<kRtmpContext, RtmpContext>()
+            template <int Type, typename T>
+            T *Context() const
+            {
+                static_assert(Type >= 0 && Type < kContextSlots, "Context<Type> only supports the fixed context slots");
+                return static_cast<T *>(context_slots_[Type].get());
+            }
+
             // 声明一个函数，用于清除特定类型的上下文，接受一个类型作为参数
             void ClearContext(int type);
 
@@ -108,6 +149,15 @@ namespace tmms
             // 声明一个函数，用于停用连接
             void Deactive();
 
+            // 设置单次读事件的读取预算，max_bytes 为最多读取的字节数，max_loops 为最多读取的次数，0 表示不限制
+            void SetReadBudget(size_t max_bytes, int32_t max_loops);
+
+            // 返回读取预算被用完的次数，即该连接被迫让出事件循环的次数
+            uint64_t ReadBudgetHits() const;
+
+            // 返回连接统计数据的快照，计数器都是原子的，任何线程都可以调用
+            ConnectionStatsSnapshot Stats() const;
+
             // 声明一个虚函数，用于强制关闭连接，virtual关键字让子类必须实现该函数
             virtual void ForceClose() = 0;
 
@@ -126,8 +176,26 @@ namespace tmms
             // 远端地址
             InetAddress peer_addr_;
 
+            // 判断本次读事件是否已经用完预算，bytes 为已读取的字节数，loops 为已读取的次数
+            bool ReadBudgetExhausted(size_t bytes, int32_t loops) const;
+
+            // 预算用完但数据还没读完时调用，记录一次命中，并把剩余的读取放到下一轮事件循环
+            void ScheduleRead();
+
+            // 用户态发送队列有数据积压时调用，queued 为当前积压的字节数，更新峰值并开始计算阻塞时间
+            void OnWriteQueued(size_t queued);
+
+            // 用户态发送队列清空时调用，累计本次阻塞的时间
+            void OnWriteDrained();
+
+            // 连接的统计计数器，只由事件循环线程写
+            ConnectionStats stats_;
+
         private:
-            // 存储上下文的哈希表，键为整数，值为上下文指针
+            // 已知类型的上下文槽位，下标为上下文类型
+            std::array<ContexPtr, kContextSlots> context_slots_;
+
+            // 存储其他类型上下文的哈希表，键为整数，值为上下文指针
             std::unordered_map<int, ContexPtr> contexts_;
 
             // 激活回调函数   激活的时候调用这个回调 告诉用户 我现在是激活状态，你可以给我发数据了
@@ -135,6 +203,21 @@ namespace tmms
 
             // 表示当前是否处于活动状态的原子布尔值
             std::atomic<bool> active_{false};
+
+            // 单次读事件最多读取的字节数
+            size_t read_budget_bytes_{kDefaultReadBudgetBytes};
+
+            // 单次读事件最多读取的次数
+            int32_t read_budget_loops_{kDefaultReadBudgetLoops};
+
+            // 读取预算被用完的次数，其他线程也可以读取
+            std::atomic<uint64_t> read_budget_hits_{0};
+
+            // 是否已经安排了下一轮的读取，避免重复入队
+            bool read_scheduled_{false};
+
+            // 发送队列开始积压的时间，单位：微秒，0 表示当前没有积压
+            std::atomic<uint64_t> write_blocked_since_{0};
         };
     }
 }
\ No newline at end of file
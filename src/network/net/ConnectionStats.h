@@ -0,0 +1,65 @@
+#pragma once
+/*
+    每个连接的流量和系统调用统计
+    计数器只由连接所在的事件循环线程写，用 relaxed 的原子读写即可，不需要加锁，也不需要 lock 前缀的原子加
+    其他线程（比如统计、监控线程）随时可以读取一份快照
+*/
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace tmms
+{
+    namespace network
+    {
+        // 统计数据的快照，普通数值，方便拷贝和汇总
+        struct ConnectionStatsSnapshot
+        {
+            std::string peer;                   // 对端地址
+            uint64_t bytes_in{0};               // 接收的字节数
+            uint64_t bytes_out{0};              // 发送的字节数
+            uint64_t msgs_in{0};                // 接收的消息数（TCP 为消息回调次数，UDP 为数据报个数）
+            uint64_t msgs_out{0};               // 发送的消息数（TCP 为 Send 调用次数，UDP 为数据报个数）
+            uint64_t read_calls{0};             // 读系统调用次数
+            uint64_t write_calls{0};            // 写系统调用次数
+            uint64_t eagain{0};                 // 读写返回 EAGAIN 的次数
+            uint64_t peak_queued_bytes{0};      // 用户态发送队列的峰值字节数
+            uint64_t write_blocked_us{0};       // 发送队列不为空（等待可写）的累计时间，单位：微秒
+            uint64_t read_budget_hits{0};       // 读取预算被用完的次数
+        };
+
+        // 一组连接统计快照的回调
+        using ConnectionStatsCallback = std::function<void(const std::vector<ConnectionStatsSnapshot> &)>;
+
+        // 连接内部的计数器
+        struct ConnectionStats
+        {
+            std::atomic<uint64_t> bytes_in{0};
+            std::atomic<uint64_t> bytes_out{0};
+            std::atomic<uint64_t> msgs_in{0};
+            std::atomic<uint64_t> msgs_out{0};
+            std::atomic<uint64_t> read_calls{0};
+            std::atomic<uint64_t> write_calls{0};
+            std::atomic<uint64_t> eagain{0};
+            std::atomic<uint64_t> peak_queued_bytes{0};
+            std::atomic<uint64_t> write_blocked_us{0};
+
+            // 单写者累加，读取旧值再写回，不需要原子加
+            static void Add(std::atomic<uint64_t> &counter, uint64_t value)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+
+            // 单写者更新峰值
+            static void Max(std::atomic<uint64_t> &counter, uint64_t value)
+            {
+                if (value > counter.load(std::memory_order_relaxed))
+                {
+                    counter.store(value, std::memory_order_relaxed);
+                }
+            }
+        };
+    }
+}
@@ -39,4 +39,9 @@ bool Event::EnableReading(bool enable)
 int Event::Fd() const
 {
     return fd_;
+}
+
+EventLoop *Event::Loop() const
+{
+    return loop_;
 }
\ No newline at end of file
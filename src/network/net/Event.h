@@ -32,6 +32,7 @@ namespace tmms
             bool EnableReading(bool enable);
 
             int Fd() const;//返回文件描述符
+            EventLoop *Loop() const;//返回所属的事件循环
             void Close();
 
         protected:
@@ -33,11 +33,13 @@ void EventLoop::Loop()
     // looping_ 是一个布尔成员变量，用于控制 while 循环的执行。
     // 在调用 Quit() 方法前，它一直为 true。
     looping_ = true;
-     // 设置 epoll_wait 的超时时间为 1000 毫秒（1秒）。
-    // 这意味着 epoll_wait 最多阻塞1秒，即使没有任何I/O事件，也会返回一次。
+     // epoll_wait 最多阻塞1秒，即使没有任何I/O事件，也会返回一次。
+    // 有毫秒级定时任务时，在最近的任务到期时醒来。
     int64_t timeout = 1000;
     while (looping_)
     {
+        timeout = NextTimeout(tmms::base::TTime::NowMS());
+
         memset(&epoll_events_[0], 0x00, sizeof(struct epoll_event) * epoll_events_.size());
 
         // 步骤 2: 调用 epoll_wait，阻塞等待I/O事件
@@ -58,17 +60,18 @@ void EventLoop::Loop()
                 struct epoll_event &ev = epoll_events_[i];// 获取一个就绪事件
                 if (ev.data.fd <= 0)// 安全检查：fd <= 0 是无效的
                 {
-                    NETWORK_ERROR << "epoll wait error(非法fd). fd:" << ev.data.fd;
+                    NETWORK_ERROR_LIMITED(10, 1000) << "epoll wait error(非法fd). fd:" << ev.data.fd;
                     continue;
                 }
                 //从 events_ 哈希表中查找 fd 对应的 Event 对象，是一个键值对
                 auto iter = events_.find(ev.data.fd);
                 if (iter == events_.end())// 如果找不到，说明该Event可能已被移除
                 {
-                    NETWORK_ERROR << "epoll wait error(查不到). fd:" << ev.data.fd;
+                    NETWORK_ERROR_LIMITED(10, 1000) << "epoll wait error(查不到). fd:" << ev.data.fd;
                     continue;
                 }
-                EventPtr &event = iter->second;
+                // 持有一份引用计数，回调里可能把它从 events_ 中删除
+                EventPtr event = iter->second;
                
                 // 根据具体的事件类型，调用相应的回调函数
                 // 1、事件出错
@@ -87,15 +90,18 @@ void EventLoop::Loop()
                 {
                     event->OnClose();
                 }
-                // 3、可读事件或紧急数据事件
-                else if (ev.events & (EPOLLIN | EPOLLPRI))
-                {
-                    event->OnRead();
-                }
-                // 4、可写事件
-                else if (ev.events & EPOLLOUT)
+                else
                 {
-                    event->OnWrite();
+                    // 3、可读事件或紧急数据事件
+                    if (ev.events & (EPOLLIN | EPOLLPRI))
+                    {
+                        event->OnRead();
+                    }
+                    // 4、可写事件，边缘触发下可读和可写可能同时到达，可写通知丢了就不会再来，所以不能和可读互斥
+                    if (ev.events & EPOLLOUT)
+                    {
+                        event->OnWrite();
+                    }
                 }
             }
 
@@ -108,11 +114,13 @@ void EventLoop::Loop()
             }
             RunFunctions();
             int64_t now = tmms::base::TTime::NowMS();
+            RunMsTimers(now);
             wheel_.OnTimer(now);
         }
         else if (ret < 0)
         {
-            NETWORK_ERROR << "epoll wait error.error:" << errno;
+            // epoll_wait 持续出错时每轮都会走到这里，限频避免刷屏
+            NETWORK_ERROR_LIMITED(10, 1000) << "epoll wait error.error:" << errno;
         }
     }
 }
@@ -260,14 +268,35 @@ void EventLoop::RunInLoop(Func &&f)
     }
 }
 
-void EventLoop::RunFunctions()
+// QueueInLoop：总是入队，即使在事件循环线程里调用也不会立即执行
+void EventLoop::QueueInLoop(const Func &f)
+{
+    std::lock_guard<std::mutex> lk(lock_);
+    functions_.push(f);
+
+    WakeUp();
+}
+void EventLoop::QueueInLoop(Func &&f)
 {
     std::lock_guard<std::mutex> lk(lock_);
-    while (!functions_.empty())
+    functions_.push(std::move(f));
+
+    WakeUp();
+}
+
+void EventLoop::RunFunctions()
+{
+    // 先把队列整体换出来再执行，任务里再调用 QueueInLoop 不会死锁，新任务留到下一轮执行
+    std::queue<Func> functions;
     {
-        auto &f = functions_.front();
+        std::lock_guard<std::mutex> lk(lock_);
+        functions.swap(functions_);
+    }
+    while (!functions.empty())
+    {
+        auto &f = functions.front();
         f();
-        functions_.pop();
+        functions.pop();
     }
 }
 void EventLoop::WakeUp()
@@ -347,4 +376,53 @@ void EventLoop::RunEvery(double inerval, Func &&cb)
         RunInLoop([this, inerval, cb]()
                   { wheel_.RunEvery(inerval, cb); });
     }
-}
\ No newline at end of file
+}
+
+// 毫秒级定时任务
+void EventLoop::RunAfterMs(int64_t delay, const Func &cb)
+{
+    Func f = cb;
+    RunAfterMs(delay, std::move(f));
+}
+
+void EventLoop::RunAfterMs(int64_t delay, Func &&cb)
+{
+    // 到期时间在调用线程里算好，跨线程投递的耗时不会推迟任务
+    int64_t when = tmms::base::TTime::NowMS() + (delay > 0 ? delay : 0);
+    auto f = std::make_shared<Func>(std::move(cb));
+    RunInLoop([this, when, f]()
+              {
+        MsTimer timer;
+        timer.when = when;
+        timer.seq = ms_timer_seq_++;
+        timer.cb = std::move(*f);
+        ms_timers_.push(std::move(timer)); });
+}
+
+void EventLoop::RunMsTimers(int64_t now)
+{
+    while (!ms_timers_.empty() && ms_timers_.top().when <= now)
+    {
+        // 先出堆再执行，任务里可以继续加新的定时任务
+        Func cb = std::move(const_cast<MsTimer &>(ms_timers_.top()).cb);
+        ms_timers_.pop();
+        if (cb)
+        {
+            cb();
+        }
+    }
+}
+
+int64_t EventLoop::NextTimeout(int64_t now) const
+{
+    if (ms_timers_.empty())
+    {
+        return 1000;
+    }
+    int64_t wait = ms_timers_.top().when - now;
+    if (wait < 0)
+    {
+        return 0;
+    }
+    return wait < 1000 ? wait : 1000;
+}
@@ -48,6 +48,9 @@ namespace network
             bool IsInLoopThread() const;
             void RunInLoop(const Func &f);//跑任务队列中的任务
             void RunInLoop(Func &&f);
+            // 无论调用方在哪个线程，都把任务放进队列，留到下一轮循环执行（用于把剩余工作让给其他连接）
+            void QueueInLoop(const Func &f);
+            void QueueInLoop(Func &&f);
 
             // 时间轮功能
             void InsertEntry(uint32_t delay, EntryPtr entrPtr); 
@@ -55,6 +58,11 @@ namespace network
             void RunAfter(double delay, Func &&cb);
             void RunEvery(double inerval, const Func &cb);
             void RunEvery(double inerval, Func &&cb);
+
+            // 毫秒级定时任务，时间轮的精度只有秒，连接错开、限速恢复这类亚秒级的定时用这个
+            // 任何线程都可以调用，任务在事件循环线程执行，只执行一次
+            void RunAfterMs(int64_t delay, const Func &cb);
+            void RunAfterMs(int64_t delay, Func &&cb);
         private:
             bool looping_{false};
             int epoll_fd_{-1};
@@ -71,6 +79,28 @@ namespace network
 
             // 时间轮
             TimingWheel wheel_;
+
+            // 毫秒级定时任务，按到期时间排序的小顶堆，只在事件循环线程访问
+            struct MsTimer
+            {
+                int64_t when{0};        // 到期时间，单位：毫秒
+                uint64_t seq{0};        // 到期时间相同时按加入顺序执行
+                Func cb;
+            };
+            struct MsTimerLater
+            {
+                bool operator()(const MsTimer &a, const MsTimer &b) const
+                {
+                    return a.when > b.when || (a.when == b.when && a.seq > b.seq);
+                }
+            };
+            std::priority_queue<MsTimer, std::vector<MsTimer>, MsTimerLater> ms_timers_;
+            uint64_t ms_timer_seq_{0};
+
+            // 执行到期的毫秒级定时任务
+            void RunMsTimers(int64_t now);
+            // epoll_wait 的超时时间，最近的毫秒级定时任务到期前醒来，最长 1 秒，保证时间轮按秒推进
+            int64_t NextTimeout(int64_t now) const;
         };
     }
 }
@@ -15,16 +15,29 @@ EventLoopThread::EventLoopThread() : thread_([this]()
 //析构函数
 EventLoopThread::~EventLoopThread()
 {
+    Stop();
+}
+
+// 退出事件循环并等待线程结束
+void EventLoopThread::Stop()
+{
+    // 线程还没进入事件循环的话先让它进入，保证 loop_ 有效
     Run();
-    if (loop_)
-    {
-        loop_->Quit();
-    }
+    std::call_once(stop_once_, [this]()
+                   {
+        EventLoop *loop = loop_;
+        if (loop)
+        {
+            // 投递到事件循环里退出，管道会唤醒 epoll_wait，不用等超时
+            // 退出前已经在队列里的任务会先执行完
+            loop->RunInLoop([loop]()
+                            { loop->Quit(); });
+        }
 
-    if (thread_.joinable())
-    {
-        thread_.join();
-    }
+        if (thread_.joinable())
+        {
+            thread_.join();
+        } });
 }
 
 void EventLoopThread::Run()
@@ -20,6 +20,9 @@ namespace tmms
             ~EventLoopThread();
 
             void Run();
+
+            // 退出事件循环并等待线程结束，可以重复调用，不能在自己的事件循环线程里调用
+            void Stop();
             
             EventLoop * Loop() const;
 
@@ -28,13 +31,15 @@ namespace tmms
         private:
             void StartEventLoop();
             EventLoop * loop_{nullptr};
-            //std::thread 的构造函数接收一个可调用对象（这里是一个lambda表达式），并立即启动一个新的操作系统线程来执行这个对象。
-            std::thread thread_;
             bool running_{false};
             std::mutex lock_;
             std::condition_variable condition_;
             std::once_flag once_;
+            std::once_flag stop_once_;
             std::promise<int> promise_loop;
+            //std::thread 的构造函数接收一个可调用对象（这里是一个lambda表达式），并立即启动一个新的操作系统线程来执行这个对象。
+            // 必须放在最后：成员按声明顺序构造，线程一启动就会用到上面的锁、条件变量和 promise，它们必须先构造好
+            std::thread thread_;
         };
     }
 }
@@ -4,7 +4,7 @@
 using namespace tmms::network;
 namespace
 {
-    void bind_cpu(std::thread &t, int n)
+    bool bind_cpu(std::thread &t, int n)
     {
         // 1. 创建一个CPU核心的集合
         cpu_set_t cpu;
@@ -13,7 +13,8 @@ namespace
         // 3. 将编号为 n 的CPU核心加入到集合中
         CPU_SET(n, &cpu);
         // 4. 将线程 t 绑定到上述CPU核心集合中
-        pthread_setaffinity_np(t.native_handle(), sizeof(cpu), &cpu);
+        // 5. CPU 不存在或者不在允许的集合里时绑定失败
+        return pthread_setaffinity_np(t.native_handle(), sizeof(cpu), &cpu) == 0;
     }
 }
 
@@ -37,7 +38,12 @@ EventLoopThreadPool::EventLoopThreadPool(int thread_num, int start, int cpus)
             int n = (start + i) % cpus;
             // 调用匿名命名空间中的辅助函数 bind_cpu，将底层的 std::thread 对象和
             // 我们计算出的核心编号 n 作为参数传进去，完成线程与CPU核心的绑定。
-            bind_cpu(threads_.back()->Thread(), n);
+            // 绑定失败的记为没有绑定，按 CPU 查找时不会选中它
+            thread_cpus_.emplace_back(bind_cpu(threads_.back()->Thread(), n) ? n : -1);
+        }
+        else
+        {
+            thread_cpus_.emplace_back(-1);
         }
     }
 }
@@ -69,6 +75,21 @@ EventLoop *EventLoopThreadPool::GetNextLoop()
     return threads_[index % threads_.size()]->Loop();
 }
 
+// 返回绑定在 cpu 上的事件循环，线程数少于 CPU 数时不是每个 CPU 都有，这时按轮询分配
+EventLoop *EventLoopThreadPool::GetLoopByCpu(int cpu)
+{
+    if (cpu >= 0)
+    {
+        for (size_t i = 0; i < thread_cpus_.size(); i++)
+        {
+            if (thread_cpus_[i] == cpu)
+            {
+                return threads_[i]->Loop();
+            }
+        }
+    }
+    return GetNextLoop();
+}
 // 返回线程池中配置的线程数量。
 size_t EventLoopThreadPool::Size()
 {
@@ -84,4 +105,12 @@ void EventLoopThreadPool::Start()
         // Run() 方法才会返回。
         t->Run();
     }
-}
\ No newline at end of file
+}
+// 停止线程池中的所有 EventLoop 线程。
+void EventLoopThreadPool::Stop()
+{
+    for (auto &t : threads_)
+    {
+        t->Stop();
+    }
+}
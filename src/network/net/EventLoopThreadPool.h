@@ -19,13 +19,20 @@ namespace tmms{
             std::vector<EventLoop*> GetLoops() const;
             // 获取事件循环的接口
             EventLoop * GetNextLoop();
+            // 返回绑定在 cpu 上的事件循环，没有线程绑定在这个 CPU 上时按轮询返回
+            EventLoop * GetLoopByCpu(int cpu);
             // 返回线程数量
             size_t Size();
             // 启动线程池
             void Start();
+            // 停止线程池，退出所有事件循环并等待线程结束
+            // 优雅停止时先对服务器调用 TcpServer::Shutdown，等所有连接关闭后再调用，不能在池里的线程调用
+            void Stop();
 
         private:
             std::vector<EventLoopThreadPtr> threads_; 
+            // 每个线程绑定的 CPU，没有绑定的为 -1
+            std::vector<int> thread_cpus_;
             std::atomic<int32_t> loop_index_{0};//用来指示我们取到的loop是哪个
         };
     }
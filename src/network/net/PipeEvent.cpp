@@ -33,14 +33,22 @@ PipeEvent::~PipeEvent()
 
 void PipeEvent::OnRead()
 {
+    // 边缘触发，一次把管道里的唤醒数据读干净，QueueInLoop 会频繁唤醒，这里不再逐次打印
     int64_t tmp = 0;
-    auto ret = ::read(fd_, &tmp, sizeof(tmp));
-    if (ret < 0)
+    while (true)
     {
-        NETWORK_ERROR << "pipe read error. ret:" << errno;
-        return;
+        auto ret = ::read(fd_, &tmp, sizeof(tmp));
+        if (ret > 0 || (ret < 0 && errno == EINTR))
+        {
+            continue;
+        }
+        if (ret < 0 && errno != EAGAIN)
+        {
+            NETWORK_ERROR << "pipe read error. ret:" << errno;
+        }
+        break;
     }
-    std::cout << "管道读取到的值为：" << tmp << std::endl;
+    NETWORK_TRACE << "pipe wake up.";
 }
 
 void PipeEvent::OnClose()
@@ -2,11 +2,14 @@
 #include <iostream>
 #include "TcpConnection.h"
 #include "network/base/Network.h"
+#include "network/base/SlabPool.h"
+#include "base/TTime.h"
 
 using namespace tmms::network;
 // 构造函数
 TcpConnection::TcpConnection(EventLoop *loop, int sockfd, const InetAddress &localAddr, const InetAddress &peerAddr)
     : Connection(loop, sockfd, localAddr, peerAddr) // 初始化基类 Connection，传递参数
+    , message_buffer_(0)                            // 接收缓冲区延迟分配，空闲连接不占内存，有数据时再从池里借
 {
 }
 // 设置回调函数
@@ -35,11 +38,14 @@ void TcpConnection::OnClose()
         // 此时closed_还是false,就会导致重复调用关闭逻辑，产生竞态条件
         closed_ = true;
 
+        // 关闭后不再等待发送，停止累计阻塞时间
+        OnWriteDrained();
+
         // 如果存在关闭回调函数
         if (close_cb_)
         {
             // 调用关闭回调，并将当前对象转换为 TcpConnection 的共享指针
-            close_cb_(std::dynamic_pointer_cast<TcpConnection>(shared_from_this()));
+            close_cb_(Self());
         }
     }
 
@@ -94,8 +100,63 @@ void TcpConnection::ForceClose()
              ForceClose() 函数立即返回，Worker线程5 可以继续做别的事情。
              稍后，I/O线程2 在自己的事件循环中，从任务队列里取出了这个 OnClose() 任务，并在自己的线程里安全地执行了它。
     */
-    loop_->RunInLoop([this]()
-                     { OnClose(); });
+    // 任务里持有连接的智能指针，调用者投递后马上释放最后一个引用时，执行任务时连接也还活着
+    auto self = Self();
+    loop_->RunInLoop([self]()
+                     { self->OnClose(); });
+}
+// 优雅关闭
+void TcpConnection::Shutdown(int32_t timeout)
+{
+    auto self = Self();
+    loop_->RunInLoop([self, timeout]()
+                     { self->ShutdownInLoop(timeout); });
+}
+// 是否已经开始优雅关闭
+bool TcpConnection::IsShuttingDown() const
+{
+    return shutting_down_;
+}
+// 在事件循环中开始优雅关闭
+void TcpConnection::ShutdownInLoop(int32_t timeout)
+{
+    if (closed_ || shutting_down_)
+    {
+        return;
+    }
+    shutting_down_ = true;
+    NETWORK_TRACE << " host : " << peer_addr_.ToIpPort() << " shutdown, queued bytes : " << queued_bytes_;
+
+    // 到时间还没关闭的强制关闭，对端不读数据或者不关闭时不会一直挂着
+    if (timeout > 0)
+    {
+        std::weak_ptr<TcpConnection> weak = Self();
+        loop_->RunAfter(timeout, [weak]()
+                        {
+            auto con = weak.lock();
+            if (con && !con->closed_)
+            {
+                NETWORK_WARN << " host : " << con->peer_addr_.ToIpPort() << " shutdown timeout, drop queued bytes : " << con->queued_bytes_;
+                con->OnClose();
+            } });
+    }
+
+    // 没有积压的数据直接半关闭，否则等 OnWrite 发完
+    if (io_vec_list_.empty())
+    {
+        ShutdownWrite();
+    }
+}
+// 发送队列已经发完，半关闭写方向
+void TcpConnection::ShutdownWrite()
+{
+    if (write_shutdown_ || closed_)
+    {
+        return;
+    }
+    write_shutdown_ = true;
+    // 对端读到 EOF 后关闭连接，这边 OnRead 读到 0 再走 OnClose，之前对端发来的数据照常交给回调
+    ::shutdown(fd_, SHUT_WR);
 }
 // 读取数据
 void TcpConnection::OnRead()
@@ -111,22 +172,58 @@ void TcpConnection::OnRead()
 
     ExtendLife();
 
+    // 本次读事件已经读取的字节数和次数，用于读取预算
+    size_t read_bytes = 0;
+    int32_t read_loops = 0;
+
+    // 共享指针形式的回调才需要，一次读事件只取一次
+    TcpConnectionPtr self;
+
     // 开始一个无限循环，直到手动中断
     while (true)
     {
+        // 预算用完了，把剩余的数据留到下一轮事件循环，先让同一线程上的其他连接处理
+        if (ReadBudgetExhausted(read_bytes, read_loops))
+        {
+            ScheduleRead();
+            break;
+        }
+
         // 初始化错误码
         int err = 0;
         // 从文件描述符 fd_ 中读取数据到 message_buffer_，并获取返回值和错误码
         auto ret = message_buffer_.ReadFd(fd_, &err);
+        ConnectionStats::Add(stats_.read_calls, 1);
 
         // 如果成功读取到数据
         if (ret > 0)
         {
+            read_bytes += ret;
+            read_loops++;
+            ConnectionStats::Add(stats_.bytes_in, ret);
+
+            // 优先调用借用引用的回调，不需要共享指针
+            if (message_ref_cb_)
+            {
+                ConnectionStats::Add(stats_.msgs_in, 1);
+                message_ref_cb_(*this, message_buffer_);
+            }
             // 检查是否设置了消息回调
-            if (message_cb_)
+            else if (message_cb_)
             {
+                ConnectionStats::Add(stats_.msgs_in, 1);
+                if (!self)
+                {
+                    self = Self();
+                }
                 // 调用消息回调，传递当前对象的共享指针和消息缓冲区
-                message_cb_(std::dynamic_pointer_cast<TcpConnection>(shared_from_this()), message_buffer_);
+                message_cb_(self, message_buffer_);
+            }
+
+            // 回调里可能已经关闭了连接
+            if (closed_)
+            {
+                break;
             }
         }
         // 如果返回值为 0，表示对端关闭了连接
@@ -140,7 +237,11 @@ void TcpConnection::OnRead()
         else // 如果读取失败
         {
             // 检查错误码是否为中断、暂时不可用或非阻塞
-            if (err != EINTR && err != EAGAIN && err != EWOULDBLOCK)
+            if (err == EAGAIN || err == EWOULDBLOCK)
+            {
+                ConnectionStats::Add(stats_.eagain, 1);
+            }
+            else if (err != EINTR)
             {
                 // 记录读取错误的日志
                 // NETWORK_ERROR << " read err : " << err;
@@ -193,13 +294,58 @@ void TcpConnection::OnWrite()
         // 开始一个无限循环，直到手动中断
         while (true)
         {
+            // 限速时本次最多写 quota 字节，令牌不够就等攒够了再写
+            size_t quota = queued_bytes_;
+            if (Paced())
+            {
+                quota = PacingQuota(queued_bytes_);
+                if (quota == 0)
+                {
+                    SchedulePacing();
+                    return;
+                }
+            }
+
+            // 配额不够发完整个队列时，临时截短最后一个 iovec，写完再恢复
+            size_t iov_count = io_vec_list_.size();
+            size_t cut_len = 0;
+            if (quota < queued_bytes_)
+            {
+                size_t sum = 0;
+                for (iov_count = 0; iov_count < io_vec_list_.size(); iov_count++)
+                {
+                    if (sum + io_vec_list_[iov_count].iov_len >= quota)
+                    {
+                        break;
+                    }
+                    sum += io_vec_list_[iov_count].iov_len;
+                }
+                cut_len = io_vec_list_[iov_count].iov_len;
+                io_vec_list_[iov_count].iov_len = quota - sum;
+                iov_count++;
+            }
+
             // 使用 writev 函数将数据写入文件描述符 fd_，写入的起始地址，大小
             // ret 的值代表实际成功写入内核发送缓冲区的字节总数。
-            auto ret = ::writev(fd_, &io_vec_list_[0], io_vec_list_.size());
+            auto ret = ::writev(fd_, &io_vec_list_[0], iov_count);
+            // 之后的退还令牌要加锁，可能改掉 errno，先保存下来
+            int err = errno;
+            ConnectionStats::Add(stats_.write_calls, 1);
+            if (cut_len > 0)
+            {
+                io_vec_list_[iov_count - 1].iov_len = cut_len;
+            }
+            if (Paced())
+            {
+                PacingRefund(quota - (ret > 0 ? ret : 0));
+            }
 
             // 如果写入成功
             if (ret >= 0)
             {
+                ConnectionStats::Add(stats_.bytes_out, ret);
+                queued_bytes_ -= ret;
+
                 // 处理写入的字节数
                 while (ret > 0)
                 {
@@ -227,12 +373,16 @@ void TcpConnection::OnWrite()
                 {
                     // 禁用写入
                     EnableWriting(false);
+                    queued_bytes_ = 0;
+                    OnWriteDrained();
+
+                    // 调用写入完成的回调，通知业务层 我已经将数据发送完毕
+                    WriteComplete();
 
-                    // 检查是否设置了写入完成的回调
-                    if (write_complete_cb_)
+                    // 优雅关闭时，发完了就半关闭
+                    if (shutting_down_)
                     {
-                        // 调用写入完成的回调，通知业务层 我已经将数据发送完毕
-                        write_complete_cb_(std::dynamic_pointer_cast<TcpConnection>(shared_from_this()));
+                        ShutdownWrite();
                     }
 
                     // 退出函数
@@ -242,15 +392,20 @@ void TcpConnection::OnWrite()
             else // 如果写入失败
             {
                 // 检查错误码是否为中断、暂时不可用或非阻塞
-                if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+                if (err == EINTR)
+                {
+                    continue;
+                }
+                if (err != EAGAIN && err != EWOULDBLOCK)
                 {
                     // 记录写入错误的日志
-                    NETWORK_ERROR << " host : " << peer_addr_.ToIpPort() << " write err : " << errno;
+                    NETWORK_ERROR << " host : " << peer_addr_.ToIpPort() << " write err : " << err;
                     // 调用关闭连接的函数
                     OnClose();
                     // 退出函数
                     return;
                 }
+                ConnectionStats::Add(stats_.eagain, 1);
 
                 // 退出循环
                 break;
@@ -261,15 +416,28 @@ void TcpConnection::OnWrite()
     {
         // 禁用写入
         EnableWriting(false);
+        OnWriteDrained();
+
+        // 调用写入完成的回调
+        WriteComplete();
 
-        // 检查是否设置了写入完成的回调
-        if (write_complete_cb_)
+        // 和发完数据的分支一样，优雅关闭时半关闭，ShutdownWrite 重复调用没有影响
+        if (shutting_down_)
         {
-            // 调用写入完成的回调，传递当前对象的共享指针
-            write_complete_cb_(std::dynamic_pointer_cast<TcpConnection>(shared_from_this()));
+            ShutdownWrite();
         }
     }
 }
+// 设置借用引用的接收消息回调
+void TcpConnection::SetRecvMsgRefCallback(const MessageRefCallback &cb)
+{
+    message_ref_cb_ = cb;
+}
+// 设置借用引用的接收消息回调（右值引用）
+void TcpConnection::SetRecvMsgRefCallback(MessageRefCallback &&cb)
+{
+    message_ref_cb_ = std::move(cb);
+}
 // 设置写完后的回调函数
 void TcpConnection::SetWriteCompleteCallback(const WriteCompleteCallback &cb)
 {
@@ -282,6 +450,29 @@ void TcpConnection::SetWriteCompleteCallback(WriteCompleteCallback &&cb)
     // 使用 std::move 将右值引用的回调函数移动到成员变量 write_complete_cb_
     write_complete_cb_ = std::move(cb);
 }
+// 设置借用引用的写完后的回调函数
+void TcpConnection::SetWriteCompleteRefCallback(const WriteCompleteRefCallback &cb)
+{
+    write_complete_ref_cb_ = cb;
+}
+// 设置借用引用的写完后的回调函数（右值引用）
+void TcpConnection::SetWriteCompleteRefCallback(WriteCompleteRefCallback &&cb)
+{
+    write_complete_ref_cb_ = std::move(cb);
+}
+// 调用写入完成回调
+void TcpConnection::WriteComplete()
+{
+    // 优先调用借用引用的回调，不需要共享指针
+    if (write_complete_ref_cb_)
+    {
+        write_complete_ref_cb_(*this);
+    }
+    else if (write_complete_cb_)
+    {
+        write_complete_cb_(Self());
+    }
+}
 // 发送多个、在内存中可能不连续的数据块，作为一个逻辑上的整体，按顺序发送出去（分散写）
 void TcpConnection::Send(std::list<BufferNodePtr> &list)
 {
@@ -307,16 +498,25 @@ void TcpConnection::SendInLoop(const char *buff, size_t size)
         // 直接返回，不再处理
         return;
     }
+    // 优雅关闭开始后不再接受新的发送
+    if (shutting_down_)
+    {
+        NETWORK_TRACE << " host : " << peer_addr_.ToIpPort() << " is shutting down, drop " << size << " bytes.";
+        return;
+    }
+
+    ConnectionStats::Add(stats_.msgs_out, 1);
 
-    // 初始化一个变量 send_len 用于存储实际发送的字节数
-    size_t send_len = 0;
+    // 初始化一个变量 send_len 用于存储实际发送的字节数，write 失败时返回 -1，必须用有符号类型
+    ssize_t send_len = 0;
 
     // 检查 io_vec_list_ 是否为空，如果为空，表示没有因为上次发送不完而积压的数据
-    // 最佳情况
-    if (io_vec_list_.empty())
+    // 最佳情况；限速时所有数据都要经过发送队列，由 OnWrite 按令牌放出
+    if (io_vec_list_.empty() && !Paced())
     {
         // 调用系统的 write 函数，将数据从 buff 发送到文件描述符 fd_，并将返回的字节数存储在 send_len 中
         send_len = ::write(fd_, buff, size);
+        ConnectionStats::Add(stats_.write_calls, 1);
 
         // 检查 send_len 是否小于 0，表示写入失败
         if (send_len < 0)
@@ -329,6 +529,10 @@ void TcpConnection::SendInLoop(const char *buff, size_t size)
 
                 return;
             }
+            if (errno != EINTR)
+            {
+                ConnectionStats::Add(stats_.eagain, 1);
+            }
 
             // 如果写入失败但错误是可恢复的，将 send_len 设置为 0，把完整的buff全部交给下面的常规路径去缓冲。
             send_len = 0;
@@ -336,18 +540,15 @@ void TcpConnection::SendInLoop(const char *buff, size_t size)
 
         // 从待发送的字节数中减去已成功发送的字节数
         size -= send_len;
+        ConnectionStats::Add(stats_.bytes_out, send_len);
 
         // 检查 size 是否为 0，说明所有数据一次性发送成功！ 
         // 没有发送完成也没有关系，记下了成功发送的字节数send_len，
         // 剩下的部分（size也已更新）就交给下面的常规路径去处理。
         if (size == 0)
         {
-            // 如果 write_complete_cb_（写完成的回调函数）存在，则执行以下操作
-            if (write_complete_cb_)
-            {
-                // 使用 std::dynamic_pointer_cast 将当前对象（通过 shared_from_this() 获取）转换为 TcpConnection 类型的智能指针，并调用回调函数
-                write_complete_cb_(std::dynamic_pointer_cast<TcpConnection>(shared_from_this()));
-            }
+            // 调用写完成的回调函数
+            WriteComplete();
 
             // 结束当前函数的执行
             return;
@@ -367,6 +568,8 @@ void TcpConnection::SendInLoop(const char *buff, size_t size)
 
         // 将 iovec 结构体添加到 io_vec_list_ 中，准备后续发送
         io_vec_list_.push_back(vec);
+        queued_bytes_ += size;
+        OnWriteQueued(queued_bytes_);
 
         // 调用 EnableWriting 函数，启用写入操作
         EnableWriting(true);
@@ -381,6 +584,15 @@ void TcpConnection::SendInLoop(std::list<BufferNodePtr> &list)
         NETWORK_TRACE << " host : " << peer_addr_.ToIpPort() << " had closed.";
         return;
     }
+    // 优雅关闭开始后不再接受新的发送
+    if (shutting_down_)
+    {
+        NETWORK_TRACE << " host : " << peer_addr_.ToIpPort() << " is shutting down, drop list.";
+        return;
+    }
+
+    // 一个列表作为一条消息
+    ConnectionStats::Add(stats_.msgs_out, 1);
 
     // 遍历传入的 BufferNodePtr 列表
     for (auto &l : list)
@@ -394,19 +606,21 @@ void TcpConnection::SendInLoop(std::list<BufferNodePtr> &list)
 
         // 将 iovec 结构体添加到 io_vec_list_ 中
         io_vec_list_.push_back(vec);
+        queued_bytes_ += l->size;
     }
 
     // 如果 io_vec_list_ 不为空，调用 EnableWriting(true); 启用写入操作
     if (!io_vec_list_.empty())
     {
+        OnWriteQueued(queued_bytes_);
         EnableWriting(true);
     }
 }
 // 超时关闭连接
 void TcpConnection::OnTimeout()
 {
-    NETWORK_ERROR << " host : " << peer_addr_.ToIpPort() << " timeout and close it.";
-    std::cout << "host : " << peer_addr_.ToIpPort() << " timeout and close it." << std::endl;
+    // 大量空连接一起超时（比如被攻击）时限频，被压掉的条数记在下一条日志里
+    NETWORK_ERROR_LIMITED(100, 1000) << " host : " << peer_addr_.ToIpPort() << " timeout and close it.";
     OnClose();
 }
 // 设置定时
@@ -418,7 +632,8 @@ void TcpConnection::EnableCheckIdleTimeout(int32_t max_time)
     // 2、它会把我们准备好的参数 conn_sptr 传递给这个构造函数
     //最后我们得到了一个智能指针tp，这个tp的类型是 std::shared_ptr<TimeoutEntry>，
     //并且它指向了一个 TimeoutEntry 对象.
-    auto tp = std::make_shared<TimeoutEntry>(std::dynamic_pointer_cast<TcpConnection>(shared_from_this()));
+    // 超时节点和连接一起频繁创建销毁，从内存块池里申请
+    auto tp = MakeSlabShared<TimeoutEntry>(Self());
     max_idle_time_ = max_time;
     // 把一个强指针赋值给 timeout_entry_这个弱指针
     timeout_entry_ = tp;
@@ -434,15 +649,15 @@ SetTimeoutCallback 的逻辑是：
 */
 void TcpConnection::SetTimeoutCallback(int timeout, const TimeoutCallback &cb)
 {
-    auto cp = std::dynamic_pointer_cast<TcpConnection>(shared_from_this());
-    loop_->RunAfter(timeout, [&cp, &cb]()
+    auto cp = Self();
+    loop_->RunAfter(timeout, [cp, cb]()
                     { cb(cp); });
 }
 // 设置定时回调函数（右值引用）
 void TcpConnection::SetTimeoutCallback(int timeout, TimeoutCallback &&cb)
 {
-    auto cp = std::dynamic_pointer_cast<TcpConnection>(shared_from_this());
-    loop_->RunAfter(timeout, [&cp, cb]()
+    auto cp = Self();
+    loop_->RunAfter(timeout, [cp, cb]()
                     { cb(cp); });
 }
 //延长时间
@@ -457,8 +672,242 @@ void TcpConnection::ExtendLife()
     }
 }
 
+// 开启单连接的令牌桶限速
+void TcpConnection::SetPacing(uint64_t rate, uint64_t burst)
+{
+    if (rate == 0)
+    {
+        pacing_.reset();
+        return;
+    }
+    if (pacing_)
+    {
+        pacing_->SetRate(rate, burst);
+    }
+    else
+    {
+        pacing_ = std::make_shared<TokenBucket>(rate, burst);
+    }
+}
+// 加入限速组
+void TcpConnection::SetPacingGroup(const TokenBucketPtr &group)
+{
+    pacing_group_ = group;
+}
+// 设置内核的 SO_MAX_PACING_RATE
+bool TcpConnection::SetMaxPacingRate(uint64_t rate)
+{
+    SocketOpt opt(fd_);
+    return opt.SetMaxPacingRate(rate);
+}
+// 是否开启了限速
+bool TcpConnection::Paced() const
+{
+    return pacing_ || pacing_group_;
+}
+// 从单连接和组的令牌桶里取本次最多可以写的字节数
+size_t TcpConnection::PacingQuota(size_t want)
+{
+    size_t quota = want;
+    if (pacing_)
+    {
+        quota = pacing_->Take(quota);
+    }
+    if (pacing_group_ && quota > 0)
+    {
+        // 组里给得少，多取的单连接令牌还回去
+        size_t got = pacing_group_->Take(quota);
+        if (pacing_ && got < quota)
+        {
+            pacing_->Refund(quota - got);
+        }
+        quota = got;
+    }
+    return quota;
+}
+// 没写出去的令牌还回去
+void TcpConnection::PacingRefund(size_t bytes)
+{
+    if (bytes == 0)
+    {
+        return;
+    }
+    if (pacing_)
+    {
+        pacing_->Refund(bytes);
+    }
+    if (pacing_group_)
+    {
+        pacing_group_->Refund(bytes);
+    }
+}
+// 令牌不够时，等攒够了再继续写
+void TcpConnection::SchedulePacing()
+{
+    if (pacing_pending_)
+    {
+        return;
+    }
+    pacing_pending_ = true;
+
+    // 每次至少攒够一小块再写，避免按字节唤醒
+    const size_t kPacingChunk = 16 * 1024;
+    size_t chunk = queued_bytes_ < kPacingChunk ? queued_bytes_ : kPacingChunk;
+    int64_t wait = 1;
+    if (pacing_)
+    {
+        wait = pacing_->WaitMs(chunk);
+    }
+    if (pacing_group_)
+    {
+        auto group_wait = pacing_group_->WaitMs(chunk);
+        wait = group_wait > wait ? group_wait : wait;
+    }
+
+    std::weak_ptr<TcpConnection> weak = Self();
+    loop_->RunAfterMs(wait, [weak]()
+                      {
+        auto con = weak.lock();
+        if (con)
+        {
+            con->pacing_pending_ = false;
+            con->OnWrite();
+        } });
+}
+
+// 设置 TCP_NOTSENT_LOWAT
+void TcpConnection::SetNotSentLowat(uint32_t bytes)
+{
+    notsent_lowat_ = bytes;
+    if (bytes > 0)
+    {
+        SocketOpt opt(fd_);
+        opt.SetTcpNotSentLowat(bytes);
+    }
+}
+
+// 立即采样一次 TCP_INFO
+bool TcpConnection::SampleTcpInfo()
+{
+    if (closed_)
+    {
+        return false;
+    }
+    SocketOpt opt(fd_);
+    if (!opt.GetTcpInfo(&tcp_info_))
+    {
+        return false;
+    }
+    tcp_info_time_ = tmms::base::TTime::NowMS();
+    return true;
+}
+
+// 返回最近一次采样的 TCP_INFO
+const TcpInfo &TcpConnection::LastTcpInfo() const
+{
+    return tcp_info_;
+}
+
+// 开启周期采样 TCP_INFO
+void TcpConnection::EnableTcpInfoSampling(int32_t interval, const TcpInfoCallback &cb)
+{
+    TcpInfoCallback callback = cb;
+    EnableTcpInfoSampling(interval, std::move(callback));
+}
+
+// 开启周期采样 TCP_INFO（右值引用）
+void TcpConnection::EnableTcpInfoSampling(int32_t interval, TcpInfoCallback &&cb)
+{
+    // 时间轮的精度是秒，间隔至少 1 秒
+    if (interval < 1)
+    {
+        interval = 1;
+    }
+    auto self = Self();
+    loop_->RunInLoop([self, interval, cb]()
+                     {
+        self->tcp_info_interval_ = interval;
+        self->tcp_info_cb_ = cb;
+        self->tcp_info_seq_++;
+        self->ScheduleTcpInfoSample(self->tcp_info_seq_); });
+}
+
+// 停止周期采样 TCP_INFO
+void TcpConnection::DisableTcpInfoSampling()
+{
+    auto self = Self();
+    loop_->RunInLoop([self]()
+                     {
+        self->tcp_info_interval_ = 0;
+        self->tcp_info_seq_++;
+        self->tcp_info_cb_ = nullptr; });
+}
+
+// 安排下一次 TCP_INFO 采样
+void TcpConnection::ScheduleTcpInfoSample(uint32_t seq)
+{
+    // 时间轮的 RunEvery 停不下来，这里每次采样后再安排下一次，用弱指针避免定时任务延长连接的生命周期
+    std::weak_ptr<TcpConnection> weak = Self();
+    loop_->RunAfter(tcp_info_interval_, [weak, seq]()
+                    {
+        auto self = weak.lock();
+        // 连接已经销毁、关闭，或者采样已经被停止/重新开启
+        if (!self || self->closed_ || seq != self->tcp_info_seq_)
+        {
+            return;
+        }
+        if (self->SampleTcpInfo() && self->tcp_info_cb_)
+        {
+            self->tcp_info_cb_(self, self->tcp_info_);
+        }
+        // 回调里可能停止了采样或者关闭了连接
+        if (!self->closed_ && seq == self->tcp_info_seq_)
+        {
+            self->ScheduleTcpInfoSample(seq);
+        } });
+}
+
+// 用户态发送队列中还没发送的字节数
+size_t TcpConnection::QueuedBytes() const
+{
+    return queued_bytes_;
+}
+
+// 设置流的码率
+void TcpConnection::SetStreamBitrate(uint64_t rate)
+{
+    stream_bitrate_ = rate;
+}
+
+// 发送方向的状态
+EgressState TcpConnection::Egress() const
+{
+    // 用户态还有积压，说明内核已经不收了
+    // 设置了低水位时，内核里未发送的数据超过低水位就不再可写，所以积压能及时反映出来
+    if (queued_bytes_ > 0)
+    {
+        return kEgressBacklogged;
+    }
+    if (stream_bitrate_ == 0 || tcp_info_time_ == 0 || tmms::base::TTime::NowMS() - tcp_info_time_ > kEgressSampleMaxAgeMs)
+    {
+        return kEgressOk;
+    }
+    // 空闲连接的交付速率本来就低，只有采样时内核里还有数据在等着发，交付速率才说明链路跟不上码率
+    if (tcp_info_.notsent_bytes > 0 && tcp_info_.delivery_rate > 0 && tcp_info_.delivery_rate < stream_bitrate_)
+    {
+        return kEgressSlow;
+    }
+    return kEgressOk;
+}
+
+// 发送方向是否拥塞
+bool TcpConnection::IsEgressCongested() const
+{
+    return Egress() != kEgressOk;
+}
+
 TcpConnection::~TcpConnection()
 {
-    // 处理连接关闭的逻辑
-    OnClose();
+    // 析构函数里不能再走 OnClose：它要求在事件循环线程，关闭回调还要用 shared_from_this
+    // 事件循环持有连接的智能指针，走到这里时连接已经不在事件循环里，套接字由 Event 的析构函数关闭
 }
\ No newline at end of file
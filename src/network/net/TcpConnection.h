@@ -7,6 +7,8 @@
 #include "Connection.h"
 #include "network/base/InetAddress.h"
 #include "network/base/MsgBuffer.h"
+#include "network/base/SocketOpt.h"
+#include "network/base/TokenBucket.h"
 
 namespace tmms
 {
@@ -28,12 +30,33 @@ namespace tmms
         // 定义写入完成的回调函数类型，接受一个 TcpConnectionPtr 参数，用于处理写入完成事件
         using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
 
+        // 借用引用的消息回调，连接只在回调期间有效，不产生引用计数和类型转换的开销
+        // 需要在回调之外继续持有连接时，调用 conn.Self() 取得共享指针
+        using MessageRefCallback = std::function<void(TcpConnection &, MsgBuffer &buffer)>;
+
+        // 借用引用的写入完成回调
+        using WriteCompleteRefCallback = std::function<void(TcpConnection &)>;
+
         // 定义超时回调函数类型，接受一个 TcpConnectionPtr 参数，用于处理超时事件
         using TimeoutCallback = std::function<void(const TcpConnectionPtr &)>;
 
+        // 定义 TCP_INFO 采样回调函数类型，每次周期采样后调用，媒体层据此决定继续发送还是丢到下一个关键帧
+        using TcpInfoCallback = std::function<void(const TcpConnectionPtr &, const TcpInfo &)>;
+
         // 前置声明，避免循环依赖
         struct TimeoutEntry;
 
+        // 发送方向的状态，不是 kEgressOk 时媒体层应该丢弃后续的非关键帧，直到下一个关键帧
+        enum EgressState
+        {
+            kEgressOk = 0,      // 没有积压，最近的采样里交付速率跟得上流的码率
+            kEgressBacklogged,  // 用户态发送队列有积压，内核已经不收了
+            kEgressSlow,        // 用户态没有积压，但采样时内核里还有没发出去的数据，交付速率低于流的码率
+        };
+
+        // TCP_INFO 采样超过这么久就不再用来判断发送状态，单位：毫秒
+        const int64_t kEgressSampleMaxAgeMs = 3000;
+
         class TcpConnection : public Connection // 继承自 Connection 类，包含与 TCP 连接相关的功能和数据成员
         {
         public:
@@ -49,8 +72,13 @@ namespace tmms
             // 关闭连接时调用的函数
             void OnClose() override;
 
-            // 强制关闭连接的函数
+            // 强制关闭连接的函数，发送队列里还没发出去的数据直接丢弃
             void ForceClose() override;
+            // 优雅关闭：不再接受新的发送，把发送队列发完后半关闭写方向（SHUT_WR），等对端关闭后再关闭连接
+            // timeout 为最长等待时间，单位：秒，到时还没关闭就强制关闭，0 表示不限制
+            void Shutdown(int32_t timeout = 0);
+            // 是否已经开始优雅关闭
+            bool IsShuttingDown() const;
 
             // 读取数据时调用的函数
             void OnRead() override;
@@ -61,6 +89,12 @@ namespace tmms
             // 设置接收消息的回调函数（右值引用）
             void SetRecvMsgCallback(MessageCallback &&cb);
 
+            // 设置借用引用的接收消息回调函数，设置后优先于 SetRecvMsgCallback 设置的回调
+            void SetRecvMsgRefCallback(const MessageRefCallback &cb);
+
+            // 设置借用引用的接收消息回调函数（右值引用）
+            void SetRecvMsgRefCallback(MessageRefCallback &&cb);
+
             // 发生错误时调用的函数
             void OnError(const std::string &msg) override;
 
@@ -73,6 +107,19 @@ namespace tmms
             // 设置写入完成的回调函数（右值引用）
             void SetWriteCompleteCallback(WriteCompleteCallback &&cb);
 
+            // 设置借用引用的写入完成回调函数，设置后优先于 SetWriteCompleteCallback 设置的回调
+            void SetWriteCompleteRefCallback(const WriteCompleteRefCallback &cb);
+
+            // 设置借用引用的写入完成回调函数（右值引用）
+            void SetWriteCompleteRefCallback(WriteCompleteRefCallback &&cb);
+
+            // 取得自身的共享指针，只在需要持有连接时调用
+            // 对象一定是 TcpConnection（或其子类），静态转换即可，不需要 dynamic_pointer_cast 的 RTTI 检查
+            TcpConnectionPtr Self()
+            {
+                return std::static_pointer_cast<TcpConnection>(shared_from_this());
+            }
+
             // 发送数据列表的函数
             void Send(std::list<BufferNodePtr>&list);
 
@@ -91,6 +138,45 @@ namespace tmms
             // 设置超时回调函数（右值引用）
             void SetTimeoutCallback(int timeout, TimeoutCallback &&cb);
 
+            // 设置 TCP_NOTSENT_LOWAT，让内核发送缓冲区保持较浅，积压的数据留在用户态，0 表示不设置
+            void SetNotSentLowat(uint32_t bytes);
+
+            // 立即采样一次 TCP_INFO，必须在事件循环线程调用，成功返回 true
+            bool SampleTcpInfo();
+
+            // 返回最近一次采样的 TCP_INFO
+            const TcpInfo &LastTcpInfo() const;
+
+            // 开启周期采样 TCP_INFO，interval 为采样间隔，单位：秒，每次采样后调用回调
+            void EnableTcpInfoSampling(int32_t interval, const TcpInfoCallback &cb);
+
+            // 开启周期采样 TCP_INFO（右值引用）
+            void EnableTcpInfoSampling(int32_t interval, TcpInfoCallback &&cb);
+
+            // 停止周期采样 TCP_INFO
+            void DisableTcpInfoSampling();
+
+            // 开启单连接的令牌桶限速，发送队列里的数据按速率放出，rate 单位：字节/秒，burst 单位：字节，rate 为 0 表示关闭
+            // 新观众一进来就收到整个 GOP 时，限速可以避免把共享的上行带宽打满，影响其他观众
+            // 和下面两个设置一样，必须在事件循环线程调用，或者在连接加入事件循环之前调用
+            void SetPacing(uint64_t rate, uint64_t burst = 0);
+            // 加入限速组，组里的连接共用一个令牌桶，用于按流或者按租户限速，传空表示退出
+            void SetPacingGroup(const TokenBucketPtr &group);
+            // 设置内核的 SO_MAX_PACING_RATE，单位：字节/秒，由内核平滑地发送，内核不支持时返回 false
+            bool SetMaxPacingRate(uint64_t rate);
+            // 用户态发送队列中还没发送的字节数
+            size_t QueuedBytes() const;
+
+            // 设置流的码率，单位：字节/秒，0 表示不按码率判断；判断发送状态时和 TCP_INFO 的交付速率比较
+            void SetStreamBitrate(uint64_t rate);
+
+            // 发送方向的状态：先看用户态发送队列，配合 SetNotSentLowat 使用时积压能及时反映出来；
+            // 没有积压时再看最近一次 TCP_INFO 采样（SampleTcpInfo 或者周期采样），采样超过 kEgressSampleMaxAgeMs 不用
+            EgressState Egress() const;
+
+            // 发送方向是否拥塞，即 Egress() 不是 kEgressOk
+            bool IsEgressCongested() const;
+
             // 析构函数
             virtual ~TcpConnection();
 
@@ -104,8 +190,30 @@ namespace tmms
             // 在事件循环中发送指定大小的缓冲区数据的函数
             void ExtendLife();
 
+            // 调用写入完成回调
+            void WriteComplete();
+            // 在事件循环中开始优雅关闭
+            void ShutdownInLoop(int32_t timeout);
+            // 发送队列已经发完，半关闭写方向
+            void ShutdownWrite();
+            // 是否开启了限速
+            bool Paced() const;
+            // 从单连接和组的令牌桶里取本次最多可以写的字节数
+            size_t PacingQuota(size_t want);
+            // 没写出去的令牌还回去
+            void PacingRefund(size_t bytes);
+            // 令牌不够时，等攒够了再继续写
+            void SchedulePacing();
+
+            // 安排下一次 TCP_INFO 采样
+            void ScheduleTcpInfoSample(uint32_t seq);
+
             // 连接是否关闭的标志
             bool closed_{false};
+            // 是否已经开始优雅关闭，开始后新的发送直接丢弃
+            bool shutting_down_{false};
+            // 写方向是否已经半关闭
+            bool write_shutdown_{false};
 
             // 关闭连接时的回调函数
             CloseConnectionCallback close_cb_;
@@ -116,18 +224,52 @@ namespace tmms
             // 接收消息时的回调函数
             MessageCallback message_cb_; 
 
+            // 借用引用的接收消息回调
+            MessageRefCallback message_ref_cb_;
+
             // 存储写入事件的数据队列(内存空间连续)，我要写的东西
             std::vector<struct iovec> io_vec_list_;
 
+            // io_vec_list_ 中还没发送的字节数
+            size_t queued_bytes_{0};
+
             // 写入完成时的回调函数
             WriteCompleteCallback write_complete_cb_;
 
+            // 借用引用的写入完成回调
+            WriteCompleteRefCallback write_complete_ref_cb_;
+
             // 声明了一个指向 TimeoutEntry 对象的弱指针，使用弱指针可以避免循环引用，从而防止内存泄漏
             // 弱指针不会管理所指向对象的生命周期，因此可以指向由 std::shared_ptr 管理的对象，而不会阻止该对象被销毁
             std::weak_ptr<TimeoutEntry> timeout_entry_;
 
             // 连接的最大空闲时间，单位:秒
             int32_t max_idle_time_{30};
+
+            // TCP_NOTSENT_LOWAT 的值，0 表示没有设置
+            uint32_t notsent_lowat_{0};
+
+            // 最近一次采样的 TCP_INFO
+            TcpInfo tcp_info_;
+            // 最近一次采样的时间，单位：毫秒，0 表示还没有采样
+            int64_t tcp_info_time_{0};
+            // 流的码率，单位：字节/秒，0 表示不按码率判断
+            uint64_t stream_bitrate_{0};
+
+            // TCP_INFO 采样间隔，单位：秒，0 表示没有开启周期采样
+            int32_t tcp_info_interval_{0};
+
+            // 周期采样的序号，重新开启或停止采样时加一，旧的定时任务发现序号变了就不再继续
+            uint32_t tcp_info_seq_{0};
+
+            // TCP_INFO 采样回调函数
+            TcpInfoCallback tcp_info_cb_;
+            // 单连接的令牌桶
+            TokenBucketPtr pacing_;
+            // 限速组的令牌桶
+            TokenBucketPtr pacing_group_;
+            // 是否已经安排了等令牌的定时任务
+            bool pacing_pending_{false};
         };
 
         // 定义一个超时时间节点
@@ -1,8 +1,56 @@
 #include "UdpSocket.h"
+#include <cstring>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
 #include "network/base/Network.h"
+#include "network/base/SlabPool.h"
+#include "network/base/SocketOpt.h"
+#include "network/base/UdpPacer.h"
 
 using namespace tmms::network;
 
+namespace
+{
+    // 每个接收槽的控制消息缓冲区大小，放得下一个 int 类型的 UDP_GRO 分段大小
+    const size_t kRecvCtrlSize = CMSG_SPACE(sizeof(int));
+    // 开启 UDP_GRO 时接收槽的大小，合并后的数据报不超过一个 IP 包的上限
+    const int32_t kMaxGroSize = 65535;
+    // 定时器只有毫秒精度，离发送时间不到半毫秒的数据报直接发出
+    const uint64_t kTxTimeSlackNs = 500000;
+
+    // 在消息头的控制消息缓冲区里追加一个 SCM_TXTIME，返回新的控制消息长度
+    size_t PutTxTime(struct msghdr *hdr, size_t used, uint64_t txtime)
+    {
+#ifdef SCM_TXTIME
+        struct cmsghdr *cm = (struct cmsghdr *)((char *)hdr->msg_control + used);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_TXTIME;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+        memcpy(CMSG_DATA(cm), &txtime, sizeof(txtime));
+        return used + CMSG_SPACE(sizeof(uint64_t));
+#else
+        return used;
+#endif
+    }
+
+    // 从控制消息里取出 UDP_GRO 的分段大小，没有合并时返回 0
+    size_t GroSegmentSize(struct msghdr *hdr)
+    {
+#ifdef UDP_GRO
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(hdr); cm != nullptr; cm = CMSG_NXTHDR(hdr, cm))
+        {
+            if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+            {
+                int segment = 0;
+                memcpy(&segment, CMSG_DATA(cm), sizeof(segment));
+                return segment > 0 ? segment : 0;
+            }
+        }
+#endif
+        return 0;
+    }
+}
+
 // 初始化UdpSocket对象
 UdpSocket::UdpSocket(EventLoop *loop, int socketfd, const InetAddress &localAddr, const InetAddress &peerAddr)
     : Connection(loop, socketfd, localAddr, peerAddr)   // 调用基类Connection的构造函数，loop: 事件循环对象，socketfd: 套接字文件描述符，localAddr: 本地地址，peerAddr: 远端地址
@@ -35,6 +83,27 @@ void UdpSocket::SetRecvMsgCallback(UdpSocketMessageCallback &&cb)
     message_cb_ = std::move(cb);
 }
 
+// 设置批量接收的回调函数
+void UdpSocket::SetRecvBatchCallback(const UdpSocketBatchCallback &cb)
+{
+    batch_cb_ = cb;
+}
+
+// 设置批量接收的回调函数，使用右值引用来避免拷贝
+void UdpSocket::SetRecvBatchCallback(UdpSocketBatchCallback &&cb)
+{
+    batch_cb_ = std::move(cb);
+}
+
+// 设置一次接收的数据报个数和每个接收槽的大小
+void UdpSocket::SetRecvBatch(int32_t count, int32_t slot_size)
+{
+    recv_batch_ = count > 0 ? count : 1;
+    recv_slot_size_ = slot_size > 0 ? slot_size : kDefaultRecvSlotSize;
+    // 下一次接收时按新的配置重新分配
+    recv_slots_.clear();
+}
+
 // 设置写操作完成时的回调函数
 void UdpSocket::SetWriteCompleteCallback(const UdpSocketWriteCompleteCallback &cb)
 {
@@ -82,7 +151,8 @@ void UdpSocket::OnTimeOut()
 void UdpSocket::EnableCheckIdleTimeout(int32_t max_time)
 {
     // 创建一个超时条目，并将其与当前套接字关联
-    auto tp = std::make_shared<UdpTimeoutEntry>(std::dynamic_pointer_cast<UdpSocket>(shared_from_this()));
+    // 从内存块池里申请超时节点
+    auto tp = MakeSlabShared<UdpTimeoutEntry>(std::dynamic_pointer_cast<UdpSocket>(shared_from_this()));
     // 设置最大空闲时间
     max_idle_time_ = max_time;
     // 保存超时条目
@@ -115,16 +185,365 @@ void UdpSocket::Send(std::list<UdpBufferNodePtr> &list)
 }
 
 // 发送数据，使用缓冲区、大小、地址和长度作为参数
-void UdpSocket::Send(const char *buff, size_t size, struct sockaddr *addr, socklen_t len)
+void UdpSocket::Send(const char *buff, size_t size, const struct sockaddr *addr, socklen_t len)
 {
-    loop_->RunInLoop([this, buff, size, addr, len](){
+    // 地址拷贝一份，任务可能在调用方返回之后才执行
+    struct sockaddr_storage saddr;
+    socklen_t slen = len < sizeof(saddr) ? len : sizeof(saddr);
+    if (addr && slen > 0)
+    {
+        memcpy(&saddr, addr, slen);
+    }
+    loop_->RunInLoop([this, buff, size, saddr, slen](){
         // 在循环中发送数据
-        SendInLoop(buff, size, addr, len);
+        SendInLoop(buff, size, slen > 0 ? (const struct sockaddr *)&saddr : nullptr, slen);
+    });
+}
+
+// 发送一个数据报，需要排队时拷贝
+void UdpSocket::SendCopy(const char *buff, size_t size, const struct sockaddr *addr, socklen_t len)
+{
+    if (!loop_->IsInLoopThread())
+    {
+        // 任务执行时调用方的缓冲区可能已经没了，先拷贝
+        UdpBufferNodePtr node = std::make_shared<UdpOwnedBufferNode>(buff, size, addr, len);
+        loop_->RunInLoop([this, node]()
+                         { SendNodeInLoop(node); });
+        return;
+    }
+    if (closed_ || SendToNow(buff, size, addr, len))
+    {
+        return;
+    }
+    // 只有排队的数据报才拷贝
+    QueueNode(MakeSlabShared<UdpOwnedBufferNode>(buff, size, addr, len));
+}
+
+// 队列为空时直接发送，发不出去时把节点放进发送队列
+void UdpSocket::SendNodeInLoop(const UdpBufferNodePtr &node)
+{
+    if (closed_ || SendToNow((const char *)node->addr, node->size, node->sock_addr, node->sock_len))
+    {
+        return;
+    }
+    QueueNode(node);
+}
+
+// 发送队列为空时尝试直接发送，发出去了返回 true
+bool UdpSocket::SendToNow(const char *buff, size_t size, const struct sockaddr *addr, socklen_t len, uint64_t txtime)
+{
+    if (!buffer_list_.empty())
+    {
+        return false;
+    }
+    ssize_t ret = 0;
+    if (txtime > 0 && txtime_kernel_)
+    {
+        struct iovec iov;
+        iov.iov_base = (void *)buff;
+        iov.iov_len = size;
+        union
+        {
+            char buf[CMSG_SPACE(sizeof(uint64_t))];
+            struct cmsghdr align;
+        } ctrl;
+        struct msghdr hdr;
+        memset(&hdr, 0x00, sizeof(hdr));
+        hdr.msg_name = (void *)addr;
+        hdr.msg_namelen = len;
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = ctrl.buf;
+        hdr.msg_controllen = PutTxTime(&hdr, 0, KernelTxTime(txtime));
+        ret = ::sendmsg(fd_, &hdr, 0);
+    }
+    else
+    {
+        ret = ::sendto(fd_, buff, size, 0, addr, len);
+    }
+    ConnectionStats::Add(stats_.write_calls, 1);
+    if (ret > 0)
+    {
+        ConnectionStats::Add(stats_.bytes_out, ret);
+        ConnectionStats::Add(stats_.msgs_out, 1);
+        return true;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+        ConnectionStats::Add(stats_.eagain, 1);
+    }
+    else if (txtime > 0 && txtime_kernel_ && (errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP))
+    {
+        // 内核不接受发送时间，之后改用定时器，这个数据报排队立即发出
+        NETWORK_WARN << " host : " << peer_addr_.ToIpPort() << " scm_txtime not supported, error : " << errno;
+        txtime_kernel_ = false;
+    }
+    return false;
+}
+
+// 开启或者关闭内核按时间发送
+void UdpSocket::EnableTxTime(bool on, clockid_t clockid)
+{
+    txtime_enabled_ = on;
+    txtime_clock_ = clockid;
+    if (!on)
+    {
+        // SO_TXTIME 没法关闭，不带控制消息就是立即发送
+        txtime_kernel_ = false;
+        return;
+    }
+    if (fd_ > 0)
+    {
+        ApplyTxTime();
+    }
+}
+
+// 是否正在使用内核的 SO_TXTIME
+bool UdpSocket::TxTimeKernel() const
+{
+    return txtime_kernel_;
+}
+
+// 套接字创建之后设置 SO_TXTIME
+void UdpSocket::ApplyTxTime()
+{
+    if (!txtime_enabled_)
+    {
+        return;
+    }
+    SocketOpt opt(fd_);
+    txtime_kernel_ = opt.SetTxTime(txtime_clock_);
+    if (!txtime_kernel_)
+    {
+        NETWORK_WARN << " host : " << peer_addr_.ToIpPort() << " so_txtime not supported, use timer, error : " << errno;
+    }
+}
+
+// 单调时钟的发送时间换算成 SO_TXTIME 设置的时钟，两个时钟各取一次，差值就是偏移
+uint64_t UdpSocket::KernelTxTime(uint64_t txtime) const
+{
+    if (txtime_clock_ == CLOCK_MONOTONIC)
+    {
+        return txtime;
+    }
+    struct timespec ts;
+    ::clock_gettime(txtime_clock_, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return txtime + now - UdpPacer::NowNs();
+}
+
+// etf 丢掉数据报时把原来的数据报连同 SO_EE_ORIGIN_TXTIME 的错误放到错误队列，epoll 报告 EPOLLERR
+// 发送时间已经错过或者时钟和队列规则不一致，之后的数据报多半也一样，改用定时器
+bool UdpSocket::DrainTxTimeErrors()
+{
+#ifdef SO_EE_ORIGIN_TXTIME
+    if (!txtime_enabled_)
+    {
+        return false;
+    }
+    uint64_t reports = 0;
+    uint32_t code = 0;
+    while (true)
+    {
+        // 数据报本身不需要，只取控制消息
+        char data[1];
+        struct iovec iov;
+        iov.iov_base = data;
+        iov.iov_len = sizeof(data);
+        union
+        {
+            char buf[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+            struct cmsghdr align;
+        } ctrl;
+        struct msghdr hdr;
+        memset(&hdr, 0x00, sizeof(hdr));
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = ctrl.buf;
+        hdr.msg_controllen = sizeof(ctrl.buf);
+        if (::recvmsg(fd_, &hdr, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            break;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&hdr); cm != nullptr; cm = CMSG_NXTHDR(&hdr, cm))
+        {
+            if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+            {
+                struct sock_extended_err err;
+                memcpy(&err, CMSG_DATA(cm), sizeof(err));
+                if (err.ee_origin == SO_EE_ORIGIN_TXTIME)
+                {
+                    reports++;
+                    code = err.ee_code;
+                }
+            }
+        }
+    }
+    if (reports > 0 && txtime_kernel_)
+    {
+        NETWORK_WARN << " host : " << peer_addr_.ToIpPort() << " so_txtime dropped " << reports
+                     << " datagrams, code : " << code << ", use timer.";
+        txtime_kernel_ = false;
+    }
+    return reports > 0;
+#else
+    return false;
+#endif
+}
+
+// 在 txtime 发送一个数据报
+void UdpSocket::SendAt(const char *buff, size_t size, const struct sockaddr *addr, socklen_t len, uint64_t txtime)
+{
+    if (!loop_->IsInLoopThread())
+    {
+        UdpBufferNodePtr node = std::make_shared<UdpOwnedBufferNode>(buff, size, addr, len);
+        node->txtime = txtime;
+        loop_->RunInLoop([this, node]()
+                         { SendAtInLoop(node); });
+        return;
+    }
+    if (closed_)
+    {
+        return;
+    }
+    // 内核模式和已经到时间的数据报先直接发送，发不出去再拷贝
+    bool due = txtime <= UdpPacer::NowNs() + kTxTimeSlackNs;
+    if ((txtime_kernel_ || due) && SendToNow(buff, size, addr, len, due ? 0 : txtime))
+    {
+        return;
+    }
+    UdpBufferNodePtr node = MakeSlabShared<UdpOwnedBufferNode>(buff, size, addr, len);
+    node->txtime = due ? 0 : txtime;
+    if (txtime_kernel_ || due)
+    {
+        QueueNode(node);
+        return;
+    }
+    SendAtInLoop(node);
+}
+
+// 带发送时间的节点
+void UdpSocket::SendAtInLoop(const UdpBufferNodePtr &node)
+{
+    if (closed_)
+    {
+        return;
+    }
+    if (node->txtime <= UdpPacer::NowNs() + kTxTimeSlackNs)
+    {
+        node->txtime = 0;
+    }
+    if (node->txtime == 0 || txtime_kernel_)
+    {
+        if (!SendToNow((const char *)node->addr, node->size, node->sock_addr, node->sock_len, node->txtime))
+        {
+            QueueNode(node);
+        }
+        return;
+    }
+    TxTimeEntry entry;
+    entry.txtime = node->txtime;
+    entry.seq = tx_pending_seq_++;
+    entry.node = node;
+    tx_pending_bytes_ += node->size;
+    tx_pending_.push(std::move(entry));
+    ArmTxTimer();
+}
+
+// 发出定时队列里到时间的数据报
+void UdpSocket::OnTxTimer(uint64_t when)
+{
+    if (closed_)
+    {
+        return;
+    }
+    // 定时器按毫秒取整，可能比 when 早一点到，最早的定时器到了就要重新设置，否则队列停住
+    if (tx_timer_at_ == when)
+    {
+        tx_timer_at_ = 0;
+    }
+    uint64_t now = UdpPacer::NowNs();
+    while (!tx_pending_.empty() && tx_pending_.top().txtime <= now + kTxTimeSlackNs)
+    {
+        auto node = tx_pending_.top().node;
+        tx_pending_.pop();
+        tx_pending_bytes_ -= node->size;
+        node->txtime = 0;
+        if (!SendToNow((const char *)node->addr, node->size, node->sock_addr, node->sock_len))
+        {
+            QueueNode(node);
+        }
+        if (closed_)
+        {
+            return;
+        }
+    }
+    ArmTxTimer();
+}
+
+// 按定时队列里最早的发送时间设置定时器，已经有更早的定时器时不用再设
+void UdpSocket::ArmTxTimer()
+{
+    if (tx_pending_.empty())
+    {
+        return;
+    }
+    uint64_t when = tx_pending_.top().txtime;
+    if (tx_timer_at_ != 0 && tx_timer_at_ <= when)
+    {
+        return;
+    }
+    tx_timer_at_ = when;
+    uint64_t now = UdpPacer::NowNs();
+    // 向上取整到毫秒，宁可晚一点也不提前
+    int64_t delay = when > now ? (int64_t)((when - now + 999999) / 1000000) : 0;
+    std::weak_ptr<UdpSocket> weak = std::dynamic_pointer_cast<UdpSocket>(shared_from_this());
+    loop_->RunAfterMs(delay, [weak, when]()
+                      {
+        auto socket = weak.lock();
+        if (socket)
+        {
+            socket->OnTxTimer(when);
+        } });
+}
+
+// 定时器模式下还没到发送时间的字节数
+size_t UdpSocket::PendingTxBytes() const
+{
+    return tx_pending_bytes_;
+}
+
+// 把节点放进发送队列，等可写时再发
+void UdpSocket::QueueNode(const UdpBufferNodePtr &node)
+{
+    buffer_list_.emplace_back(node);
+    queued_bytes_ += node->size;
+    OnWriteQueued(queued_bytes_);
+    EnableWriting(true);
+}
+
+// 发送一串大小相同的数据报给同一个地址
+void UdpSocket::SendSegments(const char *buff, size_t size, uint16_t segment_size, const struct sockaddr *addr, socklen_t len)
+{
+    struct sockaddr_storage saddr;
+    socklen_t slen = len < sizeof(saddr) ? len : sizeof(saddr);
+    if (addr && slen > 0)
+    {
+        memcpy(&saddr, addr, slen);
+    }
+    loop_->RunInLoop([this, buff, size, segment_size, saddr, slen](){
+        SendSegmentsInLoop(buff, size, segment_size, slen > 0 ? (const struct sockaddr *)&saddr : nullptr, slen);
     });
 }
 
 void UdpSocket::OnError(const std::string &msg)
 {
+    // SO_TXTIME 的错误报告不是套接字出错，取出来之后套接字照常使用
+    if (DrainTxTimeErrors())
+    {
+        return;
+    }
     // 记录日志
     NETWORK_TRACE << " host : " << peer_addr_.ToIpPort() << " error : " << msg;
     // 关闭连接
@@ -143,15 +562,37 @@ void UdpSocket::OnRead()
         return;
     }
 
+    // 设置了批量接收回调或者开启了 UDP_GRO 时一次系统调用接收多个数据报
+    if (batch_cb_ || gro_enabled_)
+    {
+        ReadBatch();
+        return;
+    }
+
+    // 本次读事件已经接收的字节数和数据报个数，用于读取预算
+    size_t read_bytes = 0;
+    int32_t read_loops = 0;
+
     // 循环处理接收的数据
     while (true)
     {
+        // 预算用完了，剩余的数据报留到下一轮事件循环再收
+        if (ReadBudgetExhausted(read_bytes, read_loops))
+        {
+            ScheduleRead();
+            break;
+        }
+
         // 定义用于存储接收地址信息的结构体
         struct sockaddr_in6 sock_addr;
         socklen_t len = sizeof(sock_addr);
 
+        // 确保缓冲区有一个完整数据报的空间，缓冲区清空后可能已经把内存还回池里
+        message_buffer_.EnsureWritableBytes(message_buffer_size_);
+
         // 从套接字中接收数据
         auto ret = ::recvfrom(fd_, message_buffer_.BeginWrite(), message_buffer_size_, 0, (struct sockaddr *)&sock_addr, &len);
+        ConnectionStats::Add(stats_.read_calls, 1);
 
         // 如果成功接收到数据
         if (ret > 0)
@@ -160,34 +601,13 @@ void UdpSocket::OnRead()
             InetAddress peeraddr;
             // 更新缓冲区的已写入字节数
             message_buffer_.HasWritten(ret);
+            read_bytes += ret;
+            read_loops++;
+            ConnectionStats::Add(stats_.bytes_in, ret);
+            ConnectionStats::Add(stats_.msgs_in, 1);
 
-            // 根据地址族处理不同的地址格式
-            if (sock_addr.sin6_family == AF_INET)
-            {
-                // IPv4 地址
-                char ip[16] = {0, };
-                // 将 sockaddr_in 转换为指针
-                struct sockaddr_in *saddr = (struct sockaddr_in*)&sock_addr;
-                // 将 IPv4 地址转换为字符串
-                ::inet_ntop(AF_INET, &(saddr->sin_addr.s_addr), ip, sizeof(ip));
-                // 设置对端地址
-                peeraddr.SetAddr(ip);
-                // 设置对端端口
-                peeraddr.SetPort(ntohs(saddr->sin_port));
-            }
-            else if (sock_addr.sin6_family == AF_INET6)
-            {
-                // IPv6 地址
-                char ip[INET6_ADDRSTRLEN] = {0, };
-                // 将 IPv6 地址转换为字符串
-                ::inet_ntop(AF_INET6, &(sock_addr.sin6_addr), ip, sizeof(ip));
-                // 设置对端地址
-                peeraddr.SetAddr(ip);
-                // 设置对端端口
-                peeraddr.SetPort(ntohs(sock_addr.sin6_port));
-                // 标记为 IPv6 地址
-                peeraddr.SetIsIPV6(true);
-            }
+            // 直接保存二进制地址，需要文本时再格式化
+            peeraddr.SetSockAddr((const struct sockaddr *)&sock_addr, len);
 
             // 如果定义了消息回调函数
             if (message_cb_)
@@ -198,6 +618,18 @@ void UdpSocket::OnRead()
 
             // 清空缓冲区
             message_buffer_.RetrieveAll();
+
+            // 回调里可能已经关闭了套接字
+            if (closed_)
+            {
+                break;
+            }
+        }
+        else if (ret == 0)
+        {
+            // 空数据报也算一次读取，防止空包绕过预算
+            read_loops++;
+            ConnectionStats::Add(stats_.msgs_in, 1);
         }
         else if (ret < 0)
         {
@@ -212,6 +644,10 @@ void UdpSocket::OnRead()
                 // 结束函数
                 return;
             }
+            if (errno != EINTR)
+            {
+                ConnectionStats::Add(stats_.eagain, 1);
+            }
             
             // 退出循环
             break;
@@ -219,6 +655,187 @@ void UdpSocket::OnRead()
     }
 }
 
+// 按配置分配接收槽和 recvmmsg 用到的数组
+void UdpSocket::PrepareRecvSlots()
+{
+    // 合并后的数据报最大接近 64KB，接收槽要能放下
+    if (gro_enabled_ && recv_slot_size_ < kMaxGroSize)
+    {
+        recv_slot_size_ = kMaxGroSize;
+    }
+
+    recv_slots_.resize((size_t)recv_batch_ * recv_slot_size_);
+    recv_msgs_.resize(recv_batch_);
+    recv_iovs_.resize(recv_batch_);
+    recv_addrs_.resize(recv_batch_);
+    recv_ctrls_.assign((size_t)recv_batch_ * kRecvCtrlSize, 0);
+    recv_datagrams_.resize(recv_batch_);
+
+    for (int32_t i = 0; i < recv_batch_; i++)
+    {
+        recv_iovs_[i].iov_base = &recv_slots_[(size_t)i * recv_slot_size_];
+        recv_iovs_[i].iov_len = recv_slot_size_;
+
+        memset(&recv_msgs_[i], 0x00, sizeof(struct mmsghdr));
+        recv_msgs_[i].msg_hdr.msg_iov = &recv_iovs_[i];
+        recv_msgs_[i].msg_hdr.msg_iovlen = 1;
+        recv_msgs_[i].msg_hdr.msg_name = &recv_addrs_[i];
+    }
+}
+
+// 把收到的数据报交给业务层，只设置了逐个接收的回调时逐个调用
+void UdpSocket::DeliverBatch(size_t count)
+{
+    if (batch_cb_)
+    {
+        batch_cb_(&recv_datagrams_[0], count);
+        return;
+    }
+    for (size_t i = 0; i < count && !closed_; i++)
+    {
+        auto &dgram = recv_datagrams_[i];
+        InetAddress peeraddr(dgram.addr, dgram.addr_len);
+        message_buffer_.Append(dgram.data, dgram.size);
+        if (message_cb_)
+        {
+            message_cb_(peeraddr, message_buffer_);
+        }
+        message_buffer_.RetrieveAll();
+    }
+}
+
+// 开启或者关闭 UDP_GRO 接收合并
+void UdpSocket::EnableGro(bool on)
+{
+    gro_enabled_ = on;
+    // 接收槽按新的配置重新分配
+    recv_slots_.clear();
+    if (fd_ > 0)
+    {
+        ApplyGro();
+    }
+}
+
+// 套接字创建之后设置 UDP_GRO
+void UdpSocket::ApplyGro()
+{
+    if (!gro_enabled_)
+    {
+        return;
+    }
+    SocketOpt opt(fd_);
+    if (!opt.SetUdpGro(true))
+    {
+        NETWORK_WARN << " host : " << peer_addr_.ToIpPort() << " udp gro not supported, error : " << errno;
+        gro_enabled_ = false;
+        recv_slots_.clear();
+    }
+}
+
+// 用 recvmmsg 批量接收，合并的数据报拆开后交给回调
+void UdpSocket::ReadBatch()
+{
+    if (recv_slots_.empty())
+    {
+        PrepareRecvSlots();
+    }
+
+    // 本次读事件已经接收的字节数和数据报个数，用于读取预算
+    size_t read_bytes = 0;
+    int32_t read_loops = 0;
+
+    while (true)
+    {
+        // 预算用完了，剩余的数据报留到下一轮事件循环再收
+        if (ReadBudgetExhausted(read_bytes, read_loops))
+        {
+            ScheduleRead();
+            break;
+        }
+
+        // 地址长度和控制消息长度是输入输出参数，每次接收前都要重置
+        for (int32_t i = 0; i < recv_batch_; i++)
+        {
+            auto &hdr = recv_msgs_[i].msg_hdr;
+            hdr.msg_namelen = sizeof(struct sockaddr_storage);
+            hdr.msg_control = gro_enabled_ ? &recv_ctrls_[(size_t)i * kRecvCtrlSize] : nullptr;
+            hdr.msg_controllen = gro_enabled_ ? kRecvCtrlSize : 0;
+        }
+
+        auto ret = ::recvmmsg(fd_, &recv_msgs_[0], recv_batch_, 0, nullptr);
+        ConnectionStats::Add(stats_.read_calls, 1);
+
+        if (ret > 0)
+        {
+            size_t bytes = 0;
+            size_t count = 0;
+            for (int i = 0; i < ret; i++)
+            {
+                auto &msg = recv_msgs_[i];
+                bool truncated = (msg.msg_hdr.msg_flags & MSG_TRUNC) != 0;
+                const char *data = (const char *)recv_iovs_[i].iov_base;
+                size_t size = truncated ? recv_slot_size_ : msg.msg_len;
+                // 合并的数据报按分段大小拆开，最后一段可以短一些
+                size_t segment = gro_enabled_ ? GroSegmentSize(&msg.msg_hdr) : 0;
+                if (segment == 0 || segment >= size)
+                {
+                    segment = size;
+                }
+                size_t offset = 0;
+                do
+                {
+                    if (count == recv_datagrams_.size())
+                    {
+                        recv_datagrams_.resize(count * 2);
+                    }
+                    auto &dgram = recv_datagrams_[count++];
+                    dgram.data = data + offset;
+                    dgram.size = size - offset < segment ? size - offset : segment;
+                    dgram.addr = (const struct sockaddr *)&recv_addrs_[i];
+                    dgram.addr_len = msg.msg_hdr.msg_namelen;
+                    dgram.truncated = truncated;
+                    offset += dgram.size;
+                } while (offset < size);
+                bytes += size;
+            }
+            // 空数据报也算一次读取，防止空包绕过预算
+            read_bytes += bytes;
+            read_loops += count;
+            ConnectionStats::Add(stats_.bytes_in, bytes);
+            ConnectionStats::Add(stats_.msgs_in, count);
+
+            DeliverBatch(count);
+
+            // 回调里可能已经关闭了套接字
+            if (closed_)
+            {
+                break;
+            }
+            // 没有收满说明内核队列已经空了，省掉一次返回 EAGAIN 的系统调用
+            if (ret < recv_batch_)
+            {
+                break;
+            }
+        }
+        else
+        {
+            // 如果接收数据出错
+            if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                NETWORK_ERROR << " host : " << peer_addr_.ToIpPort() << " error : " << errno;
+                OnClose();
+                return;
+            }
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            ConnectionStats::Add(stats_.eagain, 1);
+            break;
+        }
+    }
+}
+
 void UdpSocket::OnWrite()
 {
     // 如果套接字已经关闭
@@ -234,56 +851,144 @@ void UdpSocket::OnWrite()
     // 延长对象的生命周期，与事件循环相关
     ExtendLife();
 
-    // 循环处理缓冲区中的数据
-    while (true)
+    // 批量发送队列中的数据，出错时套接字已经关闭
+    if (!FlushSendQueue())
     {
-        // 如果缓冲区不为空
-        if (!buffer_list_.empty())
+        return;
+    }
+
+    // 如果缓冲区为空
+    if (buffer_list_.empty())
+    {
+        queued_bytes_ = 0;
+        OnWriteDrained();
+
+        // 如果定义了写完成的回调函数
+        if (write_complete_cb_)
         {
-            // 获取缓冲区中的第一个数据块
-            auto buf = buffer_list_.front();
-            // 发送数据
-            auto ret = ::sendto(fd_, buf->addr, buf->size, 0, buf->sock_addr, buf->sock_len);
+            // 调用写完成回调函数
+            write_complete_cb_(std::dynamic_pointer_cast<UdpSocket>(shared_from_this()));
+        }
+    }
+}
 
-            // 如果数据发送成功
-            if (ret > 0)
+// 用 sendmmsg 批量发送队列里的数据包，不同的目的地址可以在同一批里
+bool UdpSocket::FlushSendQueue()
+{
+    struct mmsghdr msgs[kSendBatch];
+    struct iovec iovs[kSendBatch];
+    // 每个消息一个放 UDP_SEGMENT 和 SCM_TXTIME 的控制消息缓冲区，按 cmsghdr 对齐
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(uint16_t)) + CMSG_SPACE(sizeof(uint64_t))];
+        struct cmsghdr align;
+    } ctrls[kSendBatch];
+
+    while (!buffer_list_.empty())
+    {
+        int count = 0;
+        for (auto it = buffer_list_.begin(); it != buffer_list_.end() && count < kSendBatch; ++it, ++count)
+        {
+            auto &buf = *it;
+            auto &hdr = msgs[count].msg_hdr;
+            memset(&msgs[count], 0x00, sizeof(struct mmsghdr));
+            iovs[count].iov_base = buf->addr;
+            iovs[count].iov_len = buf->size;
+            hdr.msg_iov = &iovs[count];
+            hdr.msg_iovlen = 1;
+            hdr.msg_name = buf->sock_addr;
+            hdr.msg_namelen = buf->sock_len;
+            hdr.msg_control = ctrls[count].buf;
+            size_t ctrl_len = 0;
+#ifdef UDP_SEGMENT
+            // 多个数据报的节点带上分段大小，一次发出
+            if (buf->Segments() > 1)
             {
-                // 从缓冲区中移除已发送的数据块
-                buffer_list_.pop_front();
+                struct cmsghdr *cm = (struct cmsghdr *)ctrls[count].buf;
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segment = buf->segment_size;
+                memcpy(CMSG_DATA(cm), &segment, sizeof(segment));
+                ctrl_len = CMSG_SPACE(sizeof(uint16_t));
             }
-            // 如果发送失败
-            else if (ret < 0)
+#endif
+            // 写满时排队的数据报也要带上发送时间
+            if (buf->txtime > 0 && txtime_kernel_)
             {
-                // 如果错误不是由中断、资源暂时不可用等常见原因引起的
-                if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
-                {
-                    // 输出错误信息
-                    NETWORK_ERROR << " host : " << peer_addr_.ToIpPort() << " error : " << errno;
-                    // 处理关闭操作
-                    OnClose();
-
-                    // 结束函数
-                    return;
-                }
-
-                // 如果是可恢复的错误，退出循环
-                break;
+                ctrl_len = PutTxTime(&hdr, ctrl_len, KernelTxTime(buf->txtime));
+            }
+            hdr.msg_controllen = ctrl_len;
+            if (ctrl_len == 0)
+            {
+                hdr.msg_control = nullptr;
             }
         }
 
-        // 如果缓冲区为空
-        if (buffer_list_.empty())
+        auto ret = ::sendmmsg(fd_, msgs, count, 0);
+        ConnectionStats::Add(stats_.write_calls, 1);
+
+        // 前 ret 个发送成功，空数据报也算发送成功，否则会一直重试
+        if (ret > 0)
         {
-            // 如果定义了写完成的回调函数
-            if (write_complete_cb_)
+            for (int i = 0; i < ret; i++)
             {
-                // 调用写完成回调函数
-                write_complete_cb_(std::dynamic_pointer_cast<UdpSocket>(shared_from_this()));
+                auto &buf = buffer_list_.front();
+                ConnectionStats::Add(stats_.bytes_out, buf->size);
+                ConnectionStats::Add(stats_.msgs_out, buf->Segments());
+                queued_bytes_ -= buf->size;
+                // 从缓冲区中移除已发送的数据块
+                buffer_list_.pop_front();
             }
+            continue;
+        }
 
-            // 退出循环
+        // 第一个数据包就没有发出去
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            ConnectionStats::Add(stats_.eagain, 1);
             break;
         }
+        // 内核或者出口网卡不支持 UDP_SEGMENT，拆成单个数据报重新发送
+        if ((errno == EIO || errno == EINVAL || errno == ENOPROTOOPT) && buffer_list_.front()->Segments() > 1)
+        {
+            NETWORK_WARN << " host : " << peer_addr_.ToIpPort() << " udp gso not supported, error : " << errno;
+            gso_enabled_ = false;
+            SplitSegments();
+            continue;
+        }
+
+        // 输出错误信息
+        NETWORK_ERROR << " host : " << peer_addr_.ToIpPort() << " error : " << errno;
+        // 处理关闭操作
+        OnClose();
+        return false;
+    }
+    return true;
+}
+
+// 把队列里的多数据报节点拆成单个数据报的节点
+void UdpSocket::SplitSegments()
+{
+    for (auto it = buffer_list_.begin(); it != buffer_list_.end();)
+    {
+        auto buf = *it;
+        if (buf->Segments() <= 1)
+        {
+            ++it;
+            continue;
+        }
+        it = buffer_list_.erase(it);
+        auto data = (char *)buf->addr;
+        for (size_t offset = 0; offset < buf->size; offset += buf->segment_size)
+        {
+            size_t len = buf->size - offset < buf->segment_size ? buf->size - offset : buf->segment_size;
+            buffer_list_.insert(it, MakeSlabShared<UdpBufferNode>(data + offset, len, buf->sock_addr, buf->sock_len));
+        }
     }
 }
 
@@ -294,6 +999,10 @@ void UdpSocket::OnClose()
     {
         // 标记套接字为关闭状态
         closed_ = true;
+        OnWriteDrained();
+        // 还没到发送时间的数据报不再发送
+        tx_pending_ = decltype(tx_pending_)();
+        tx_pending_bytes_ = 0;
 
         // 如果定义了关闭回调函数
         if (close_cb_)
@@ -320,40 +1029,102 @@ void UdpSocket::SendInLoop(std::list<UdpBufferNodePtr> &list)
     // 将传入的缓冲区节点列表添加到套接字的缓冲区列表中
     for (auto &i : list)
     {
+        queued_bytes_ += i->size;
         buffer_list_.emplace_back(i);
     }
 
     // 如果缓冲区列表不为空，则启用写操作
     if (!buffer_list_.empty())
     {
+        OnWriteQueued(queued_bytes_);
         EnableWriting(true);
     }
 }
 
-void UdpSocket::SendInLoop(const char *buff, size_t size, struct sockaddr *saddr, socklen_t len)
+void UdpSocket::SendInLoop(const char *buff, size_t size, const struct sockaddr *saddr, socklen_t len)
 {
     // 如果缓冲区列表为空，尝试立即发送数据
     if (buffer_list_.empty())
     {
         // 尝试发送数据
         auto ret = ::sendto(fd_, buff, size, 0, saddr, len);
+        ConnectionStats::Add(stats_.write_calls, 1);
 
         // 如果发送成功，直接返回
         if (ret > 0)
         {
+            ConnectionStats::Add(stats_.bytes_out, ret);
+            ConnectionStats::Add(stats_.msgs_out, 1);
             return ;
         }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            ConnectionStats::Add(stats_.eagain, 1);
+        }
     }
 
     // 如果立即发送失败，或者缓冲区列表不为空，将数据添加到缓冲区列表中
-    auto node = std::make_shared<UdpBufferNode>((void*)buff, size, saddr, len);
+    auto node = MakeSlabShared<UdpBufferNode>((void*)buff, size, saddr, len);
 
     buffer_list_.emplace_back(node);
+    queued_bytes_ += size;
+    OnWriteQueued(queued_bytes_);
 
     // 如果立即发送失败，或者缓冲区列表不为空，将数据添加到缓冲区列表中
     EnableWriting(true);
 }
 
+// 把一串数据报按 UDP_SEGMENT 的限制切成若干节点放进发送队列
+void UdpSocket::SendSegmentsInLoop(const char *buff, size_t size, uint16_t segment_size, const struct sockaddr *saddr, socklen_t len)
+{
+    if (closed_)
+    {
+        return;
+    }
+    // 没有分段大小时整个缓冲区是一个数据报
+    if (segment_size == 0 || segment_size >= size)
+    {
+        SendInLoop(buff, size, saddr, len);
+        return;
+    }
+
+    // 一次 UDP_SEGMENT 最多 64 个分段，总长度不能超过一个 UDP 数据报的上限
+    const size_t kMaxSegments = 64;
+    const size_t kMaxGsoBytes = 65507;
+    size_t per_node = 1;
+#ifdef UDP_SEGMENT
+    if (gso_enabled_ && segment_size <= kMaxGsoBytes)
+    {
+        per_node = kMaxGsoBytes / segment_size;
+        if (per_node > kMaxSegments)
+        {
+            per_node = kMaxSegments;
+        }
+    }
+#endif
+
+    bool was_empty = buffer_list_.empty();
+    size_t chunk = per_node * segment_size;
+    for (size_t offset = 0; offset < size; offset += chunk)
+    {
+        size_t bytes = size - offset < chunk ? size - offset : chunk;
+        buffer_list_.emplace_back(MakeSlabShared<UdpBufferNode>((void *)(buff + offset), bytes, saddr, len,
+                                                                per_node > 1 ? segment_size : 0));
+        queued_bytes_ += bytes;
+    }
+
+    // 队列原来是空的，不用等可写事件，直接发送
+    if (was_empty && !FlushSendQueue())
+    {
+        return;
+    }
+    if (!buffer_list_.empty())
+    {
+        OnWriteQueued(queued_bytes_);
+        EnableWriting(true);
+    }
+}
+
 UdpSocket::~UdpSocket()
 {
     // 析构函数，释放 UdpSocket 对象时调用
@@ -1,7 +1,13 @@
 #pragma once
 #include <list>
+#include <queue>
+#include <vector>
+#include <cstring>
 #include <functional>
 #include <memory>
+#include <string>
+#include <ctime>
+#include <sys/socket.h>
 #include "network/base/InetAddress.h"
 #include "network/base/MsgBuffer.h"
 #include "network/net/EventLoop.h"
@@ -20,6 +26,29 @@ namespace tmms
         // 定义UdpSocket的智能指针类型，处理接收到的消息
         using UdpSocketMessageCallback = std::function<void (const InetAddress &addr, MsgBuffer &buff)>;
 
+        // 批量接收的一个数据报，data 和 addr 指向套接字内部的接收槽，只在回调期间有效，需要保留时自己拷贝
+        struct UdpDatagram
+        {
+            // 数据报内容
+            const char *data{nullptr};
+            // 数据报长度，截断时是接收槽的大小
+            size_t size{0};
+            // 对端地址，二进制格式，需要字符串时再自己转换
+            const struct sockaddr *addr{nullptr};
+            // 对端地址长度
+            socklen_t addr_len{0};
+            // 数据报比接收槽大，超出的部分被内核丢弃了
+            bool truncated{false};
+        };
+
+        // 批量接收回调，一次 recvmmsg 收到的所有数据报一起交给业务层
+        using UdpSocketBatchCallback = std::function<void(const UdpDatagram *msgs, size_t count)>;
+
+        // 一次 recvmmsg 最多接收的数据报个数
+        const int32_t kDefaultRecvBatch = 16;
+        // 每个接收槽的大小，能放下一个以太网 MTU 的数据报
+        const int32_t kDefaultRecvSlotSize = 2048;
+
         // 定义UdpSocket的智能指针类型，处理写入完成事件
         using UdpSocketWriteCompleteCallback = std::function<void (const UdpSocketPtr &)>;
 
@@ -32,19 +61,58 @@ namespace tmms
         // 结构体前向声明
         struct UdpTimeoutEntry;
 
+        // 一次 sendmmsg 最多发送的数据包个数
+        const int32_t kSendBatch = 32;
+
         // 定义UdpBufferNode类，继承自BufferNode，用于存储UDP数据包的信息
+        // 目的地址拷贝一份保存在节点里，调用方的地址可以是栈上的临时变量
         struct UdpBufferNode : public BufferNode
         {
-            UdpBufferNode(void *buff, size_t s, struct sockaddr *saddr, socklen_t len)
+            // segment 不为 0 时 buff 里是多个 segment 字节的数据报（最后一个可以短一些），发给同一个地址
+            UdpBufferNode(void *buff, size_t s, const struct sockaddr *saddr, socklen_t len, uint16_t segment = 0)
                 : BufferNode(buff, s)
-                , sock_addr(saddr)
-                , sock_len(len)
-            {}
+                , segment_size(segment)
+            {
+                if (saddr && len > 0)
+                {
+                    sock_len = len < sizeof(sock_storage) ? len : sizeof(sock_storage);
+                    memcpy(&sock_storage, saddr, sock_len);
+                    sock_addr = (struct sockaddr *)&sock_storage;
+                }
+            }
+            // sock_addr 指向自己的 sock_storage，不能拷贝
+            UdpBufferNode(const UdpBufferNode &) = delete;
+            UdpBufferNode &operator=(const UdpBufferNode &) = delete;
+
+            // 包含的数据报个数
+            size_t Segments() const
+            {
+                return segment_size > 0 && size > segment_size ? (size + segment_size - 1) / segment_size : 1;
+            }
 
-            // 存储地址信息
+            // 目的地址的拷贝
+            struct sockaddr_storage sock_storage;
+            // 存储地址信息，指向 sock_storage，已连接的套接字为空
             struct sockaddr *sock_addr{nullptr};
             // 存储地址长度
             socklen_t sock_len{0};
+            // 每个数据报的大小，为 0 表示整个缓冲区是一个数据报
+            uint16_t segment_size{0};
+            // 开启 SO_TXTIME 时的发送时间，CLOCK_MONOTONIC 纳秒，0 表示立即发送
+            uint64_t txtime{0};
+        };
+
+        // 自己持有一份数据拷贝的节点，调用方的缓冲区在发送完成之前就会被释放或者改写时使用
+        struct UdpOwnedBufferNode : public UdpBufferNode
+        {
+            UdpOwnedBufferNode(const char *buff, size_t s, const struct sockaddr *saddr, socklen_t len)
+                : UdpBufferNode(nullptr, s, saddr, len)
+                , data(buff, s)
+            {
+                addr = (void *)data.data();
+            }
+
+            std::string data;
         };
 
         // 定义UdpBufferNodePtr的智能指针类型，用于管理UdpBufferNode对象的生命周期
@@ -69,6 +137,21 @@ namespace tmms
             // 设置接收到消息的回调函数，接受右值引用，允许使用临时对象
             void SetRecvMsgCallback(UdpSocketMessageCallback &&cb);
 
+            // 设置批量接收的回调函数，设置后用 recvmmsg 一次接收多个数据报，不再调用逐个接收的回调
+            void SetRecvBatchCallback(const UdpSocketBatchCallback &cb);
+
+            // 设置批量接收的回调函数，接受右值引用，允许使用临时对象
+            void SetRecvBatchCallback(UdpSocketBatchCallback &&cb);
+
+            // 设置一次接收的数据报个数和每个接收槽的大小，比接收槽大的数据报会被截断
+            // 在启动之前或者事件循环线程里调用
+            void SetRecvBatch(int32_t count, int32_t slot_size);
+
+            // 开启或者关闭 UDP_GRO 接收合并，合并的大数据报按控制消息里的分段大小拆回单个数据报再交给回调
+            // 开启后走 recvmmsg 批量接收，接收槽扩大到能放下一个合并后的数据报
+            // 套接字还没创建时记下来，UdpServer/UdpClient 打开套接字时设置
+            void EnableGro(bool on);
+
             // 设置写入完成的回调函数
             void SetWriteCompleteCallback(const UdpSocketWriteCompleteCallback &cb);
 
@@ -91,7 +174,36 @@ namespace tmms
             void Send(std::list<UdpBufferNodePtr> &list);
 
             // 重载的Send方法，允许直接发送一个字符缓冲区。buff是要发送的数据，size是数据的大小，addr是目标地址，len是地址的长度
-            void Send(const char *buff, size_t size, struct sockaddr *addr, socklen_t len);
+            // 地址在调用时拷贝，buff 要保持有效直到发送完成
+            void Send(const char *buff, size_t size, const struct sockaddr *addr, socklen_t len);
+
+            // 发送一个数据报，能立即发出时直接发送，需要排队时拷贝一份放进发送队列，返回后 buff 就可以释放或者改写
+            // 不在事件循环线程调用时先拷贝再投递
+            void SendCopy(const char *buff, size_t size, const struct sockaddr *addr, socklen_t len);
+
+            // 发送一串大小相同的数据报给同一个地址，buff 里依次是 segment_size 字节的数据报，最后一个可以短一些
+            // 内核支持 UDP_SEGMENT 时一次系统调用发出一整串，由内核（或者网卡）切分；不支持时退化成逐个数据报批量发送
+            // 地址在调用时拷贝，buff 要保持有效直到发送完成
+            void SendSegments(const char *buff, size_t size, uint16_t segment_size, const struct sockaddr *addr, socklen_t len);
+
+            // 开启或者关闭内核按时间发送（SO_TXTIME），开启后 SendAt 的数据报带上发送时间直接交给内核，
+            // 由出口的 fq 或者 etf 队列规则到时间再发出；关闭或者内核不支持时 SendAt 用用户态的毫秒定时器排队
+            // clockid 要和队列规则一致：fq 用 CLOCK_MONOTONIC，etf 用它配置的时钟（一般是 CLOCK_TAI），
+            // 发送时间在交给内核前从单调时钟换算过去
+            // 内核在错误队列里报告丢弃的数据报（发送时间已过、时钟不对）时，改用定时器，之后的数据报不再交给内核
+            // 出口没有配置 fq/etf 时内核会忽略发送时间立即发出，这种情况要关闭，改用定时器
+            // 套接字还没创建时记下来，UdpServer/UdpClient 打开套接字时设置
+            void EnableTxTime(bool on, clockid_t clockid = CLOCK_MONOTONIC);
+
+            // 是否正在使用内核的 SO_TXTIME
+            bool TxTimeKernel() const;
+
+            // 在 txtime（CLOCK_MONOTONIC 纳秒，一般由 UdpPacer 算出）发送一个数据报，已经过了的时间立即发送
+            // 和 SendCopy 一样，需要排队时拷贝，返回后 buff 就可以释放或者改写
+            void SendAt(const char *buff, size_t size, const struct sockaddr *addr, socklen_t len, uint64_t txtime);
+
+            // 定时器模式下还没到发送时间的字节数
+            size_t PendingTxBytes() const;
             
             // 重写错误事件的处理方法（从基类继承而来），msg 参数包含错误信息
             void OnError(const std::string &msg) override;
@@ -111,19 +223,72 @@ namespace tmms
             // 析构函数
             ~UdpSocket();
 
+        protected:
+            // 套接字创建之后设置 UDP_GRO，内核不支持时退回普通接收
+            void ApplyGro();
+
+            // 套接字创建之后设置 SO_TXTIME，内核不支持时退回定时器
+            void ApplyTxTime();
+            // 取出错误队列里 SO_TXTIME 的错误报告，有的话退回定时器，返回是否取到了
+            bool DrainTxTimeErrors();
+            // 单调时钟的发送时间换算成 SO_TXTIME 设置的时钟
+            uint64_t KernelTxTime(uint64_t txtime) const;
+
         private:
             // 延长某个对象或连接的生命周期
             void ExtendLife();
 
+            // 用 recvmmsg 批量接收，合并的数据报拆开后交给回调
+            void ReadBatch();
+
+            // 按配置分配接收槽和 recvmmsg 用到的数组
+            void PrepareRecvSlots();
+
+            // 把 recv_datagrams_ 里的前 count 个数据报交给回调
+            void DeliverBatch(size_t count);
+
             // 循环发送队列中的数据，表示要在循环中发送的数据包
             void SendInLoop(std::list<UdpBufferNodePtr> &list);
 
             // 方法重载，允许直接发送一个字符缓冲区，buff是要发送的数据，size是数据的大小，saddr是目标地址，len是地址的长度
-            void SendInLoop(const char *buff, size_t size, struct sockaddr *saddr, socklen_t len);
+            void SendInLoop(const char *buff, size_t size, const struct sockaddr *saddr, socklen_t len);
+
+            // 队列为空时直接发送，发不出去时把节点放进发送队列
+            void SendNodeInLoop(const UdpBufferNodePtr &node);
+
+            // 发送队列为空时尝试直接发送，发出去了返回 true，txtime 不为 0 时带上 SCM_TXTIME
+            bool SendToNow(const char *buff, size_t size, const struct sockaddr *addr, socklen_t len, uint64_t txtime = 0);
+
+            // 带发送时间的节点，内核模式直接发送，定时器模式没到时间的放进定时队列
+            void SendAtInLoop(const UdpBufferNodePtr &node);
+
+            // 发出定时队列里到时间的数据报，when 是这个定时器对应的发送时间
+            void OnTxTimer(uint64_t when);
+
+            // 按定时队列里最早的发送时间设置定时器
+            void ArmTxTimer();
+
+            // 把节点放进发送队列，等可写时再发
+            void QueueNode(const UdpBufferNodePtr &node);
+
+            // 把一串数据报按 UDP_SEGMENT 的限制切成若干节点放进发送队列
+            void SendSegmentsInLoop(const char *buff, size_t size, uint16_t segment_size, const struct sockaddr *saddr, socklen_t len);
+
+            // 用 sendmmsg 批量发送队列里的数据包，发生不可恢复的错误关闭套接字后返回 false
+            bool FlushSendQueue();
+
+            // 内核不支持 UDP_SEGMENT 时，把队列里的多数据报节点拆成单个数据报的节点
+            void SplitSegments();
 
             // 存储待发送的UDP数据包列表，使用std::list允许动态添加和删除数据包
             std::list<UdpBufferNodePtr> buffer_list_; 
 
+            // buffer_list_ 中还没发送的字节数
+            size_t queued_bytes_{0};
+
+            // 是否使用 UDP_SEGMENT，发送时内核报告不支持后关闭
+            bool gso_enabled_{true};
+
             // 标记连接是否关闭，默认值为false，表示连接是打开的
             bool closed_{false};  
 
@@ -142,6 +307,58 @@ namespace tmms
             // 消息回调，用于处理接收到的消息
             UdpSocketMessageCallback message_cb_;  
 
+            // 批量接收回调
+            UdpSocketBatchCallback batch_cb_;
+
+            // 一次接收的数据报个数
+            int32_t recv_batch_{kDefaultRecvBatch};
+
+            // 每个接收槽的大小
+            int32_t recv_slot_size_{kDefaultRecvSlotSize};
+
+            // 所有接收槽连在一起的内存，第一次批量接收时分配，之后一直复用
+            std::vector<char> recv_slots_;
+
+            // recvmmsg 的消息头、数据缓冲区和对端地址，和接收槽一一对应
+            std::vector<struct mmsghdr> recv_msgs_;
+            std::vector<struct iovec> recv_iovs_;
+            std::vector<struct sockaddr_storage> recv_addrs_;
+
+            // 每个接收槽的控制消息缓冲区，放 UDP_GRO 的分段大小
+            std::vector<char> recv_ctrls_;
+
+            // 交给批量接收回调的数据报，合并的数据报拆开后可能比接收槽多
+            std::vector<UdpDatagram> recv_datagrams_;
+
+            // 是否开启了 UDP_GRO
+            bool gro_enabled_{false};
+
+            // 定时队列里的一个数据报，按发送时间排序，时间相同的按进入的顺序
+            struct TxTimeEntry
+            {
+                uint64_t txtime{0};
+                uint64_t seq{0};
+                UdpBufferNodePtr node;
+
+                bool operator>(const TxTimeEntry &other) const
+                {
+                    return txtime != other.txtime ? txtime > other.txtime : seq > other.seq;
+                }
+            };
+
+            // 要求使用 SO_TXTIME
+            bool txtime_enabled_{false};
+            // SO_TXTIME 设置成功，发送时带上控制消息
+            bool txtime_kernel_{false};
+            // SO_TXTIME 使用的时钟
+            clockid_t txtime_clock_{CLOCK_MONOTONIC};
+            // 定时器模式下还没到时间的数据报
+            std::priority_queue<TxTimeEntry, std::vector<TxTimeEntry>, std::greater<TxTimeEntry>> tx_pending_;
+            uint64_t tx_pending_seq_{0};
+            size_t tx_pending_bytes_{0};
+            // 已经设置的最早的定时器，0 表示没有
+            uint64_t tx_timer_at_{0};
+
             // 写入完成回调，用于处理写入完成的事件
             UdpSocketWriteCompleteCallback write_complete_cb_; 
 
@@ -0,0 +1,238 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "base/AsyncLog.h"
+#include "base/LogStream.h"
+#include "TestUtil.h"
+
+using namespace tmms::base;
+
+static std::string ReadFile(const std::string &path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// 打开一个新的日志文件
+static FileLogPtr OpenLog(const std::string &path)
+{
+    ::unlink(path.c_str());
+    auto log = std::make_shared<FileLog>();
+    log->Open(path);
+    return log;
+}
+
+// 打开一个 FIFO 作为日志文件，不读的话后台线程写满管道后阻塞，用来模拟磁盘卡住
+static FileLogPtr OpenFifo(const std::string &path, int *reader)
+{
+    ::unlink(path.c_str());
+    ::mkfifo(path.c_str(), 0600);
+    // 先以非阻塞方式打开读端，写端打开时才不会阻塞
+    *reader = ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
+    auto log = std::make_shared<FileLog>();
+    log->Open(path);
+    return log;
+}
+
+// 读空管道，返回读到的字节数
+static size_t Drain(int fd)
+{
+    size_t total = 0;
+    char buf[65536];
+    while (true)
+    {
+        auto n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+int main(int argc, const char **argv)
+{
+    // 1. 多个线程并发写：每一行完整，每个线程的行保持顺序，一行都不少
+    {
+        const std::string path = "/tmp/tmms_async_log_test.log";
+        auto async = std::make_shared<AsyncLog>(OpenLog(path), 4096, 4);
+        async->SetOverflowPolicy(kLogOverflowBlock);
+        async->Start();
+        const int kThreads = 4;
+        const int kLines = 20000;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; t++)
+        {
+            threads.emplace_back([&async, t]()
+                                 {
+                for (int i = 0; i < kLines; i++)
+                {
+                    auto line = "t" + std::to_string(t) + " n" + std::to_string(i) + "\n";
+                    async->Append(line.data(), line.size());
+                } });
+        }
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+        async->Stop();
+        CHECK(async->Dropped() == 0);
+
+        std::ifstream in(path);
+        std::string line;
+        std::vector<int> next(kThreads, 0);
+        int total = 0;
+        while (std::getline(in, line))
+        {
+            int t = -1, n = -1;
+            CHECK(sscanf(line.c_str(), "t%d n%d", &t, &n) == 2);
+            CHECK(t >= 0 && t < kThreads);
+            CHECK(n == next[t]);
+            next[t]++;
+            total++;
+        }
+        CHECK(total == kThreads * kLines);
+        ::unlink(path.c_str());
+    }
+
+    // 2. 没写满的缓冲按刷新间隔写出；Flush 等待之前的日志写完
+    {
+        const std::string path = "/tmp/tmms_async_log_flush.log";
+        auto async = std::make_shared<AsyncLog>(OpenLog(path));
+        async->SetFlushInterval(100);
+        async->Start();
+        async->Append("interval\n", 9);
+        CHECK(WaitFor([&path]()
+                      { return ReadFile(path) == "interval\n"; }, 1000));
+        async->Append("flush\n", 6);
+        async->Flush();
+        CHECK(ReadFile(path) == "interval\nflush\n");
+        async->Stop();
+        ::unlink(path.c_str());
+    }
+
+    // 3. 文件写不动时按丢弃策略：写日志的线程不阻塞，丢弃计数，恢复后写一条提示
+    {
+        const std::string path = "/tmp/tmms_async_log_drop.fifo";
+        int reader = -1;
+        auto async = std::make_shared<AsyncLog>(OpenFifo(path, &reader), 4096, 4);
+        async->Start();
+        std::string line(100, 'd');
+        line.back() = '\n';
+        // 管道 64KB 写满后后台线程阻塞，再写满 4 个缓冲后开始丢弃
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 5000; i++)
+        {
+            async->Append(line.data(), line.size());
+        }
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "drop policy: dropped " << async->Dropped() << " in " << ms << " ms" << std::endl;
+        CHECK(async->Dropped() > 0);
+        CHECK(ms < 1000);
+
+        size_t total = 0;
+        CHECK(WaitFor([&]()
+                      { total += Drain(reader);
+                        return async->Written() + async->Dropped() * line.size() >= 5000 * line.size(); }, 3000));
+        async->Append(line.data(), line.size());
+        async->Stop();
+        total += Drain(reader);
+        // 写出的字节比日志多出一条丢弃提示
+        CHECK(total > async->Written());
+        CHECK(async->Written() == (5001 - async->Dropped()) * line.size());
+        ::close(reader);
+        ::unlink(path.c_str());
+    }
+
+    // 4. 阻塞策略：文件写不动时写日志的线程等待，恢复后全部写出，不丢日志
+    {
+        const std::string path = "/tmp/tmms_async_log_block.fifo";
+        int reader = -1;
+        auto async = std::make_shared<AsyncLog>(OpenFifo(path, &reader), 4096, 4);
+        async->SetOverflowPolicy(kLogOverflowBlock);
+        async->Start();
+        std::string line(100, 'b');
+        line.back() = '\n';
+        const int kLines = 5000;
+        std::atomic<bool> finished{false};
+        std::thread producer([&]()
+                             {
+            for (int i = 0; i < kLines; i++)
+            {
+                async->Append(line.data(), line.size());
+            }
+            finished = true; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        // 管道和缓冲加起来装不下，生产者还在等
+        CHECK(!finished);
+        size_t total = 0;
+        CHECK(WaitFor([&]()
+                      { total += Drain(reader);
+                        return finished.load(); }, 3000));
+        async->Stop();
+        total += Drain(reader);
+        CHECK(async->Dropped() == 0);
+        CHECK(total == kLines * line.size());
+        producer.join();
+        ::close(reader);
+        ::unlink(path.c_str());
+    }
+
+    // 5. 接到 Logger 上：LOG_INFO 的日志经过后台线程写到文件
+    {
+        const std::string path = "/tmp/tmms_async_log_logger.log";
+        auto log = OpenLog(path);
+        auto async = std::make_shared<AsyncLog>(log);
+        async->SetFlushInterval(60000);
+        async->Start();
+        Logger logger(log);
+        logger.SetLogLevel(kInfo);
+        logger.SetAsyncLog(async);
+        g_logger = &logger;
+        LOG_INFO << "through async " << 42;
+        g_logger = nullptr;
+        // 还在缓冲里，没有写到文件
+        CHECK(ReadFile(path).empty());
+        async->Flush();
+        CHECK(ReadFile(path).find("through async 42") != std::string::npos);
+        async->Stop();
+        ::unlink(path.c_str());
+    }
+
+    // 6. 崩溃时写出缓冲里的日志：子进程写日志后 abort，刷新间隔很长，日志只可能是崩溃处理写出的
+    {
+        const std::string path = "/tmp/tmms_async_log_crash.log";
+        ::unlink(path.c_str());
+        pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            auto async = std::make_shared<AsyncLog>(OpenLog(path));
+            async->SetFlushInterval(60000);
+            async->Start();
+            AsyncLog::InstallCrashHandler(async);
+            async->Append("before crash\n", 13);
+            ::abort();
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+        CHECK(ReadFile(path) == "before crash\n");
+        ::unlink(path.c_str());
+    }
+
+    return TestPassed("AsyncLogTest");
+}
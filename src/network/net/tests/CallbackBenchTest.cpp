@@ -0,0 +1,121 @@
+#include <iostream>
+#include <chrono>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "network/net/EventLoop.h"
+#include "network/net/TcpConnection.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+using Clock = std::chrono::steady_clock;
+
+// 两个时间点之间平均每次的纳秒数
+static double NsPer(Clock::time_point begin, Clock::time_point end, int count)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / static_cast<double>(count);
+}
+
+// 在 socketpair 上驱动 OnRead，每次写 1 个字节，测量一次读事件的开销
+static double BenchOnRead(const TcpConnectionPtr &con, int peer, int count)
+{
+    char ch = 'x';
+    auto begin = Clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        if (::write(peer, &ch, 1) != 1)
+        {
+            return -1;
+        }
+        con->OnRead();
+    }
+    return NsPer(begin, Clock::now(), count);
+}
+
+int main(int argc, const char **argv)
+{
+    const int kEvents = 1000000;
+    const int kDispatch = 10000000;
+
+    // 不运行事件循环，只用它的线程归属，OnRead 直接在当前线程调用
+    EventLoop loop;
+    int fds[2];
+    CHECK(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    auto con = std::make_shared<TcpConnection>(&loop, fds[1], InetAddress(), InetAddress());
+    con->SetReadBudget(0, 0);
+
+    // 1. 单纯的回调分发开销：旧的 dynamic_pointer_cast、Self()（static_pointer_cast）、借用引用
+    {
+        MsgBuffer buff;
+        buff.Append("x");
+        uint64_t sum = 0;
+        MessageCallback ptr_cb = [&sum](const TcpConnectionPtr &c, MsgBuffer &b)
+        { sum += b.ReadableBytes(); };
+        MessageRefCallback ref_cb = [&sum](TcpConnection &c, MsgBuffer &b)
+        { sum += b.ReadableBytes(); };
+        TcpConnection &ref = *con;
+
+        auto begin = Clock::now();
+        for (int i = 0; i < kDispatch; i++)
+        {
+            ptr_cb(std::dynamic_pointer_cast<TcpConnection>(ref.shared_from_this()), buff);
+        }
+        auto dynamic_ns = NsPer(begin, Clock::now(), kDispatch);
+
+        begin = Clock::now();
+        for (int i = 0; i < kDispatch; i++)
+        {
+            ptr_cb(ref.Self(), buff);
+        }
+        auto static_ns = NsPer(begin, Clock::now(), kDispatch);
+
+        begin = Clock::now();
+        for (int i = 0; i < kDispatch; i++)
+        {
+            ref_cb(ref, buff);
+        }
+        auto ref_ns = NsPer(begin, Clock::now(), kDispatch);
+
+        CHECK(sum == 3ull * kDispatch);
+        std::cout << "dispatch dynamic_pointer_cast: " << dynamic_ns << " ns" << std::endl;
+        std::cout << "dispatch Self()              : " << static_ns << " ns" << std::endl;
+        std::cout << "dispatch borrowed reference  : " << ref_ns << " ns" << std::endl;
+    }
+
+    // 2. 完整的读事件：read + 回调 + 读到 EAGAIN
+    {
+        uint64_t bytes = 0;
+        con->SetRecvMsgCallback([&bytes](const TcpConnectionPtr &c, MsgBuffer &b)
+                                {
+            bytes += b.ReadableBytes();
+            b.RetrieveAll(); });
+        auto ptr_ns = BenchOnRead(con, fds[0], kEvents);
+
+        con->SetRecvMsgRefCallback([&bytes](TcpConnection &c, MsgBuffer &b)
+                                   {
+            bytes += b.ReadableBytes();
+            b.RetrieveAll(); });
+        auto ref_ns = BenchOnRead(con, fds[0], kEvents);
+
+        CHECK(ptr_ns > 0 && ref_ns > 0);
+        CHECK(bytes == 2ull * kEvents);
+        std::cout << "OnRead shared_ptr callback : " << ptr_ns << " ns/event" << std::endl;
+        std::cout << "OnRead borrowed callback   : " << ref_ns << " ns/event" << std::endl;
+    }
+
+    // 3. 回调里取得所有权后，连接在回调之外仍然有效
+    {
+        TcpConnectionPtr kept;
+        con->SetRecvMsgRefCallback([&kept](TcpConnection &c, MsgBuffer &b)
+                                   {
+            kept = c.Self();
+            b.RetrieveAll(); });
+        char ch = 'y';
+        CHECK(::write(fds[0], &ch, 1) == 1);
+        con->OnRead();
+        CHECK(kept == con);
+    }
+
+    ::close(fds[0]);
+    return TestPassed("CallbackBenchTest");
+}
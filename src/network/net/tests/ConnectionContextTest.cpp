@@ -0,0 +1,101 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "network/net/EventLoop.h"
+#include "network/net/TcpConnection.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 没有固定槽位的上下文类型，走 contexts_ 的查找
+const int kExtraContext = kContextSlots + 10;
+
+// 记录析构次数的上下文
+struct CountedContext
+{
+    explicit CountedContext(int v, int *destroyed)
+        : value(v), destroyed(destroyed)
+    {
+    }
+    ~CountedContext()
+    {
+        (*destroyed)++;
+    }
+    int value{0};
+    int *destroyed{nullptr};
+};
+
+int main(int argc, const char **argv)
+{
+    // 不运行事件循环，上下文的读写都在当前线程
+    EventLoop loop;
+    int fds[2];
+    CHECK(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    auto con = std::make_shared<TcpConnection>(&loop, fds[1], InetAddress(), InetAddress());
+    int destroyed = 0;
+
+    // 1. 固定槽位：三种读取方式拿到同一个对象，没有设置的槽位为空
+    {
+        CHECK(con->GetContextPtr<CountedContext>(kRtmpContext) == nullptr);
+        CHECK((con->Context<kRtmpContext, CountedContext>()) == nullptr);
+        CHECK(!con->GetContext<CountedContext>(kRtmpContext));
+
+        auto rtmp = std::make_shared<CountedContext>(1, &destroyed);
+        con->SetContext(kRtmpContext, rtmp);
+        CHECK(con->GetContextPtr<CountedContext>(kRtmpContext) == rtmp.get());
+        CHECK((con->Context<kRtmpContext, CountedContext>()) == rtmp.get());
+        CHECK(con->GetContext<CountedContext>(kRtmpContext) == rtmp);
+        // 裸指针的读取不增加引用计数
+        CHECK(rtmp.use_count() == 2);
+
+        // 右值设置，槽位之间互不影响
+        con->SetContext(kHttpContext, std::make_shared<CountedContext>(2, &destroyed));
+        CHECK(con->GetContextPtr<CountedContext>(kHttpContext)->value == 2);
+        CHECK(con->GetContextPtr<CountedContext>(kRtmpContext)->value == 1);
+        CHECK(con->GetContextPtr<CountedContext>(kFlvContext) == nullptr);
+    }
+
+    // 2. 覆盖和清除固定槽位都会释放旧的上下文
+    {
+        con->SetContext(kHttpContext, std::make_shared<CountedContext>(3, &destroyed));
+        CHECK(destroyed == 1);
+        CHECK((con->Context<kHttpContext, CountedContext>())->value == 3);
+        con->ClearContext(kHttpContext);
+        CHECK(destroyed == 2);
+        CHECK(con->GetContextPtr<CountedContext>(kHttpContext) == nullptr);
+        CHECK(con->GetContextPtr<CountedContext>(kRtmpContext)->value == 1);
+    }
+
+    // 3. 没有固定槽位的类型（超出范围和负数）退回到查找表，和固定槽位互不影响
+    {
+        CHECK(con->GetContextPtr<CountedContext>(kExtraContext) == nullptr);
+        CHECK(!con->GetContext<CountedContext>(kExtraContext));
+
+        auto extra = std::make_shared<CountedContext>(4, &destroyed);
+        con->SetContext(kExtraContext, extra);
+        con->SetContext(-1, std::make_shared<CountedContext>(5, &destroyed));
+        CHECK(con->GetContextPtr<CountedContext>(kExtraContext) == extra.get());
+        CHECK(con->GetContext<CountedContext>(kExtraContext) == extra);
+        CHECK(con->GetContextPtr<CountedContext>(-1)->value == 5);
+        CHECK(con->GetContextPtr<CountedContext>(kRtmpContext)->value == 1);
+
+        con->ClearContext(kExtraContext);
+        CHECK(con->GetContextPtr<CountedContext>(kExtraContext) == nullptr);
+        CHECK(extra.use_count() == 1);
+        CHECK(con->GetContextPtr<CountedContext>(-1)->value == 5);
+    }
+
+    // 4. 清除全部：固定槽位和查找表里的上下文都释放
+    {
+        int before = destroyed;
+        con->ClearContext();
+        CHECK(destroyed == before + 2);
+        CHECK(con->GetContextPtr<CountedContext>(kRtmpContext) == nullptr);
+        CHECK(con->GetContextPtr<CountedContext>(-1) == nullptr);
+    }
+
+    ::close(fds[0]);
+    return TestPassed("ConnectionContextTest");
+}
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <string>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "network/net/EventLoop.h"
+#include "network/net/EventLoopThread.h"
+#include "network/TcpServer.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 服务端发给客户端的数据，足够大，客户端不读的时候会在服务端积压
+static std::string g_send_data(4 * 1024 * 1024, 's');
+
+// 客户端发给服务端的字节数
+static const size_t kClientBytes = 100 * 1024;
+
+int main(int argc, const char **argv)
+{
+    EventLoopThread eventloop_thread;
+    eventloop_thread.Run();
+    EventLoop *loop = eventloop_thread.Loop();
+    CHECK(loop != nullptr);
+
+    InetAddress listen("127.0.0.1:34561");
+    TcpServer server(loop, listen);
+
+    // 服务端收到的数据直接丢弃
+    server.SetMessageCallback([](const TcpConnectionPtr &con, MsgBuffer &buff)
+                              { buff.RetrieveAll(); });
+
+    // 新连接上来后一次性发送大量数据
+    TcpConnectionPtr server_con;
+    server.SetNewConnectionCallback([&server_con](const TcpConnectionPtr &con)
+                                    {
+        server_con = con;
+        con->Send(g_send_data.data(), g_send_data.size()); });
+    // 内核发送缓冲区只保留少量未发送数据，积压留在用户态
+    server.SetNotSentLowat(16 * 1024);
+    server.Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    CHECK(fd >= 0);
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(34561);
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    CHECK(::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    // 客户端发送数据，但先不读，让服务端的发送队列积压一段时间
+    std::string client_data(kClientBytes, 'c');
+    CHECK(::write(fd, client_data.data(), client_data.size()) == (ssize_t)client_data.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // 客户端不读，服务端的发送方向应该是拥塞的，TCP_INFO 能采样到
+    {
+        std::promise<bool> congested;
+        std::promise<bool> sampled;
+        std::promise<EgressState> state;
+        loop->RunInLoop([&server_con, &congested, &sampled, &state]()
+                        {
+            congested.set_value(server_con->IsEgressCongested());
+            sampled.set_value(server_con->SampleTcpInfo());
+            state.set_value(server_con->Egress()); });
+        CHECK(congested.get_future().get());
+        CHECK(sampled.get_future().get());
+        CHECK(state.get_future().get() == kEgressBacklogged);
+    }
+
+    // 读完服务端发来的全部数据
+    size_t total = 0;
+    char buf[64 * 1024];
+    while (total < g_send_data.size())
+    {
+        auto n = ::read(fd, buf, sizeof(buf));
+        CHECK(n > 0);
+        total += n;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // 读完之后不再拥塞，周期采样能收到回调
+    {
+        std::promise<bool> congested;
+        loop->RunInLoop([&server_con, &congested]()
+                        { congested.set_value(server_con->IsEgressCongested()); });
+        CHECK(!congested.get_future().get());
+
+        // 码率远高于交付速率，但内核里没有等着发的数据，空闲不算拥塞
+        std::promise<EgressState> state;
+        loop->RunInLoop([&server_con, &state]()
+                        {
+            server_con->SetStreamBitrate(UINT64_MAX);
+            server_con->SampleTcpInfo();
+            state.set_value(server_con->Egress()); });
+        CHECK(state.get_future().get() == kEgressOk);
+
+        std::promise<TcpInfo> sample;
+        bool done = false;
+        server_con->EnableTcpInfoSampling(1, [&sample, &done](const TcpConnectionPtr &con, const TcpInfo &info)
+                                          {
+            if (!done)
+            {
+                done = true;
+                con->DisableTcpInfoSampling();
+                sample.set_value(info);
+            } });
+        auto info = sample.get_future().get();
+        std::cout << "rtt_us:" << info.rtt_us << " snd_cwnd:" << info.snd_cwnd << " snd_mss:" << info.snd_mss
+                  << " notsent_bytes:" << info.notsent_bytes << " delivery_rate:" << info.delivery_rate << std::endl;
+        CHECK(info.snd_mss > 0 && info.snd_cwnd > 0);
+    }
+
+    // 在事件循环线程里收集统计快照
+    std::promise<std::vector<ConnectionStatsSnapshot>> promise;
+    server.GetConnectionStats([&promise](const std::vector<ConnectionStatsSnapshot> &list)
+                              { promise.set_value(list); });
+    auto list = promise.get_future().get();
+    CHECK(list.size() == 1);
+
+    auto &stats = list[0];
+    std::cout << "peer:" << stats.peer
+              << " bytes_in:" << stats.bytes_in
+              << " bytes_out:" << stats.bytes_out
+              << " msgs_in:" << stats.msgs_in
+              << " msgs_out:" << stats.msgs_out
+              << " read_calls:" << stats.read_calls
+              << " write_calls:" << stats.write_calls
+              << " eagain:" << stats.eagain
+              << " peak_queued_bytes:" << stats.peak_queued_bytes
+              << " write_blocked_us:" << stats.write_blocked_us << std::endl;
+
+    CHECK(stats.bytes_in == kClientBytes);
+    CHECK(stats.bytes_out == g_send_data.size());
+    CHECK(stats.msgs_out == 1);
+    CHECK(stats.msgs_in >= 1);
+    CHECK(stats.read_calls > stats.msgs_in);
+    CHECK(stats.write_calls > 1);
+    CHECK(stats.eagain > 0);
+    CHECK(stats.peak_queued_bytes > 0 && stats.peak_queued_bytes < g_send_data.size());
+    CHECK(stats.write_blocked_us >= 100 * 1000);
+
+    server_con.reset();
+    ::close(fd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return TestPassed("ConnectionStatsTest");
+}
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/net/EventLoopThreadPool.h"
+#include "network/TcpServer.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 阻塞方式连接服务器
+static int ConnectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 新连接所在的事件循环和它的 SO_INCOMING_CPU
+struct Accepted
+{
+    std::mutex lock;
+    std::vector<EventLoop *> loops;
+    std::vector<int> cpus;
+    bool in_loop{true};
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        return loops.size();
+    }
+};
+
+static void Record(TcpServer &server, Accepted &accepted)
+{
+    server.SetNewConnectionCallback([&accepted](const TcpConnectionPtr &con)
+                                    {
+        SocketOpt opt(con->Fd());
+        std::lock_guard<std::mutex> lk(accepted.lock);
+        // 新连接回调在连接所在的事件循环里执行
+        accepted.in_loop = accepted.in_loop && con->Loop()->IsInLoopThread();
+        accepted.loops.push_back(con->Loop());
+        accepted.cpus.push_back(opt.GetIncomingCpu()); });
+}
+
+int main(int argc, const char **argv)
+{
+    EventLoopThread acceptor_thread;
+    acceptor_thread.Run();
+    EventLoop *acceptor_loop = acceptor_thread.Loop();
+
+    // 两个线程都绑定在 0 号 CPU 上，只有一个核的机器上也能绑定成功
+    EventLoopThreadPool pool(2, 0, 1);
+    pool.Start();
+    auto loops = pool.GetLoops();
+
+    // 1. 没有绑定的 CPU 按轮询分配，绑定了的按 CPU 找到对应的事件循环
+    {
+        CHECK(pool.GetLoopByCpu(0) == loops[0]);
+        std::set<EventLoop *> picked{pool.GetLoopByCpu(-1), pool.GetLoopByCpu(-1), pool.GetLoopByCpu(1024)};
+        CHECK(picked.size() == 2);
+    }
+
+    // 2. 使用线程池时连接轮询分配到池里的事件循环，不在接受连接的事件循环上
+    {
+        TcpServer server(acceptor_loop, InetAddress("127.0.0.1:34611"));
+        server.SetThreadPool(&pool);
+        Accepted accepted;
+        Record(server, accepted);
+        server.Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        int fds[4];
+        for (auto &fd : fds)
+        {
+            fd = ConnectTo(34611);
+            CHECK(fd >= 0);
+        }
+        CHECK(WaitFor([&]()
+                      { return accepted.Size() == 4; }, 2000));
+        std::set<EventLoop *> used(accepted.loops.begin(), accepted.loops.end());
+        CHECK(accepted.in_loop);
+        CHECK(used.size() == 2);
+        CHECK(used.count(acceptor_loop) == 0);
+
+        // 统计从所有事件循环汇总
+        std::promise<size_t> count;
+        server.GetConnectionStats([&count](const std::vector<ConnectionStatsSnapshot> &list)
+                                  { count.set_value(list.size()); });
+        CHECK(count.get_future().get() == 4);
+
+        // 优雅停止等所有事件循环上的连接都关闭
+        std::promise<void> drained;
+        server.Shutdown(2, [&drained]()
+                        { drained.set_value(); });
+        auto drained_future = drained.get_future();
+        CHECK(drained_future.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout);
+        for (auto fd : fds)
+        {
+            ::close(fd);
+        }
+        CHECK(drained_future.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    }
+
+    // 3. 按 SO_INCOMING_CPU 分配：能读到 CPU 时连接在绑定该 CPU 的事件循环上
+    {
+        TcpServer server(acceptor_loop, InetAddress("127.0.0.1:34612"));
+        server.SetThreadPool(&pool, true);
+        Accepted accepted;
+        Record(server, accepted);
+        server.Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        int fds[2] = {ConnectTo(34612), ConnectTo(34612)};
+        CHECK(fds[0] >= 0 && fds[1] >= 0);
+        CHECK(WaitFor([&]()
+                      { return accepted.Size() == 2; }, 2000));
+        for (size_t i = 0; i < accepted.loops.size(); i++)
+        {
+            std::cout << "incoming cpu: " << accepted.cpus[i] << std::endl;
+            CHECK(accepted.cpus[i] >= -1);
+            CHECK(accepted.loops[i] != acceptor_loop);
+            if (accepted.cpus[i] == 0)
+            {
+                CHECK(accepted.loops[i] == loops[0]);
+            }
+        }
+        ::close(fds[0]);
+        ::close(fds[1]);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    return TestPassed("CpuSteeringTest");
+}
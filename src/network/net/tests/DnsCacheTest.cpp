@@ -0,0 +1,292 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <map>
+#include <atomic>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/DnsService.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+static void Put16(std::string *out, uint16_t v)
+{
+    out->push_back((char)(v >> 8));
+    out->push_back((char)(v & 0xff));
+}
+
+static void Put32(std::string *out, uint32_t v)
+{
+    Put16(out, (uint16_t)(v >> 16));
+    Put16(out, (uint16_t)(v & 0xffff));
+}
+
+// 假 DNS 服务器的应答方式
+enum
+{
+    kReplyAddress = 0,  // 返回一个 A 记录
+    kReplyNxDomain = 1, // NXDOMAIN，SOA 的 minimum 是 ttl
+    kReplySilent = 2,   // 不回复
+};
+
+// 本地的假 DNS 服务器，应答方式可以随时修改，记录每个主机名收到的 A 查询次数
+class FakeDnsServer
+{
+public:
+    explicit FakeDnsServer(uint16_t port)
+    {
+        fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        struct timeval tv = {0, 100000};
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        struct sockaddr_in addr;
+        memset(&addr, 0x00, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(fd_, (struct sockaddr *)&addr, sizeof(addr));
+        thread_ = std::thread([this]()
+                              { Run(); });
+    }
+
+    ~FakeDnsServer()
+    {
+        running_ = false;
+        thread_.join();
+        ::close(fd_);
+    }
+
+    void Set(const std::string &host, int mode, const std::string &ip, uint32_t ttl)
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        auto &r = rules_[host];
+        r.mode = mode;
+        r.ip = ip;
+        r.ttl = ttl;
+    }
+
+    int Queries(const std::string &host)
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        return queries_[host];
+    }
+
+private:
+    struct Rule
+    {
+        int mode{kReplySilent};
+        std::string ip;
+        uint32_t ttl{0};
+    };
+
+    void Run()
+    {
+        char buf[1024];
+        while (running_)
+        {
+            struct sockaddr_in peer;
+            socklen_t len = sizeof(peer);
+            auto n = ::recvfrom(fd_, buf, sizeof(buf), 0, (struct sockaddr *)&peer, &len);
+            if (n <= (ssize_t)kDnsHeaderSize)
+            {
+                continue;
+            }
+            std::string name;
+            size_t pos = kDnsHeaderSize;
+            while (pos < (size_t)n && buf[pos] != 0)
+            {
+                uint8_t l = (uint8_t)buf[pos];
+                if (!name.empty())
+                {
+                    name.push_back('.');
+                }
+                name.append(buf + pos + 1, l);
+                pos += 1 + l;
+            }
+            pos++;
+            uint16_t qtype = ((uint8_t)buf[pos] << 8) | (uint8_t)buf[pos + 1];
+            std::string question(buf + kDnsHeaderSize, pos + 4 - kDnsHeaderSize);
+
+            Rule rule;
+            {
+                std::lock_guard<std::mutex> lk(lock_);
+                if (qtype == kDnsTypeA)
+                {
+                    queries_[name]++;
+                }
+                rule = rules_[name];
+            }
+            if (rule.mode == kReplySilent)
+            {
+                continue;
+            }
+
+            std::string reply(buf, 2);
+            bool nx = rule.mode == kReplyNxDomain;
+            bool answer = !nx && qtype == kDnsTypeA;
+            Put16(&reply, (uint16_t)(0x8180 | (nx ? kDnsRcodeNxDomain : kDnsRcodeNoError)));
+            Put16(&reply, 1);
+            Put16(&reply, answer ? 1 : 0);
+            Put16(&reply, nx ? 1 : 0);
+            Put16(&reply, 0);
+            reply.append(question);
+            if (answer)
+            {
+                struct in_addr a;
+                ::inet_pton(AF_INET, rule.ip.c_str(), &a);
+                Put16(&reply, 0xc00c);
+                Put16(&reply, kDnsTypeA);
+                Put16(&reply, kDnsClassIn);
+                Put32(&reply, rule.ttl);
+                Put16(&reply, 4);
+                reply.append((const char *)&a, 4);
+            }
+            if (nx)
+            {
+                // SOA 的两个名字都用根域名
+                Put16(&reply, 0xc00c);
+                Put16(&reply, kDnsTypeSoa);
+                Put16(&reply, kDnsClassIn);
+                Put32(&reply, 3600);
+                Put16(&reply, 22);
+                reply.push_back('\0');
+                reply.push_back('\0');
+                for (uint32_t v : {1u, 3600u, 600u, 86400u})
+                {
+                    Put32(&reply, v);
+                }
+                Put32(&reply, rule.ttl);
+            }
+            ::sendto(fd_, reply.data(), reply.size(), 0, (struct sockaddr *)&peer, len);
+        }
+    }
+
+    int fd_{-1};
+    std::atomic<bool> running_{true};
+    std::thread thread_;
+    std::mutex lock_;
+    std::map<std::string, Rule> rules_;
+    std::map<std::string, int> queries_;
+};
+
+// 主机名当前的第一个地址，没有时返回空字符串
+static std::string Address(DnsService &service, const std::string &host)
+{
+    auto addr = service.GetHostAddress(host, 0);
+    return addr ? addr->IP() : std::string();
+}
+
+int main(int argc, const char **argv)
+{
+    FakeDnsServer server(34691);
+    server.Set("a.test", kReplyAddress, "10.0.0.1", 2);
+    server.Set("gone.test", kReplyNxDomain, "", 30);
+    server.Set("late.test", kReplyAddress, "10.0.0.9", 60);
+
+    DnsService service;
+    service.SetNameServer(InetAddress("127.0.0.1", (uint16_t)34691));
+    service.SetDnsServiceParam(60 * 1000, 200, 0);
+    service.SetCacheParam(1000, 6000);
+    service.AddHost("a.test");
+    service.AddHost("gone.test");
+
+    // 1. 启动前主机名在缓存里，但没有地址
+    {
+        auto entry = service.GetHostEntry("a.test");
+        CHECK(entry && entry->addrs.empty());
+        CHECK(!service.GetHostEntry("unknown.test"));
+        CHECK(!service.GetHostAddress("a.test", 0));
+    }
+
+    service.Start();
+
+    // 2. 解析成功；不存在的主机名按否定缓存时间缓存，期间不再查询
+    {
+        CHECK(WaitFor([&service]()
+                      { return Address(service, "a.test") == "10.0.0.1"; }, 2000));
+        CHECK(WaitFor([&service]()
+                      { auto e = service.GetHostEntry("gone.test");
+                        return e && e->status == kDnsNotFound; }, 2000));
+        CHECK(service.GetHostAddress("gone.test").empty());
+    }
+
+    // 多个线程不停地读，地址变化和刷新失败的过程中，始终能读到一个有效地址
+    std::atomic<bool> reading{true};
+    std::atomic<int64_t> reads{0};
+    std::atomic<int64_t> misses{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++)
+    {
+        readers.emplace_back([&service, &reading, &reads, &misses, i]()
+                             {
+            while (reading)
+            {
+                auto addr = service.GetHostAddress("a.test", i);
+                if (!addr || addr->IP().compare(0, 7, "10.0.0.") != 0)
+                {
+                    misses++;
+                }
+                reads++;
+            } });
+    }
+
+    // 3. 按 TTL 刷新，记录变化后读到新地址
+    {
+        server.Set("a.test", kReplyAddress, "10.0.0.2", 2);
+        CHECK(WaitFor([&service]()
+                      { return Address(service, "a.test") == "10.0.0.2"; }, 4000));
+        CHECK(server.Queries("a.test") <= 4);
+    }
+
+    // 4. 服务器不回复时继续返回旧地址
+    {
+        server.Set("a.test", kReplySilent, "", 0);
+        CHECK(WaitFor([&service]()
+                      { auto e = service.GetHostEntry("a.test");
+                        return e && e->status == kDnsTimeout; }, 8000));
+        CHECK(Address(service, "a.test") == "10.0.0.2");
+    }
+
+    reading = false;
+    for (auto &t : readers)
+    {
+        t.join();
+    }
+    std::cout << "reads: " << reads << " misses: " << misses << std::endl;
+    CHECK(reads > 0 && misses == 0);
+
+    // 5. 旧地址过期超过 stale 时间后丢弃，服务器恢复后重新解析
+    {
+        CHECK(WaitFor([&service]()
+                      { return Address(service, "a.test").empty(); }, 15000));
+        server.Set("a.test", kReplyAddress, "10.0.0.3", 2);
+        CHECK(WaitFor([&service]()
+                      { return Address(service, "a.test") == "10.0.0.3"; }, 8000));
+        // 否定缓存 30 秒，整个过程只查询了一次
+        CHECK(server.Queries("gone.test") == 1);
+    }
+
+    // 6. 手工设置立即可见；启动后添加的主机立即解析；停止后地址保留
+    {
+        std::vector<InetAddressPtr> list{std::make_shared<InetAddress>("10.9.9.9", (uint16_t)0)};
+        service.UpdateHost("manual.test", list);
+        CHECK(Address(service, "manual.test") == "10.9.9.9");
+
+        service.AddHost("late.test");
+        CHECK(WaitFor([&service]()
+                      { return Address(service, "late.test") == "10.0.0.9"; }, 2000));
+        CHECK(service.GetHosts().size() == 4);
+
+        service.Stop();
+        CHECK(Address(service, "late.test") == "10.0.0.9");
+    }
+
+    return TestPassed("DnsCacheTest");
+}
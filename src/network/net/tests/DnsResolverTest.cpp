@@ -0,0 +1,610 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <map>
+#include <atomic>
+#include <vector>
+#include <fstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/DnsResolver.h"
+#include "network/TcpClient.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+static void Put16(std::string *out, uint16_t v)
+{
+    out->push_back((char)(v >> 8));
+    out->push_back((char)(v & 0xff));
+}
+
+static void Put32(std::string *out, uint32_t v)
+{
+    Put16(out, (uint16_t)(v >> 16));
+    Put16(out, (uint16_t)(v & 0xffff));
+}
+
+// 编码一个名字，不用压缩
+static void PutName(std::string *out, const std::string &name)
+{
+    size_t start = 0;
+    while (start < name.size())
+    {
+        auto dot = name.find('.', start);
+        if (dot == std::string::npos)
+        {
+            dot = name.size();
+        }
+        out->push_back((char)(dot - start));
+        out->append(name, start, dot - start);
+        start = dot + 1;
+    }
+    out->push_back('\0');
+}
+
+// 一条回答记录，名字用指向问题的压缩指针
+static void PutRecord(std::string *out, uint16_t type, uint32_t ttl, const std::string &rdata)
+{
+    Put16(out, 0xc00c);
+    Put16(out, type);
+    Put16(out, kDnsClassIn);
+    Put32(out, ttl);
+    Put16(out, (uint16_t)rdata.size());
+    out->append(rdata);
+}
+
+// 一条回答记录，名字不压缩
+static void PutNamedRecord(std::string *out, const std::string &name, uint16_t type, uint32_t ttl, const std::string &rdata)
+{
+    PutName(out, name);
+    Put16(out, type);
+    Put16(out, kDnsClassIn);
+    Put32(out, ttl);
+    Put16(out, (uint16_t)rdata.size());
+    out->append(rdata);
+}
+
+static std::string V4(const char *ip)
+{
+    struct in_addr a;
+    ::inet_pton(AF_INET, ip, &a);
+    return std::string((const char *)&a, 4);
+}
+
+static std::string V6(const char *ip)
+{
+    struct in6_addr a;
+    ::inet_pton(AF_INET6, ip, &a);
+    return std::string((const char *)&a, 16);
+}
+
+// 本地的假 DNS 服务器，按主机名返回预先定好的应答，记录每个主机名收到的查询次数
+class FakeDnsServer
+{
+public:
+    explicit FakeDnsServer(uint16_t port)
+    {
+        fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        struct timeval tv = {0, 100000};
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        struct sockaddr_in addr;
+        memset(&addr, 0x00, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(fd_, (struct sockaddr *)&addr, sizeof(addr));
+        thread_ = std::thread([this]()
+                              { Run(); });
+    }
+
+    ~FakeDnsServer()
+    {
+        running_ = false;
+        thread_.join();
+        ::close(fd_);
+    }
+
+    // 某个主机名收到的 A 查询次数
+    int Queries(const std::string &host)
+    {
+        std::lock_guard<std::mutex> lk(lock_);
+        return queries_[host];
+    }
+
+private:
+    void Run()
+    {
+        char buf[1024];
+        while (running_)
+        {
+            struct sockaddr_in peer;
+            socklen_t len = sizeof(peer);
+            auto n = ::recvfrom(fd_, buf, sizeof(buf), 0, (struct sockaddr *)&peer, &len);
+            if (n <= (ssize_t)kDnsHeaderSize)
+            {
+                continue;
+            }
+            // 解析问题：名字和类型
+            std::string name;
+            size_t pos = kDnsHeaderSize;
+            while (pos < (size_t)n && buf[pos] != 0)
+            {
+                uint8_t l = (uint8_t)buf[pos];
+                if (!name.empty())
+                {
+                    name.push_back('.');
+                }
+                name.append(buf + pos + 1, l);
+                pos += 1 + l;
+            }
+            pos++;
+            uint16_t qtype = ((uint8_t)buf[pos] << 8) | (uint8_t)buf[pos + 1];
+            std::string question(buf + kDnsHeaderSize, pos + 4 - kDnsHeaderSize);
+            uint16_t id = ((uint8_t)buf[0] << 8) | (uint8_t)buf[1];
+            int count = 0;
+            if (qtype == kDnsTypeA)
+            {
+                std::lock_guard<std::mutex> lk(lock_);
+                count = ++queries_[name];
+            }
+            std::string forged, reply;
+            if (!Answer(name, qtype, id, question, count, &forged, &reply))
+            {
+                continue;
+            }
+            if (!forged.empty())
+            {
+                ::sendto(fd_, forged.data(), forged.size(), 0, (struct sockaddr *)&peer, len);
+            }
+            ::sendto(fd_, reply.data(), reply.size(), 0, (struct sockaddr *)&peer, len);
+        }
+    }
+
+    // 按主机名组织应答，返回 false 表示不回复；forged 不为空时在应答之前先发出去
+    bool Answer(const std::string &name, uint16_t qtype, uint16_t id, const std::string &question, int count,
+                std::string *forged, std::string *out)
+    {
+        uint8_t rcode = kDnsRcodeNoError;
+        std::string answers, authority;
+        uint16_t ancount = 0, nscount = 0;
+        bool v6 = qtype == kDnsTypeAaaa;
+
+        if (name == "media.example.com")
+        {
+            if (v6)
+            {
+                PutRecord(&answers, kDnsTypeAaaa, 60, V6("fd00::1"));
+                ancount = 1;
+            }
+            else
+            {
+                PutRecord(&answers, kDnsTypeA, 300, V4("10.0.0.1"));
+                PutRecord(&answers, kDnsTypeA, 300, V4("10.0.0.2"));
+                ancount = 2;
+            }
+        }
+        else if (name == "alias.example.com" && !v6)
+        {
+            // 别名指向 edge.example.com，别名的 TTL 更短
+            std::string target;
+            PutName(&target, "edge.example.com");
+            PutRecord(&answers, kDnsTypeCname, 30, target);
+            // 地址记录的名字指向上一条记录的 rdata（问题之后 12 字节）
+            Put16(&answers, (uint16_t)(0xc000 | (kDnsHeaderSize + question.size() + 12)));
+            Put16(&answers, kDnsTypeA);
+            Put16(&answers, kDnsClassIn);
+            Put32(&answers, 300);
+            Put16(&answers, 4);
+            answers.append(V4("10.0.0.3"));
+            ancount = 2;
+        }
+        else if (name == "missing.example.com" || (name == "alias.example.com" && v6) ||
+                 (name == "v4only.example.com" && v6) || (name == "local.example.com" && v6))
+        {
+            // NXDOMAIN 或者 NODATA，授权部分带 SOA，TTL 900，minimum 120
+            if (name == "missing.example.com")
+            {
+                rcode = kDnsRcodeNxDomain;
+            }
+            Put16(&authority, 0xc00c);
+            Put16(&authority, kDnsTypeSoa);
+            Put16(&authority, kDnsClassIn);
+            Put32(&authority, 900);
+            std::string soa;
+            PutName(&soa, "ns.example.com");
+            PutName(&soa, "admin.example.com");
+            for (uint32_t v : {1u, 3600u, 600u, 86400u, 120u})
+            {
+                Put32(&soa, v);
+            }
+            Put16(&authority, (uint16_t)soa.size());
+            authority.append(soa);
+            nscount = 1;
+        }
+        else if (name == "v4only.example.com")
+        {
+            PutRecord(&answers, kDnsTypeA, 100, V4("10.0.0.4"));
+            ancount = 1;
+        }
+        else if (name == "local.example.com")
+        {
+            PutRecord(&answers, kDnsTypeA, 100, V4("127.0.0.1"));
+            ancount = 1;
+        }
+        else if (name == "slow.example.com")
+        {
+            // 第一次的 A 查询不回复，重发后才回复
+            if (!v6 && count == 1)
+            {
+                return false;
+            }
+            if (!v6)
+            {
+                PutRecord(&answers, kDnsTypeA, 100, V4("10.0.0.5"));
+                ancount = 1;
+            }
+        }
+        else if (name == "dead.example.com")
+        {
+            return false;
+        }
+        else if (name == "fail.example.com")
+        {
+            rcode = kDnsRcodeServFail;
+        }
+        else if (name == "spoof.example.com")
+        {
+            // 先发一个 ID 不对的应答，再发正确的
+            if (!v6)
+            {
+                Put16(forged, (uint16_t)(id + 1));
+                Put16(forged, 0x8180);
+                Put16(forged, 1);
+                Put16(forged, 1);
+                Put16(forged, 0);
+                Put16(forged, 0);
+                forged->append(question);
+                PutRecord(forged, kDnsTypeA, 100, V4("6.6.6.6"));
+                PutRecord(&answers, kDnsTypeA, 100, V4("10.0.0.6"));
+                ancount = 1;
+            }
+        }
+        else if (name == "inject.example.com" && !v6)
+        {
+            // 夹带别的名字的地址记录和不在别名链上的别名，只有问题的名字的记录有效
+            std::string target;
+            PutName(&target, "evil.example.com");
+            PutNamedRecord(&answers, "other.example.com", kDnsTypeCname, 5, target);
+            PutNamedRecord(&answers, "evil.example.com", kDnsTypeA, 5, V4("6.6.6.6"));
+            PutNamedRecord(&answers, "other.example.com", kDnsTypeA, 5, V4("6.6.6.7"));
+            PutRecord(&answers, kDnsTypeA, 100, V4("10.0.0.7"));
+            ancount = 4;
+        }
+        else if (name == "api.svc.example.com" && !v6)
+        {
+            PutRecord(&answers, kDnsTypeA, 100, V4("10.0.0.8"));
+            ancount = 1;
+        }
+        else if (name.compare(0, 1, "h") == 0 && !v6)
+        {
+            PutRecord(&answers, kDnsTypeA, 100, V4("10.1.0.1"));
+            ancount = 1;
+        }
+
+        out->clear();
+        Put16(out, id);
+        Put16(out, (uint16_t)(0x8180 | rcode));
+        Put16(out, 1);
+        Put16(out, ancount);
+        Put16(out, nscount);
+        Put16(out, 0);
+        out->append(question);
+        out->append(answers);
+        out->append(authority);
+        return true;
+    }
+
+    int fd_{-1};
+    std::atomic<bool> running_{true};
+    std::thread thread_;
+    std::mutex lock_;
+    std::map<std::string, int> queries_;
+};
+
+// 同步等待一次解析的结果
+static DnsResult ResolveSync(const DnsResolverPtr &resolver, const std::string &host, int ms = 5000)
+{
+    std::mutex lock;
+    bool done = false;
+    DnsResult result;
+    resolver->Resolve(host, [&](const std::string &, const DnsResult &r)
+                      {
+        std::lock_guard<std::mutex> lk(lock);
+        result = r;
+        done = true; });
+    WaitFor([&]()
+            {
+        std::lock_guard<std::mutex> lk(lock);
+        return done; }, ms);
+    std::lock_guard<std::mutex> lk(lock);
+    return result;
+}
+
+int main(int argc, const char **argv)
+{
+    // 1. 报文编解码：不合法的主机名编码失败，压缩指针成环的应答解码失败
+    {
+        std::string out;
+        CHECK(DnsPacket::EncodeQuery(1, "Www.Example.com.", kDnsTypeA, &out));
+        CHECK(out.size() == kDnsHeaderSize + 17 + 4);
+        CHECK(!DnsPacket::EncodeQuery(1, "a..b", kDnsTypeA, &out));
+        CHECK(!DnsPacket::EncodeQuery(1, std::string(64, 'a') + ".com", kDnsTypeA, &out));
+        CHECK(!DnsPacket::EncodeQuery(1, "", kDnsTypeA, &out));
+
+        std::string loop;
+        Put16(&loop, 1);
+        Put16(&loop, 0x8180);
+        Put16(&loop, 1);
+        Put16(&loop, 0);
+        Put16(&loop, 0);
+        Put16(&loop, 0);
+        Put16(&loop, 0xc00c);
+        Put16(&loop, kDnsTypeA);
+        Put16(&loop, kDnsClassIn);
+        DnsResponse resp;
+        CHECK(!DnsPacket::DecodeResponse(loop.data(), loop.size(), &resp));
+    }
+
+    FakeDnsServer server(34681);
+    EventLoopThread loop_thread;
+    loop_thread.Run();
+    EventLoop *loop = loop_thread.Loop();
+
+    auto resolver = std::make_shared<DnsResolver>(loop, InetAddress("127.0.0.1", (uint16_t)34681));
+    resolver->SetTimeout(1, 1);
+    resolver->Start();
+
+    // 2. A 和 AAAA 一起查询，TTL 取最小的
+    {
+        auto r = ResolveSync(resolver, "media.example.com");
+        CHECK(r.status == kDnsOk);
+        CHECK(r.addrs.size() == 3);
+        CHECK(r.addrs[0]->IsIpV6() && r.addrs[0]->IP() == "fd00::1");
+        CHECK(r.addrs[1]->IP() == "10.0.0.1" && r.addrs[2]->IP() == "10.0.0.2");
+        CHECK(r.ttl == 60);
+    }
+
+    // 3. 别名：压缩指针指向别名记录里的名字，TTL 受别名限制
+    {
+        auto r = ResolveSync(resolver, "alias.example.com");
+        CHECK(r.status == kDnsOk);
+        CHECK(r.addrs.size() == 1 && r.addrs[0]->IP() == "10.0.0.3");
+        CHECK(r.ttl == 30);
+    }
+
+    // 4. 不存在：否定缓存时间取 SOA 的 TTL 和 minimum 中较小的；只有 A 记录的也算成功
+    {
+        auto r = ResolveSync(resolver, "missing.example.com");
+        CHECK(r.status == kDnsNotFound);
+        CHECK(r.ttl == 120);
+        r = ResolveSync(resolver, "v4only.example.com");
+        CHECK(r.status == kDnsOk && r.addrs.size() == 1 && r.ttl == 100);
+        r = ResolveSync(resolver, "fail.example.com");
+        CHECK(r.status == kDnsError);
+    }
+
+    // 5. 超时重发，重试用完后以超时结束；ID 不对的伪造应答被丢弃
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto r = ResolveSync(resolver, "slow.example.com");
+        CHECK(r.status == kDnsOk && r.addrs[0]->IP() == "10.0.0.5");
+        CHECK(server.Queries("slow.example.com") == 2);
+        r = ResolveSync(resolver, "dead.example.com", 8000);
+        CHECK(r.status == kDnsTimeout);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "retry and timeout took " << ms << " ms" << std::endl;
+        CHECK(server.Queries("dead.example.com") == 2);
+        CHECK(ms < 8000);
+
+        r = ResolveSync(resolver, "spoof.example.com");
+        CHECK(r.status == kDnsOk);
+        CHECK(r.addrs.size() == 1 && r.addrs[0]->IP() == "10.0.0.6");
+
+        // 名字不在别名链上的记录被丢弃，TTL 也不受它们影响
+        r = ResolveSync(resolver, "inject.example.com");
+        CHECK(r.status == kDnsOk);
+        CHECK(r.addrs.size() == 1 && r.addrs[0]->IP() == "10.0.0.7");
+        CHECK(r.ttl == 100);
+    }
+
+    // 6. 同时进行多个查询，同一个主机名的请求合并成一次查询
+    {
+        std::atomic<int> done{0};
+        std::atomic<int> ok{0};
+        const int kHosts = 50;
+        for (int i = 0; i < kHosts; i++)
+        {
+            resolver->Resolve("h" + std::to_string(i) + ".example.com", [&](const std::string &, const DnsResult &r)
+                              {
+                if (r.status == kDnsOk)
+                {
+                    ok++;
+                }
+                done++; });
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            resolver->Resolve("hshared.example.com", [&](const std::string &, const DnsResult &r)
+                              {
+                if (r.status == kDnsOk)
+                {
+                    ok++;
+                }
+                done++; });
+        }
+        CHECK(WaitFor([&]()
+                      { return done == kHosts + 3; }, 5000));
+        CHECK(ok == kHosts + 3);
+        CHECK(server.Queries("hshared.example.com") == 1);
+
+        // IP 字面量不发查询
+        auto r = ResolveSync(resolver, "192.168.1.1");
+        CHECK(r.status == kDnsOk && r.addrs[0]->IP() == "192.168.1.1");
+    }
+
+    // 7. TcpClient 先解析再连接，解析失败通过连接回调报告
+    {
+        int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        struct sockaddr_in addr;
+        memset(&addr, 0x00, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(34682);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        CHECK(::bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        ::listen(listen_fd, 16);
+
+        std::atomic<int> result{-1};
+        auto client = std::make_shared<TcpClient>(loop, InetAddress());
+        client->SetConnectCallback([&result](const TcpConnectionPtr &c, bool connected)
+                                   { result = connected ? 1 : 0; });
+        client->Connect(resolver, "local.example.com", 34682);
+        CHECK(WaitFor([&result]()
+                      { return result >= 0; }, 3000));
+        CHECK(result == 1);
+        client->ForceClose();
+
+        std::atomic<int> failed{-1};
+        auto missing = std::make_shared<TcpClient>(loop, InetAddress());
+        missing->SetConnectCallback([&failed](const TcpConnectionPtr &c, bool connected)
+                                    { failed = connected ? 1 : 0; });
+        missing->Connect(resolver, "missing.example.com", 34682);
+        CHECK(WaitFor([&failed]()
+                      { return failed >= 0; }, 3000));
+        CHECK(failed == 0);
+
+        // 解析期间状态是连接中，期间关闭按连接失败报告一次，解析完成后也不再连接
+        std::atomic<int> closed{0};
+        auto pending = std::make_shared<TcpClient>(loop, InetAddress());
+        pending->SetConnectCallback([&closed](const TcpConnectionPtr &c, bool connected)
+                                    { closed++; });
+        CHECK(pending->Status() == kTcpConStatusInit);
+        pending->Connect(resolver, "dead.example.com", 34682);
+        CHECK(WaitFor([&pending]()
+                      { return pending->Status() == kTcpConStatusConnecting; }, 1000));
+        pending->ForceClose();
+        CHECK(WaitFor([&closed]()
+                      { return closed == 1; }, 1000));
+        CHECK(pending->Status() == kTcpConStatusDisConnected);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ::close(listen_fd);
+    }
+
+    // 8. resolv.conf 和 hosts 文件：静态表里的名字不发查询，短名字按搜索域查询，服务器不可用时换下一个
+    {
+        const char *conf_path = "/tmp/dns_resolver_test_resolv.conf";
+        const char *hosts_path = "/tmp/dns_resolver_test_hosts";
+        {
+            std::ofstream conf(conf_path);
+            conf << "# comment\n"
+                 << "nameserver 127.0.0.1\n"
+                 << "nameserver fe80::1%eth0\n"
+                 << "nameserver ::1\n"
+                 << "domain ignored.example.com\n"
+                 << "search svc.example.com example.com.\n"
+                 << "options timeout:1 ndots:2\n";
+            std::ofstream hosts(hosts_path);
+            hosts << "127.0.0.1 localhost\n"
+                  << "10.9.9.9  static.example.com  Static  # comment\n"
+                  << "fd00::9   static.example.com\n"
+                  << "# 10.9.9.8 commented.example.com\n"
+                  << "bad-ip    bad.example.com\n";
+        }
+        auto config = DnsResolver::SystemConfig(conf_path);
+        CHECK(config.servers.size() == 2);
+        CHECK(config.servers[0].IP() == "127.0.0.1" && config.servers[0].Port() == 53);
+        CHECK(config.servers[1].IsIpV6() && config.servers[1].IP() == "::1");
+        CHECK(config.search.size() == 2);
+        CHECK(config.search[0] == "svc.example.com" && config.search[1] == "example.com");
+        CHECK(config.ndots == 2);
+        CHECK(DnsResolver::SystemNameServer(conf_path).IP() == "127.0.0.1");
+        CHECK(DnsResolver::SystemConfig("/nonexistent/resolv.conf").servers.size() == 1);
+
+        auto hosts = DnsResolver::LoadHosts(hosts_path);
+        CHECK(hosts.size() == 3);
+        CHECK(hosts["static.example.com"].size() == 2);
+        CHECK(hosts["static.example.com"][0]->IP() == "fd00::9");
+        CHECK(hosts["static.example.com"][1]->IP() == "10.9.9.9");
+        CHECK(hosts["static"].size() == 1);
+        CHECK(hosts.find("commented.example.com") == hosts.end());
+        CHECK(hosts.find("bad.example.com") == hosts.end());
+        ::unlink(conf_path);
+        ::unlink(hosts_path);
+
+        // 第一个服务器的端口没有监听，查询超时后换到第二个服务器
+        DnsConfig dns;
+        dns.servers.emplace_back("127.0.0.1", (uint16_t)34683);
+        dns.servers.emplace_back("127.0.0.1", (uint16_t)34681);
+        dns.search.emplace_back("svc.example.com");
+        dns.ndots = 1;
+        auto multi = std::make_shared<DnsResolver>(loop, dns);
+        multi->SetTimeout(1, 0);
+        multi->SetHosts(hosts);
+        multi->Start();
+
+        int before = server.Queries("static.example.com");
+        auto r = ResolveSync(multi, "Static.Example.com.");
+        CHECK(r.status == kDnsOk && r.addrs.size() == 2);
+        CHECK(r.addrs[0]->IP() == "fd00::9");
+        CHECK(server.Queries("static.example.com") == before);
+        multi->SetQueryIpv6(false);
+        r = ResolveSync(multi, "static");
+        CHECK(r.status == kDnsOk && r.addrs.size() == 1 && r.addrs[0]->IP() == "10.9.9.9");
+        r = ResolveSync(multi, "db.localhost");
+        CHECK(r.status == kDnsOk && r.addrs.size() == 1 && r.addrs[0]->IP() == "127.0.0.1");
+
+        // 短名字先查询 api.svc.example.com，超时一次后由第二个服务器回答
+        auto start = std::chrono::steady_clock::now();
+        r = ResolveSync(multi, "api");
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        CHECK(r.status == kDnsOk && r.addrs.size() == 1 && r.addrs[0]->IP() == "10.0.0.8");
+        CHECK(server.Queries("api.svc.example.com") == 1);
+        CHECK(server.Queries("api") == 0);
+        CHECK(ms < 3000);
+
+        // 点够多的名字先按原名查询，原名不存在时再加搜索域
+        r = ResolveSync(multi, "media.example.com");
+        CHECK(r.status == kDnsOk && r.addrs.size() == 2);
+        CHECK(server.Queries("media.example.com.svc.example.com") == 0);
+        r = ResolveSync(multi, "nothing.example");
+        CHECK(r.status == kDnsOk || r.status == kDnsNotFound);
+        CHECK(server.Queries("nothing.example") == 1);
+        CHECK(server.Queries("nothing.example.svc.example.com") == 1);
+        multi->Stop();
+    }
+
+    // 9. 停止后没完成的查询以错误结束，新的请求也立即以错误结束
+    {
+        std::atomic<int> status{-1};
+        resolver->Resolve("dead.example.com", [&status](const std::string &, const DnsResult &r)
+                          { status = r.status; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        resolver->Stop();
+        CHECK(WaitFor([&status]()
+                      { return status >= 0; }, 1000));
+        CHECK(status == kDnsError);
+        auto r = ResolveSync(resolver, "media.example.com");
+        CHECK(r.status == kDnsError);
+    }
+
+    return TestPassed("DnsResolverTest");
+}
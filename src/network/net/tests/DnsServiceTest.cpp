@@ -22,9 +22,6 @@ int main(int argc, const char **argv)
     // 获取结果
     list = sDnsService->GetHostAddress(myadd);
 
-    // 获取主机信息
-    // DnsService::GetHostInfo("www.baidu.com", list);
-
     // 遍历地址列表
     for (auto &i : list)
     {
@@ -0,0 +1,359 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+#include "network/fec/FecXor.h"
+#include "network/fec/FecEncoder.h"
+#include "network/fec/FecDecoder.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 第 i 个媒体包的内容，长度不一，前 4 个字节是编号
+static std::string MakePayload(uint32_t i)
+{
+    std::string payload(20 + (i * 37) % 1200, '\0');
+    memcpy(&payload[0], &i, sizeof(i));
+    for (size_t k = sizeof(i); k < payload.size(); k++)
+    {
+        payload[k] = (char)(i * 31 + k);
+    }
+    return payload;
+}
+
+// 异或内核和标量实现的结果一致，包括不对齐的地址和不是 8 的倍数的长度
+static int TestXorKernel()
+{
+    std::mt19937 rng(7);
+    std::vector<char> src(400), a(400), b(400);
+    for (size_t size = 0; size <= 300; size++)
+    {
+        for (size_t offset = 0; offset < 4; offset++)
+        {
+            for (size_t k = 0; k < src.size(); k++)
+            {
+                src[k] = (char)rng();
+                a[k] = b[k] = (char)rng();
+            }
+            FecXor(a.data() + offset, src.data() + 3, size);
+            FecXorScalar(b.data() + offset, src.data() + 3, size);
+            CHECK(a == b);
+        }
+    }
+
+    // 吞吐只输出参考，不做判断
+    std::vector<char> dst(1400), data(1400, 0x5a);
+    const int kLoops = 200000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kLoops; i++)
+    {
+        FecXor(dst.data(), data.data(), data.size());
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "xor kernel:" << FecXorKernel() << " " << (us > 0 ? (double)kLoops * 1400 / us : 0) << " MB/s" << std::endl;
+    return 0;
+}
+
+// 编码 total 个媒体包，丢掉 lost_sources 里编号的源包后解码，记录交付的编号
+struct Result
+{
+    std::set<uint32_t> delivered;
+    uint64_t recovered{0};
+    uint64_t parities{0};
+    bool corrupt{false};
+};
+
+static Result Run(const FecConfig &config, uint32_t total, const std::set<uint32_t> &lost_sources)
+{
+    Result result;
+    FecEncoder encoder(config);
+    FecDecoder decoder;
+    decoder.SetMessageCallback([&result](const char *data, size_t size)
+                               {
+        uint32_t i = 0;
+        memcpy(&i, data, sizeof(i));
+        if (MakePayload(i) != std::string(data, size))
+        {
+            result.corrupt = true;
+        }
+        result.delivered.insert(i); });
+
+    // 源包按媒体包编号丢，校验包都送到
+    uint32_t current = 0;
+    encoder.SetOutputCallback([&](const char *data, size_t size)
+                              {
+        if (FecPacket::Type(data, size) == kFecSource && lost_sources.count(current))
+        {
+            return;
+        }
+        decoder.Input(data, size); });
+    for (uint32_t i = 0; i < total; i++)
+    {
+        current = i;
+        auto payload = MakePayload(i);
+        encoder.Protect(payload.data(), payload.size());
+    }
+    result.recovered = decoder.Recovered();
+    result.parities = encoder.ParityPackets();
+    return result;
+}
+
+static int TestNoLoss()
+{
+    FecConfig config;
+    config.columns = 4;
+    config.rows = 4;
+    auto r = Run(config, 64, {});
+    CHECK(!r.corrupt);
+    CHECK(r.delivered.size() == 64);
+    CHECK(r.recovered == 0);
+    // 每块 4 个行校验和 4 个列校验
+    CHECK(r.parities == 4 * 8);
+    return 0;
+}
+
+// 只有行校验：每行丢一个都能恢复
+static int TestRowOnly()
+{
+    FecConfig config;
+    config.columns = 5;
+    config.rows = 0;
+    std::set<uint32_t> lost{0, 7, 14, 16, 24};
+    auto r = Run(config, 25, lost);
+    CHECK(!r.corrupt);
+    CHECK(r.delivered.size() == 25);
+    CHECK(r.recovered == lost.size());
+
+    // 同一行丢两个，行校验恢复不了
+    r = Run(config, 25, {5, 6});
+    CHECK(r.delivered.size() == 23);
+    CHECK(r.recovered == 0);
+    return 0;
+}
+
+// 行列都有：同一行丢两个靠列恢复，整行突发丢失也靠列恢复
+static int TestRowColumn()
+{
+    FecConfig config;
+    config.columns = 4;
+    config.rows = 4;
+    auto r = Run(config, 32, {5, 6});
+    CHECK(!r.corrupt);
+    CHECK(r.delivered.size() == 32);
+    CHECK(r.recovered == 2);
+
+    r = Run(config, 32, {20, 21, 22, 23});
+    CHECK(!r.corrupt);
+    CHECK(r.delivered.size() == 32);
+    CHECK(r.recovered == 4);
+
+    // L 形丢失：列 1 先恢复，然后行 0，最后列 0，要连续推进
+    r = Run(config, 16, {0, 1, 4});
+    CHECK(!r.corrupt);
+    CHECK(r.delivered.size() == 16);
+    CHECK(r.recovered == 3);
+
+    // 2x2 的方块，行和列都缺两个，异或校验恢复不了
+    r = Run(config, 16, {0, 1, 4, 5});
+    CHECK(r.delivered.size() == 12);
+
+    // 只发列校验，整行丢失也能恢复
+    config.row_parity = false;
+    r = Run(config, 16, {8, 9, 10, 11});
+    CHECK(!r.corrupt);
+    CHECK(r.delivered.size() == 16);
+    CHECK(r.recovered == 4);
+    return 0;
+}
+
+// 乱序和重复：先到的校验包也要留着，重复的源包不交付两次
+static int TestReorder()
+{
+    FecConfig config;
+    config.columns = 3;
+    config.rows = 0;
+    FecEncoder encoder(config);
+    std::vector<std::string> packets;
+    encoder.SetOutputCallback([&packets](const char *data, size_t size)
+                              { packets.emplace_back(data, size); });
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        auto payload = MakePayload(i);
+        encoder.Protect(payload.data(), payload.size());
+    }
+    CHECK(packets.size() == 4);
+
+    std::vector<uint32_t> delivered;
+    FecDecoder decoder;
+    decoder.SetMessageCallback([&delivered](const char *data, size_t size)
+                               {
+        uint32_t i = 0;
+        memcpy(&i, data, sizeof(i));
+        delivered.push_back(i); });
+    // 校验包先到，然后源包 2、0，源包 1 丢失
+    decoder.Input(packets[3].data(), packets[3].size());
+    decoder.Input(packets[2].data(), packets[2].size());
+    CHECK(delivered.size() == 1);
+    decoder.Input(packets[0].data(), packets[0].size());
+    CHECK(delivered.size() == 3);
+    CHECK(delivered[2] == 1);
+    CHECK(decoder.Recovered() == 1);
+    // 源包 1 迟到，已经恢复过
+    decoder.Input(packets[1].data(), packets[1].size());
+    decoder.Input(packets[0].data(), packets[0].size());
+    CHECK(delivered.size() == 3);
+    return 0;
+}
+
+// 随机丢 5%，行列校验恢复绝大部分
+static int TestRandomLoss()
+{
+    FecConfig config;
+    config.columns = 10;
+    config.rows = 10;
+    std::mt19937 rng(2024);
+    std::set<uint32_t> lost;
+    const uint32_t kTotal = 2000;
+    for (uint32_t i = 0; i < kTotal; i++)
+    {
+        if (rng() % 100 < 5)
+        {
+            lost.insert(i);
+        }
+    }
+    auto r = Run(config, kTotal, lost);
+    CHECK(!r.corrupt);
+    std::cout << "random loss lost:" << lost.size() << " recovered:" << r.recovered
+              << " delivered:" << r.delivered.size() << std::endl;
+    CHECK(r.recovered + (kTotal - lost.size()) == r.delivered.size());
+    CHECK(r.delivered.size() >= kTotal - lost.size() / 10);
+    return 0;
+}
+
+// 发送端重启，序号从 0 重新开始：解码器重新同步，新的包照常交付和恢复
+static int TestEncoderRestart()
+{
+    FecConfig config;
+    config.columns = 4;
+    config.rows = 4;
+    FecDecoder decoder;
+    std::set<uint32_t> delivered;
+    decoder.SetMessageCallback([&delivered](const char *data, size_t size)
+                               {
+        uint32_t i = 0;
+        memcpy(&i, data, sizeof(i));
+        delivered.insert(i); });
+
+    // 第一个发送端送出的序号远大于几个窗口
+    {
+        FecEncoder encoder(config);
+        encoder.SetOutputCallback([&decoder](const char *data, size_t size)
+                                  { decoder.Input(data, size); });
+        for (uint32_t i = 0; i < 6000; i++)
+        {
+            auto payload = MakePayload(i);
+            encoder.Protect(payload.data(), payload.size());
+        }
+    }
+    CHECK(delivered.size() == 6000);
+    CHECK(decoder.Resyncs() == 0);
+
+    // 重启后的发送端，媒体包编号换一段，丢一个靠行校验恢复
+    delivered.clear();
+    const uint32_t kBase = 100000;
+    FecEncoder encoder(config);
+    uint32_t current = 0;
+    encoder.SetOutputCallback([&](const char *data, size_t size)
+                              {
+        if (FecPacket::Type(data, size) == kFecSource && current == kBase + 5)
+        {
+            return;
+        }
+        decoder.Input(data, size); });
+    for (uint32_t i = kBase; i < kBase + 32; i++)
+    {
+        current = i;
+        auto payload = MakePayload(i);
+        encoder.Protect(payload.data(), payload.size());
+    }
+    CHECK(decoder.Resyncs() == 1);
+    CHECK(delivered.size() == 32);
+    CHECK(decoder.Late() == 0);
+    CHECK(decoder.Recovered() == 1);
+    return 0;
+}
+
+// 保护范围比窗口还大的校验包直接忽略
+static int TestOversizeParity()
+{
+    FecConfig config;
+    config.columns = 16;
+    config.rows = 0;
+    FecEncoder encoder(config);
+    std::vector<std::string> packets;
+    encoder.SetOutputCallback([&packets](const char *data, size_t size)
+                              { packets.emplace_back(data, size); });
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        auto payload = MakePayload(i);
+        encoder.Protect(payload.data(), payload.size());
+    }
+    CHECK(packets.size() == 17);
+
+    // 窗口只有 8 个包，16 个包的行校验用不上，丢的包不会被恢复
+    FecDecoder decoder(8);
+    size_t delivered = 0;
+    decoder.SetMessageCallback([&delivered](const char *data, size_t size)
+                               { delivered++; });
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        if (i != 15)
+        {
+            decoder.Input(packets[i].data(), packets[i].size());
+        }
+    }
+    CHECK(delivered == 15);
+    CHECK(decoder.Recovered() == 0);
+    CHECK(decoder.Resyncs() == 0);
+    return 0;
+}
+
+int main(int argc, const char **argv)
+{
+    if (TestXorKernel() != 0)
+    {
+        return -1;
+    }
+    if (TestNoLoss() != 0)
+    {
+        return -1;
+    }
+    if (TestRowOnly() != 0)
+    {
+        return -1;
+    }
+    if (TestRowColumn() != 0)
+    {
+        return -1;
+    }
+    if (TestReorder() != 0)
+    {
+        return -1;
+    }
+    if (TestRandomLoss() != 0)
+    {
+        return -1;
+    }
+    if (TestEncoderRestart() != 0)
+    {
+        return -1;
+    }
+    if (TestOversizeParity() != 0)
+    {
+        return -1;
+    }
+    return TestPassed("FecTest");
+}
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/net/EventLoopThreadPool.h"
+#include "network/TcpServer.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+using Clock = std::chrono::steady_clock;
+
+// 服务器在新连接上发送的数据，远大于内核缓冲区，关闭时一定还有积压
+static std::string g_payload(8 * 1024 * 1024, 'x');
+
+// 阻塞方式连接服务器，接收缓冲区设小，让服务器的发送队列积压
+static int ConnectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int rcvbuf = 16 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr;
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 一直读到 EOF 或者出错，返回读到的字节数，eof 表示是否正常读到 EOF
+static size_t ReadAll(int fd, bool *eof)
+{
+    char buf[64 * 1024];
+    size_t total = 0;
+    *eof = false;
+    while (true)
+    {
+        auto n = ::read(fd, buf, sizeof(buf));
+        if (n > 0)
+        {
+            total += n;
+            continue;
+        }
+        *eof = (n == 0);
+        return total;
+    }
+}
+
+int main(int argc, const char **argv)
+{
+    EventLoopThread loop_thread;
+    loop_thread.Run();
+    EventLoop *loop = loop_thread.Loop();
+
+    // 1. 优雅停止：积压的数据全部发完，客户端读到 EOF，客户端关闭后服务器通知停止完成
+    {
+        InetAddress listen("127.0.0.1:34591");
+        TcpServer server(loop, listen);
+        std::promise<void> accepted;
+        server.SetNewConnectionCallback([&accepted](const TcpConnectionPtr &con)
+                                        {
+            con->Send(g_payload.data(), g_payload.size());
+            accepted.set_value(); });
+        server.Start();
+        // Acceptor 在事件循环里异步打开监听
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        int fd = ConnectTo(34591);
+        CHECK(fd >= 0);
+        accepted.get_future().get();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        std::promise<void> drained;
+        server.Shutdown(5, [&drained]()
+                        { drained.set_value(); });
+        auto drained_future = drained.get_future();
+
+        bool eof = false;
+        auto total = ReadAll(fd, &eof);
+        std::cout << "graceful: read " << total << " bytes, eof " << eof << std::endl;
+        CHECK(eof);
+        CHECK(total == g_payload.size());
+
+        // 收到 EOF 时服务器只是半关闭，客户端关闭后服务器才关闭连接
+        CHECK(drained_future.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout);
+        ::close(fd);
+        CHECK(drained_future.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    }
+
+    // 2. 客户端不读数据，到了期限强制关闭，停止完成的通知不会一直等下去
+    {
+        InetAddress listen("127.0.0.1:34592");
+        TcpServer server(loop, listen);
+        std::promise<void> accepted;
+        server.SetNewConnectionCallback([&accepted](const TcpConnectionPtr &con)
+                                        {
+            con->Send(g_payload.data(), g_payload.size());
+            accepted.set_value(); });
+        server.Start();
+        // Acceptor 在事件循环里异步打开监听
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        int fd = ConnectTo(34592);
+        CHECK(fd >= 0);
+        accepted.get_future().get();
+
+        std::promise<void> drained;
+        auto begin = Clock::now();
+        server.Shutdown(1, [&drained]()
+                        { drained.set_value(); });
+        CHECK(drained.get_future().wait_for(std::chrono::seconds(4)) == std::future_status::ready);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+        std::cout << "deadline: drained after " << ms << " ms" << std::endl;
+        CHECK(ms >= 900);
+
+        bool eof = false;
+        auto total = ReadAll(fd, &eof);
+        CHECK(total < g_payload.size());
+        ::close(fd);
+    }
+
+    // 3. 没有连接时立即通知停止完成
+    {
+        InetAddress listen("127.0.0.1:34593");
+        TcpServer server(loop, listen);
+        server.Start();
+        std::promise<void> drained;
+        server.Shutdown(1, [&drained]()
+                        { drained.set_value(); });
+        CHECK(drained.get_future().wait_for(std::chrono::milliseconds(500)) == std::future_status::ready);
+    }
+
+    // 4. 线程池停止时事件循环立即被唤醒退出，不用等 epoll_wait 超时
+    {
+        EventLoopThreadPool pool(2, 0, 0);
+        pool.Start();
+        auto begin = Clock::now();
+        pool.Stop();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+        std::cout << "pool stop: " << ms << " ms" << std::endl;
+        CHECK(ms < 500);
+    }
+
+    return TestPassed("GracefulShutdownTest");
+}
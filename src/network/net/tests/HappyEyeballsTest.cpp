@@ -0,0 +1,148 @@
+#include <iostream>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/TcpServer.h"
+#include "network/TcpClient.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+using Clock = std::chrono::steady_clock;
+
+// 连接结果：是否连上、连上的地址、耗时
+struct RaceResult
+{
+    bool connected{false};
+    std::string peer;
+    int64_t ms{0};
+};
+
+// 对候选地址竞速连接，等待连接回调
+static RaceResult Race(EventLoop *loop, const std::vector<InetAddress> &addrs, std::shared_ptr<TcpClient> &client)
+{
+    client = std::make_shared<TcpClient>(loop, addrs.front());
+    client->SetCandidates(addrs);
+    client->SetConnectStagger(100);
+    client->SetConnectTimeout(5);
+
+    auto result = std::make_shared<std::promise<RaceResult>>();
+    auto begin = Clock::now();
+    client->SetConnectCallback([result, begin](const TcpConnectionPtr &con, bool connected)
+                               {
+        RaceResult r;
+        r.connected = connected;
+        r.peer = con->PeerAddr().ToIpPort();
+        r.ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+        result->set_value(r); });
+    client->Connect();
+    return result->get_future().get();
+}
+
+// 在本机造一个黑洞：监听但从不 accept，全连接队列填满后新的 SYN 会被丢弃，连接一直挂着
+static int MakeBlackhole(uint16_t port, std::vector<int> &fillers)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr;
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(fd, 0) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        int c = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        ::connect(c, (struct sockaddr *)&addr, sizeof(addr));
+        fillers.push_back(c);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return fd;
+}
+
+int main(int argc, const char **argv)
+{
+    EventLoopThread loop_thread;
+    loop_thread.Run();
+    EventLoop *loop = loop_thread.Loop();
+
+    InetAddress listen("127.0.0.1:34581");
+    TcpServer server(loop, listen);
+    server.Start();
+
+    // 1. 毫秒级定时任务按时执行，不用等时间轮的一秒
+    {
+        std::promise<int64_t> elapsed;
+        auto begin = Clock::now();
+        loop->RunAfterMs(50, [&elapsed, begin]()
+                         { elapsed.set_value(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count()); });
+        auto ms = elapsed.get_future().get();
+        std::cout << "RunAfterMs(50) fired after " << ms << " ms" << std::endl;
+        CHECK(ms >= 45 && ms < 500);
+    }
+
+    // 2. 第一个地址不通（黑洞或者不可达），错开后第二个地址胜出
+    {
+        std::shared_ptr<TcpClient> client;
+        auto r = Race(loop, {InetAddress("10.255.255.1:34581"), InetAddress("127.0.0.1:34581")}, client);
+        std::cout << "blackhole first: " << r.peer << " in " << r.ms << " ms" << std::endl;
+        CHECK(r.connected);
+        CHECK(r.peer == "127.0.0.1:34581");
+        CHECK(r.ms < 1000);
+        CHECK(client->Status() == kTcpConStatusConnected);
+        client->ForceClose();
+    }
+
+    // 3. 第一个地址的连接一直挂着，错开的间隔到了就发起第二个，第二个胜出后第一个被关闭
+    {
+        std::vector<int> fillers;
+        int hole = MakeBlackhole(34585, fillers);
+        CHECK(hole >= 0);
+        std::shared_ptr<TcpClient> client;
+        auto r = Race(loop, {InetAddress("127.0.0.1:34585"), InetAddress("127.0.0.1:34581")}, client);
+        std::cout << "hanging first: " << r.peer << " in " << r.ms << " ms" << std::endl;
+        CHECK(r.connected);
+        CHECK(r.peer == "127.0.0.1:34581");
+        CHECK(r.ms >= 90 && r.ms < 1000);
+        client->ForceClose();
+        for (auto c : fillers)
+        {
+            ::close(c);
+        }
+        ::close(hole);
+    }
+
+    // 4. IPv6 地址没有监听，交替到 IPv4 地址连上
+    {
+        std::shared_ptr<TcpClient> client;
+        auto r = Race(loop, {InetAddress("::1", 34581, true), InetAddress("127.0.0.1:34581")}, client);
+        std::cout << "ipv6 refused: " << r.peer << " in " << r.ms << " ms" << std::endl;
+        CHECK(r.connected);
+        CHECK(r.peer == "127.0.0.1:34581");
+        client->ForceClose();
+    }
+
+    // 5. 所有地址都被拒绝，很快通过连接回调报告失败，不用等连接超时
+    {
+        std::shared_ptr<TcpClient> client;
+        auto r = Race(loop, {InetAddress("127.0.0.1:34582"), InetAddress("127.0.0.1:34583"), InetAddress("127.0.0.1:34584")}, client);
+        std::cout << "all refused in " << r.ms << " ms" << std::endl;
+        CHECK(!r.connected);
+        CHECK(r.ms < 1000);
+        CHECK(client->Status() == kTcpConStatusDisConnected);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    return TestPassed("HappyEyeballsTest");
+}
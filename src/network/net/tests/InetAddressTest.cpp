@@ -1,10 +1,81 @@
 #include "network/base/InetAddress.h"
 #include <string>
 #include <iostream>
+#include <unordered_map>
+#include "TestUtil.h"
 
 using namespace tmms::network;
 
+// 二进制地址的转换、比较和哈希
+static int SelfCheck()
+{
+    InetAddress v4("192.168.1.10:8080");
+    CHECK(v4.IP() == "192.168.1.10");
+    CHECK(v4.Port() == 8080);
+    CHECK(v4.IPv4() == 0xc0a8010a);
+    CHECK(v4.ToIpPort() == "192.168.1.10:8080");
+    CHECK(!v4.IsIpV6() && v4.IsLanIp() && !v4.IsWanIp());
+
+    InetAddress v6("::1", 443, true);
+    CHECK(v6.IsIpV6() && v6.IsLoopbackIp() && !v6.IsWanIp());
+
+    // 整个 127/8 都是回环，任意地址、链路本地、IPv6 的本地地址都不是广域网地址
+    CHECK(InetAddress("127.0.0.2:80").IsLoopbackIp() && !InetAddress("127.0.0.2:80").IsWanIp());
+    CHECK(!InetAddress("0.0.0.0:80").IsWanIp());
+    CHECK(!InetAddress("169.254.1.1:80").IsWanIp());
+    CHECK(!InetAddress("::", 80, true).IsWanIp());
+    CHECK(!InetAddress("fe80::1", 80, true).IsWanIp());
+    CHECK(!InetAddress("fd00::1", 80, true).IsWanIp());
+    CHECK(!InetAddress("::ffff:10.0.0.1", 80, true).IsWanIp());
+    CHECK(InetAddress("::ffff:8.8.8.8", 80, true).IsWanIp());
+    CHECK(InetAddress("2001:db8::1", 80, true).IsWanIp());
+    CHECK(!InetAddress().IsWanIp());
+    CHECK(v6.IP() == "::1" && v6.Port() == 443);
+    CHECK(v6.SockAddrLen() == sizeof(struct sockaddr_in6));
+
+    // 端口和地址分开设置，和原来的用法一致
+    InetAddress addr;
+    addr.SetAddr("10.0.0.1");
+    addr.SetPort(1935);
+    CHECK(addr.ToIpPort() == "10.0.0.1:1935");
+    addr.SetHost("8.8.8.8");
+    CHECK(addr.ToIpPort() == "8.8.8.8:1935" && addr.IsWanIp());
+
+    // 从系统调用返回的 sockaddr 构造，和从字符串构造的相等
+    struct sockaddr_in sin;
+    v4.GetSockAddr((struct sockaddr *)&sin);
+    InetAddress from_sock((struct sockaddr *)&sin, sizeof(sin));
+    CHECK(from_sock == v4);
+    CHECK(from_sock.Hash() == v4.Hash());
+    CHECK(from_sock != InetAddress("192.168.1.10:8081"));
+    CHECK(v6 != InetAddress("::2", 443, true));
+
+    // IPv4 和 IPv4 映射的 IPv6 地址互相转换
+    InetAddress mapped("1.2.3.4:80");
+    mapped.SetIsIPV6(true);
+    CHECK(mapped.IsIpV6() && mapped.IP() == "::ffff:1.2.3.4" && mapped.Port() == 80);
+    mapped.SetIsIPV6(false);
+    CHECK(mapped == InetAddress("1.2.3.4:80"));
+
+    // 可以直接做哈希表的键
+    std::unordered_map<InetAddress, int> peers;
+    for (int i = 0; i < 1000; i++)
+    {
+        peers[InetAddress("10.0.0.1", (uint16_t)(10000 + i))] = i;
+    }
+    peers[v6] = -1;
+    CHECK(peers.size() == 1001);
+    CHECK(peers[InetAddress("10.0.0.1:10500")] == 500);
+    CHECK(peers[InetAddress("::1", 443, true)] == -1);
+    return 0;
+}
+
 int main(int argc, const char **argv){
+    if (SelfCheck() != 0)
+    {
+        return -1;
+    }
+
     std::string  host;
     while(std::cin >> host){
         InetAddress addr(host);
@@ -18,4 +89,4 @@ int main(int argc, const char **argv){
                     << "is_loopback_ip:" << addr.IsLoopbackIp() << std::endl;
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,212 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <unistd.h>
+#include "base/LogStream.h"
+#include "TestUtil.h"
+
+using namespace tmms::base;
+
+static std::vector<std::string> ReadLines(const std::string &path)
+{
+    std::vector<std::string> lines;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        lines.emplace_back(line);
+    }
+    return lines;
+}
+
+// 等到新的一秒开始，之后的一段循环在同一个限频窗口里
+static void WaitNextSecond()
+{
+    auto now = LogRateLimiter::CoarseSeconds();
+    while (LogRateLimiter::CoarseSeconds() == now)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// 累加日志里注明的压掉的条数
+static uint64_t SumSuppressed(const std::vector<std::string> &lines)
+{
+    uint64_t sum = 0;
+    for (auto &line : lines)
+    {
+        auto pos = line.find("[suppressed ");
+        if (pos != std::string::npos)
+        {
+            sum += std::stoull(line.substr(pos + 12));
+        }
+    }
+    return sum;
+}
+
+// 记录参数被求值的次数
+static std::atomic<int> evaluated{0};
+static int Arg()
+{
+    evaluated++;
+    return 1;
+}
+
+int main(int argc, const char **argv)
+{
+    // 1. 没有安装 g_logger 时所有级别都不构造 LogStream，参数不求值
+    {
+        g_logger = nullptr;
+        LOG_TRACE << Arg();
+        LOG_INFO << Arg();
+        LOG_WARN << Arg();
+        LOG_ERROR << Arg();
+        LOG_ERROR_LIMITED(1, 1) << Arg();
+        CHECK(evaluated == 0);
+    }
+
+    const std::string path = "/tmp/tmms_log_rate_limit_test.log";
+    ::unlink(path.c_str());
+    auto log = std::make_shared<FileLog>();
+    CHECK(log->Open(path));
+    Logger logger(log);
+    g_logger = &logger;
+
+    // 2. 级别不够的参数不求值
+    {
+        logger.SetLogLevel(kError);
+        LOG_WARN << Arg();
+        LOG_WARN_LIMITED(1, 1) << Arg();
+        CHECK(evaluated == 0);
+        LOG_ERROR << Arg();
+        CHECK(evaluated == 1);
+        CHECK(ReadLines(path).size() == 1);
+    }
+
+    // 3. 宏放在 if/else 里，else 配对正确
+    {
+        bool other = false;
+        if (false)
+            LOG_ERROR << "never";
+        else
+            other = true;
+        CHECK(other);
+        other = false;
+        if (false)
+            LOG_ERROR_LIMITED(1, 1) << "never";
+        else
+            other = true;
+        CHECK(other);
+        CHECK(ReadLines(path).size() == 1);
+    }
+
+    // 4. 限频：前 5 条都输出，之后每 1000 条输出一条并注明压掉了 999 条，被压掉的参数不求值
+    {
+        ::truncate(path.c_str(), 0);
+        evaluated = 0;
+        WaitNextSecond();
+        for (int i = 0; i < 10000; i++)
+        {
+            LOG_ERROR_LIMITED(5, 1000) << "flood " << i << " " << Arg();
+        }
+        auto lines = ReadLines(path);
+        CHECK(lines.size() == 14);
+        CHECK(evaluated == 14);
+        for (int i = 0; i < 5; i++)
+        {
+            CHECK(lines[i].find("flood " + std::to_string(i) + " ") != std::string::npos);
+            CHECK(lines[i].find("suppressed") == std::string::npos);
+        }
+        CHECK(lines[5].find("[suppressed 999] flood 1004 ") != std::string::npos);
+        CHECK(lines[13].find("[suppressed 999] flood 9004 ") != std::string::npos);
+    }
+
+    // 5. 每个调用点有自己的限频器
+    {
+        ::truncate(path.c_str(), 0);
+        for (int i = 0; i < 100; i++)
+        {
+            LOG_ERROR_LIMITED(2, 1000) << "a";
+            LOG_ERROR_LIMITED(3, 1000) << "b";
+        }
+        auto lines = ReadLines(path);
+        CHECK(lines.size() == 2 + 3);
+    }
+
+    // 6. 多个线程打同一个调用点，输出的条数加上注明压掉的条数等于调用次数
+    {
+        ::truncate(path.c_str(), 0);
+        WaitNextSecond();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([]()
+                                 {
+                for (int i = 0; i < 25000; i++)
+                {
+                    LOG_ERROR_LIMITED(5, 1000) << "threads";
+                } });
+        }
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+        // 同一秒里是 5 + (100000 - 5) / 1000 条，跨秒时新的一秒又从前 5 条开始
+        // 最后一条输出之后压掉的还没有注明，最多 999 条
+        auto lines = ReadLines(path);
+        CHECK(lines.size() >= 104);
+        auto total = lines.size() + SumSuppressed(lines);
+        CHECK(total <= 100000 && total > 100000 - 1000);
+    }
+
+    // 7. 换到新的一秒时重新开始计数，之前压掉的条数注明在下一条输出的日志上
+    {
+        ::truncate(path.c_str(), 0);
+        WaitNextSecond();
+        // 同一个调用点：前 10 条在同一秒，第 11 条在下一秒
+        for (int i = 0; i <= 10; i++)
+        {
+            if (i == 10)
+            {
+                CHECK(ReadLines(path).size() == 2);
+                WaitNextSecond();
+            }
+            LOG_ERROR_LIMITED(2, 1000000) << "window " << i;
+        }
+        auto lines = ReadLines(path);
+        CHECK(lines.size() == 3);
+        CHECK(lines[2].find("[suppressed 8] window 10") != std::string::npos);
+    }
+
+    // 8. 快路径的耗时：级别不够，和被限频压掉
+    {
+        const int kCalls = 10000000;
+        logger.SetLogLevel(kError);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kCalls; i++)
+        {
+            LOG_WARN << "disabled " << i;
+        }
+        auto disabled = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() * 1.0 / kCalls;
+
+        ::truncate(path.c_str(), 0);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kCalls; i++)
+        {
+            LOG_ERROR_LIMITED(1, kCalls) << "limited " << i;
+        }
+        auto limited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() * 1.0 / kCalls;
+        std::cout << "ns/call: disabled " << disabled << " suppressed " << limited << std::endl;
+        // 每一秒的第一条输出
+        CHECK(ReadLines(path).size() >= 1);
+        CHECK(ReadLines(path).size() <= 2 + (size_t)(limited * kCalls / 1e9));
+    }
+
+    g_logger = nullptr;
+    ::unlink(path.c_str());
+    return TestPassed("LogRateLimitTest");
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include "base/LogStream.h"
+#include "base/TTime.h"
+#include "TestUtil.h"
+
+using namespace tmms::base;
+
+enum TestColor
+{
+    kTestRed = 3,
+};
+
+static std::string ReadFile(const std::string &path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// 日志行里 "] " 之后的正文
+static std::string Body(const std::string &line)
+{
+    auto pos = line.find("] ");
+    return pos == std::string::npos ? line : line.substr(pos + 2);
+}
+
+int main(int argc, const char **argv)
+{
+    const std::string path = "/tmp/tmms_log_stream_test.log";
+    ::unlink(path.c_str());
+    auto log = std::make_shared<FileLog>();
+    CHECK(log->Open(path));
+    Logger logger(log);
+
+    // 格式化一条日志，返回写到文件的内容
+    auto format = [&](void (*fill)(LogStream &)) -> std::string
+    {
+        ::truncate(path.c_str(), 0);
+        {
+            LogStream s(&logger, __FILE__, 1, kInfo);
+            fill(s);
+        }
+        return ReadFile(path);
+    };
+
+    // 1. 前缀：时间、线程 ID、级别、文件名和行号，以换行结尾
+    {
+        auto line = format([](LogStream &s)
+                           { s << "hello"; });
+        CHECK(line.size() > 20 && line[4] == '-' && line[10] == 'T');
+        CHECK(line.find(" INFO [LogStreamTest.cpp:1] hello\n") != std::string::npos);
+        CHECK(line.find(std::to_string(::getpid())) != std::string::npos);
+    }
+
+    // 2. 整数：和 std::to_string 一致，包括边界值
+    {
+        CHECK(Body(format([](LogStream &s)
+                          { s << 0 << " " << -1 << " " << 7 << " " << 100 << " " << 99; })) == "0 -1 7 100 99\n");
+        CHECK(Body(format([](LogStream &s)
+                          { s << INT_MIN << " " << INT_MAX; })) == std::to_string(INT_MIN) + " " + std::to_string(INT_MAX) + "\n");
+        CHECK(Body(format([](LogStream &s)
+                          { s << LLONG_MIN << " " << ULLONG_MAX; })) == std::to_string(LLONG_MIN) + " " + std::to_string(ULLONG_MAX) + "\n");
+        CHECK(Body(format([](LogStream &s)
+                          { s << (short)-12 << " " << (unsigned short)65535 << " " << (size_t)1234567890123ULL; })) == "-12 65535 1234567890123\n");
+    }
+
+    // 3. 字符、布尔、枚举、字符串、指针
+    {
+        CHECK(Body(format([](LogStream &s)
+                          { s << 'x' << (unsigned char)'y' << " " << true << false << " " << kTestRed; })) == "xy 10 3\n");
+        CHECK(Body(format([](LogStream &s)
+                          { s << std::string("str") << " " << (const char *)nullptr; })) == "str (null)\n");
+        CHECK(Body(format([](LogStream &s)
+                          { s << (const void *)0x1234abcd << " " << (void *)nullptr; })) == "0x1234abcd 0x0\n");
+    }
+
+    // 4. 浮点数：常见范围用定点格式，其余用 %g
+    {
+        CHECK(Body(format([](LogStream &s)
+                          { s << 0.0 << " " << 1.5 << " " << -2.25 << " " << 3.0 << " " << 0.125f; })) == "0 1.5 -2.25 3 0.125\n");
+        CHECK(Body(format([](LogStream &s)
+                          { s << 3.14159265 << " " << 0.0001 << " " << 100.000001 << " " << 0.9999999; })) == "3.141593 0.0001 100.000001 1\n");
+        CHECK(Body(format([](LogStream &s)
+                          { s << 1e20 << " " << 1e-9 << " " << -0.0; })) == "1e+20 1e-09 0\n");
+        // 0.0 / 0.0 在 x86 上带符号位，和 std::ostream 一样输出 -nan
+        auto special = Body(format([](LogStream &s)
+                                   { s << (1.0 / 0.0) << " " << -(1.0 / 0.0) << " " << (0.0 / 0.0); }));
+        CHECK(special.find("inf -inf ") == 0 && special.find("nan") != std::string::npos);
+    }
+
+    // 5. 超长的日志截断，换行保留
+    {
+        auto line = format([](LogStream &s)
+                           { s << std::string(kLogLineMax * 2, 'z'); });
+        CHECK(line.size() == kLogLineMax);
+        CHECK(line.back() == '\n');
+    }
+
+    // 6. 时间戳每个线程按秒缓存：同一秒内返回同一个缓冲，内容和 ISOTime 一致
+    {
+        size_t len1 = 0, len2 = 0;
+        const char *t1 = TTime::CachedISOTime(len1);
+        const char *t2 = TTime::CachedISOTime(len2);
+        CHECK(t1 == t2 && len1 == len2 && len1 == 19);
+        auto iso = TTime::ISOTime();
+        // 跨秒时允许差一秒
+        CHECK(iso.compare(0, 17, t1, 17) == 0);
+        const char *other = nullptr;
+        std::thread([&other]()
+                    { size_t len = 0;
+                      other = TTime::CachedISOTime(len); })
+            .join();
+        CHECK(other != t1);
+    }
+
+    // 7. 和原来的 std::ostringstream 加 ISOTime 的做法对比耗时，都写到 /dev/null
+    {
+        auto null_log = std::make_shared<FileLog>();
+        CHECK(null_log->Open("/dev/null"));
+        Logger null_logger(null_log);
+        const int kLines = 200000;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kLines; i++)
+        {
+            LogStream(&null_logger, __FILE__, __LINE__, kDebug) << "peer 127.0.0.1:8080 fd " << i << " bytes " << (size_t)i * 1460 << " rtt " << 1.25 * i;
+        }
+        auto ours = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / kLines;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kLines; i++)
+        {
+            std::ostringstream ss;
+            ss << TTime::ISOTime() << "  " << 1234 << " DEBUG [" << "LogStreamTest.cpp" << ":" << __LINE__ << "] "
+               << "peer 127.0.0.1:8080 fd " << i << " bytes " << (size_t)i * 1460 << " rtt " << 1.25 * i << "\n";
+            null_logger.Write(ss.str());
+        }
+        auto theirs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / kLines;
+        std::cout << "ns/line: LogStream " << ours << " ostringstream " << theirs << std::endl;
+        CHECK(ours < theirs);
+    }
+
+    ::unlink(path.c_str());
+    return TestPassed("LogStreamTest");
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "network/base/MsgBuffer.h"
+#include "network/base/BufferPool.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+int main(int argc, const char **argv)
+{
+    // 1. 追加数据超过初始容量，内存按级别增长，全部读走后超出初始容量的内存还回池里
+    {
+        MsgBuffer buf;
+        std::string data(100 * 1024, 'a');
+        buf.Append(data);
+        CHECK(buf.ReadableBytes() == data.size());
+        CHECK(buf.Capacity() >= data.size());
+        CHECK(buf.Read(data.size()) == data);
+        CHECK(buf.Capacity() == 0);
+
+        // 再次写入时按需借用
+        buf.AppendInt32(0x12345678);
+        CHECK(buf.ReadInt32() == 0x12345678);
+    }
+
+    // 2. 延迟分配的缓冲区，在前面插入数据
+    {
+        MsgBuffer buf(0);
+        CHECK(buf.Capacity() == 0);
+        buf.AddInFrontInt16(0x0102);
+        buf.Append("body");
+        CHECK(buf.ReadInt16() == 0x0102);
+        CHECK(buf.Read(4) == "body");
+    }
+
+    // 3. 拷贝和移动
+    {
+        MsgBuffer a;
+        a.Append("hello");
+        MsgBuffer b(a);
+        MsgBuffer c(std::move(a));
+        CHECK(b.Read(5) == "hello");
+        CHECK(c.Read(5) == "hello");
+        CHECK(a.ReadableBytes() == 0);
+    }
+
+    // 4. 从套接字读取大块数据，溢出部分直接成为新的存储
+    {
+        int fds[2];
+        CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        int size = 256 * 1024;
+        ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+        std::string data;
+        for (int i = 0; i < 40000; i++)
+        {
+            data.push_back('a' + i % 26);
+        }
+        CHECK(::write(fds[0], data.data(), data.size()) == (ssize_t)data.size());
+
+        MsgBuffer buf(0);
+        buf.Append("xyz");
+        while (buf.ReadableBytes() < data.size() + 3)
+        {
+            int err = 0;
+            auto n = buf.ReadFd(fds[1], &err);
+            CHECK(n > 0);
+        }
+        CHECK(buf.Read(3) == "xyz");
+        CHECK(buf.Read(data.size()) == data);
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    // 5. 读走大部分数据后，剩余的少量数据搬到小内存块
+    {
+        MsgBuffer buf;
+        std::string data(512 * 1024, 'b');
+        buf.Append(data);
+        size_t peak = buf.Capacity();
+        buf.Retrieve(data.size() - 10);
+        CHECK(buf.ReadableBytes() == 10);
+        CHECK(buf.Capacity() < peak);
+        CHECK(buf.Read(10) == std::string(10, 'b'));
+    }
+
+    // 6. ReadFd 借来的内存块里只剩半个消息时，收缩到按剩余数据大小借的内存块
+    {
+        int fds[2];
+        CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        std::string data(40000, 'c');
+        CHECK(::write(fds[0], data.data(), data.size()) == (ssize_t)data.size());
+
+        MsgBuffer buf;
+        size_t normal = buf.Capacity();
+        while (buf.ReadableBytes() < data.size())
+        {
+            int err = 0;
+            auto n = buf.ReadFd(fds[1], &err);
+            CHECK(n > 0);
+        }
+        CHECK(buf.Capacity() > normal);
+        buf.Retrieve(data.size() - 100);
+        CHECK(buf.ReadableBytes() == 100);
+        CHECK(buf.Capacity() == normal);
+        CHECK(buf.Read(100) == std::string(100, 'c'));
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    std::cout << "pool cached bytes: " << BufferPool::Local()->CachedBytes() << std::endl;
+    return TestPassed("MsgBufferTest");
+}
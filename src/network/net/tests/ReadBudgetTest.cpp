@@ -0,0 +1,90 @@
+#include <iostream>
+#include <atomic>
+#include <future>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "network/net/EventLoop.h"
+#include "network/net/EventLoopThread.h"
+#include "network/net/TcpConnection.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+int main(int argc, const char **argv)
+{
+    EventLoopThread eventloop_thread;
+    eventloop_thread.Run();
+    EventLoop *loop = eventloop_thread.Loop();
+    CHECK(loop != nullptr);
+
+    // 写端先灌满，之后不再写入，边缘触发只会通知一次，剩下的数据只能靠预算用完后补的那次读取
+    int fds[2];
+    CHECK(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    size_t total = 0;
+    char chunk[4096];
+    for (size_t i = 0; i < sizeof(chunk); i++)
+    {
+        chunk[i] = 'a' + i % 26;
+    }
+    while (true)
+    {
+        auto n = ::write(fds[0], chunk, sizeof(chunk));
+        if (n <= 0)
+        {
+            break;
+        }
+        total += n;
+    }
+    CHECK(total > 64 * 1024);
+
+    auto con = std::make_shared<TcpConnection>(loop, fds[1], InetAddress(), InetAddress());
+    // 每次读事件只读一次，最多 16K
+    con->SetReadBudget(16 * 1024, 1);
+
+    std::atomic<size_t> received{0};
+    std::atomic<int> calls{0};
+    // 第一次回调里投递的任务执行时看到的状态
+    std::atomic<size_t> marker_received{0};
+    std::atomic<bool> marker_pending{false};
+    std::atomic<bool> marker_ran{false};
+    int peer = fds[1];
+    con->SetRecvMsgRefCallback([&](TcpConnection &c, MsgBuffer &buff)
+                               {
+        received += buff.ReadableBytes();
+        buff.RetrieveAll();
+        if (calls++ > 0)
+        {
+            return;
+        }
+        // 这个任务排在预算用完后补读的任务前面；OnRead 没有读到 EAGAIN 就返回时，
+        // 它执行时只收到了一部分数据，套接字里还有剩下的
+        loop->QueueInLoop([&, peer]()
+                          {
+            char ch;
+            marker_received = received.load();
+            marker_pending = ::recv(peer, &ch, 1, MSG_PEEK | MSG_DONTWAIT) == 1;
+            marker_ran = true; }); });
+
+    loop->RunInLoop([loop, con]()
+                    { loop->AddEvent(con); });
+
+    // 剩下的数据由补读的任务在后面几轮循环里读完
+    CHECK(WaitFor([&]()
+                  { return received == total; }, 5000));
+    CHECK(marker_ran);
+    CHECK(marker_received < total);
+    CHECK(marker_pending);
+    CHECK(calls > 1);
+    CHECK(con->ReadBudgetHits() > 0);
+    std::cout << "total:" << total << " calls:" << calls << " budget hits:" << con->ReadBudgetHits() << std::endl;
+
+    // 在事件循环里删除事件，之后再释放连接
+    std::promise<void> removed;
+    loop->RunInLoop([loop, con, &removed]()
+                    {
+        loop->DelEvent(con);
+        removed.set_value(); });
+    removed.get_future().get();
+    ::close(fds[0]);
+    return TestPassed("ReadBudgetTest");
+}
@@ -0,0 +1,243 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <atomic>
+#include <vector>
+#include "network/net/EventLoopThread.h"
+#include "network/UdpServer.h"
+#include "network/rudp/RudpConnection.h"
+#include "network/base/SeqNumber.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 模拟有损链路：按概率丢包，blackhole 时全部丢弃，filter 返回 true 的也丢弃
+struct Link
+{
+    double loss{0.0};
+    std::atomic<bool> blackhole{false};
+    std::function<bool(const char *, size_t)> filter;
+    std::mt19937 rng{12345};
+    std::atomic<uint64_t> dropped{0};
+};
+
+// 一端：UDP 套接字和上面的可靠连接，收到的消息按序号记录
+struct Endpoint
+{
+    std::shared_ptr<UdpServer> socket;
+    RudpConnectionPtr conn;
+    Link link;
+    std::mutex lock;
+    std::vector<uint32_t> received;
+};
+
+// 建立两端，a 发往 b，b 的 ACK/NACK 发回 a，两个方向都经过各自的模拟链路
+static void Setup(EventLoop *loop, Endpoint &a, Endpoint &b, uint16_t port_a, uint16_t port_b, int32_t latency)
+{
+    Endpoint *ends[2] = {&a, &b};
+    uint16_t ports[2] = {port_a, port_b};
+    for (int i = 0; i < 2; i++)
+    {
+        Endpoint *self = ends[i];
+        InetAddress peer("127.0.0.1", ports[1 - i]);
+        self->socket = std::make_shared<UdpServer>(loop, InetAddress("127.0.0.1", ports[i]));
+        self->conn = std::make_shared<RudpConnection>(loop);
+        self->conn->SetLatency(latency);
+        auto socket = self->socket;
+        self->conn->SetOutputCallback([self, socket, peer](const char *data, size_t size)
+                                      {
+            Link &link = self->link;
+            std::uniform_real_distribution<double> dist(0.0, 1.0);
+            if (link.blackhole || (link.filter && link.filter(data, size)) || dist(link.rng) < link.loss)
+            {
+                link.dropped++;
+                return;
+            }
+            socket->SendCopy(data, size, peer.SockAddr(), peer.SockAddrLen()); });
+        self->conn->SetMessageCallback([self](const RudpConnectionPtr &, const char *data, size_t size)
+                                       {
+            uint32_t index = 0;
+            memcpy(&index, data, sizeof(index));
+            std::lock_guard<std::mutex> lk(self->lock);
+            self->received.push_back(index); });
+        auto conn = self->conn;
+        self->socket->SetRecvBatchCallback([conn](const UdpDatagram *msgs, size_t count)
+                                           {
+            for (size_t j = 0; j < count; j++)
+            {
+                conn->Input(msgs[j].data, msgs[j].size);
+            } });
+        self->socket->Start();
+        self->conn->Start();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+static void Teardown(Endpoint &a, Endpoint &b)
+{
+    a.conn->Stop();
+    b.conn->Stop();
+    a.socket->Stop();
+    b.socket->Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+// 在事件循环线程里发送 [from, to) 这些序号，每个消息 200 字节，开头是序号，每隔 interval 毫秒发一个
+static void SendRange(EventLoop *loop, const RudpConnectionPtr &conn, uint32_t from, uint32_t to, int interval)
+{
+    for (uint32_t i = from; i < to; i++)
+    {
+        loop->RunInLoop([conn, i]()
+                        {
+            char buf[200];
+            memset(buf, 'x', sizeof(buf));
+            memcpy(buf, &i, sizeof(i));
+            conn->Send(buf, sizeof(buf)); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+    }
+}
+
+// 收到的序号是否严格递增
+static bool StrictlyIncreasing(const std::vector<uint32_t> &list)
+{
+    for (size_t i = 1; i < list.size(); i++)
+    {
+        if (list[i] <= list[i - 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, const char **argv)
+{
+    // 1. 报文编解码和序号还原
+    {
+        char buf[kRudpMaxPacketSize];
+        auto len = RudpPacket::EncodeAck(buf, 25, 0xfffffff0u, 1234, 5);
+        RudpHeader header;
+        uint32_t ack = 0, ts = 0, delay = 0;
+        CHECK(len == kRudpAckSize);
+        CHECK(RudpPacket::DecodeHeader(buf, len, &header) && header.type == kRudpAck && header.rtt == 25);
+        CHECK(RudpPacket::DecodeAck(buf, len, &ack, &ts, &delay) && ack == 0xfffffff0u && ts == 1234 && delay == 5);
+        CHECK(!RudpPacket::DecodeAck(buf, len - 1, &ack, &ts, &delay));
+
+        RudpNackRange ranges[2];
+        ranges[0].seq = 7;
+        ranges[0].count = 3;
+        ranges[1].seq = 100;
+        ranges[1].count = 1;
+        len = RudpPacket::EncodeNack(buf, 0, ranges, 2);
+        CHECK(RudpPacket::NackRanges(len) == 2);
+        CHECK(RudpPacket::DecodeNackRange(buf, 1).seq == 100 && RudpPacket::DecodeNackRange(buf, 0).count == 3);
+
+        const uint64_t kSpan = 1ULL << 32;
+        CHECK(UnwrapSeq(5, 3) == 5);
+        CHECK(UnwrapSeq(0xfffffffeu, 1) == 0xfffffffeu);
+        CHECK(UnwrapSeq(2, kSpan - 3) == kSpan + 2);
+        CHECK(UnwrapSeq(0xfffffffeu, kSpan + 1) == kSpan - 2);
+    }
+
+    EventLoopThread loop_thread;
+    loop_thread.Run();
+    EventLoop *loop = loop_thread.Loop();
+
+    // 2. 两个方向各丢 20%，延迟预算足够时全部按序交付
+    {
+        Endpoint a, b;
+        a.link.loss = 0.2;
+        b.link.loss = 0.2;
+        Setup(loop, a, b, 34661, 34662, 1000);
+        const uint32_t kCount = 300;
+        SendRange(loop, a.conn, 0, kCount, 1);
+        CHECK(WaitFor([&]()
+                      { std::lock_guard<std::mutex> lk(b.lock);
+                        return b.received.size() == kCount; }, 5000));
+        auto sa = a.conn->Stats();
+        auto sb = b.conn->Stats();
+        std::cout << "loss 20%: sent " << sa.packets_sent << " retrans " << sa.packets_retrans
+                  << " nacks " << sb.nacks_sent << " dup " << sb.packets_duplicate
+                  << " rtt " << sa.rtt_ms << " ms" << std::endl;
+        {
+            std::lock_guard<std::mutex> lk(b.lock);
+            for (uint32_t i = 0; i < kCount; i++)
+            {
+                CHECK(b.received[i] == i);
+            }
+        }
+        CHECK(sa.packets_sent == kCount);
+        CHECK(sa.packets_retrans > 0);
+        CHECK(sb.nacks_sent > 0 && sa.nacks_received > 0);
+        CHECK(sb.packets_lost == 0 && sa.packets_dropped == 0);
+        CHECK(sa.rtt_ms < 100);
+        Teardown(a, b);
+    }
+
+    // 3. 最后一个包丢了，后面没有新的包，接收端发现不了空洞，靠 RTO 重传
+    {
+        Endpoint a, b;
+        const uint32_t kLast = 9;
+        std::atomic<bool> dropped_once{false};
+        a.link.filter = [&](const char *data, size_t size)
+        {
+            RudpHeader header;
+            uint32_t seq = 0, ts = 0;
+            if (RudpPacket::DecodeHeader(data, size, &header) && header.type == kRudpData &&
+                RudpPacket::DecodeData(data, size, &seq, &ts) && seq == kLast && !dropped_once)
+            {
+                dropped_once = true;
+                return true;
+            }
+            return false;
+        };
+        Setup(loop, a, b, 34663, 34664, 1000);
+        SendRange(loop, a.conn, 0, kLast + 1, 1);
+        CHECK(WaitFor([&]()
+                      { std::lock_guard<std::mutex> lk(b.lock);
+                        return b.received.size() == kLast + 1; }, 2000));
+        CHECK(dropped_once);
+        CHECK(a.conn->Stats().packets_retrans >= 1);
+        CHECK(b.conn->Stats().nacks_sent == 0);
+        Teardown(a, b);
+    }
+
+    // 4. 链路中断超过延迟预算：发送端不再重传太晚的包，接收端跳过空洞，之后的数据照常按序交付
+    {
+        Endpoint a, b;
+        Setup(loop, a, b, 34665, 34666, 100);
+        SendRange(loop, a.conn, 0, 50, 2);
+        a.link.blackhole = true;
+        SendRange(loop, a.conn, 50, 200, 2);
+        a.link.blackhole = false;
+        SendRange(loop, a.conn, 200, 250, 2);
+        CHECK(WaitFor([&]()
+                      { std::lock_guard<std::mutex> lk(b.lock);
+                        return !b.received.empty() && b.received.back() == 249; }, 2000));
+        // 等接收端处理完剩下的空洞
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        auto sa = a.conn->Stats();
+        auto sb = b.conn->Stats();
+        std::cout << "blackhole: delivered " << sb.messages_delivered << " lost " << sb.packets_lost
+                  << " sender dropped " << sa.packets_dropped << " retrans " << sa.packets_retrans << std::endl;
+        {
+            std::lock_guard<std::mutex> lk(b.lock);
+            CHECK(StrictlyIncreasing(b.received));
+            for (uint32_t i = 0; i < 50; i++)
+            {
+                CHECK(b.received[i] == i);
+            }
+            CHECK(b.received.size() >= 100 && b.received.size() < 250);
+        }
+        CHECK(sa.packets_dropped > 0);
+        CHECK(sb.packets_lost > 0);
+        CHECK(sb.messages_delivered + sb.packets_lost == 250);
+        Teardown(a, b);
+    }
+
+    return TestPassed("RudpTest");
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "network/base/SlabPool.h"
+#include "network/net/TcpConnection.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 记录析构次数
+static int g_destroyed = 0;
+
+struct Node
+{
+    Node(int v) : value(v) {}
+    ~Node() { g_destroyed++; }
+    int value{0};
+    char pad[100];
+};
+
+int main(int argc, const char **argv)
+{
+    auto pool = SlabPool::Local();
+
+    // 1. 释放后同样大小的对象复用池里的内存块
+    {
+        void *addr = nullptr;
+        {
+            auto n = MakeSlabShared<Node>(1);
+            CHECK(n->value == 1);
+            addr = n.get();
+        }
+        CHECK(g_destroyed == 1);
+        CHECK(pool->CachedBlocks() == 1);
+
+        auto reused = pool->Reused();
+        auto n = MakeSlabShared<Node>(2);
+        CHECK(n.get() == addr);
+        CHECK(pool->Reused() == reused + 1);
+        CHECK(pool->CachedBlocks() == 0);
+    }
+
+    // 2. 弱指针比对象活得久时，控制块的内存等弱指针释放后才归还
+    {
+        std::weak_ptr<Node> weak;
+        {
+            auto n = MakeSlabShared<Node>(3);
+            weak = n;
+        }
+        CHECK(weak.expired());
+        auto cached = pool->CachedBlocks();
+        weak.reset();
+        CHECK(pool->CachedBlocks() == cached + 1);
+    }
+
+    // 3. 在其他线程释放，内存块进入释放线程的池，不会出错
+    {
+        std::vector<std::shared_ptr<Node>> list;
+        for (int i = 0; i < 100; i++)
+        {
+            list.emplace_back(MakeSlabShared<Node>(i));
+        }
+        std::thread th([&list]()
+                       { list.clear(); });
+        th.join();
+        CHECK(list.empty());
+    }
+
+    // 4. 超过最大块大小的对象直接走系统分配
+    {
+        struct Big
+        {
+            char data[kSlabMaxBlock * 2];
+        };
+        auto cached = pool->CachedBlocks();
+        {
+            auto b = MakeSlabShared<Big>();
+        }
+        CHECK(pool->CachedBlocks() == cached);
+    }
+
+    // 5. 每一级缓存的字节数有上限
+    {
+        std::vector<std::shared_ptr<Node>> list;
+        for (int i = 0; i < 10000; i++)
+        {
+            list.emplace_back(MakeSlabShared<Node>(i));
+        }
+        list.clear();
+        CHECK(pool->CachedBlocks() * 128 <= kSlabClassBytes);
+    }
+
+    std::cout << "sizeof(TcpConnection): " << sizeof(TcpConnection) << std::endl;
+    return TestPassed("SlabPoolTest");
+}
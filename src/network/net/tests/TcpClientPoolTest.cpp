@@ -0,0 +1,91 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <atomic>
+#include "network/net/EventLoopThread.h"
+#include "network/net/EventLoopThreadPool.h"
+#include "network/TcpServer.h"
+#include "network/TcpClientPool.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+int main(int argc, const char **argv)
+{
+    // 源站
+    EventLoopThread server_thread;
+    server_thread.Run();
+    InetAddress origin("127.0.0.1:34571");
+    TcpServer server(server_thread.Loop(), origin);
+    server.Start();
+
+    // 回源的事件循环
+    EventLoopThreadPool loops(2, 0, 2);
+    loops.Start();
+
+    auto pool = std::make_shared<TcpClientPool>(&loops);
+    pool->SetConnectTimeout(2);
+    pool->SetBackoff(200, 2000);
+
+    // 1. 添加源站后建立预热连接
+    pool->AddOrigin(origin, 2);
+    CHECK(WaitFor([&]()
+                  { return pool->IdleCount(origin) == 2; }, 3000));
+
+    // 2. 取走一个连接，池会补足预热连接
+    {
+        std::promise<TcpClientPtr> got;
+        pool->Acquire(origin, [&got](const TcpClientPtr &c)
+                      { got.set_value(c); });
+        auto client = got.get_future().get();
+        CHECK(client && client->Status() == kTcpConStatusConnected);
+        CHECK(WaitFor([&]()
+                      { return pool->IdleCount(origin) == 2; }, 3000));
+
+        // 还回来时空闲连接已经够了，多余的连接被关闭
+        pool->Release(client);
+        CHECK(WaitFor([&]()
+                      { return client->Status() == kTcpConStatusDisConnected; }, 3000));
+        CHECK(pool->IdleCount(origin) == 2);
+    }
+
+    // 3. 源站不可用时退避重试，源站恢复后补足连接
+    InetAddress down("127.0.0.1:34572");
+    pool->AddOrigin(down, 1);
+    std::promise<TcpClientPtr> waiting;
+    pool->Acquire(down, [&waiting](const TcpClientPtr &c)
+                  { waiting.set_value(c); });
+    // 等待超时的 Acquire 回调空指针，其他等待者不受影响
+    std::atomic<int> timed_out{0};
+    auto start = std::chrono::steady_clock::now();
+    pool->Acquire(down, [&timed_out](const TcpClientPtr &c)
+                  { timed_out = c ? 2 : 1; }, 300);
+    CHECK(WaitFor([&]()
+                  { return timed_out != 0; }, 3000));
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(timed_out == 1);
+    CHECK(ms >= 250 && ms < 1500);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    CHECK(pool->IdleCount(down) == 0);
+
+    TcpServer server2(server_thread.Loop(), down);
+    server2.Start();
+    auto future = waiting.get_future();
+    CHECK(future.wait_for(std::chrono::seconds(8)) == std::future_status::ready);
+    auto client = future.get();
+    CHECK(client && client->Status() == kTcpConStatusConnected);
+    CHECK(WaitFor([&]()
+                  { return pool->IdleCount(down) == 1; }, 8000));
+
+    // 4. 停止后 Acquire 直接返回空
+    pool->Stop();
+    std::promise<TcpClientPtr> stopped;
+    pool->Acquire(origin, [&stopped](const TcpClientPtr &c)
+                  { stopped.set_value(c); });
+    CHECK(stopped.get_future().get() == nullptr);
+
+    client->ForceClose();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    return TestPassed("TcpClientPoolTest");
+}
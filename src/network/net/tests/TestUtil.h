@@ -0,0 +1,42 @@
+#pragma once
+/*
+    自检测试共用的检查宏和辅助函数
+    测试是普通的可执行文件，通过时输出 "<名字> ok" 并返回 0，检查失败时输出失败的条件和行号并返回非 0
+*/
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+// 检查条件，失败时输出信息并返回非 0，只能在返回 int 的函数里使用
+// 包在 do/while 里，放在不带大括号的 if/else 中也不会把 else 配到宏里的 if 上
+#define CHECK(cond)                                                        \
+    do                                                                     \
+    {                                                                      \
+        if (!(cond))                                                       \
+        {                                                                  \
+            std::cout << "check failed: " << #cond << " line:" << __LINE__ << std::endl; \
+            return -1;                                                     \
+        }                                                                  \
+    } while (0)
+
+// 等待条件成立，最多等待 ms 毫秒
+template <typename F>
+static bool WaitFor(F f, int ms)
+{
+    for (int i = 0; i < ms / 10; i++)
+    {
+        if (f())
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return f();
+}
+
+// 所有检查都通过，输出统一的通过信息，返回 main 的返回值
+inline int TestPassed(const char *name)
+{
+    std::cout << name << " ok" << std::endl;
+    return 0;
+}
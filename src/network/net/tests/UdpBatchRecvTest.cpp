@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/UdpServer.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 批量回调收到的结果
+struct Received
+{
+    std::mutex lock;
+    size_t datagrams{0};
+    size_t batches{0};
+    size_t truncated{0};
+    size_t bytes{0};
+    bool payload_ok{true};
+    uint16_t peer_port{0};
+};
+
+int main(int argc, const char **argv)
+{
+    EventLoopThread loop_thread;
+    loop_thread.Run();
+    EventLoop *loop = loop_thread.Loop();
+
+    InetAddress listen("127.0.0.1:34621");
+    auto server = std::make_shared<UdpServer>(loop, listen);
+    server->SetRecvBatch(8, 1024);
+
+    Received received;
+    server->SetRecvBatchCallback([&received](const UdpDatagram *msgs, size_t count)
+                                 {
+        std::lock_guard<std::mutex> lk(received.lock);
+        received.batches++;
+        for (size_t i = 0; i < count; i++)
+        {
+            received.datagrams++;
+            received.bytes += msgs[i].size;
+            if (msgs[i].truncated)
+            {
+                received.truncated++;
+                continue;
+            }
+            // 每个数据报的内容是它的序号
+            std::string data(msgs[i].data, msgs[i].size);
+            if (data.compare(0, 4, "seq:") != 0)
+            {
+                received.payload_ok = false;
+            }
+            if (msgs[i].addr->sa_family == AF_INET && msgs[i].addr_len == sizeof(struct sockaddr_in))
+            {
+                received.peer_port = ntohs(((const struct sockaddr_in *)msgs[i].addr)->sin_port);
+            }
+        } });
+    server->Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    CHECK(fd >= 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(34621);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    struct sockaddr_in local;
+    socklen_t local_len = sizeof(local);
+    ::getsockname(fd, (struct sockaddr *)&local, &local_len);
+
+    // 1. 一次发出大量数据报，服务端一次系统调用收多个，地址是二进制的对端地址
+    const size_t kCount = 200;
+    for (size_t i = 0; i < kCount; i++)
+    {
+        std::string data = "seq:" + std::to_string(i);
+        CHECK(::send(fd, data.data(), data.size(), 0) == (ssize_t)data.size());
+    }
+    CHECK(WaitFor([&received, kCount]()
+                  {
+        std::lock_guard<std::mutex> lk(received.lock);
+        return received.datagrams == kCount; }, 2000));
+    {
+        std::lock_guard<std::mutex> lk(received.lock);
+        std::cout << "datagrams: " << received.datagrams << " batches: " << received.batches << std::endl;
+        CHECK(received.payload_ok);
+        CHECK(received.peer_port == ntohs(local.sin_port));
+        // 至少有一部分是成批收的
+        CHECK(received.batches < kCount);
+    }
+    auto stats = server->Stats();
+    std::cout << "read calls: " << stats.read_calls << " msgs in: " << stats.msgs_in << std::endl;
+    CHECK(stats.msgs_in == kCount);
+    CHECK(stats.read_calls < kCount);
+
+    // 2. 比接收槽大的数据报被截断，并且标记出来
+    {
+        std::string big(3000, 'b');
+        CHECK(::send(fd, big.data(), big.size(), 0) == (ssize_t)big.size());
+        CHECK(WaitFor([&received]()
+                      {
+            std::lock_guard<std::mutex> lk(received.lock);
+            return received.truncated == 1; }, 2000));
+    }
+
+    ::close(fd);
+    server->Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return TestPassed("UdpBatchRecvTest");
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/UdpServer.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 创建一个阻塞的接收端，接收超时 1 秒，接收缓冲区足够放下整串数据报
+static int MakeReceiver(uint16_t port, struct sockaddr_in *addr)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    int rcvbuf = 4 * 1024 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct timeval tv = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    memset(addr, 0x00, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, (struct sockaddr *)addr, sizeof(*addr)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 接收数据报直到超时，返回个数，sizes 里是每个数据报的大小
+static size_t Drain(int fd, std::vector<size_t> &sizes)
+{
+    char buf[65536];
+    while (true)
+    {
+        auto n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n < 0)
+        {
+            break;
+        }
+        sizes.push_back(n);
+    }
+    return sizes.size();
+}
+
+int main(int argc, const char **argv)
+{
+    EventLoopThread loop_thread;
+    loop_thread.Run();
+    EventLoop *loop = loop_thread.Loop();
+
+    auto sender = std::make_shared<UdpServer>(loop, InetAddress("127.0.0.1:34631"));
+    sender->Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    struct sockaddr_in addr1, addr2;
+    int r1 = MakeReceiver(34632, &addr1);
+    int r2 = MakeReceiver(34633, &addr2);
+    CHECK(r1 >= 0 && r2 >= 0);
+
+    // 1. 同一个地址的一串数据报，切分正确，系统调用次数远少于数据报个数
+    {
+        const size_t kSegment = 1000;
+        const size_t kCount = 100;
+        // 最后一个数据报短一些
+        std::string burst(kSegment * kCount - 500, 'g');
+        sender->SendSegments(burst.data(), burst.size(), kSegment, (struct sockaddr *)&addr1, sizeof(addr1));
+
+        std::vector<size_t> sizes;
+        CHECK(Drain(r1, sizes) == kCount);
+        for (size_t i = 0; i + 1 < sizes.size(); i++)
+        {
+            CHECK(sizes[i] == kSegment);
+        }
+        CHECK(sizes.back() == kSegment - 500);
+
+        auto stats = sender->Stats();
+        std::cout << "segments: " << stats.msgs_out << " write calls: " << stats.write_calls << std::endl;
+        CHECK(stats.msgs_out == kCount);
+        CHECK(stats.bytes_out == burst.size());
+        CHECK(stats.write_calls <= 4);
+    }
+
+    // 2. 发给不同地址的数据包放在同一批 sendmmsg 里，地址在入队时拷贝
+    {
+        auto before = sender->Stats();
+        std::string payload(200, 'm');
+        std::list<UdpBufferNodePtr> list;
+        for (int i = 0; i < 20; i++)
+        {
+            // 地址是循环里的临时变量，节点里保存的是拷贝
+            struct sockaddr_in to = (i % 2 == 0) ? addr1 : addr2;
+            list.emplace_back(std::make_shared<UdpBufferNode>((void *)payload.data(), payload.size(), (struct sockaddr *)&to, sizeof(to)));
+        }
+        sender->Send(list);
+
+        std::vector<size_t> sizes1, sizes2;
+        CHECK(Drain(r1, sizes1) == 10);
+        CHECK(Drain(r2, sizes2) == 10);
+        auto stats = sender->Stats();
+        std::cout << "fan-out write calls: " << stats.write_calls - before.write_calls << std::endl;
+        CHECK(stats.msgs_out - before.msgs_out == 20);
+        CHECK(stats.write_calls - before.write_calls <= 2);
+    }
+
+    ::close(r1);
+    ::close(r2);
+    sender->Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return TestPassed("UdpBatchSendTest");
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/UdpServer.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 收到的数据报，按顺序记录大小和第一个字节
+struct Received
+{
+    std::mutex lock;
+    std::vector<size_t> sizes;
+    std::vector<char> marks;
+
+    void Add(const char *data, size_t size)
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        sizes.push_back(size);
+        marks.push_back(size > 0 ? data[0] : 0);
+    }
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        return sizes.size();
+    }
+};
+
+// 一串 kSegment 字节的数据报，第 i 个的内容都是 'a' + i % 26，最后一个短一些
+static const size_t kSegment = 1200;
+static const size_t kCount = 40;
+static std::string MakeBurst()
+{
+    std::string burst;
+    for (size_t i = 0; i < kCount; i++)
+    {
+        burst.append(i + 1 == kCount ? kSegment / 2 : kSegment, (char)('a' + i % 26));
+    }
+    return burst;
+}
+
+// 检查收到的数据报和发送的一致
+static bool Verify(Received &received)
+{
+    std::lock_guard<std::mutex> lk(received.lock);
+    if (received.sizes.size() != kCount)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < kCount; i++)
+    {
+        size_t expect = i + 1 == kCount ? kSegment / 2 : kSegment;
+        if (received.sizes[i] != expect || received.marks[i] != (char)('a' + i % 26))
+        {
+            std::cout << "datagram " << i << " size " << received.sizes[i] << " mark " << received.marks[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, const char **argv)
+{
+    EventLoopThread loop_thread;
+    loop_thread.Run();
+    EventLoop *loop = loop_thread.Loop();
+
+    auto sender = std::make_shared<UdpServer>(loop, InetAddress("127.0.0.1:34641"));
+    sender->Start();
+
+    std::string burst = MakeBurst();
+
+    // 1. 批量接收：合并的数据报按分段大小拆回原来的数据报
+    {
+        auto receiver = std::make_shared<UdpServer>(loop, InetAddress("127.0.0.1:34642"));
+        receiver->EnableGro(true);
+        Received received;
+        receiver->SetRecvBatchCallback([&received](const UdpDatagram *msgs, size_t count)
+                                       {
+            for (size_t i = 0; i < count; i++)
+            {
+                received.Add(msgs[i].data, msgs[i].size);
+            } });
+        receiver->Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        struct sockaddr_in to;
+        memset(&to, 0x00, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_port = htons(34642);
+        to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sender->SendSegments(burst.data(), burst.size(), kSegment, (struct sockaddr *)&to, sizeof(to));
+
+        CHECK(WaitFor([&received]()
+                      { return received.Size() >= kCount; }, 2000));
+        CHECK(Verify(received));
+        auto stats = receiver->Stats();
+        std::cout << "batch: msgs in " << stats.msgs_in << " read calls " << stats.read_calls << std::endl;
+        CHECK(stats.msgs_in == kCount);
+        receiver->Stop();
+    }
+
+    // 2. 只有逐个接收的回调时，开启 UDP_GRO 也是一个数据报调用一次
+    {
+        auto receiver = std::make_shared<UdpServer>(loop, InetAddress("127.0.0.1:34643"));
+        receiver->EnableGro(true);
+        Received received;
+        receiver->SetRecvMsgCallback([&received](const InetAddress &addr, MsgBuffer &buff)
+                                     {
+            received.Add(buff.Peek(), buff.ReadableBytes());
+            buff.RetrieveAll(); });
+        receiver->Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        struct sockaddr_in to;
+        memset(&to, 0x00, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_port = htons(34643);
+        to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sender->SendSegments(burst.data(), burst.size(), kSegment, (struct sockaddr *)&to, sizeof(to));
+
+        CHECK(WaitFor([&received]()
+                      { return received.Size() >= kCount; }, 2000));
+        CHECK(Verify(received));
+        receiver->Stop();
+    }
+
+    sender->Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return TestPassed("UdpGroTest");
+}
@@ -0,0 +1,170 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/net/EventLoopThreadPool.h"
+#include "network/UdpSessionServer.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 连接到服务器的 UDP 套接字，接收超时 1 秒
+static int Dial(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval tv = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in addr;
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    return fd;
+}
+
+// 回复的内容，会话发送时要保持有效
+static const std::string kAck = "ack";
+
+int main(int argc, const char **argv)
+{
+    // 1. 会话表：插入、查找、删除后探测链不断，扩容后都还能找到
+    {
+        UdpSessionTable table(8);
+        std::vector<UdpSessionPtr> list;
+        for (int i = 0; i < 1000; i++)
+        {
+            auto s = std::make_shared<UdpSession>(nullptr, InetAddress("10.0.0.1", (uint16_t)(20000 + i)), nullptr);
+            list.push_back(s);
+            table.Insert(s);
+        }
+        CHECK(table.Size() == 1000);
+        for (int i = 0; i < 1000; i += 2)
+        {
+            CHECK(table.Erase(list[i]->PeerAddr()));
+        }
+        CHECK(!table.Erase(list[0]->PeerAddr()));
+        CHECK(table.Size() == 500);
+        for (int i = 0; i < 1000; i++)
+        {
+            auto found = table.Find(list[i]->PeerAddr());
+            CHECK((i % 2 == 0) ? !found : found == list[i]);
+        }
+        CHECK(table.TakeAll().size() == 500);
+        CHECK(table.Size() == 0 && !table.Find(list[1]->PeerAddr()));
+    }
+
+    EventLoopThreadPool pool(2, 0, 0);
+    pool.Start();
+
+    // 2. 每个对端一个会话，回复从同一个端口发出，空闲超时后关闭
+    {
+        auto server = std::make_shared<UdpSessionServer>(&pool, InetAddress("127.0.0.1:34651"));
+        server->SetIdleTimeout(1);
+
+        std::mutex lock;
+        std::set<EventLoop *> loops;
+        size_t created = 0, closed = 0;
+        bool in_loop = true;
+        server->SetNewSessionCallback([&](const UdpSessionPtr &s)
+                                      {
+            std::lock_guard<std::mutex> lk(lock);
+            created++;
+            loops.insert(s->Loop());
+            in_loop = in_loop && s->Loop()->IsInLoopThread(); });
+        server->SetSessionMessageCallback([](const UdpSessionPtr &s, const char *data, size_t size)
+                                          { s->Send(kAck.data(), kAck.size()); });
+        std::vector<uint64_t> msgs_in;
+        server->SetSessionCloseCallback([&](const UdpSessionPtr &s)
+                                        {
+            std::lock_guard<std::mutex> lk(lock);
+            closed++;
+            msgs_in.push_back(s->MsgsIn()); });
+        server->Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        const int kPeers = 8;
+        const int kMsgs = 10;
+        std::vector<int> fds;
+        for (int i = 0; i < kPeers; i++)
+        {
+            fds.push_back(Dial(34651));
+        }
+        for (int m = 0; m < kMsgs; m++)
+        {
+            for (auto fd : fds)
+            {
+                CHECK(::send(fd, "data", 4, 0) == 4);
+                char buf[16];
+                CHECK(::recv(fd, buf, sizeof(buf), 0) == (ssize_t)kAck.size());
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            std::cout << "sessions: " << created << " on " << loops.size() << " loops" << std::endl;
+            CHECK(created == (size_t)kPeers);
+            CHECK(in_loop);
+        }
+        CHECK(server->SessionCount() == (size_t)kPeers);
+
+        // 时间轮的精度是秒，1 秒的空闲超时最多 3 秒内关闭
+        CHECK(WaitFor([&]()
+                      { return server->SessionCount() == 0; }, 4000));
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            CHECK(closed == (size_t)kPeers);
+            for (auto n : msgs_in)
+            {
+                CHECK(n == (uint64_t)kMsgs);
+            }
+        }
+
+        // 超时关闭后再发数据，创建新的会话
+        CHECK(::send(fds[0], "data", 4, 0) == 4);
+        CHECK(WaitFor([&]()
+                      { return server->SessionCount() == 1; }, 1000));
+
+        server->Stop();
+        CHECK(WaitFor([&]()
+                      { return server->SessionCount() == 0; }, 1000));
+        for (auto fd : fds)
+        {
+            ::close(fd);
+        }
+    }
+
+    // 3. 会话数达到上限后新的对端的数据报被丢弃
+    {
+        auto server = std::make_shared<UdpSessionServer>(pool.GetLoops()[0], InetAddress("127.0.0.1:34652"));
+        server->SetMaxSessions(1);
+        server->Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        int a = Dial(34652);
+        int b = Dial(34652);
+        CHECK(::send(a, "a", 1, 0) == 1);
+        CHECK(WaitFor([&]()
+                      { return server->SessionCount() == 1; }, 1000));
+        CHECK(::send(b, "b", 1, 0) == 1);
+        CHECK(WaitFor([&]()
+                      { return server->Dropped() == 1; }, 1000));
+        CHECK(server->SessionCount() == 1);
+
+        server->Stop();
+        ::close(a);
+        ::close(b);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    pool.Stop();
+    return TestPassed("UdpSessionTest");
+}
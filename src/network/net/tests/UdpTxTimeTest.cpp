@@ -0,0 +1,170 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "network/net/EventLoopThread.h"
+#include "network/UdpServer.h"
+#include "network/UdpSessionServer.h"
+#include "network/base/UdpPacer.h"
+#include "TestUtil.h"
+
+using namespace tmms::network;
+
+// 连接到服务器的 UDP 套接字，接收超时 1 秒
+static int Dial(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval tv = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in addr;
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    return fd;
+}
+
+// 一帧打成的数据报个数、大小和目标码率，码率下每个数据报间隔 10ms
+const int kPackets = 20;
+const size_t kPacketSize = 1000;
+const uint64_t kRate = 100000;
+
+// 发一个数据报建立会话，会话收到后按码率发回一帧，返回每个数据报的到达时间（毫秒）
+static std::vector<int64_t> RunSession(EventLoop *loop, uint16_t port, bool txtime, clockid_t clockid = CLOCK_MONOTONIC)
+{
+    std::vector<int64_t> arrivals;
+    auto server = std::make_shared<UdpSessionServer>(loop, InetAddress("127.0.0.1", port));
+    server->EnableTxTime(txtime, clockid);
+    static const std::string kFrame(kPacketSize, 'v');
+    server->SetSessionMessageCallback([](const UdpSessionPtr &s, const char *data, size_t size)
+                                      {
+        s->SetPacing(kRate);
+        for (int i = 0; i < kPackets; i++)
+        {
+            s->SendMedia(kFrame.data(), kFrame.size(), 0);
+        } });
+    server->Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    int fd = Dial(port);
+    ::send(fd, "play", 4, 0);
+    auto start = std::chrono::steady_clock::now();
+    char buf[2048];
+    for (int i = 0; i < kPackets; i++)
+    {
+        if (::recv(fd, buf, sizeof(buf), 0) != (ssize_t)kPacketSize)
+        {
+            break;
+        }
+        arrivals.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    ::close(fd);
+    server->Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return arrivals;
+}
+
+int main(int argc, const char **argv)
+{
+    // 1. 发送时间计算：同一帧按码率错开，下一帧按媒体时间戳对齐，时间戳跳变后重新对齐
+    {
+        UdpPacer pacer(kRate);
+        uint64_t first = pacer.Next(kPacketSize, 0);
+        uint64_t prev = first;
+        for (int i = 1; i < 5; i++)
+        {
+            uint64_t t = pacer.Next(kPacketSize, 0);
+            CHECK(t - prev == 10000000);
+            prev = t;
+        }
+        // 下一帧在 100ms 之后，比码率排出来的 50ms 晚
+        uint64_t frame = pacer.Next(kPacketSize, 100);
+        CHECK(frame - first == 100000000);
+        // 时间戳往前跳 1 小时，重新对齐，不会等 1 小时
+        uint64_t jump = pacer.Next(kPacketSize, 3600 * 1000);
+        CHECK(jump < UdpPacer::NowNs() + (uint64_t)kUdpPacerMaxDelayMs * 1000000 + 1);
+
+        // 没有码率时只按时间戳，没有时间戳时立即发送
+        UdpPacer plain;
+        uint64_t now = UdpPacer::NowNs();
+        CHECK(plain.Next(kPacketSize) < now + 1000000);
+        CHECK(plain.Next(kPacketSize, 0) < now + 1000000);
+        CHECK(plain.Next(kPacketSize, 30) - now >= 29000000);
+    }
+
+    EventLoopThread loop_thread;
+    loop_thread.Run();
+    EventLoop *loop = loop_thread.Loop();
+
+    // 2. 定时器模式：一帧 20 个数据报按码率间隔 10ms 到达，而不是一起到达
+    {
+        auto arrivals = RunSession(loop, 34671, false);
+        CHECK(arrivals.size() == (size_t)kPackets);
+        int64_t span = arrivals.back() - arrivals.front();
+        std::cout << "timer pacing span: " << span << " ms" << std::endl;
+        CHECK(span >= 150 && span < 1000);
+        // 任意 5ms 之内最多到达 2 个
+        for (size_t i = 2; i < arrivals.size(); i++)
+        {
+            CHECK(arrivals[i] - arrivals[i - 2] >= 5);
+        }
+    }
+
+    // 3. 内核模式：设置 SO_TXTIME，数据报带着发送时间都能送达
+    // 回环口默认没有 fq/etf，内核忽略发送时间，这里不检查间隔
+    {
+        auto socket = std::make_shared<UdpServer>(loop, InetAddress("127.0.0.1:34672"));
+        socket->EnableTxTime(true);
+        socket->Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::cout << "so_txtime kernel: " << socket->TxTimeKernel() << std::endl;
+
+        auto arrivals = RunSession(loop, 34673, true);
+        CHECK(arrivals.size() == (size_t)kPackets);
+        socket->Stop();
+    }
+
+    // 3.1 etf 用的 CLOCK_TAI：发送时间换算过去，没有权限设置时退回定时器，数据报都能送达
+    {
+        auto socket = std::make_shared<UdpServer>(loop, InetAddress("127.0.0.1:34676"));
+        socket->EnableTxTime(true, CLOCK_TAI);
+        socket->Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::cout << "so_txtime kernel (tai): " << socket->TxTimeKernel() << std::endl;
+        socket->Stop();
+
+        auto arrivals = RunSession(loop, 34677, true, CLOCK_TAI);
+        CHECK(arrivals.size() == (size_t)kPackets);
+    }
+
+    // 4. 关闭后定时队列里的数据报丢弃，不再发送
+    {
+        auto socket = std::make_shared<UdpServer>(loop, InetAddress("127.0.0.1:34674"));
+        socket->Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        int fd = Dial(34675);
+        struct sockaddr_in peer;
+        memset(&peer, 0x00, sizeof(peer));
+        peer.sin_family = AF_INET;
+        peer.sin_port = htons(34675);
+        peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        std::string data(kPacketSize, 'x');
+        socket->SendAt(data.data(), data.size(), (struct sockaddr *)&peer, sizeof(peer), UdpPacer::NowNs() + 200000000);
+        CHECK(WaitFor([&socket]()
+                      { return socket->PendingTxBytes() == kPacketSize; }, 500));
+        socket->Stop();
+        CHECK(WaitFor([&socket]()
+                      { return socket->PendingTxBytes() == 0; }, 500));
+        ::close(fd);
+    }
+
+    return TestPassed("UdpTxTimeTest");
+}
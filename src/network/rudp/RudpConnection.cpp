@@ -0,0 +1,508 @@
+#include "RudpConnection.h"
+#include <cstring>
+#include "network/base/Network.h"
+#include "network/net/ConnectionStats.h"
+#include "network/base/SeqNumber.h"
+#include "base/TTime.h"
+
+using namespace tmms::network;
+
+RudpConnection::RudpConnection(EventLoop *loop)
+    : loop_(loop), start_ms_(tmms::base::TTime::NowMS())
+{
+}
+
+void RudpConnection::SetOutputCallback(const RudpOutputCallback &cb)
+{
+    output_cb_ = cb;
+}
+
+void RudpConnection::SetOutputCallback(RudpOutputCallback &&cb)
+{
+    output_cb_ = std::move(cb);
+}
+
+void RudpConnection::SetMessageCallback(const RudpMessageCallback &cb)
+{
+    message_cb_ = cb;
+}
+
+void RudpConnection::SetMessageCallback(RudpMessageCallback &&cb)
+{
+    message_cb_ = std::move(cb);
+}
+
+// 把输出接到 UDP 套接字上
+void RudpConnection::Attach(const UdpSocketPtr &socket, const InetAddress &peer)
+{
+    // 重传缓冲区里的包在确认或者超出预算时释放，套接字需要排队时必须自己拷贝
+    output_cb_ = [socket, peer](const char *data, size_t size)
+    {
+        socket->SendCopy(data, size, peer.SockAddr(), peer.SockAddrLen());
+    };
+}
+
+// 设置延迟预算
+void RudpConnection::SetLatency(int32_t ms)
+{
+    latency_ms_ = ms > kRudpTickMs ? ms : kRudpTickMs;
+}
+
+// 启动定时器
+void RudpConnection::Start()
+{
+    auto self = shared_from_this();
+    loop_->RunInLoop([self]()
+                     {
+        if (self->running_)
+        {
+            return;
+        }
+        self->running_ = true;
+        self->ScheduleTick(); });
+}
+
+// 停止定时器，丢弃所有缓冲的数据
+void RudpConnection::Stop()
+{
+    auto self = shared_from_this();
+    loop_->RunInLoop([self]()
+                     {
+        self->running_ = false;
+        self->snd_buf_.clear();
+        self->rcv_buf_.clear();
+        self->loss_.clear(); });
+}
+
+// 发送一个消息
+bool RudpConnection::Send(const char *data, size_t size)
+{
+    if (size > kRudpMaxPayload)
+    {
+        NETWORK_WARN << " rudp message too large : " << size << " max : " << kRudpMaxPayload;
+        return false;
+    }
+    int64_t now = tmms::base::TTime::NowMS();
+
+    snd_buf_.emplace_back();
+    auto &packet = snd_buf_.back();
+    packet.seq = snd_nxt_++;
+    packet.first_send = now;
+    packet.last_send = now;
+    packet.data.resize(kRudpDataHeaderSize + size);
+    char *buf = &packet.data[0];
+    RudpHeader header;
+    header.type = kRudpData;
+    header.rtt = (uint16_t)counters_.rtt_ms.load(std::memory_order_relaxed);
+    RudpPacket::EncodeHeader(buf, header);
+    RudpPacket::EncodeData(buf, (uint32_t)packet.seq, Timestamp(now));
+    memcpy(buf + kRudpDataHeaderSize, data, size);
+
+    ConnectionStats::Add(counters_.packets_sent, 1);
+    Output(packet.data.data(), packet.data.size());
+    return true;
+}
+
+// 收到对端的一个数据报
+void RudpConnection::Input(const char *data, size_t size)
+{
+    RudpHeader header;
+    if (!RudpPacket::DecodeHeader(data, size, &header))
+    {
+        return;
+    }
+    int64_t now = tmms::base::TTime::NowMS();
+    switch (header.type)
+    {
+    case kRudpData:
+        OnData(header, data, size, now);
+        break;
+    case kRudpAck:
+        OnAck(data, size, now);
+        break;
+    case kRudpNack:
+        OnNack(data, size, now);
+        break;
+    default:
+        break;
+    }
+}
+
+// 统计数据的快照
+RudpStats RudpConnection::Stats() const
+{
+    RudpStats stats;
+    stats.packets_sent = counters_.packets_sent.load(std::memory_order_relaxed);
+    stats.packets_retrans = counters_.packets_retrans.load(std::memory_order_relaxed);
+    stats.packets_dropped = counters_.packets_dropped.load(std::memory_order_relaxed);
+    stats.packets_received = counters_.packets_received.load(std::memory_order_relaxed);
+    stats.packets_duplicate = counters_.packets_duplicate.load(std::memory_order_relaxed);
+    stats.packets_lost = counters_.packets_lost.load(std::memory_order_relaxed);
+    stats.messages_delivered = counters_.messages_delivered.load(std::memory_order_relaxed);
+    stats.nacks_sent = counters_.nacks_sent.load(std::memory_order_relaxed);
+    stats.nacks_received = counters_.nacks_received.load(std::memory_order_relaxed);
+    stats.rtt_ms = counters_.rtt_ms.load(std::memory_order_relaxed);
+    stats.rtt_var_ms = counters_.rtt_var_ms.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// 所属的事件循环
+EventLoop *RudpConnection::Loop() const
+{
+    return loop_;
+}
+
+// 定时器通过弱指针访问连接，连接释放后自然停止
+void RudpConnection::ScheduleTick()
+{
+    std::weak_ptr<RudpConnection> weak = shared_from_this();
+    loop_->RunAfterMs(kRudpTickMs, [weak]()
+                      {
+        auto self = weak.lock();
+        if (self && self->running_)
+        {
+            self->OnTick();
+            self->ScheduleTick();
+        } });
+}
+
+void RudpConnection::OnTick()
+{
+    int64_t now = tmms::base::TTime::NowMS();
+    // 发送端
+    DropTooLate(now);
+    RetransmitTimeout(now);
+    // 接收端
+    SkipTooLate(now);
+    SendNack(now, false);
+    if (ack_pending_)
+    {
+        SendAck(now);
+    }
+}
+
+// 收到一个数据包
+void RudpConnection::OnData(const RudpHeader &header, const char *data, size_t size, int64_t now)
+{
+    uint32_t wire_seq = 0, ts = 0;
+    if (!RudpPacket::DecodeData(data, size, &wire_seq, &ts))
+    {
+        return;
+    }
+    ConnectionStats::Add(counters_.packets_received, 1);
+    if (header.rtt > 0)
+    {
+        peer_rtt_ms_ = header.rtt;
+    }
+    ack_pending_ = true;
+    last_data_ts_ = ts;
+    last_data_arrive_ = now;
+
+    uint64_t seq = UnwrapSeq(wire_seq, rcv_nxt_);
+    if (seq < rcv_nxt_ || rcv_buf_.find(seq) != rcv_buf_.end())
+    {
+        ConnectionStats::Add(counters_.packets_duplicate, 1);
+        return;
+    }
+
+    if (seq - rcv_nxt_ >= kRudpMaxGap)
+    {
+        // 空洞太大，多半是对端重启或者长时间断开，已经收到的按序交付，之前的都不等了
+        while (!rcv_buf_.empty())
+        {
+            SkipTo(rcv_buf_.begin()->first);
+        }
+        SkipTo(seq);
+        rcv_max_ = seq;
+    }
+
+    if (seq >= rcv_max_)
+    {
+        // 序号跳过的都是新发现的丢包，立即发一次 NACK，不等定时器
+        if (seq > rcv_max_)
+        {
+            for (uint64_t s = rcv_max_; s < seq; s++)
+            {
+                loss_[s].last_nack = 0;
+            }
+            SendNack(now, true);
+        }
+        rcv_max_ = seq + 1;
+    }
+    else
+    {
+        // 补上了一个空洞
+        loss_.erase(seq);
+    }
+
+    const char *payload = data + kRudpDataHeaderSize;
+    size_t payload_size = size - kRudpDataHeaderSize;
+    if (seq != rcv_nxt_)
+    {
+        auto &packet = rcv_buf_[seq];
+        packet.payload.assign(payload, payload_size);
+        packet.arrive = now;
+        return;
+    }
+
+    // 按序到达的直接交付，不拷贝
+    rcv_nxt_++;
+    ConnectionStats::Add(counters_.messages_delivered, 1);
+    if (message_cb_)
+    {
+        message_cb_(shared_from_this(), payload, payload_size);
+    }
+    DeliverBuffered();
+}
+
+// 收到 ACK，释放确认的包，用回显的时间戳估计 RTT
+void RudpConnection::OnAck(const char *data, size_t size, int64_t now)
+{
+    uint32_t wire_ack = 0, echo_ts = 0, delay = 0;
+    if (!RudpPacket::DecodeAck(data, size, &wire_ack, &echo_ts, &delay))
+    {
+        return;
+    }
+    uint64_t una = snd_buf_.empty() ? snd_nxt_ : snd_buf_.front().seq;
+    uint64_t ack = UnwrapSeq(wire_ack, una);
+    if (ack > snd_nxt_)
+    {
+        return;
+    }
+    while (!snd_buf_.empty() && snd_buf_.front().seq < ack)
+    {
+        snd_buf_.pop_front();
+    }
+
+    int64_t sample = (int64_t)(int32_t)(Timestamp(now) - echo_ts) - (int64_t)delay;
+    if (sample >= 0 && sample < 60 * 1000)
+    {
+        UpdateRtt((int32_t)sample);
+    }
+}
+
+// 收到 NACK，重传还在缓冲区里的包
+void RudpConnection::OnNack(const char *data, size_t size, int64_t now)
+{
+    ConnectionStats::Add(counters_.nacks_received, 1);
+    if (snd_buf_.empty())
+    {
+        return;
+    }
+    uint64_t una = snd_buf_.front().seq;
+    // 半个 RTT 内重传过的不再重传，重复的 NACK 不会引起重传风暴
+    int32_t min_interval = counters_.rtt_ms.load(std::memory_order_relaxed) / 2;
+    size_t n = RudpPacket::NackRanges(size);
+    for (size_t i = 0; i < n; i++)
+    {
+        auto range = RudpPacket::DecodeNackRange(data, i);
+        uint64_t first = UnwrapSeq(range.seq, una);
+        for (uint64_t seq = first; seq < first + range.count; seq++)
+        {
+            if (seq < una || seq >= snd_nxt_)
+            {
+                continue;
+            }
+            auto &packet = snd_buf_[seq - una];
+            if (now - packet.last_send >= min_interval)
+            {
+                Retransmit(packet, now);
+            }
+        }
+    }
+}
+
+// 重写时间戳和标志后重发一个包
+void RudpConnection::Retransmit(SendPacket &packet, int64_t now)
+{
+    char *buf = &packet.data[0];
+    RudpHeader header;
+    header.type = kRudpData;
+    header.flags = kRudpFlagRetrans;
+    header.rtt = (uint16_t)counters_.rtt_ms.load(std::memory_order_relaxed);
+    RudpPacket::EncodeHeader(buf, header);
+    RudpPacket::EncodeData(buf, (uint32_t)packet.seq, Timestamp(now));
+    packet.last_send = now;
+    ConnectionStats::Add(counters_.packets_retrans, 1);
+    Output(packet.data.data(), packet.data.size());
+}
+
+// 发送端丢弃超出延迟预算的包，接收端这时也已经跳过了，再重传只是浪费带宽
+void RudpConnection::DropTooLate(int64_t now)
+{
+    while (!snd_buf_.empty() && now - snd_buf_.front().first_send > latency_ms_)
+    {
+        snd_buf_.pop_front();
+        ConnectionStats::Add(counters_.packets_dropped, 1);
+    }
+}
+
+// 超过 RTO 还没确认的包重传，主要处理尾部丢包：后面没有新的包，接收端发现不了空洞
+void RudpConnection::RetransmitTimeout(int64_t now)
+{
+    int32_t rto = Rto();
+    int32_t burst = 0;
+    for (auto &packet : snd_buf_)
+    {
+        if (burst >= kRudpMaxRtoBurst)
+        {
+            break;
+        }
+        // 同一个包连续超时按指数退避，对端长时间没有响应时不会按 RTO 的频率一直重传
+        int32_t shift = packet.timeouts < 4 ? packet.timeouts : 4;
+        if (now - packet.last_send >= ((int64_t)rto << shift))
+        {
+            packet.timeouts++;
+            Retransmit(packet, now);
+            burst++;
+        }
+    }
+}
+
+// 把连续的包交付给业务层
+void RudpConnection::DeliverBuffered()
+{
+    while (!rcv_buf_.empty() && rcv_buf_.begin()->first == rcv_nxt_)
+    {
+        // 先移出来，回调里可能再调用 Input
+        std::string payload;
+        payload.swap(rcv_buf_.begin()->second.payload);
+        rcv_buf_.erase(rcv_buf_.begin());
+        rcv_nxt_++;
+        ConnectionStats::Add(counters_.messages_delivered, 1);
+        if (message_cb_)
+        {
+            message_cb_(shared_from_this(), payload.data(), payload.size());
+        }
+    }
+}
+
+// 空洞后面第一个到达的包已经等了超过延迟预算，空洞里的包不再等待
+void RudpConnection::SkipTooLate(int64_t now)
+{
+    while (!rcv_buf_.empty() && now - rcv_buf_.begin()->second.arrive > latency_ms_)
+    {
+        SkipTo(rcv_buf_.begin()->first);
+    }
+}
+
+// 放弃 next 之前还没收到的包，交付 next 开始连续的包
+void RudpConnection::SkipTo(uint64_t next)
+{
+    ConnectionStats::Add(counters_.packets_lost, next - rcv_nxt_);
+    loss_.erase(loss_.begin(), loss_.lower_bound(next));
+    rcv_nxt_ = next;
+    DeliverBuffered();
+}
+
+// 发送 ACK：下一个要交付的序号，跳过的包也算确认了
+void RudpConnection::SendAck(int64_t now)
+{
+    ack_pending_ = false;
+    auto len = RudpPacket::EncodeAck(ctrl_buf_, (uint16_t)counters_.rtt_ms.load(std::memory_order_relaxed),
+                                     (uint32_t)rcv_nxt_, last_data_ts_, (uint32_t)(now - last_data_arrive_));
+    Output(ctrl_buf_, len);
+}
+
+// 发送到期的 NACK
+void RudpConnection::SendNack(int64_t now, bool force)
+{
+    if (loss_.empty())
+    {
+        return;
+    }
+    int32_t interval = NackInterval();
+    std::vector<uint64_t> seqs;
+    for (auto &kv : loss_)
+    {
+        if (force || now - kv.second.last_nack >= interval)
+        {
+            kv.second.last_nack = now;
+            seqs.push_back(kv.first);
+        }
+    }
+    if (!seqs.empty())
+    {
+        SendNackRanges(seqs);
+    }
+}
+
+// 把有序的丢失序号合并成区间，一个报文放不下时分成多个
+void RudpConnection::SendNackRanges(const std::vector<uint64_t> &seqs)
+{
+    std::vector<RudpNackRange> ranges;
+    for (auto seq : seqs)
+    {
+        if (!ranges.empty())
+        {
+            auto &last = ranges.back();
+            if ((uint32_t)seq == last.seq + last.count && last.count < UINT16_MAX)
+            {
+                last.count++;
+                continue;
+            }
+        }
+        RudpNackRange range;
+        range.seq = (uint32_t)seq;
+        range.count = 1;
+        ranges.push_back(range);
+    }
+    uint16_t rtt = (uint16_t)counters_.rtt_ms.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < ranges.size(); i += kRudpMaxNackRanges)
+    {
+        size_t count = ranges.size() - i < kRudpMaxNackRanges ? ranges.size() - i : kRudpMaxNackRanges;
+        auto len = RudpPacket::EncodeNack(ctrl_buf_, rtt, &ranges[i], count);
+        ConnectionStats::Add(counters_.nacks_sent, 1);
+        Output(ctrl_buf_, len);
+    }
+}
+
+// RFC 6298 的平滑 RTT 和平均偏差
+void RudpConnection::UpdateRtt(int32_t sample)
+{
+    int32_t srtt = counters_.rtt_ms.load(std::memory_order_relaxed);
+    int32_t rttvar = counters_.rtt_var_ms.load(std::memory_order_relaxed);
+    if (!rtt_sampled_)
+    {
+        rtt_sampled_ = true;
+        srtt = sample;
+        rttvar = sample / 2;
+    }
+    else
+    {
+        int32_t err = sample > srtt ? sample - srtt : srtt - sample;
+        rttvar = (3 * rttvar + err) / 4;
+        srtt = (7 * srtt + sample) / 8;
+    }
+    counters_.rtt_ms.store(srtt, std::memory_order_relaxed);
+    counters_.rtt_var_ms.store(rttvar, std::memory_order_relaxed);
+}
+
+// 重传超时，ACK 最多晚一个定时器周期发出，也算进去
+int32_t RudpConnection::Rto() const
+{
+    int32_t rto = counters_.rtt_ms.load(std::memory_order_relaxed) + 4 * counters_.rtt_var_ms.load(std::memory_order_relaxed) + kRudpTickMs;
+    return rto > kRudpMinRtoMs ? rto : kRudpMinRtoMs;
+}
+
+// NACK 的重发间隔，一个 RTT 内重传的包还在路上，不用再要
+int32_t RudpConnection::NackInterval() const
+{
+    int32_t interval = peer_rtt_ms_ + kRudpTickMs;
+    return interval > kRudpMinNackIntervalMs ? interval : kRudpMinNackIntervalMs;
+}
+
+// 相对于创建时刻的毫秒时间戳
+uint32_t RudpConnection::Timestamp(int64_t now) const
+{
+    return (uint32_t)(now - start_ms_);
+}
+
+// 把报文交给输出回调
+void RudpConnection::Output(const char *data, size_t size)
+{
+    if (output_cb_)
+    {
+        output_cb_(data, size);
+    }
+}
@@ -0,0 +1,212 @@
+#pragma once
+/*
+    低延迟的可靠 UDP 传输（ARQ/NACK）
+    推流的贡献链路经常跑在有丢包的公网上，RTMP over TCP 丢一个包要等重传超时，后面的数据全部被队头阻塞
+    这里每个数据包带序号，接收端发现空洞立即发 NACK，之后按 RTT 周期性重发 NACK，发送端收到后重传
+    发送端按累计 ACK 释放缓冲，ACK 回显数据包的时间戳用来估计 RTT，尾部丢包靠 RTO 重传
+    整条链路有一个延迟预算：发送端超过预算还没确认的包不再重传（too-late-to-send），
+    接收端空洞等待超过预算后跳过，后面的数据照常交付，宁可丢一点也不让延迟无限增长
+    定时器由所属的 EventLoop 驱动，所有接口都在事件循环线程调用，统计可以在任意线程读取
+    和具体的套接字无关，发出的报文交给输出回调，收到的数据报调用 Input；Attach 把输出接到一个 UdpSocket 上
+*/
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "network/net/EventLoop.h"
+#include "network/net/UdpSocket.h"
+#include "network/base/InetAddress.h"
+#include "network/rudp/RudpPacket.h"
+#include "base/NonCopyable.h"
+
+namespace tmms
+{
+    namespace network
+    {
+        class RudpConnection;
+        using RudpConnectionPtr = std::shared_ptr<RudpConnection>;
+
+        // 输出一个要发给对端的报文，data 只在回调期间有效
+        using RudpOutputCallback = std::function<void(const char *data, size_t size)>;
+        // 按序交付一个消息，data 只在回调期间有效
+        using RudpMessageCallback = std::function<void(const RudpConnectionPtr &, const char *data, size_t size)>;
+
+        // 默认的延迟预算，单位：毫秒
+        const int32_t kRudpDefaultLatencyMs = 120;
+        // 定时器的周期，ACK、周期性 NACK、RTO 和延迟预算都在这里检查，单位：毫秒
+        const int32_t kRudpTickMs = 10;
+        // 没有 RTT 样本时使用的 RTT，单位：毫秒
+        const int32_t kRudpInitRttMs = 100;
+        // 最小的 RTO 和 NACK 重发间隔，单位：毫秒
+        const int32_t kRudpMinRtoMs = 30;
+        const int32_t kRudpMinNackIntervalMs = 20;
+        // 一次定时器最多因为 RTO 重传的包数，对端没有响应时不会一下子把整个缓冲区发出去
+        const int32_t kRudpMaxRtoBurst = 32;
+        // 接收端允许的最大空洞，超过时认为中间的全部丢了，直接跳到新的序号
+        const uint64_t kRudpMaxGap = 8192;
+
+        // 统计数据的快照
+        struct RudpStats
+        {
+            uint64_t packets_sent{0};       // 发出的数据包，不含重传
+            uint64_t packets_retrans{0};    // 重传的次数，包括 NACK 和 RTO 触发的
+            uint64_t packets_dropped{0};    // 发送端超出延迟预算还没确认、不再重传的包
+            uint64_t packets_received{0};   // 收到的数据包，包括重复的
+            uint64_t packets_duplicate{0};  // 收到的重复数据包
+            uint64_t packets_lost{0};       // 接收端超出延迟预算跳过的包
+            uint64_t messages_delivered{0}; // 交付给业务层的消息
+            uint64_t nacks_sent{0};         // 发出的 NACK 报文
+            uint64_t nacks_received{0};     // 收到的 NACK 报文
+            int32_t rtt_ms{0};              // 平滑 RTT，单位：毫秒
+            int32_t rtt_var_ms{0};          // RTT 的平均偏差，单位：毫秒
+        };
+
+        class RudpConnection : public std::enable_shared_from_this<RudpConnection>, public base::NonCopyable
+        {
+        public:
+            explicit RudpConnection(EventLoop *loop);
+
+            // 设置输出回调，在 Start 之前调用
+            void SetOutputCallback(const RudpOutputCallback &cb);
+            void SetOutputCallback(RudpOutputCallback &&cb);
+            // 设置消息回调，在 Start 之前调用
+            void SetMessageCallback(const RudpMessageCallback &cb);
+            void SetMessageCallback(RudpMessageCallback &&cb);
+            // 把输出接到 UDP 套接字上发给 peer，要排队时套接字拷贝一份，重传缓冲区可以随时释放
+            // 收到的数据报要由调用方交给 Input（UdpClient/UdpServer 的接收回调或者 UdpSessionServer 的会话回调）
+            void Attach(const UdpSocketPtr &socket, const InetAddress &peer);
+
+            // 设置延迟预算，单位：毫秒，两端要设置成一样的
+            void SetLatency(int32_t ms);
+
+            // 启动定时器，之后才会发 ACK、NACK 和重传
+            void Start();
+            // 停止定时器，丢弃所有缓冲的数据
+            void Stop();
+
+            // 发送一个消息，一个消息对应一个数据包，超过 kRudpMaxPayload 时返回 false，在事件循环线程调用
+            bool Send(const char *data, size_t size);
+            // 收到对端的一个数据报，在事件循环线程调用
+            void Input(const char *data, size_t size);
+
+            // 统计数据的快照，可以在任意线程调用
+            RudpStats Stats() const;
+            // 所属的事件循环
+            EventLoop *Loop() const;
+
+        private:
+            // 发送缓冲区里的一个包，data 是完整的 DATA 报文
+            struct SendPacket
+            {
+                uint64_t seq{0};
+                int64_t first_send{0};
+                int64_t last_send{0};
+                // RTO 触发的重传次数，每次超时时间翻倍
+                int32_t timeouts{0};
+                std::string data;
+            };
+
+            // 接收缓冲区里一个乱序到达的包
+            struct RecvPacket
+            {
+                std::string payload;
+                int64_t arrive{0};
+            };
+
+            // 接收端发现的一个丢失的包
+            struct LossEntry
+            {
+                int64_t last_nack{0};
+            };
+
+            // 内部计数器，只由事件循环线程写
+            struct Counters
+            {
+                std::atomic<uint64_t> packets_sent{0};
+                std::atomic<uint64_t> packets_retrans{0};
+                std::atomic<uint64_t> packets_dropped{0};
+                std::atomic<uint64_t> packets_received{0};
+                std::atomic<uint64_t> packets_duplicate{0};
+                std::atomic<uint64_t> packets_lost{0};
+                std::atomic<uint64_t> messages_delivered{0};
+                std::atomic<uint64_t> nacks_sent{0};
+                std::atomic<uint64_t> nacks_received{0};
+                std::atomic<int32_t> rtt_ms{kRudpInitRttMs};
+                std::atomic<int32_t> rtt_var_ms{kRudpInitRttMs / 2};
+            };
+
+            // 定时器
+            void ScheduleTick();
+            void OnTick();
+
+            // 处理三种报文
+            void OnData(const RudpHeader &header, const char *data, size_t size, int64_t now);
+            void OnAck(const char *data, size_t size, int64_t now);
+            void OnNack(const char *data, size_t size, int64_t now);
+
+            // 重写时间戳和标志后重发一个包
+            void Retransmit(SendPacket &packet, int64_t now);
+            // 发送端丢弃超出延迟预算的包
+            void DropTooLate(int64_t now);
+            // 发送端对超过 RTO 还没确认的包重传
+            void RetransmitTimeout(int64_t now);
+
+            // 接收端把连续的包交付给业务层
+            void DeliverBuffered();
+            // 接收端跳过等待超过延迟预算的空洞
+            void SkipTooLate(int64_t now);
+            // 接收端放弃 next 之前还没收到的包
+            void SkipTo(uint64_t next);
+            // 发送 ACK
+            void SendAck(int64_t now);
+            // 发送到期的 NACK，force 为 true 时发送所有丢失的包
+            void SendNack(int64_t now, bool force);
+            // 把丢失的包合并成区间发出去
+            void SendNackRanges(const std::vector<uint64_t> &seqs);
+
+            // 更新 RTT 估计
+            void UpdateRtt(int32_t sample);
+            // 重传超时
+            int32_t Rto() const;
+            // NACK 的重发间隔，按对端报告的 RTT
+            int32_t NackInterval() const;
+            // 相对于创建时刻的毫秒时间戳
+            uint32_t Timestamp(int64_t now) const;
+            // 把报文交给输出回调
+            void Output(const char *data, size_t size);
+
+            EventLoop *loop_{nullptr};
+            RudpOutputCallback output_cb_;
+            RudpMessageCallback message_cb_;
+            int32_t latency_ms_{kRudpDefaultLatencyMs};
+            bool running_{false};
+            int64_t start_ms_{0};
+
+            // 发送端：下一个要用的序号，已发出还没确认的包按序号排列
+            uint64_t snd_nxt_{0};
+            std::deque<SendPacket> snd_buf_;
+
+            // 接收端：下一个要交付的序号，收到过的最大序号 + 1，乱序到达的包和丢失的包
+            uint64_t rcv_nxt_{0};
+            uint64_t rcv_max_{0};
+            std::map<uint64_t, RecvPacket> rcv_buf_;
+            std::map<uint64_t, LossEntry> loss_;
+            // 上次 ACK 之后是否收到过数据包，最近一个数据包的时间戳和到达时间，ACK 里回显
+            bool ack_pending_{false};
+            uint32_t last_data_ts_{0};
+            int64_t last_data_arrive_{0};
+            // 对端报告的 RTT
+            int32_t peer_rtt_ms_{kRudpInitRttMs};
+            // 是否已经有 RTT 样本
+            bool rtt_sampled_{false};
+
+            // 编码 ACK 和 NACK 用的缓冲区
+            char ctrl_buf_[kRudpMaxPacketSize];
+
+            Counters counters_;
+        };
+    }
+}
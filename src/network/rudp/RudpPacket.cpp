@@ -0,0 +1,128 @@
+#include "RudpPacket.h"
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace tmms::network;
+
+namespace
+{
+    void Put16(char *buf, uint16_t v)
+    {
+        v = htons(v);
+        memcpy(buf, &v, sizeof(v));
+    }
+
+    void Put32(char *buf, uint32_t v)
+    {
+        v = htonl(v);
+        memcpy(buf, &v, sizeof(v));
+    }
+
+    uint16_t Get16(const char *buf)
+    {
+        uint16_t v;
+        memcpy(&v, buf, sizeof(v));
+        return ntohs(v);
+    }
+
+    uint32_t Get32(const char *buf)
+    {
+        uint32_t v;
+        memcpy(&v, buf, sizeof(v));
+        return ntohl(v);
+    }
+}
+
+void RudpPacket::EncodeHeader(char *buf, const RudpHeader &header)
+{
+    buf[0] = (char)header.type;
+    buf[1] = (char)header.flags;
+    Put16(buf + 2, header.rtt);
+}
+
+bool RudpPacket::DecodeHeader(const char *buf, size_t size, RudpHeader *header)
+{
+    if (size < kRudpHeaderSize)
+    {
+        return false;
+    }
+    header->type = (uint8_t)buf[0];
+    header->flags = (uint8_t)buf[1];
+    header->rtt = Get16(buf + 2);
+    return true;
+}
+
+void RudpPacket::EncodeData(char *buf, uint32_t seq, uint32_t ts)
+{
+    Put32(buf + kRudpHeaderSize, seq);
+    Put32(buf + kRudpHeaderSize + 4, ts);
+}
+
+bool RudpPacket::DecodeData(const char *buf, size_t size, uint32_t *seq, uint32_t *ts)
+{
+    if (size < kRudpDataHeaderSize)
+    {
+        return false;
+    }
+    *seq = Get32(buf + kRudpHeaderSize);
+    *ts = Get32(buf + kRudpHeaderSize + 4);
+    return true;
+}
+
+size_t RudpPacket::EncodeAck(char *buf, uint16_t rtt, uint32_t ack, uint32_t echo_ts, uint32_t delay)
+{
+    RudpHeader header;
+    header.type = kRudpAck;
+    header.rtt = rtt;
+    EncodeHeader(buf, header);
+    Put32(buf + kRudpHeaderSize, ack);
+    Put32(buf + kRudpHeaderSize + 4, echo_ts);
+    Put32(buf + kRudpHeaderSize + 8, delay);
+    return kRudpAckSize;
+}
+
+bool RudpPacket::DecodeAck(const char *buf, size_t size, uint32_t *ack, uint32_t *echo_ts, uint32_t *delay)
+{
+    if (size < kRudpAckSize)
+    {
+        return false;
+    }
+    *ack = Get32(buf + kRudpHeaderSize);
+    *echo_ts = Get32(buf + kRudpHeaderSize + 4);
+    *delay = Get32(buf + kRudpHeaderSize + 8);
+    return true;
+}
+
+size_t RudpPacket::EncodeNack(char *buf, uint16_t rtt, const RudpNackRange *ranges, size_t count)
+{
+    RudpHeader header;
+    header.type = kRudpNack;
+    header.rtt = rtt;
+    EncodeHeader(buf, header);
+    if (count > kRudpMaxNackRanges)
+    {
+        count = kRudpMaxNackRanges;
+    }
+    char *p = buf + kRudpHeaderSize;
+    for (size_t i = 0; i < count; i++)
+    {
+        Put32(p, ranges[i].seq);
+        Put16(p + 4, ranges[i].count);
+        p += kRudpNackRangeSize;
+    }
+    return p - buf;
+}
+
+size_t RudpPacket::NackRanges(size_t size)
+{
+    return size < kRudpHeaderSize ? 0 : (size - kRudpHeaderSize) / kRudpNackRangeSize;
+}
+
+RudpNackRange RudpPacket::DecodeNackRange(const char *buf, size_t index)
+{
+    const char *p = buf + kRudpHeaderSize + index * kRudpNackRangeSize;
+    RudpNackRange range;
+    range.seq = Get32(p);
+    range.count = Get16(p + 4);
+    return range;
+}
@@ -0,0 +1,82 @@
+#pragma once
+/*
+    可靠 UDP 的报文格式，所有字段都是网络字节序
+    公共头 4 字节：类型(1) 标志(1) RTT(2)，RTT 是发送方当前的平滑 RTT，单位：毫秒，对端据此决定 NACK 的间隔
+    DATA：公共头 + 序号(4) + 时间戳(4) + 负载，时间戳是发送方的毫秒时钟，每次（重）发送时重写
+    ACK ：公共头 + 下一个期望的序号(4) + 回显的时间戳(4) + 回显前在接收端停留的时间(4)
+    NACK：公共头 + 若干个丢失区间，每个区间是起始序号(4) + 个数(2)
+    序号在报文里只有 32 位，两端内部用 64 位，收到时按离参考序号最近的方式还原
+*/
+#include <cstddef>
+#include <cstdint>
+
+namespace tmms
+{
+    namespace network
+    {
+        // 报文类型
+        enum RudpPacketType
+        {
+            kRudpData = 1,
+            kRudpAck = 2,
+            kRudpNack = 3
+        };
+
+        // DATA 的标志位：这是一次重传
+        const uint8_t kRudpFlagRetrans = 0x01;
+
+        // 公共头、DATA 头、ACK 和一个 NACK 区间的大小
+        const size_t kRudpHeaderSize = 4;
+        const size_t kRudpDataHeaderSize = 12;
+        const size_t kRudpAckSize = 16;
+        const size_t kRudpNackRangeSize = 6;
+        // 一个报文最大的大小，以太网 MTU 1500 减去 IP 头 20 字节和 UDP 头 8 字节
+        const size_t kRudpMaxPacketSize = 1472;
+        // 一个 DATA 最多携带的负载
+        const size_t kRudpMaxPayload = kRudpMaxPacketSize - kRudpDataHeaderSize;
+        // 一个 NACK 最多携带的区间个数
+        const size_t kRudpMaxNackRanges = (kRudpMaxPacketSize - kRudpHeaderSize) / kRudpNackRangeSize;
+
+        // 公共头
+        struct RudpHeader
+        {
+            uint8_t type{0};
+            uint8_t flags{0};
+            uint16_t rtt{0};
+        };
+
+        // 一个丢失区间
+        struct RudpNackRange
+        {
+            uint32_t seq{0};
+            uint16_t count{0};
+        };
+
+        // 报文的编码和解码，buf 的大小由调用方保证
+        class RudpPacket
+        {
+        public:
+            // 写公共头
+            static void EncodeHeader(char *buf, const RudpHeader &header);
+            // 读公共头，长度不够返回 false
+            static bool DecodeHeader(const char *buf, size_t size, RudpHeader *header);
+
+            // 写 DATA 头（公共头之后的序号和时间戳）
+            static void EncodeData(char *buf, uint32_t seq, uint32_t ts);
+            // 读 DATA 头，长度不够返回 false
+            static bool DecodeData(const char *buf, size_t size, uint32_t *seq, uint32_t *ts);
+
+            // 写一个完整的 ACK，返回长度
+            static size_t EncodeAck(char *buf, uint16_t rtt, uint32_t ack, uint32_t echo_ts, uint32_t delay);
+            // 读 ACK，长度不够返回 false
+            static bool DecodeAck(const char *buf, size_t size, uint32_t *ack, uint32_t *echo_ts, uint32_t *delay);
+
+            // 写一个完整的 NACK，最多写 kRudpMaxNackRanges 个区间，返回长度
+            static size_t EncodeNack(char *buf, uint16_t rtt, const RudpNackRange *ranges, size_t count);
+            // 读 NACK 里的区间个数
+            static size_t NackRanges(size_t size);
+            // 读 NACK 里的第 index 个区间
+            static RudpNackRange DecodeNackRange(const char *buf, size_t index);
+        };
+    }
+}